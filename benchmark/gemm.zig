@@ -20,8 +20,9 @@ const GemmOperation = wekua.blas.GemmOperation;
 
 fn toCblasTranspose(op: GemmOperation) c_uint {
     return switch (op) {
-        .no_transpose => utils.openblas.CblasNoTrans,
+        .no_transpose, .conjugate => utils.openblas.CblasNoTrans,
         .transpose => utils.openblas.CblasTrans,
+        .conjugate_transpose => utils.openblas.CblasConjTrans,
     };
 }
 
@@ -29,6 +30,8 @@ fn opName(op: GemmOperation) []const u8 {
     return switch (op) {
         .no_transpose => "N",
         .transpose => "T",
+        .conjugate => "R",
+        .conjugate_transpose => "C",
     };
 }
 
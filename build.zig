@@ -22,6 +22,7 @@ pub fn build(b: *std.Build) void {
         .optimize = optimize,
     });
     core_module.addImport("opencl", opencl_module);
+    core_module.addImport("utils", utils_module);
 
     const tensor_module = b.addModule("tensor", .{
         .root_source_file = b.path("src/tensor/main.zig"),
@@ -120,6 +120,8 @@ pub fn axpy(
         substract
     );
 
+    y.markModified();
+
     const prev_events = pipeline.prevEvents();
 
     const setArg = cl.kernel.setArg;
@@ -10,6 +10,7 @@ const tensor_module = @import("tensor");
 const Tensor = tensor_module.Tensor;
 const TensorErrors = tensor_module.Errors;
 const GemmAlgorithm = tensor_module.GemmAlgorithm;
+const GemmRectangularBlock = tensor_module.GemmRectangularBlock;
 
 const GEMM_2x2_KERNEL: []const u8 = @embedFile("kernels/gemm_2x2.cl");
 const GEMM_NXN_KERNEL: []const u8 = @embedFile("kernels/gemm_nxn.cl");
@@ -22,12 +23,76 @@ const GEMM_NXN_PACK_KERNEL: []const u8 = @embedFile("kernels/gemm_nxn_pack.cl");
 
 const GEMM_PACK_TILES_KERNEL: []const u8 = @embedFile("kernels/gemm_pack.cl");
 
+const gemv_module = @import("gemv.zig");
+const split_k_module = @import("split_k.zig");
+
 pub const Operation = enum(u8) {
     no_transpose = 0,
     transpose = 1,
-    // ConjugateTranspose // TODO
+    /// Complex conjugate, the same as `no_transpose` for real types
+    conjugate = 2,
+    /// Conjugate transpose (Hermitian), the same as `transpose` for real types
+    conjugate_transpose = 3,
+
+    pub inline fn isTransposed(self: Operation) bool {
+        return (@intFromEnum(self) & 1) != 0;
+    }
+
+    pub inline fn isConjugated(self: Operation) bool {
+        return (@intFromEnum(self) & 2) != 0;
+    }
+
+    // Conjugating does nothing on real types, so they share the kernels and the tuning of the
+    // operations without it
+    pub inline fn forType(self: Operation, comptime T: type) Operation {
+        if (comptime core.types.isComplex(T)) return self;
+        return @enumFromInt(@intFromEnum(self) & 1);
+    }
+};
+
+/// Activations the GEMM kernels can apply to the result before writing it, see `Epilogue`.
+pub const EpilogueActivation = enum(u8) {
+    none = 0,
+    sigmoid = 1,
+    tanh = 2,
+    relu = 3,
 };
 
+/// Work done by the GEMM kernels on every element of the result once the product is computed, so
+/// it doesn't need passes of its own over the result. `bias`, a row vector with as many elements as
+/// the result has columns, is added to every row, then `activation` is applied and its derivative
+/// (computed from its output) is written to `derivative`, which has the shape of the result.
+/// Only for real types, sigmoid and tanh also need floats.
+pub fn Epilogue(comptime T: type) type {
+    return struct {
+        bias: ?*Tensor(T) = null,
+        activation: EpilogueActivation = .none,
+        derivative: ?*Tensor(T) = null,
+
+        const Self = @This();
+
+        // 0 when there is nothing to do, the kernels without epilogue are used then
+        pub fn getIndex(self: Self) usize {
+            var index: usize = @intFromBool(self.bias != null);
+            index |= @as(usize, @intFromEnum(self.activation)) << 1;
+            index |= @as(usize, @intFromBool(self.derivative != null)) << 3;
+            return index;
+        }
+    };
+}
+
+pub const EPILOGUE_VARIANTS = 16;
+
+pub fn getEpilogueArgs(buf: *[128]u8, epilogue_index: usize) []const u8 {
+    if (epilogue_index == 0) return "";
+
+    return std.fmt.bufPrint(
+        buf,
+        " -DWK_GEMM_EPILOGUE -DWK_GEMM_BIAS={d} -DWK_GEMM_ACTIVATION={d} -DWK_GEMM_DERIVATIVE={d}",
+        .{ epilogue_index & 1, (epilogue_index >> 1) & 3, epilogue_index >> 3 },
+    ) catch unreachable;
+}
+
 inline fn getBlockSizeFromAlgorithm(algorithm: GemmAlgorithm) u16 {
     return switch (algorithm) {
         .@"2x2" => 2,
@@ -39,7 +104,7 @@ inline fn getBlockSizeFromAlgorithm(algorithm: GemmAlgorithm) u16 {
     };
 }
 
-inline fn getAlgorithm(
+pub inline fn getAlgorithm(
     default_algorithm: GemmAlgorithm,
     k_size: u64,
 ) GemmAlgorithm {
@@ -57,6 +122,117 @@ inline fn getAlgorithm(
     @panic("Unsupported block size");
 }
 
+fn getAlgorithmFromBlockSize(block_size: u64) ?GemmAlgorithm {
+    return switch (block_size) {
+        2 => .@"2x2",
+        4 => .@"4x4",
+        8 => .@"8x8",
+        16 => .@"16x16",
+        32 => .@"32x32",
+        64 => .@"64x64",
+        else => null,
+    };
+}
+
+// Choices made by `tune` are kept in the tuning table of the command queue (`core.WorkGroupTuner`),
+// so they are saved and loaded along with the local work sizes:
+//   gemm/<type>/<op_a><op_b>/<m>/<n>/<k> -> { unpacked block size, 1: unpacked or 2: packed is faster, 1 }
+//   gemm_pack/<type>/<m>/<n>/<k>         -> { packed block size, 1, 1 }
+// where m, n and k are ceil(log2) of the sizes of the product.
+fn writeTuningKey(
+    buf: *[128]u8,
+    comptime T: type,
+    operations: ?[2]Operation,
+    m_size: u64,
+    n_size: u64,
+    k_size: u64,
+) []const u8 {
+    const log2 = std.math.log2_int_ceil;
+    const m = log2(u64, @max(m_size, 1));
+    const n = log2(u64, @max(n_size, 1));
+    const k = log2(u64, @max(k_size, 1));
+    const type_index = core.types.getTypeIndex(T);
+
+    if (operations) |ops| {
+        return std.fmt.bufPrint(buf, "gemm/{d}/{d}{d}/{d}/{d}/{d}", .{
+            type_index, @intFromEnum(ops[0].forType(T)), @intFromEnum(ops[1].forType(T)), m, n, k,
+        }) catch unreachable;
+    }
+
+    return std.fmt.bufPrint(buf, "gemm_pack/{d}/{d}/{d}/{d}", .{ type_index, m, n, k }) catch unreachable;
+}
+
+// Tuned algorithms are never allowed to exceed the one of the work configuration, bigger blocks
+// have no work items configured for the result tensor.
+inline fn clampAlgorithm(algorithm: GemmAlgorithm, max_algorithm: GemmAlgorithm) GemmAlgorithm {
+    return @enumFromInt(@min(@intFromEnum(algorithm), @intFromEnum(max_algorithm)));
+}
+
+// GEMM works on the last two dimensions, a third one is a batch of independent products
+pub inline fn getBatches(shape: []const u64) u64 {
+    return if (shape.len == 3) shape[0] else 1;
+}
+
+pub inline fn getRows(shape: []const u64) u64 {
+    return shape[shape.len - 2];
+}
+
+pub inline fn getCols(shape: []const u64) u64 {
+    return shape[shape.len - 1];
+}
+
+const TunedChoice = struct {
+    algorithm: GemmAlgorithm,
+    use_packing: bool,
+};
+
+fn getTunedChoice(
+    comptime T: type,
+    command_queue: *const CommandQueue,
+    a: *Tensor(T),
+    op_a: Operation,
+    op_b: Operation,
+    c: *Tensor(T),
+) ?TunedChoice {
+    const a_shape = a.dimensions.shape;
+    const c_shape = c.dimensions.shape;
+
+    var key_buf: [128]u8 = undefined;
+    const key = writeTuningKey(
+        &key_buf,
+        T,
+        .{ op_a, op_b },
+        getRows(c_shape),
+        getCols(c_shape),
+        a_shape[a_shape.len - 1 - @intFromBool(op_a.isTransposed())],
+    );
+
+    const entry = core.WorkGroupTuner.getByKey(command_queue, key) orelse return null;
+    const algorithm = getAlgorithmFromBlockSize(entry[0]) orelse return null;
+
+    return .{
+        .algorithm = clampAlgorithm(
+            algorithm,
+            c.work_configuration.gemm_algorithm_per_device[command_queue.wekua_id],
+        ),
+        .use_packing = (entry[1] == 2),
+    };
+}
+
+fn getTunedPackedAlgorithm(
+    comptime T: type,
+    command_queue: *const CommandQueue,
+    m_size: u64,
+    n_size: u64,
+    k_size: u64,
+) ?GemmAlgorithm {
+    var key_buf: [128]u8 = undefined;
+    const key = writeTuningKey(&key_buf, T, null, m_size, n_size, k_size);
+
+    const entry = core.WorkGroupTuner.getByKey(command_queue, key) orelse return null;
+    return getAlgorithmFromBlockSize(entry[0]);
+}
+
 pub fn PackedTensors(comptime T: type) type {
     const TensorT = Tensor(T);
 
@@ -67,13 +243,35 @@ pub fn PackedTensors(comptime T: type) type {
         n_size: u64,
         k_size: u64,
 
+        max_m_size: u64,
+        max_n_size: u64,
+        max_k_size: u64,
+
+        // The tiles of every product of the batch follow each other in the packed tensors
+        batches: u64,
+
         packed_a: *TensorT,
         packed_b: *TensorT,
         vectors_enabled: bool,
         algorithm: GemmAlgorithm,
 
+        // With `persistent_b` the tiles of B are only packed again when B changes, see
+        // `setPersistentB`. `packed_b_source` is what `packed_b` currently holds.
+        persistent_b: bool,
+        packed_b_source: ?PackedOperand,
+
+        // Partial sums of products split along K, only allocated for results with fewer tiles
+        // than the device has compute units, see `split_k.zig`
+        split_k_partials: ?*TensorT,
+
         const Self = @This();
 
+        const PackedOperand = struct {
+            tensor: *const TensorT,
+            op: Operation,
+            version: u64,
+        };
+
         pub fn init(
             pipeline: *Pipeline,
             result_tensor: *Tensor(T),
@@ -81,19 +279,33 @@ pub fn PackedTensors(comptime T: type) type {
             vectors_enabled: bool,
         ) TensorErrors!*Self {
             const shape = result_tensor.dimensions.shape;
-            if (shape.len != 2) {
+            if ((shape.len != 2 and shape.len != 3) or result_tensor.flags.compact) {
                 return tensor_module.Errors.InvalidValue;
             }
 
-            const wekua_id = pipeline.command_queue.wekua_id;
-            return initInternal(
+            const rows = getRows(shape);
+            const cols = getCols(shape);
+
+            const command_queue = pipeline.command_queue;
+            var algorithm = result_tensor.work_configuration.gemm_algorithm_per_device[command_queue.wekua_id];
+            if (getTunedPackedAlgorithm(T, command_queue, rows, cols, k_size)) |tuned_algorithm| {
+                algorithm = clampAlgorithm(tuned_algorithm, algorithm);
+            }
+
+            const self = try initInternal(
                 pipeline,
-                shape[0],
-                shape[1],
+                getBatches(shape),
+                rows,
+                cols,
                 k_size,
-                result_tensor.work_configuration.gemm_algorithm_per_device[wekua_id],
+                algorithm,
                 vectors_enabled,
             );
+            errdefer self.deinit(pipeline);
+
+            self.split_k_partials = try split_k_module.allocPartials(T, pipeline, result_tensor, k_size);
+
+            return self;
         }
 
         pub fn initWithDimensions(
@@ -106,6 +318,7 @@ pub fn PackedTensors(comptime T: type) type {
         ) TensorErrors!*Self {
             return initInternal(
                 pipeline,
+                1,
                 n_size,
                 m_size,
                 k_size,
@@ -116,6 +329,7 @@ pub fn PackedTensors(comptime T: type) type {
 
         fn initInternal(
             pipeline: *Pipeline,
+            batches: u64,
             n_size: u64,
             m_size: u64,
             k_size: u64,
@@ -155,7 +369,7 @@ pub fn PackedTensors(comptime T: type) type {
             const packed_a = try TensorT.alloc(
                 context,
                 pipeline,
-                &.{ padded_n_size / block_size, row_size, col_size },
+                &.{ batches * (padded_n_size / block_size), row_size, col_size },
                 .{ .vectors_enabled = vectors_enabled },
             );
             errdefer packed_a.release(pipeline);
@@ -163,7 +377,7 @@ pub fn PackedTensors(comptime T: type) type {
             const packed_b = try TensorT.alloc(
                 context,
                 pipeline,
-                &.{ padded_m_size / block_size, row_size, col_size },
+                &.{ batches * (padded_m_size / block_size), row_size, col_size },
                 .{ .vectors_enabled = vectors_enabled },
             );
             errdefer packed_b.release(pipeline);
@@ -176,55 +390,122 @@ pub fn PackedTensors(comptime T: type) type {
                 .n_size = n_size,
                 .k_size = k_size,
 
+                .max_m_size = m_size,
+                .max_n_size = n_size,
+                .max_k_size = k_size,
+
+                .batches = batches,
+
                 .packed_a = packed_a,
                 .packed_b = packed_b,
                 .vectors_enabled = !is_complex and vectors_enabled,
                 .algorithm = recommended_algorithm,
+
+                .persistent_b = false,
+                .packed_b_source = null,
+
+                .split_k_partials = null,
             };
 
             return self;
         }
 
+        /// Sets the sizes of the products computed with these packed tensors, each one up to the
+        /// size they were created for. Nothing is allocated, so packed tensors created for the
+        /// largest batch can be used with any smaller one.
+        pub fn resize(
+            self: *Self,
+            pipeline: *Pipeline,
+            n_size: u64,
+            m_size: u64,
+            k_size: u64,
+        ) TensorErrors!void {
+            if (n_size == 0 or m_size == 0 or k_size == 0 or n_size > self.max_n_size or
+                m_size > self.max_m_size or k_size > self.max_k_size)
+            {
+                return tensor_module.Errors.InvalidValue;
+            }
+
+            // Packing only writes the elements inside the matrices and the tiles are always
+            // multiplied whole, so what a larger product left outside of them must be cleared
+            if (n_size < self.n_size or k_size < self.k_size) {
+                try tensor_module.fill.zeroes(T, pipeline, self.packed_a);
+            }
+
+            // The tiles of B only depend on m and k, a new batch size keeps persistent ones
+            if (m_size != self.m_size or k_size != self.k_size) {
+                if (m_size < self.m_size or k_size < self.k_size) {
+                    try tensor_module.fill.zeroes(T, pipeline, self.packed_b);
+                }
+                self.packed_b_source = null;
+            }
+
+            self.n_size = n_size;
+            self.m_size = m_size;
+            self.k_size = k_size;
+        }
+
+        /// Keeps the tiles of B between products, for weights that don't change between
+        /// inference requests. B is packed by the first product and again only when a product
+        /// uses another tensor or operation, or when `Tensor.version` of B changed (every write to
+        /// B changes it, see `Tensor.markModified`).
+        pub fn setPersistentB(self: *Self, persistent: bool) void {
+            self.persistent_b = persistent;
+            self.packed_b_source = null;
+        }
+
         pub fn deinit(self: *Self, pipeline: *Pipeline) void {
             self.packed_a.release(pipeline);
             self.packed_b.release(pipeline);
+            if (self.split_k_partials) |v| v.release(pipeline);
 
             pipeline.allocator.destroy(self);
         }
 
+        // `S` is `T` or, for f32 packed tensors, the storage type widened while packing
         fn getPackKernel(
             self: *const Self,
+            comptime S: type,
             command_queue: *const CommandQueue,
             transpose: bool,
+            conjugate: bool,
         ) TensorErrors!cl.kernel.Kernel {
-            const SUPPORTED_TYPES = core.types.SUPPORTED_TYPES;
+            const is_storage = comptime core.types.isStorageType(S);
+            const types_len = if (is_storage) core.types.STORAGE_TYPES.len else core.types.SUPPORTED_TYPES.len;
             const num_algorithms = std.meta.fields(GemmAlgorithm).len;
-            const kernels_per_algorithm = 2 * 2 * SUPPORTED_TYPES.len;
+            const kernels_per_algorithm = 2 * 2 * 2 * types_len;
 
+            // Storage types are never conjugated, their kernels have a set of their own
             const kernels_set = try KernelsSet.getKernelSet(
                 command_queue,
-                .PackGEMMTiles,
+                if (is_storage) .PackGEMMStorageTiles else .PackGEMMTiles,
                 num_algorithms * kernels_per_algorithm,
             );
 
             const vectors_enabled = self.vectors_enabled;
 
             var kernel_index: usize = @intFromEnum(self.algorithm) * kernels_per_algorithm;
-            kernel_index += @intFromBool(vectors_enabled) * (2 * SUPPORTED_TYPES.len);
-            kernel_index += @intFromBool(transpose) * SUPPORTED_TYPES.len;
-            kernel_index += @as(usize, core.types.getTypeIndex(T));
+            kernel_index += @intFromBool(vectors_enabled) * (2 * 2 * types_len);
+            kernel_index += @intFromBool(transpose) * (2 * types_len);
+            kernel_index += @intFromBool(conjugate) * types_len;
+            kernel_index += @as(usize, if (is_storage) core.types.getStorageTypeIndex(S) else core.types.getTypeIndex(T));
 
             if (kernels_set.kernels.?[kernel_index]) |v| return v;
 
             var kernel: cl.kernel.Kernel = undefined;
             var program: cl.program.Program = undefined;
 
+            const storage_args = if (is_storage)
+                std.fmt.comptimePrint(" -DWK_STORAGE_TYPE={d}", .{core.types.getStorageTypeIndex(S)})
+            else
+                "";
+
             const block_size = getBlockSizeFromAlgorithm(self.algorithm);
             const allocator = command_queue.context.allocator;
             const extra_args = try std.fmt.allocPrint(
                 allocator,
-                "-DTRANSPOSE={d} -DBLOCK_SIZE={d}",
-                .{ @intFromBool(transpose), block_size },
+                "-DTRANSPOSE={d} -DCONJUGATE={d} -DBLOCK_SIZE={d}{s}",
+                .{ @intFromBool(transpose), @intFromBool(conjugate), block_size, storage_args },
             );
             defer allocator.free(extra_args);
 
@@ -249,20 +530,35 @@ pub fn PackedTensors(comptime T: type) type {
 
         inline fn validateTensors(
             self: *Self,
-            a: *TensorT,
+            comptime S: type,
+            a: *Tensor(S),
             op_a: Operation,
-            b: *TensorT,
+            b: *Tensor(S),
             op_b: Operation,
         ) TensorErrors!void {
-            var valid = switch (op_a) {
-                .no_transpose => (a.dimensions.shape[0] == self.n_size and a.dimensions.shape[1] == self.k_size),
-                .transpose => (a.dimensions.shape[1] == self.n_size and a.dimensions.shape[0] == self.k_size),
-            };
+            const a_shape = a.dimensions.shape;
+            const b_shape = b.dimensions.shape;
 
-            valid &= switch (op_b) {
-                .no_transpose => (b.dimensions.shape[0] == self.k_size and b.dimensions.shape[1] == self.m_size),
-                .transpose => (b.dimensions.shape[1] == self.k_size and b.dimensions.shape[0] == self.m_size),
-            };
+            const a_rows = getRows(a_shape);
+            const a_cols = getCols(a_shape);
+            const b_rows = getRows(b_shape);
+            const b_cols = getCols(b_shape);
+
+            var valid = if (op_a.isTransposed())
+                (a_cols == self.n_size and a_rows == self.k_size)
+            else
+                (a_rows == self.n_size and a_cols == self.k_size);
+
+            valid &= if (op_b.isTransposed())
+                (b_cols == self.k_size and b_rows == self.m_size)
+            else
+                (b_rows == self.k_size and b_cols == self.m_size);
+
+            // Operands without a batch are broadcast to every product
+            const a_batches = getBatches(a_shape);
+            const b_batches = getBatches(b_shape);
+            valid &= (a_batches == 1 or a_batches == self.batches);
+            valid &= (b_batches == 1 or b_batches == self.batches);
 
             if (!valid) {
                 return tensor_module.Errors.InvalidValue;
@@ -277,88 +573,145 @@ pub fn PackedTensors(comptime T: type) type {
             b: *TensorT,
             op_b: Operation,
         ) TensorErrors!void {
-            try self.validateTensors(a, op_a, b, op_b);
+            try self.packOperands(T, pipeline, a, op_a, b, op_b);
+        }
 
-            const command_queue = pipeline.command_queue;
-            const wekua_id = command_queue.wekua_id;
+        /// Packs f16 or bf16 operands, widening them to f32. Only available for f32 packed
+        /// tensors, see `mixed.gemm`.
+        pub fn packStorage(
+            self: *Self,
+            comptime S: type,
+            pipeline: *Pipeline,
+            a: *Tensor(S),
+            op_a: Operation,
+            b: *Tensor(S),
+            op_b: Operation,
+        ) TensorErrors!void {
+            if (comptime (T != f32 or !core.types.isStorageType(S))) {
+                @compileError("Storage operands are only packed into f32 packed tensors");
+            }
 
-            const a_transpose = (op_a == .transpose);
-            const b_transpose = (op_b == .no_transpose); // inverted for B
+            try self.packOperands(S, pipeline, a, op_a, b, op_b);
+        }
 
-            const kernel_a = try self.getPackKernel(command_queue, a_transpose);
-            const kernel_b = try self.getPackKernel(command_queue, b_transpose);
+        // Enqueues the packing of the operand `x` into `packed_x`
+        fn enqueuePack(
+            self: *const Self,
+            comptime S: type,
+            command_queue: *const CommandQueue,
+            x: *Tensor(S),
+            transpose: bool,
+            conjugate: bool,
+            packed_x: *TensorT,
+            prev_events: ?[]const cl.event.Event,
+        ) TensorErrors!cl.event.Event {
+            const kernel = try self.getPackKernel(S, command_queue, transpose, conjugate);
 
             const setArg = cl.kernel.setArg;
             const cl_mem_size = @sizeOf(cl.buffer.Mem);
 
-            const packed_a = self.packed_a;
-            const packed_b = self.packed_b;
-
-            const a_src_pitch = a.memory_layout.row_pitch;
-            const a_dst_slice = packed_a.memory_layout.slice_pitch;
-            const a_dst_pitch = packed_a.memory_layout.row_pitch;
+            const src_pitch = x.memory_layout.row_pitch;
+            const dst_slice = packed_x.memory_layout.slice_pitch;
+            const dst_pitch = packed_x.memory_layout.row_pitch;
 
-            const b_src_pitch = b.memory_layout.row_pitch;
-            const b_dst_slice = packed_b.memory_layout.slice_pitch;
-            const b_dst_pitch = packed_b.memory_layout.row_pitch;
+            // Broadcast operands are packed again for every product, so the GEMM kernel reads
+            // the tiles of both operands the same way
+            const src_slice: u64 = if (getBatches(x.dimensions.shape) == 1) 0 else x.memory_layout.slice_pitch;
+            const tiles_per_matrix = packed_x.dimensions.shape[0] / self.batches;
 
-            const a_global: []const u64 = &self.packed_a.work_configuration.global_work_items_without_vectors;
-            const a_local: []const u64 = &self.packed_a.work_configuration.local_work_items_without_vectors[wekua_id];
+            const wekua_id = command_queue.wekua_id;
+            const global: []const u64 = &packed_x.work_configuration.global_work_items_without_vectors;
+            const local: []const u64 = &packed_x.work_configuration.local_work_items_without_vectors[wekua_id];
+
+            const shape = x.dimensions.shape;
+            const rows = getRows(shape);
+            const cols = getCols(shape);
+
+            try setArg(kernel, 0, cl_mem_size, @ptrCast(&x.buffer));
+            try setArg(kernel, 1, cl_mem_size, @ptrCast(&packed_x.buffer));
+            try setArg(kernel, 2, @sizeOf(u64), @ptrCast(&src_pitch));
+            try setArg(kernel, 3, @sizeOf(u64), @ptrCast(&dst_slice));
+            try setArg(kernel, 4, @sizeOf(u64), @ptrCast(&dst_pitch));
+            try setArg(kernel, 5, @sizeOf(u64), @ptrCast(&rows));
+            try setArg(kernel, 6, @sizeOf(u64), @ptrCast(&cols));
+            try setArg(kernel, 7, @sizeOf(u64), @ptrCast(&src_slice));
+            try setArg(kernel, 8, @sizeOf(u64), @ptrCast(&tiles_per_matrix));
+
+            var new_event: cl.event.Event = undefined;
+            try cl.kernel.enqueueNdRange(
+                command_queue.cl_command_queue,
+                kernel,
+                null,
+                global,
+                local,
+                prev_events,
+                &new_event,
+            );
 
-            const b_global: []const u64 = &self.packed_b.work_configuration.global_work_items_without_vectors;
-            const b_local: []const u64 = &self.packed_b.work_configuration.local_work_items_without_vectors[wekua_id];
+            return new_event;
+        }
 
-            const a_shape = a.dimensions.shape;
-            const b_shape = b.dimensions.shape;
+        fn packOperands(
+            self: *Self,
+            comptime S: type,
+            pipeline: *Pipeline,
+            a: *Tensor(S),
+            op_a: Operation,
+            b: *Tensor(S),
+            op_b: Operation,
+        ) TensorErrors!void {
+            try self.validateTensors(S, a, op_a, b, op_b);
 
+            const command_queue = pipeline.command_queue;
             const prev_events = pipeline.prevEvents();
 
-            try setArg(kernel_a, 0, cl_mem_size, @ptrCast(&a.buffer));
-            try setArg(kernel_a, 1, cl_mem_size, @ptrCast(&self.packed_a.buffer));
-            try setArg(kernel_a, 2, @sizeOf(u64), @ptrCast(&a_src_pitch));
-            try setArg(kernel_a, 3, @sizeOf(u64), @ptrCast(&a_dst_slice));
-            try setArg(kernel_a, 4, @sizeOf(u64), @ptrCast(&a_dst_pitch));
-            try setArg(kernel_a, 5, @sizeOf(u64), @ptrCast(&a_shape[0]));
-            try setArg(kernel_a, 6, @sizeOf(u64), @ptrCast(&a_shape[1]));
-
-            var event_a: cl.event.Event = undefined;
-            try cl.kernel.enqueueNdRange(
-                command_queue.cl_command_queue,
-                kernel_a,
-                null,
-                a_global,
-                a_local,
+            // Conjugated operands are conjugated while they are packed, the GEMM kernels don't
+            // need to know about it
+            const event_a = try self.enqueuePack(
+                S,
+                command_queue,
+                a,
+                op_a.isTransposed(),
+                op_a.forType(T).isConjugated(),
+                self.packed_a,
                 prev_events,
-                &event_a,
             );
             errdefer tensor_module.helpers.releaseEvent(event_a);
 
-            try setArg(kernel_b, 0, cl_mem_size, @ptrCast(&b.buffer));
-            try setArg(kernel_b, 1, cl_mem_size, @ptrCast(&self.packed_b.buffer));
-            try setArg(kernel_b, 2, @sizeOf(u64), @ptrCast(&b_src_pitch));
-            try setArg(kernel_b, 3, @sizeOf(u64), @ptrCast(&b_dst_slice));
-            try setArg(kernel_b, 4, @sizeOf(u64), @ptrCast(&b_dst_pitch));
-            try setArg(kernel_b, 5, @sizeOf(u64), @ptrCast(&b_shape[0]));
-            try setArg(kernel_b, 6, @sizeOf(u64), @ptrCast(&b_shape[1]));
+            const b_source: ?PackedOperand = if (comptime S != T)
+                null
+            else if (self.persistent_b)
+                .{ .tensor = b, .op = op_b, .version = b.version }
+            else
+                null;
+
+            if (b_source) |source| {
+                if (self.packed_b_source) |packed_source| {
+                    if (std.meta.eql(source, packed_source)) {
+                        try pipeline.append(&.{event_a});
+                        return;
+                    }
+                }
+            }
 
-            var event_b: cl.event.Event = undefined;
-            try cl.kernel.enqueueNdRange(
-                command_queue.cl_command_queue,
-                kernel_b,
-                null,
-                b_global,
-                b_local,
+            const event_b = try self.enqueuePack(
+                S,
+                command_queue,
+                b,
+                !op_b.isTransposed(), // inverted for B
+                op_b.forType(T).isConjugated(),
+                self.packed_b,
                 prev_events,
-                &event_b,
             );
             errdefer tensor_module.helpers.releaseEvent(event_b);
 
             try pipeline.append(&.{ event_a, event_b });
+            self.packed_b_source = b_source;
         }
     };
 }
 
-fn getGemmKernelWithoutPacking(
+pub fn getGemmKernelWithoutPacking(
     comptime T: type,
     command_queue: *const CommandQueue,
     vectors_enabled: bool,
@@ -367,23 +720,37 @@ fn getGemmKernelWithoutPacking(
     op_a: Operation,
     op_b: Operation,
     algorithm: GemmAlgorithm,
+    rectangular_block: ?GemmRectangularBlock,
+    epilogue_index: usize,
 ) TensorErrors!cl.kernel.Kernel {
     const SUPPORTED_TYPES = core.types.SUPPORTED_TYPES;
-    const num_algorithms = std.meta.fields(GemmAlgorithm).len;
-    const kernels_per_algorithm = 2 * 2 * 2 * 2 * 2 * SUPPORTED_TYPES.len;
+    const num_algorithms = std.meta.fields(GemmAlgorithm).len + std.meta.fields(GemmRectangularBlock).len;
+    const kernels_per_algorithm = 2 * 2 * 2 * 4 * 4 * SUPPORTED_TYPES.len;
 
+    // Kernels with an epilogue have a set of their own
+    const has_epilogue = (epilogue_index != 0);
     const kernels_set = try KernelsSet.getKernelSet(
         command_queue,
-        .GEMM,
-        num_algorithms * kernels_per_algorithm,
+        if (has_epilogue) .GEMMEpilogue else .GEMM,
+        num_algorithms * kernels_per_algorithm * @as(usize, if (has_epilogue) EPILOGUE_VARIANTS - 1 else 1),
     );
 
-    var kernel_index: usize = @intFromEnum(algorithm) * kernels_per_algorithm;
-    kernel_index += @intFromBool(vectors_enabled) * (2 * 2 * 2 * 2 * SUPPORTED_TYPES.len);
-    kernel_index += @intFromBool(has_alpha) * (2 * 2 * 2 * SUPPORTED_TYPES.len);
-    kernel_index += @intFromBool(has_beta) * (2 * 2 * SUPPORTED_TYPES.len);
-    kernel_index += @intFromEnum(op_a) * (2 * SUPPORTED_TYPES.len);
-    kernel_index += @intFromEnum(op_b) * SUPPORTED_TYPES.len;
+    // Rectangular blocks go after the square ones, `algorithm` is then the step over K
+    const algorithm_index: usize = if (rectangular_block) |v|
+        std.meta.fields(GemmAlgorithm).len + @intFromEnum(v)
+    else
+        @intFromEnum(algorithm);
+
+    var kernel_index: usize = (epilogue_index -| 1) * (num_algorithms * kernels_per_algorithm);
+    kernel_index += algorithm_index * kernels_per_algorithm;
+    const type_op_a = op_a.forType(T);
+    const type_op_b = op_b.forType(T);
+
+    kernel_index += @intFromBool(vectors_enabled) * (2 * 2 * 4 * 4 * SUPPORTED_TYPES.len);
+    kernel_index += @intFromBool(has_alpha) * (2 * 4 * 4 * SUPPORTED_TYPES.len);
+    kernel_index += @intFromBool(has_beta) * (4 * 4 * SUPPORTED_TYPES.len);
+    kernel_index += @intFromEnum(type_op_a) * (4 * SUPPORTED_TYPES.len);
+    kernel_index += @intFromEnum(type_op_b) * SUPPORTED_TYPES.len;
     kernel_index += @as(usize, core.types.getTypeIndex(T));
 
     if (kernels_set.kernels.?[kernel_index]) |v| return v;
@@ -394,22 +761,34 @@ fn getGemmKernelWithoutPacking(
     const stride = @intFromEnum(algorithm) + 1;
     const block_size = getBlockSizeFromAlgorithm(algorithm);
 
+    var block_shape_buf: [64]u8 = undefined;
+    const block_shape_args: []const u8 = if (rectangular_block) |v|
+        std.fmt.bufPrint(&block_shape_buf, " -DBLOCK_ROWS={d} -DBLOCK_COLS={d}", .{ v.getRows(), v.getCols() }) catch unreachable
+    else
+        "";
+
+    var epilogue_buf: [128]u8 = undefined;
     const allocator = command_queue.context.allocator;
     const extra_args: []u8 = try std.fmt.allocPrint(
         allocator,
-        "-DHAS_ALPHA={d} -DHAS_BETA={d} -DA_TRANS={d} -DB_TRANS={d} -DSTRIDE={d} -DBLOCK_SIZE={d}",
+        "-DHAS_ALPHA={d} -DHAS_BETA={d} -DA_TRANS={d} -DB_TRANS={d} -DA_CONJ={d} -DB_CONJ={d} -DSTRIDE={d} -DBLOCK_SIZE={d}{s}{s}",
         .{
             @intFromBool(has_alpha),
             @intFromBool(has_beta),
-            @intFromEnum(op_a),
-            @intFromEnum(op_b),
+            @intFromBool(type_op_a.isTransposed()),
+            @intFromBool(type_op_b.isTransposed()),
+            @intFromBool(type_op_a.isConjugated()),
+            @intFromBool(type_op_b.isConjugated()),
             stride,
             block_size,
+            block_shape_args,
+            getEpilogueArgs(&epilogue_buf, epilogue_index),
         },
     );
     defer allocator.free(extra_args);
 
-    const kernel_source: []const u8 = switch (algorithm) {
+    // Only the kernel for devices without local memory has rectangular blocks
+    const kernel_source: []const u8 = if (rectangular_block != null) GEMM_NXN_KERNEL else switch (algorithm) {
         .@"2x2" => switch (command_queue.local_mem_type) {
             .local => GEMM_NXN_GPU_KERNEL,
             .global => GEMM_2x2_KERNEL,
@@ -439,10 +818,12 @@ fn getGemmKernelWithoutPacking(
     return kernel;
 }
 
-inline fn validateTensors(
+// `S` is the type of the operands, which is only different from `T` in mixed precision products
+pub inline fn validateTensors(
+    comptime S: type,
     comptime T: type,
-    a: *Tensor(T),
-    b: *Tensor(T),
+    a: *Tensor(S),
+    b: *Tensor(S),
     c: *Tensor(T),
     op_a: Operation,
     op_b: Operation,
@@ -455,27 +836,41 @@ inline fn validateTensors(
     const b_shape = b.dimensions.shape;
     const c_shape = c.dimensions.shape;
 
-    if (c_shape.len != 2 or a_shape.len != 2 or b_shape.len != 2) {
+    for ([_][]const u64{ a_shape, b_shape, c_shape }) |shape| {
+        if (shape.len != 2 and shape.len != 3) return tensor_module.Errors.InvalidValue;
+    }
+
+    // A and B either have a matrix for every product of the batch or a single one that is
+    // broadcast to all of them
+    const batches = getBatches(c_shape);
+    const a_batches = getBatches(a_shape);
+    const b_batches = getBatches(b_shape);
+    if ((a_batches != 1 and a_batches != batches) or (b_batches != 1 and b_batches != batches)) {
         return tensor_module.Errors.InvalidValue;
     }
 
-    const a_m = a_shape[0];
-    const a_k = a_shape[1];
+    // The kernels need rows and columns padded to an even length
+    if (a.flags.compact or b.flags.compact or c.flags.compact) {
+        return tensor_module.Errors.InvalidValue;
+    }
+
+    const a_m = getRows(a_shape);
+    const a_k = getCols(a_shape);
 
-    const b_k = b_shape[0];
-    const b_n = b_shape[1];
+    const b_k = getRows(b_shape);
+    const b_n = getCols(b_shape);
 
-    const c_m = c_shape[0];
-    const c_n = c_shape[1];
+    const c_m = getRows(c_shape);
+    const c_n = getCols(c_shape);
 
-    const match = switch (op_a) {
-        .transpose => switch (op_b) {
-            .no_transpose => (a_m == b_k and b_n == c_n and a_k == c_m),
-            .transpose => (a_m == b_n and b_k == c_n and a_k == c_m),
+    const match = switch (op_a.isTransposed()) {
+        true => switch (op_b.isTransposed()) {
+            false => (a_m == b_k and b_n == c_n and a_k == c_m),
+            true => (a_m == b_n and b_k == c_n and a_k == c_m),
         },
-        .no_transpose => switch (op_b) {
-            .no_transpose => (a_k == b_k and b_n == c_n and a_m == c_m),
-            .transpose => (a_k == b_n and b_k == c_n and a_m == c_m),
+        false => switch (op_b.isTransposed()) {
+            false => (a_k == b_k and b_n == c_n and a_m == c_m),
+            true => (a_k == b_n and b_k == c_n and a_m == c_m),
         },
     };
 
@@ -484,6 +879,144 @@ inline fn validateTensors(
     }
 }
 
+pub const LayoutWithoutPacking = struct {
+    vectors_enabled: bool,
+    k_size: u64,
+};
+
+pub inline fn getLayoutWithoutPacking(
+    comptime T: type,
+    command_queue: *const CommandQueue,
+    a: *Tensor(T),
+    op_a: Operation,
+    b: *Tensor(T),
+    op_b: Operation,
+) LayoutWithoutPacking {
+    var vectors_enabled: bool = a.flags.vectors_enabled and b.flags.vectors_enabled;
+    if ((comptime core.types.isComplex(T)) or command_queue.vector_widths[core.types.getTypeId(T)] == 1) {
+        vectors_enabled = false;
+    } else {
+        vectors_enabled &= (!op_a.isTransposed() and op_b.isTransposed());
+    }
+
+    var k_size: u64 = undefined;
+    if (vectors_enabled) {
+        k_size = a.memory_layout.row_pitch_for_vectors;
+    } else {
+        const a_shape = a.dimensions.shape;
+        k_size = a_shape[a_shape.len - 1 - @intFromBool(op_a.isTransposed())];
+        k_size += k_size % 2;
+    }
+
+    return .{ .vectors_enabled = vectors_enabled, .k_size = k_size };
+}
+
+fn validateEpilogue(comptime T: type, c: *Tensor(T), epilogue: Epilogue(T)) TensorErrors!void {
+    if (epilogue.getIndex() == 0) return;
+
+    if (comptime core.types.isComplex(T)) {
+        return tensor_module.Errors.InvalidValue;
+    }
+
+    if (@typeInfo(T) != .float and (epilogue.activation == .sigmoid or epilogue.activation == .tanh)) {
+        return tensor_module.Errors.InvalidValue;
+    }
+
+    if (epilogue.bias) |bias| {
+        if (bias.context != c.context) return tensor_module.Errors.UnqualTensorsContext;
+
+        const cols = getCols(c.dimensions.shape);
+        const bias_shape = bias.dimensions.shape;
+        if (bias_shape[bias_shape.len - 1] != cols or bias.dimensions.number_of_elements_without_padding != cols) {
+            return tensor_module.Errors.InvalidValue;
+        }
+    }
+
+    if (epilogue.derivative) |derivative| {
+        if (derivative.context != c.context) return tensor_module.Errors.UnqualTensorsContext;
+        try tensor_module.helpers.eqlTensors(T, c, derivative);
+    }
+}
+
+// Epilogue arguments go after alpha and beta
+pub fn setEpilogueArgs(
+    comptime T: type,
+    kernel: cl.kernel.Kernel,
+    first_arg: u32,
+    c: *Tensor(T),
+    epilogue: Epilogue(T),
+) TensorErrors!void {
+    if (epilogue.getIndex() == 0) return;
+
+    const setArg = cl.kernel.setArg;
+    const cl_mem_size = @sizeOf(cl.buffer.Mem);
+
+    const c_shape = c.dimensions.shape;
+    const rows = getRows(c_shape);
+    const cols = getCols(c_shape);
+
+    var arg_index = first_arg;
+    try setArg(kernel, arg_index, @sizeOf(u64), @ptrCast(&rows));
+    try setArg(kernel, arg_index + 1, @sizeOf(u64), @ptrCast(&cols));
+    arg_index += 2;
+
+    if (epilogue.bias) |bias| {
+        try setArg(kernel, arg_index, cl_mem_size, @ptrCast(&bias.buffer));
+        arg_index += 1;
+    }
+
+    if (epilogue.derivative) |derivative| {
+        try setArg(kernel, arg_index, cl_mem_size, @ptrCast(&derivative.buffer));
+    }
+}
+
+// The work items of `c` cover a single matrix, the batch is the third dimension of the launch
+pub fn getBatchedWorkItems(
+    comptime T: type,
+    c: *Tensor(T),
+    wekua_id: usize,
+    algorithm: GemmAlgorithm,
+    global_work_items: *[3]u64,
+    local_work_items: *[3]u64,
+) void {
+    const batches = getBatches(c.dimensions.shape);
+    switch (algorithm) {
+        inline else => |v| {
+            const global = @field(c.work_configuration, "global_work_items_gemm_" ++ @tagName(v))[wekua_id];
+            const local = @field(c.work_configuration, "local_work_items_gemm_" ++ @tagName(v))[wekua_id];
+
+            global_work_items.* = .{ global[0], global[1], batches };
+            local_work_items.* = .{ local[0], local[1], 1 };
+        },
+    }
+}
+
+fn getRectangularBatchedWorkItems(
+    comptime T: type,
+    c: *Tensor(T),
+    wekua_id: usize,
+    block: GemmRectangularBlock,
+    global_work_items: *[3]u64,
+    local_work_items: *[3]u64,
+) void {
+    const batches = getBatches(c.dimensions.shape);
+    switch (block) {
+        inline else => |v| {
+            const global = @field(c.work_configuration, "global_work_items_gemm_" ++ @tagName(v))[wekua_id];
+            const local = @field(c.work_configuration, "local_work_items_gemm_" ++ @tagName(v))[wekua_id];
+
+            global_work_items.* = .{ global[0], global[1], batches };
+            local_work_items.* = .{ local[0], local[1], 1 };
+        },
+    }
+}
+
+// Elements between the matrices of `x` in the batch, 0 when a single matrix is broadcast
+pub inline fn getBatchPitch(comptime T: type, x: *Tensor(T), vectors_enabled: bool) u64 {
+    if (getBatches(x.dimensions.shape) == 1) return 0;
+    return if (vectors_enabled) x.memory_layout.slice_pitch_for_vectors else x.memory_layout.slice_pitch;
+}
+
 fn gemmWithoutPacking(
     comptime T: type,
     pipeline: *Pipeline,
@@ -494,31 +1027,30 @@ fn gemmWithoutPacking(
     op_b: Operation,
     beta: ?T,
     c: *Tensor(T),
+    default_algorithm: GemmAlgorithm,
+    rectangular_block: ?GemmRectangularBlock,
+    epilogue: Epilogue(T),
 ) TensorErrors!void {
     const command_queue = pipeline.command_queue;
 
     const has_alpha = (alpha != null or beta != null);
     const has_beta = (beta != null);
 
-    var vectors_enabled: bool = a.flags.vectors_enabled and b.flags.vectors_enabled;
-    if ((comptime core.types.isComplex(T)) or command_queue.vector_widths[core.types.getTypeId(T)] == 1) {
-        vectors_enabled = false;
-    } else {
-        vectors_enabled &= (op_a == .no_transpose and op_b == .transpose);
-    }
+    const layout = getLayoutWithoutPacking(T, command_queue, a, op_a, b, op_b);
+    const vectors_enabled = layout.vectors_enabled;
+    const k_size = layout.k_size;
 
-    var k_size: u64 = undefined;
-    if (vectors_enabled) {
-        k_size = a.memory_layout.row_pitch_for_vectors;
-    } else {
-        k_size = a.dimensions.shape[1 - @intFromEnum(op_a)];
-        k_size += k_size % 2;
+    // The rectangular block of the work configuration replaces the square one when K is a multiple
+    // of its shorter side, which is the step over K
+    var block = rectangular_block;
+    if (block) |v| {
+        if ((k_size % v.getDepth()) != 0) block = null;
     }
 
-    const algorithm = getAlgorithm(
-        c.work_configuration.gemm_algorithm_per_device[command_queue.wekua_id],
-        k_size,
-    );
+    const algorithm = if (block) |v|
+        getAlgorithmFromBlockSize(v.getDepth()).?
+    else
+        getAlgorithm(default_algorithm, k_size);
 
     var a_row_pitch: u64 = undefined;
     var b_row_pitch: u64 = undefined;
@@ -540,39 +1072,22 @@ fn gemmWithoutPacking(
         op_a,
         op_b,
         algorithm,
+        block,
+        epilogue.getIndex(),
     );
 
+    c.markModified();
+    if (epilogue.derivative) |v| v.markModified();
+
     const prev_events = pipeline.prevEvents();
     const wekua_id = command_queue.wekua_id;
 
-    var global_work_items: []const u64 = &.{};
-    var local_work_items: []const u64 = &.{};
-
-    switch (algorithm) {
-        .@"2x2" => {
-            global_work_items = &c.work_configuration.global_work_items_gemm_2x2[wekua_id];
-            local_work_items = &c.work_configuration.local_work_items_gemm_2x2[wekua_id];
-        },
-        .@"4x4" => {
-            global_work_items = &c.work_configuration.global_work_items_gemm_4x4[wekua_id];
-            local_work_items = &c.work_configuration.local_work_items_gemm_4x4[wekua_id];
-        },
-        .@"8x8" => {
-            global_work_items = &c.work_configuration.global_work_items_gemm_8x8[wekua_id];
-            local_work_items = &c.work_configuration.local_work_items_gemm_8x8[wekua_id];
-        },
-        .@"16x16" => {
-            global_work_items = &c.work_configuration.global_work_items_gemm_16x16[wekua_id];
-            local_work_items = &c.work_configuration.local_work_items_gemm_16x16[wekua_id];
-        },
-        .@"32x32" => {
-            global_work_items = &c.work_configuration.global_work_items_gemm_32x32[wekua_id];
-            local_work_items = &c.work_configuration.local_work_items_gemm_32x32[wekua_id];
-        },
-        .@"64x64" => {
-            global_work_items = &c.work_configuration.global_work_items_gemm_64x64[wekua_id];
-            local_work_items = &c.work_configuration.local_work_items_gemm_64x64[wekua_id];
-        },
+    var global_work_items: [3]u64 = undefined;
+    var local_work_items: [3]u64 = undefined;
+    if (block) |v| {
+        getRectangularBatchedWorkItems(T, c, wekua_id, v, &global_work_items, &local_work_items);
+    } else {
+        getBatchedWorkItems(T, c, wekua_id, algorithm, &global_work_items, &local_work_items);
     }
 
     const setArg = cl.kernel.setArg;
@@ -582,32 +1097,42 @@ fn gemmWithoutPacking(
     try setArg(kernel, 1, cl_mem_size, @ptrCast(&b.buffer));
     try setArg(kernel, 2, cl_mem_size, @ptrCast(&c.buffer));
 
+    const a_batch_pitch = getBatchPitch(T, a, vectors_enabled);
+    const b_batch_pitch = getBatchPitch(T, b, vectors_enabled);
+    const c_batch_pitch = c.memory_layout.slice_pitch;
+
     try setArg(kernel, 3, @sizeOf(u64), @ptrCast(&a_row_pitch));
     try setArg(kernel, 4, @sizeOf(u64), @ptrCast(&b_row_pitch));
     try setArg(kernel, 5, @sizeOf(u64), @ptrCast(&c.memory_layout.row_pitch));
 
-    try setArg(kernel, 6, @sizeOf(u64), @ptrCast(&k_size));
+    try setArg(kernel, 6, @sizeOf(u64), @ptrCast(&a_batch_pitch));
+    try setArg(kernel, 7, @sizeOf(u64), @ptrCast(&b_batch_pitch));
+    try setArg(kernel, 8, @sizeOf(u64), @ptrCast(&c_batch_pitch));
+
+    try setArg(kernel, 9, @sizeOf(u64), @ptrCast(&k_size));
 
     if (has_alpha) {
         const alpha_val: T = alpha orelse if (comptime core.types.isComplex(T))
             .{ .real = 1, .imag = 0 }
         else
             1;
-        try setArg(kernel, 7, @sizeOf(T), @ptrCast(&alpha_val));
+        try setArg(kernel, 10, @sizeOf(T), @ptrCast(&alpha_val));
 
         if (has_beta) {
             const beta_val = beta.?;
-            try setArg(kernel, 8, @sizeOf(T), @ptrCast(&beta_val));
+            try setArg(kernel, 11, @sizeOf(T), @ptrCast(&beta_val));
         }
     }
 
+    try setEpilogueArgs(T, kernel, 10 + @as(u32, @intFromBool(has_alpha)) + @intFromBool(has_beta), c, epilogue);
+
     var new_event: cl.event.Event = undefined;
     try cl.kernel.enqueueNdRange(
         command_queue.cl_command_queue,
         kernel,
         null,
-        global_work_items,
-        local_work_items,
+        &global_work_items,
+        &local_work_items,
         prev_events,
         &new_event,
     );
@@ -625,18 +1150,22 @@ fn getGemmKernelWithPacking(
     op_a: Operation,
     op_b: Operation,
     algorithm: GemmAlgorithm,
+    epilogue_index: usize,
 ) TensorErrors!cl.kernel.Kernel {
     const SUPPORTED_TYPES = core.types.SUPPORTED_TYPES;
     const num_algorithms = std.meta.fields(GemmAlgorithm).len;
     const kernels_per_algorithm = 2 * 2 * 2 * SUPPORTED_TYPES.len;
 
+    // Kernels with an epilogue have a set of their own
+    const has_epilogue = (epilogue_index != 0);
     const kernels_set = try KernelsSet.getKernelSet(
         command_queue,
-        .GEMMPack,
-        num_algorithms * kernels_per_algorithm,
+        if (has_epilogue) .GEMMPackEpilogue else .GEMMPack,
+        num_algorithms * kernels_per_algorithm * @as(usize, if (has_epilogue) EPILOGUE_VARIANTS - 1 else 1),
     );
 
-    var kernel_index: usize = @intFromEnum(algorithm) * kernels_per_algorithm;
+    var kernel_index: usize = (epilogue_index -| 1) * (num_algorithms * kernels_per_algorithm);
+    kernel_index += @intFromEnum(algorithm) * kernels_per_algorithm;
     kernel_index += @intFromBool(vectors_enabled) * (2 * 2 * SUPPORTED_TYPES.len);
     kernel_index += @intFromBool(has_alpha) * (2 * SUPPORTED_TYPES.len);
     kernel_index += @intFromBool(has_beta) * SUPPORTED_TYPES.len;
@@ -650,17 +1179,19 @@ fn getGemmKernelWithPacking(
     const stride = @intFromEnum(algorithm) + 1;
     const block_size = getBlockSizeFromAlgorithm(algorithm);
 
+    var epilogue_buf: [128]u8 = undefined;
     const allocator = command_queue.context.allocator;
     const extra_args: []u8 = try std.fmt.allocPrint(
         allocator,
-        "-DHAS_ALPHA={d} -DHAS_BETA={d} -DA_TRANS={d} -DB_TRANS={d} -DSTRIDE={d} -DBLOCK_SIZE={d}",
+        "-DHAS_ALPHA={d} -DHAS_BETA={d} -DA_TRANS={d} -DB_TRANS={d} -DSTRIDE={d} -DBLOCK_SIZE={d}{s}",
         .{
             @intFromBool(has_alpha),
             @intFromBool(has_beta),
-            @intFromEnum(op_a),
-            @intFromEnum(op_b),
+            @intFromBool(op_a.isTransposed()),
+            @intFromBool(op_b.isTransposed()),
             stride,
             block_size,
+            getEpilogueArgs(&epilogue_buf, epilogue_index),
         },
     );
     defer allocator.free(extra_args);
@@ -692,6 +1223,14 @@ fn getGemmKernelWithPacking(
     return kernel;
 }
 
+// The work configuration of `c` only has work items for the block sizes that divide it, which can
+// change when it is resized
+pub fn hasGemmWorkItems(comptime T: type, c: *Tensor(T), algorithm: GemmAlgorithm) bool {
+    return switch (algorithm) {
+        inline else => |v| @field(c.work_configuration, "global_work_items_gemm_" ++ @tagName(v)).len > 0,
+    };
+}
+
 fn gemmWithPacking(
     comptime T: type,
     pipeline: *Pipeline,
@@ -703,13 +1242,8 @@ fn gemmWithPacking(
     beta: ?T,
     c: *Tensor(T),
     packed_tensors: *PackedTensors(T),
+    epilogue: Epilogue(T),
 ) TensorErrors!void {
-    const command_queue = pipeline.command_queue;
-    const wekua_id = command_queue.wekua_id;
-
-    const has_alpha = (alpha != null or beta != null);
-    const has_beta = (beta != null);
-
     try packed_tensors.pack(
         pipeline,
         a,
@@ -718,6 +1252,28 @@ fn gemmWithPacking(
         op_b,
     );
 
+    try gemmPackedOperands(T, pipeline, alpha, op_a, op_b, beta, c, packed_tensors, epilogue);
+}
+
+/// Computes the product from the tiles already in `packed_tensors`, with `op_a` and `op_b` the
+/// operations they were packed with. `c` must match the sizes of the packed tensors.
+pub fn gemmPackedOperands(
+    comptime T: type,
+    pipeline: *Pipeline,
+    alpha: ?T,
+    op_a: Operation,
+    op_b: Operation,
+    beta: ?T,
+    c: *Tensor(T),
+    packed_tensors: *PackedTensors(T),
+    epilogue: Epilogue(T),
+) TensorErrors!void {
+    const command_queue = pipeline.command_queue;
+    const wekua_id = command_queue.wekua_id;
+
+    const has_alpha = (alpha != null or beta != null);
+    const has_beta = (beta != null);
+
     const vectors_enabled = packed_tensors.vectors_enabled;
 
     const algorithm = packed_tensors.algorithm;
@@ -730,37 +1286,12 @@ fn gemmWithPacking(
         op_a,
         op_b,
         algorithm,
+        epilogue.getIndex(),
     );
 
-    var global_work_items: []const u64 = &.{};
-    var local_work_items: []const u64 = &.{};
-
-    switch (algorithm) {
-        .@"2x2" => {
-            global_work_items = &c.work_configuration.global_work_items_gemm_2x2[wekua_id];
-            local_work_items = &c.work_configuration.local_work_items_gemm_2x2[wekua_id];
-        },
-        .@"4x4" => {
-            global_work_items = &c.work_configuration.global_work_items_gemm_4x4[wekua_id];
-            local_work_items = &c.work_configuration.local_work_items_gemm_4x4[wekua_id];
-        },
-        .@"8x8" => {
-            global_work_items = &c.work_configuration.global_work_items_gemm_8x8[wekua_id];
-            local_work_items = &c.work_configuration.local_work_items_gemm_8x8[wekua_id];
-        },
-        .@"16x16" => {
-            global_work_items = &c.work_configuration.global_work_items_gemm_16x16[wekua_id];
-            local_work_items = &c.work_configuration.local_work_items_gemm_16x16[wekua_id];
-        },
-        .@"32x32" => {
-            global_work_items = &c.work_configuration.global_work_items_gemm_32x32[wekua_id];
-            local_work_items = &c.work_configuration.local_work_items_gemm_32x32[wekua_id];
-        },
-        .@"64x64" => {
-            global_work_items = &c.work_configuration.global_work_items_gemm_64x64[wekua_id];
-            local_work_items = &c.work_configuration.local_work_items_gemm_64x64[wekua_id];
-        },
-    }
+    var global_work_items: [3]u64 = undefined;
+    var local_work_items: [3]u64 = undefined;
+    getBatchedWorkItems(T, c, wekua_id, algorithm, &global_work_items, &local_work_items);
 
     const packed_tensor_a = packed_tensors.packed_a;
     const packed_tensor_b = packed_tensors.packed_b;
@@ -785,6 +1316,9 @@ fn gemmWithPacking(
         B_row_pitch = packed_tensor_b.memory_layout.row_pitch;
     }
 
+    c.markModified();
+    if (epilogue.derivative) |v| v.markModified();
+
     const prev_events = pipeline.prevEvents();
 
     const setArg = cl.kernel.setArg;
@@ -801,76 +1335,287 @@ fn gemmWithPacking(
     try setArg(kernel, 6, @sizeOf(u64), @ptrCast(&B_row_pitch));
 
     try setArg(kernel, 7, @sizeOf(u64), @ptrCast(&c.memory_layout.row_pitch));
-    try setArg(kernel, 8, @sizeOf(u64), @ptrCast(&packed_tensor_a.dimensions.shape[1]));
+
+    // Every product of the batch has its own tiles, broadcast operands included
+    const batches = packed_tensors.batches;
+    const A_batch_pitch = (packed_tensor_a.dimensions.shape[0] / batches) * A_slice_pitch;
+    const B_batch_pitch = (packed_tensor_b.dimensions.shape[0] / batches) * B_slice_pitch;
+    const C_batch_pitch = c.memory_layout.slice_pitch;
+
+    try setArg(kernel, 8, @sizeOf(u64), @ptrCast(&A_batch_pitch));
+    try setArg(kernel, 9, @sizeOf(u64), @ptrCast(&B_batch_pitch));
+    try setArg(kernel, 10, @sizeOf(u64), @ptrCast(&C_batch_pitch));
+
+    try setArg(kernel, 11, @sizeOf(u64), @ptrCast(&packed_tensor_a.dimensions.shape[1]));
 
     if (has_alpha) {
         const alpha_val: T = alpha orelse if (comptime core.types.isComplex(T))
             .{ .real = 1, .imag = 0 }
         else
             1;
-        try setArg(kernel, 9, @sizeOf(T), @ptrCast(&alpha_val));
+        try setArg(kernel, 12, @sizeOf(T), @ptrCast(&alpha_val));
+
+        if (has_beta) {
+            const beta_val = beta.?;
+            try setArg(kernel, 13, @sizeOf(T), @ptrCast(&beta_val));
+        }
+    }
+
+    try setEpilogueArgs(T, kernel, 12 + @as(u32, @intFromBool(has_alpha)) + @intFromBool(has_beta), c, epilogue);
+
+    var new_event: cl.event.Event = undefined;
+    try cl.kernel.enqueueNdRange(
+        command_queue.cl_command_queue,
+        kernel,
+        null,
+        &global_work_items,
+        &local_work_items,
+        prev_events,
+        &new_event,
+    );
+    errdefer tensor_module.helpers.releaseEvent(new_event);
+
+    try pipeline.append(&.{new_event});
+}
+
+/// `c = alpha * op_a(a) * op_b(b) + beta * c`. Tensors with three dimensions hold a batch of
+/// matrices and every product of the batch is computed in the same launch. `a` or `b` may be a
+/// single matrix, which is then used in every product. Results with up to `gemv.MAX_SKINNY_SIZE` rows
+/// or columns are computed as matrix vector products and never use `packed_tensors`. Results with
+/// fewer tiles than the device has compute units are split along K when `packed_tensors` were
+/// created for them with a long K, see `split_k.zig`.
+pub fn gemm(
+    comptime T: type,
+    pipeline: *Pipeline,
+    alpha: ?T,
+    a: *Tensor(T),
+    op_a: Operation,
+    b: *Tensor(T),
+    op_b: Operation,
+    beta: ?T,
+    c: *Tensor(T),
+    packed_tensors: ?*PackedTensors(T),
+) TensorErrors!void {
+    try gemmWithEpilogue(T, pipeline, alpha, a, op_a, b, op_b, beta, c, packed_tensors, .{});
+}
+
+/// `gemm` followed by `epilogue`, computed by the same kernels.
+pub fn gemmWithEpilogue(
+    comptime T: type,
+    pipeline: *Pipeline,
+    alpha: ?T,
+    a: *Tensor(T),
+    op_a: Operation,
+    b: *Tensor(T),
+    op_b: Operation,
+    beta: ?T,
+    c: *Tensor(T),
+    packed_tensors: ?*PackedTensors(T),
+    epilogue: Epilogue(T),
+) TensorErrors!void {
+    try validateTensors(T, T, a, b, c, op_a, op_b);
+    try validateEpilogue(T, c, epilogue);
+
+    if (packed_tensors) |v| {
+        if (v.batches != getBatches(c.dimensions.shape)) {
+            return tensor_module.Errors.InvalidValue;
+        }
+    }
+
+    // Results with very few rows or columns would be mostly padding for the tile kernels
+    if (gemv_module.isSkinny(T, c)) {
+        try gemv_module.skinnyGemm(T, pipeline, alpha, a, op_a, b, op_b, beta, c, epilogue);
+        return;
+    }
+
+    const command_queue = pipeline.command_queue;
+
+    // Results with fewer tiles than compute units would leave most of the device idle, a long K
+    // is split over more work-groups instead
+    if (comptime !core.types.isComplex(T)) {
+        if (packed_tensors) |v| {
+            if (v.split_k_partials) |partials| {
+                if (split_k_module.getSplit(T, command_queue, a, op_a, b, op_b, c, partials)) |split| {
+                    try split_k_module.splitKGemm(T, pipeline, alpha, a, op_a, b, op_b, beta, c, partials, split, epilogue);
+                    return;
+                }
+            }
+        }
+    }
+
+    const tuned_choice = getTunedChoice(T, command_queue, a, op_a, op_b, c);
+
+    if (packed_tensors) |v| {
+        // Packing is skipped when it was measured to be slower for this kind of product
+        const use_packing = if (tuned_choice) |choice| choice.use_packing else true;
+        if (use_packing and hasGemmWorkItems(T, c, v.algorithm)) {
+            try gemmWithPacking(
+                T,
+                pipeline,
+                alpha,
+                a,
+                op_a,
+                b,
+                op_b,
+                beta,
+                c,
+                v,
+                epilogue,
+            );
+            return;
+        }
+    }
+
+    const wekua_id = command_queue.wekua_id;
+    var algorithm = c.work_configuration.gemm_algorithm_per_device[wekua_id];
+    var rectangular_block = c.work_configuration.gemm_rectangular_block_per_device[wekua_id];
+
+    // Tuned choices were measured with square blocks
+    if (tuned_choice) |choice| {
+        algorithm = choice.algorithm;
+        rectangular_block = null;
+    }
+
+    try gemmWithoutPacking(
+        T,
+        pipeline,
+        alpha,
+        a,
+        op_a,
+        b,
+        op_b,
+        beta,
+        c,
+        algorithm,
+        rectangular_block,
+        epilogue,
+    );
+}
+
+fn measureVariant(
+    comptime T: type,
+    pipeline: *Pipeline,
+    a: *Tensor(T),
+    op_a: Operation,
+    b: *Tensor(T),
+    op_b: Operation,
+    c: *Tensor(T),
+    algorithm: GemmAlgorithm,
+    packed_tensors: ?*PackedTensors(T),
+    iterations: usize,
+) TensorErrors!u64 {
+    var timer: std.time.Timer = undefined;
+
+    // The first run is a warm up, it also compiles the kernels
+    for (0..(iterations + 1)) |i| {
+        if (i == 1) {
+            pipeline.waitAndCleanup();
+            timer = std.time.Timer.start() catch unreachable;
+        }
 
-        if (has_beta) {
-            const beta_val = beta.?;
-            try setArg(kernel, 10, @sizeOf(T), @ptrCast(&beta_val));
+        if (packed_tensors) |v| {
+            try gemmWithPacking(T, pipeline, null, a, op_a, b, op_b, null, c, v, .{});
+        } else {
+            try gemmWithoutPacking(T, pipeline, null, a, op_a, b, op_b, null, c, algorithm, null, .{});
         }
     }
+    pipeline.waitAndCleanup();
 
-    var new_event: cl.event.Event = undefined;
-    try cl.kernel.enqueueNdRange(
-        command_queue.cl_command_queue,
-        kernel,
-        null,
-        global_work_items,
-        local_work_items,
-        prev_events,
-        &new_event,
-    );
-    errdefer tensor_module.helpers.releaseEvent(new_event);
-
-    try pipeline.append(&.{new_event});
+    return timer.read();
 }
 
-pub fn gemm(
+/// Measures every GEMM variant able to compute `c = op_a(a) * op_b(b)` on the device of the
+/// pipeline (every block size allowed by the work configuration of `c`, with and without packing)
+/// and records the fastest ones for the type, operations and size class (ceil(log2) of M, N and K)
+/// of the product. Later calls to `gemm` and `PackedTensors.init` for products of the same class
+/// use them. The choices live in the tuning table of the command queue and are persisted with
+/// `core.WorkGroupTuner.save`/`load`.
+///
+/// Overwrites `c` and blocks until the measurements are done.
+pub fn tune(
     comptime T: type,
     pipeline: *Pipeline,
-    alpha: ?T,
     a: *Tensor(T),
     op_a: Operation,
     b: *Tensor(T),
     op_b: Operation,
-    beta: ?T,
     c: *Tensor(T),
-    packed_tensors: ?*PackedTensors(T),
+    iterations: usize,
 ) TensorErrors!void {
-    try validateTensors(T, a, b, c, op_a, op_b);
+    try validateTensors(T, T, a, b, c, op_a, op_b);
+    if (iterations == 0) return tensor_module.Errors.InvalidValue;
 
-    if (packed_tensors) |v| {
-        try gemmWithPacking(
-            T,
-            pipeline,
-            alpha,
-            a,
-            op_a,
-            b,
-            op_b,
-            beta,
-            c,
-            v,
-        );
-    } else {
-        try gemmWithoutPacking(
-            T,
+    const command_queue = pipeline.command_queue;
+    const max_algorithm = c.work_configuration.gemm_algorithm_per_device[command_queue.wekua_id];
+
+    const a_shape = a.dimensions.shape;
+    const c_shape = c.dimensions.shape;
+
+    const m_size = getRows(c_shape);
+    const n_size = getCols(c_shape);
+    const k_size = a_shape[a_shape.len - 1 - @intFromBool(op_a.isTransposed())];
+
+    pipeline.waitAndCleanup();
+
+    const unpacked_k_size = getLayoutWithoutPacking(T, command_queue, a, op_a, b, op_b).k_size;
+
+    var best_unpacked_algorithm: GemmAlgorithm = .@"2x2";
+    var best_unpacked_time: u64 = std.math.maxInt(u64);
+
+    var best_packed_algorithm: GemmAlgorithm = .@"2x2";
+    var best_packed_time: u64 = std.math.maxInt(u64);
+
+    for (0..(@as(usize, @intFromEnum(max_algorithm)) + 1)) |i| {
+        const candidate: GemmAlgorithm = @enumFromInt(i);
+
+        // Block sizes that don't divide K fall back to a smaller one, which is measured anyway
+        if (getAlgorithm(candidate, unpacked_k_size) == candidate) {
+            const time = try measureVariant(T, pipeline, a, op_a, b, op_b, c, candidate, null, iterations);
+            if (time < best_unpacked_time) {
+                best_unpacked_time = time;
+                best_unpacked_algorithm = candidate;
+            }
+        }
+
+        const packed_tensors = try PackedTensors(T).initInternal(
             pipeline,
-            alpha,
-            a,
-            op_a,
-            b,
-            op_b,
-            beta,
-            c,
+            getBatches(c_shape),
+            m_size,
+            n_size,
+            k_size,
+            candidate,
+            a.flags.vectors_enabled and b.flags.vectors_enabled,
         );
+        defer packed_tensors.deinit(pipeline);
+
+        if (packed_tensors.algorithm == candidate) {
+            const time = try measureVariant(T, pipeline, a, op_a, b, op_b, c, candidate, packed_tensors, iterations);
+            if (time < best_packed_time) {
+                best_packed_time = time;
+                best_packed_algorithm = candidate;
+            }
+        }
+
+        // The packed tensors are released when this iteration ends
+        pipeline.waitAndCleanup();
     }
+
+    var key_buf: [128]u8 = undefined;
+    try core.WorkGroupTuner.putByKey(
+        command_queue,
+        writeTuningKey(&key_buf, T, .{ op_a, op_b }, m_size, n_size, k_size),
+        .{
+            getBlockSizeFromAlgorithm(best_unpacked_algorithm),
+            @as(u64, if (best_packed_time < best_unpacked_time) 2 else 1),
+            1,
+        },
+    );
+
+    try core.WorkGroupTuner.putByKey(
+        command_queue,
+        writeTuningKey(&key_buf, T, null, m_size, n_size, k_size),
+        .{ getBlockSizeFromAlgorithm(best_packed_algorithm), 1, 1 },
+    );
 }
 
 // -----------------------------------------------------------------------------
@@ -880,6 +1625,7 @@ const testing = std.testing;
 const memory = tensor_module.memory;
 const fill = tensor_module.fill;
 const identity_fn = tensor_module.identity;
+const ComplexF32 = core.types.ComplexF32;
 
 fn castInt(comptime T: type, val: anytype) T {
     return switch (@typeInfo(T)) {
@@ -924,7 +1670,7 @@ test "gemm - invalid shapes" {
         try testing.expectError(tensor_module.Errors.InvalidValue, err);
     }
 
-    // 3D tensor → InvalidValue
+    // Batch of 2 products written into a single matrix → InvalidValue
     {
         const a = try Tensor(f32).alloc(context, pipeline, &.{ 2, 3, 4 }, config);
         defer a.release(pipeline);
@@ -1051,6 +1797,42 @@ test "gemm cpu - all algorithms, complex" {
     }
 }
 
+test "gemm cpu - rectangular blocks" {
+    const allocator = testing.allocator;
+    const context = core.Context.initFromBestDevice(allocator, null, .cpu) catch return;
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    // 12 rows only allow 4x4 square blocks, 4x8 ones reuse twice as much
+    if (command_queue.local_mem_type == .global) {
+        const c_mat = try Tensor(f32).alloc(context, pipeline, &.{ 12, 64 }, .{});
+        defer c_mat.release(pipeline);
+
+        const block = c_mat.work_configuration.gemm_rectangular_block_per_device[command_queue.wekua_id];
+        try testing.expectEqual(GemmRectangularBlock.@"4x8", block.?);
+    }
+
+    inline for (core.types.SUPPORTED_TYPES) |T| {
+        if (!(comptime core.types.isComplex(T)) and @typeInfo(T) == .float) {
+            if (command_queue.isTypeSupported(T)) {
+                // Wide (4x8, 8x16) and tall (16x8) results, and one where the square block is bigger
+                const sizes = [_][2]u64{ .{ 12, 64 }, .{ 24, 48 }, .{ 48, 24 }, .{ 96, 32 } };
+                for (sizes) |size| {
+                    const m = size[0];
+                    const k = size[1];
+                    try test_helpers.testGemmATimesIdentity(T, context, pipeline, m, k, .no_transpose, .no_transpose, false, null, null);
+                    try test_helpers.testGemmATimesIdentity(T, context, pipeline, m, k, .transpose, .no_transpose, false, null, null);
+                    try test_helpers.testGemmATimesIdentity(T, context, pipeline, m, k, .no_transpose, .transpose, false, null, null);
+                    try test_helpers.testGemmATimesIdentity(T, context, pipeline, m, k, .no_transpose, .no_transpose, false, @as(T, 2), @as(T, 3));
+                }
+            }
+        }
+    }
+}
+
 test "gemm cpu - all algorithms with packing, non-complex" {
     const allocator = testing.allocator;
     const context = core.Context.initFromBestDevice(allocator, null, .cpu) catch return;
@@ -1949,3 +2731,526 @@ test "pack - B packing with transpose for complex types" {
         }
     }
 }
+
+test "gemm - tuned algorithm selection" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const config = tensor_module.CreateConfig{};
+
+    const a = try Tensor(f32).alloc(context, pipeline, &.{ 64, 48 }, config);
+    defer a.release(pipeline);
+
+    const b = try Tensor(f32).alloc(context, pipeline, &.{ 48, 48 }, config);
+    defer b.release(pipeline);
+
+    const c_mat = try Tensor(f32).alloc(context, pipeline, &.{ 64, 48 }, config);
+    defer c_mat.release(pipeline);
+
+    try testing.expectError(
+        tensor_module.Errors.InvalidValue,
+        tune(f32, pipeline, a, .no_transpose, b, .no_transpose, c_mat, 0),
+    );
+
+    try tune(f32, pipeline, a, .no_transpose, b, .no_transpose, c_mat, 2);
+
+    const tuned_choice = getTunedChoice(f32, command_queue, a, .no_transpose, .no_transpose, c_mat);
+    try testing.expect(tuned_choice != null);
+    try testing.expect(getTunedPackedAlgorithm(f32, command_queue, 64, 48, 48) != null);
+
+    // Products of the same class must still be right with the tuned choices, with and without packing
+    try test_helpers.testGemmATimesIdentity(f32, context, pipeline, 60, 40, .no_transpose, .no_transpose, false, null, null);
+    try test_helpers.testGemmATimesIdentity(f32, context, pipeline, 60, 40, .no_transpose, .no_transpose, true, null, null);
+    try test_helpers.testGemmATimesIdentity(f32, context, pipeline, 64, 48, .no_transpose, .no_transpose, true, @as(f32, 2), @as(f32, 3));
+}
+
+test "gemm - packed tensors with a smaller batch" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const a = try Tensor(f32).alloc(context, pipeline, &.{ 8, 6 }, .{});
+    defer a.release(pipeline);
+
+    const b = try Tensor(f32).alloc(context, pipeline, &.{ 6, 6 }, .{});
+    defer b.release(pipeline);
+
+    const c_mat = try Tensor(f32).alloc(context, pipeline, &.{ 8, 6 }, .{});
+    defer c_mat.release(pipeline);
+
+    var a_values: [48]f32 = undefined;
+    for (&a_values, 0..) |*v, i| v.* = @floatFromInt(i + 1);
+    try tensor_module.memory.readFromBuffer(f32, pipeline, a, &a_values);
+    try tensor_module.fill.one(f32, pipeline, b);
+
+    const packed_tensors = try PackedTensors(f32).init(pipeline, c_mat, 6, true);
+    defer packed_tensors.deinit(pipeline);
+
+    try gemm(f32, pipeline, null, a, .no_transpose, b, .no_transpose, null, c_mat, packed_tensors);
+
+    // Odd batch, the last row of every operand becomes padding
+    try a.resize(pipeline, 5);
+    try c_mat.resize(pipeline, 5);
+    try packed_tensors.resize(pipeline, 5, 6, 6);
+
+    try tensor_module.memory.readFromBuffer(f32, pipeline, a, a_values[0..30]);
+    try gemm(f32, pipeline, null, a, .no_transpose, b, .no_transpose, null, c_mat, packed_tensors);
+
+    var result: [30]f32 = undefined;
+    try tensor_module.memory.writeToBuffer(f32, pipeline, c_mat, &result);
+    pipeline.waitAndCleanup();
+
+    for (0..5) |i| {
+        var expected: f32 = 0;
+        for (a_values[(i * 6)..((i + 1) * 6)]) |v| expected += v;
+
+        for (result[(i * 6)..((i + 1) * 6)]) |v| {
+            try testing.expectEqual(expected, v);
+        }
+    }
+
+    try testing.expectError(tensor_module.Errors.InvalidValue, packed_tensors.resize(pipeline, 9, 6, 6));
+    try testing.expectError(tensor_module.Errors.InvalidValue, c_mat.resize(pipeline, 9));
+}
+
+fn expectRowSums(pipeline: *Pipeline, c_mat: *Tensor(f32), a_values: []const f32, scale: f32) !void {
+    var result: [48]f32 = undefined;
+    const values = result[0..c_mat.dimensions.number_of_elements_without_padding];
+    try tensor_module.memory.writeToBuffer(f32, pipeline, c_mat, values);
+    pipeline.waitAndCleanup();
+
+    const rows = values.len / 6;
+    for (0..rows) |i| {
+        var expected: f32 = 0;
+        for (a_values[(i * 6)..((i + 1) * 6)]) |v| expected += v;
+
+        for (values[(i * 6)..((i + 1) * 6)]) |v| {
+            try testing.expectEqual(scale * expected, v);
+        }
+    }
+}
+
+test "gemm - persistent packed B" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const a = try Tensor(f32).alloc(context, pipeline, &.{ 8, 6 }, .{});
+    defer a.release(pipeline);
+
+    const b = try Tensor(f32).alloc(context, pipeline, &.{ 6, 6 }, .{});
+    defer b.release(pipeline);
+
+    const c_mat = try Tensor(f32).alloc(context, pipeline, &.{ 8, 6 }, .{});
+    defer c_mat.release(pipeline);
+
+    var a_values: [48]f32 = undefined;
+    for (&a_values, 0..) |*v, i| v.* = @floatFromInt(i + 1);
+    try tensor_module.memory.readFromBuffer(f32, pipeline, a, &a_values);
+    try tensor_module.fill.one(f32, pipeline, b);
+
+    const packed_tensors = try PackedTensors(f32).init(pipeline, c_mat, 6, true);
+    defer packed_tensors.deinit(pipeline);
+    packed_tensors.setPersistentB(true);
+
+    try gemm(f32, pipeline, null, a, .no_transpose, b, .no_transpose, null, c_mat, packed_tensors);
+    try expectRowSums(pipeline, c_mat, &a_values, 1);
+
+    // The same B is packed once
+    const first_version = packed_tensors.packed_b_source.?.version;
+    try gemm(f32, pipeline, null, a, .no_transpose, b, .no_transpose, null, c_mat, packed_tensors);
+    try expectRowSums(pipeline, c_mat, &a_values, 1);
+    try testing.expectEqual(first_version, packed_tensors.packed_b_source.?.version);
+
+    // Device writes mark the tensor as modified
+    try tensor_module.fill.constant(f32, pipeline, b, 2);
+    try gemm(f32, pipeline, null, a, .no_transpose, b, .no_transpose, null, c_mat, packed_tensors);
+    try expectRowSums(pipeline, c_mat, &a_values, 2);
+
+    // A smaller batch keeps the tiles of B
+    const b_version = packed_tensors.packed_b_source.?.version;
+    try a.resize(pipeline, 5);
+    try c_mat.resize(pipeline, 5);
+    try packed_tensors.resize(pipeline, 5, 6, 6);
+    try testing.expectEqual(b_version, packed_tensors.packed_b_source.?.version);
+
+    try tensor_module.memory.readFromBuffer(f32, pipeline, a, a_values[0..30]);
+    try gemm(f32, pipeline, null, a, .no_transpose, b, .no_transpose, null, c_mat, packed_tensors);
+    try expectRowSums(pipeline, c_mat, a_values[0..30], 2);
+
+    // Host writes mark the tensor as modified
+    var ones: [36]f32 = undefined;
+    @memset(&ones, 1);
+    try tensor_module.memory.readFromBuffer(f32, pipeline, b, &ones);
+    try gemm(f32, pipeline, null, a, .no_transpose, b, .no_transpose, null, c_mat, packed_tensors);
+    try expectRowSums(pipeline, c_mat, a_values[0..30], 1);
+
+    // A tensor allocated where a released one was doesn't get its tiles
+    const b_source = packed_tensors.packed_b_source.?;
+    const new_b = try Tensor(f32).alloc(context, pipeline, &.{ 6, 6 }, .{});
+    defer new_b.release(pipeline);
+    try testing.expect(new_b.version != b_source.version);
+}
+
+fn testBatchedGemm(
+    context: *const core.Context,
+    pipeline: *Pipeline,
+    a_batches: u64,
+    b_batches: u64,
+    use_packing: bool,
+) !void {
+    const batches = 3;
+    const m = 6;
+    const k = 4;
+    const n = 10;
+
+    const a_shape: []const u64 = if (a_batches == 1) &.{ m, k } else &.{ batches, m, k };
+    const b_shape: []const u64 = if (b_batches == 1) &.{ k, n } else &.{ batches, k, n };
+
+    const a = try Tensor(f32).alloc(context, pipeline, a_shape, .{});
+    defer a.release(pipeline);
+
+    const b = try Tensor(f32).alloc(context, pipeline, b_shape, .{});
+    defer b.release(pipeline);
+
+    const c_mat = try Tensor(f32).alloc(context, pipeline, &.{ batches, m, n }, .{});
+    defer c_mat.release(pipeline);
+
+    var a_values: [batches * m * k]f32 = undefined;
+    for (&a_values, 0..) |*v, i| v.* = @floatFromInt(i % 7);
+
+    var b_values: [batches * k * n]f32 = undefined;
+    for (&b_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i % 5)) - 2;
+
+    try memory.readFromBuffer(f32, pipeline, a, a_values[0..(a_batches * m * k)]);
+    try memory.readFromBuffer(f32, pipeline, b, b_values[0..(b_batches * k * n)]);
+
+    var packed_tensors: ?*PackedTensors(f32) = null;
+    if (use_packing) packed_tensors = try PackedTensors(f32).init(pipeline, c_mat, k, true);
+    defer if (packed_tensors) |v| v.deinit(pipeline);
+
+    try gemm(f32, pipeline, null, a, .no_transpose, b, .no_transpose, null, c_mat, packed_tensors);
+
+    var result: [batches * m * n]f32 = undefined;
+    try memory.writeToBuffer(f32, pipeline, c_mat, &result);
+    pipeline.waitAndCleanup();
+
+    for (0..batches) |batch| {
+        const a_matrix = a_values[((batch % a_batches) * m * k)..];
+        const b_matrix = b_values[((batch % b_batches) * k * n)..];
+
+        for (0..m) |i| {
+            for (0..n) |j| {
+                var expected: f32 = 0;
+                for (0..k) |l| expected += a_matrix[i * k + l] * b_matrix[l * n + j];
+
+                try testing.expectEqual(expected, result[(batch * m + i) * n + j]);
+            }
+        }
+    }
+}
+
+test "gemm - batched products with broadcast operands" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    for ([_]bool{ false, true }) |use_packing| {
+        try testBatchedGemm(context, pipeline, 3, 3, use_packing);
+        try testBatchedGemm(context, pipeline, 3, 1, use_packing);
+        try testBatchedGemm(context, pipeline, 1, 3, use_packing);
+    }
+
+    // A batch of 2 can't be used with products of a batch of 3
+    const a = try Tensor(f32).alloc(context, pipeline, &.{ 2, 6, 4 }, .{});
+    defer a.release(pipeline);
+
+    const b = try Tensor(f32).alloc(context, pipeline, &.{ 4, 10 }, .{});
+    defer b.release(pipeline);
+
+    const c_mat = try Tensor(f32).alloc(context, pipeline, &.{ 3, 6, 10 }, .{});
+    defer c_mat.release(pipeline);
+
+    try testing.expectError(
+        tensor_module.Errors.InvalidValue,
+        gemm(f32, pipeline, null, a, .no_transpose, b, .no_transpose, null, c_mat, null),
+    );
+}
+
+test "gemm - epilogue with bias, activations and derivative" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const m = 5;
+    const k = 6;
+    const n = 7;
+
+    const a = try Tensor(f32).alloc(context, pipeline, &.{ m, k }, .{});
+    defer a.release(pipeline);
+
+    const b = try Tensor(f32).alloc(context, pipeline, &.{ n, k }, .{});
+    defer b.release(pipeline);
+
+    const bias = try Tensor(f32).alloc(context, pipeline, &.{n}, .{});
+    defer bias.release(pipeline);
+
+    const c_mat = try Tensor(f32).alloc(context, pipeline, &.{ m, n }, .{});
+    defer c_mat.release(pipeline);
+
+    const derivative = try Tensor(f32).alloc(context, pipeline, &.{ m, n }, .{});
+    defer derivative.release(pipeline);
+
+    var a_values: [m * k]f32 = undefined;
+    for (&a_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i % 5)) * 0.25 - 0.5;
+
+    var b_values: [n * k]f32 = undefined;
+    for (&b_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i % 3)) * 0.5 - 0.5;
+
+    var bias_values: [n]f32 = undefined;
+    for (&bias_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i)) * 0.1 - 0.3;
+
+    try memory.readFromBuffer(f32, pipeline, a, &a_values);
+    try memory.readFromBuffer(f32, pipeline, b, &b_values);
+    try memory.readFromBuffer(f32, pipeline, bias, &bias_values);
+
+    const packed_tensors = try PackedTensors(f32).init(pipeline, c_mat, k, true);
+    defer packed_tensors.deinit(pipeline);
+
+    for ([_]?*PackedTensors(f32){ null, packed_tensors }) |pt| {
+        inline for (.{ EpilogueActivation.sigmoid, EpilogueActivation.tanh, EpilogueActivation.relu }) |activation| {
+            try gemmWithEpilogue(f32, pipeline, null, a, .no_transpose, b, .transpose, null, c_mat, pt, .{
+                .bias = bias,
+                .activation = activation,
+                .derivative = derivative,
+            });
+
+            var result: [m * n]f32 = undefined;
+            var derivative_result: [m * n]f32 = undefined;
+            try memory.writeToBuffer(f32, pipeline, c_mat, &result);
+            try memory.writeToBuffer(f32, pipeline, derivative, &derivative_result);
+            pipeline.waitAndCleanup();
+
+            for (0..m) |i| {
+                for (0..n) |j| {
+                    var x: f32 = bias_values[j];
+                    for (0..k) |l| x += a_values[i * k + l] * b_values[j * k + l];
+
+                    var expected: f32 = undefined;
+                    var expected_derivative: f32 = undefined;
+                    switch (activation) {
+                        .sigmoid => {
+                            expected = 1 / (1 + @exp(-x));
+                            expected_derivative = expected * (1 - expected);
+                        },
+                        .tanh => {
+                            expected = std.math.tanh(x);
+                            expected_derivative = 1 - expected * expected;
+                        },
+                        .relu => {
+                            expected = @max(x, 0);
+                            expected_derivative = if (x > 0) 1 else 0;
+                        },
+                        .none => unreachable,
+                    }
+
+                    try testing.expectApproxEqAbs(expected, result[i * n + j], 1e-5);
+                    try testing.expectApproxEqAbs(expected_derivative, derivative_result[i * n + j], 1e-5);
+                }
+            }
+        }
+    }
+
+    // The bias must have a column of the result per element
+    const wrong_bias = try Tensor(f32).alloc(context, pipeline, &.{m}, .{});
+    defer wrong_bias.release(pipeline);
+
+    try testing.expectError(
+        tensor_module.Errors.InvalidValue,
+        gemmWithEpilogue(f32, pipeline, null, a, .no_transpose, b, .transpose, null, c_mat, null, .{ .bias = wrong_bias }),
+    );
+}
+
+test "gemm - epilogue arguments after alpha and beta" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    // The layout of Linear.forward: the epilogue arguments follow K, alpha and beta, whichever of
+    // them are passed, in both the unpacked and the packed kernels
+    const m = 6;
+    const k = 8;
+    const n = 10;
+
+    const a = try Tensor(f32).alloc(context, pipeline, &.{ m, k }, .{});
+    defer a.release(pipeline);
+
+    const b = try Tensor(f32).alloc(context, pipeline, &.{ n, k }, .{});
+    defer b.release(pipeline);
+
+    const bias = try Tensor(f32).alloc(context, pipeline, &.{n}, .{});
+    defer bias.release(pipeline);
+
+    const c_mat = try Tensor(f32).alloc(context, pipeline, &.{ m, n }, .{});
+    defer c_mat.release(pipeline);
+
+    var a_values: [m * k]f32 = undefined;
+    for (&a_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i % 7)) * 0.25 - 0.75;
+
+    var b_values: [n * k]f32 = undefined;
+    for (&b_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i % 3)) * 0.5 - 0.5;
+
+    var bias_values: [n]f32 = undefined;
+    for (&bias_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i)) * 0.5 - 2;
+
+    const c_values = [_]f32{0.5} ** (m * n);
+
+    try memory.readFromBuffer(f32, pipeline, a, &a_values);
+    try memory.readFromBuffer(f32, pipeline, b, &b_values);
+    try memory.readFromBuffer(f32, pipeline, bias, &bias_values);
+
+    const packed_tensors = try PackedTensors(f32).init(pipeline, c_mat, k, true);
+    defer packed_tensors.deinit(pipeline);
+
+    const scalars = [_][2]?f32{ .{ null, null }, .{ 2, null }, .{ 2, -1 } };
+    for ([_]?*PackedTensors(f32){ null, packed_tensors }) |pt| {
+        for (scalars) |alpha_beta| {
+            inline for (.{ EpilogueActivation.none, EpilogueActivation.relu }) |activation| {
+                const alpha, const beta = alpha_beta;
+
+                try memory.readFromBuffer(f32, pipeline, c_mat, &c_values);
+                try gemmWithEpilogue(f32, pipeline, alpha, a, .no_transpose, b, .transpose, beta, c_mat, pt, .{
+                    .bias = bias,
+                    .activation = activation,
+                });
+
+                var result: [m * n]f32 = undefined;
+                try memory.writeToBuffer(f32, pipeline, c_mat, &result);
+                pipeline.waitAndCleanup();
+
+                for (0..m) |i| {
+                    for (0..n) |j| {
+                        var acc: f32 = 0;
+                        for (0..k) |l| acc += a_values[i * k + l] * b_values[j * k + l];
+
+                        var expected = (alpha orelse 1) * acc + bias_values[j];
+                        if (beta) |beta_val| expected += beta_val * c_values[i * n + j];
+                        if (activation == .relu) expected = @max(expected, 0);
+
+                        try testing.expectApproxEqAbs(expected, result[i * n + j], 1e-5);
+                    }
+                }
+            }
+        }
+    }
+}
+
+test "gemm - conjugate and conjugate transpose operands" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(ComplexF32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const m = 6;
+    const k = 5;
+    const n = 5;
+
+    // c = a^H * conj(b)
+    const a = try Tensor(ComplexF32).alloc(context, pipeline, &.{ k, m }, .{});
+    defer a.release(pipeline);
+
+    const b = try Tensor(ComplexF32).alloc(context, pipeline, &.{ k, n }, .{});
+    defer b.release(pipeline);
+
+    const c_mat = try Tensor(ComplexF32).alloc(context, pipeline, &.{ m, n }, .{});
+    defer c_mat.release(pipeline);
+
+    var a_values: [k * m]ComplexF32 = undefined;
+    for (&a_values, 0..) |*v, i| {
+        v.* = .{ .real = @floatFromInt(i % 4), .imag = @as(f32, @floatFromInt(i % 3)) - 1 };
+    }
+
+    var b_values: [k * n]ComplexF32 = undefined;
+    for (&b_values, 0..) |*v, i| {
+        v.* = .{ .real = @as(f32, @floatFromInt(i % 5)) - 2, .imag = @floatFromInt(i % 2) };
+    }
+
+    try memory.readFromBuffer(ComplexF32, pipeline, a, &a_values);
+    try memory.readFromBuffer(ComplexF32, pipeline, b, &b_values);
+
+    var expected: [m * n]ComplexF32 = undefined;
+    for (0..m) |i| {
+        for (0..n) |j| {
+            var acc = ComplexF32{ .real = 0, .imag = 0 };
+            for (0..k) |l| {
+                const x = a_values[l * m + i];
+                const y = b_values[l * n + j];
+                // conj(x) * conj(y)
+                acc.real += x.real * y.real - x.imag * y.imag;
+                acc.imag -= x.real * y.imag + x.imag * y.real;
+            }
+            expected[i * n + j] = acc;
+        }
+    }
+
+    const packed_tensors = try PackedTensors(ComplexF32).init(pipeline, c_mat, k, false);
+    defer packed_tensors.deinit(pipeline);
+
+    for ([_]?*PackedTensors(ComplexF32){ null, packed_tensors }) |pt| {
+        try gemm(ComplexF32, pipeline, null, a, .conjugate_transpose, b, .conjugate, null, c_mat, pt);
+
+        var result: [m * n]ComplexF32 = undefined;
+        try memory.writeToBuffer(ComplexF32, pipeline, c_mat, &result);
+        pipeline.waitAndCleanup();
+
+        for (expected, result) |e, r| {
+            try testing.expectApproxEqAbs(e.real, r.real, 1e-3);
+            try testing.expectApproxEqAbs(e.imag, r.imag, 1e-3);
+        }
+    }
+}
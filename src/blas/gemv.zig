@@ -0,0 +1,471 @@
+const std = @import("std");
+const cl = @import("opencl");
+
+const core = @import("core");
+const Pipeline = core.Pipeline;
+const CommandQueue = core.CommandQueue;
+const KernelsSet = core.KernelsSet;
+
+const tensor_module = @import("tensor");
+const Tensor = tensor_module.Tensor;
+const TensorErrors = tensor_module.Errors;
+
+const gemm_module = @import("gemm.zig");
+const Operation = gemm_module.Operation;
+const Epilogue = gemm_module.Epilogue;
+
+const GEMV_KERNEL: []const u8 = @embedFile("kernels/gemv.cl");
+
+/// Products whose result has up to this many rows or columns are computed by the GEMV kernel,
+/// the tile kernels would spend most of their work on padding.
+pub const MAX_SKINNY_SIZE = 4;
+
+// Work-items reducing every element on devices with local memory
+const MAX_REDUCE_SIZE = 64;
+
+fn getReduceSize(command_queue: *const CommandQueue) u64 {
+    const max_work_group_size = command_queue.max_work_group_size;
+    if (command_queue.local_mem_type != .local or max_work_group_size < 2) return 1;
+    return @min(MAX_REDUCE_SIZE, std.math.floorPowerOfTwo(u64, max_work_group_size));
+}
+
+const KERNELS_PER_EPILOGUE = 2 * 2 * 2 * 4 * 4 * core.types.SUPPORTED_TYPES.len;
+
+fn getKernelIndex(
+    comptime T: type,
+    reduce: bool,
+    has_alpha: bool,
+    has_beta: bool,
+    op_a: Operation,
+    op_b: Operation,
+    epilogue_index: usize,
+) usize {
+    const SUPPORTED_TYPES = core.types.SUPPORTED_TYPES;
+
+    var kernel_index: usize = epilogue_index * KERNELS_PER_EPILOGUE;
+    kernel_index += @intFromBool(reduce) * (2 * 2 * 4 * 4 * SUPPORTED_TYPES.len);
+    kernel_index += @intFromBool(has_alpha) * (2 * 4 * 4 * SUPPORTED_TYPES.len);
+    kernel_index += @intFromBool(has_beta) * (4 * 4 * SUPPORTED_TYPES.len);
+    kernel_index += @intFromEnum(op_a.forType(T)) * (4 * SUPPORTED_TYPES.len);
+    kernel_index += @intFromEnum(op_b.forType(T)) * SUPPORTED_TYPES.len;
+    kernel_index += @as(usize, core.types.getTypeIndex(T));
+
+    return kernel_index;
+}
+
+fn getKernel(
+    comptime T: type,
+    command_queue: *const CommandQueue,
+    reduce: bool,
+    has_alpha: bool,
+    has_beta: bool,
+    op_a: Operation,
+    op_b: Operation,
+    epilogue_index: usize,
+) TensorErrors!cl.kernel.Kernel {
+    const kernels_set = try KernelsSet.getKernelSet(
+        command_queue,
+        .GEMV,
+        gemm_module.EPILOGUE_VARIANTS * KERNELS_PER_EPILOGUE,
+    );
+
+    const type_op_a = op_a.forType(T);
+    const type_op_b = op_b.forType(T);
+
+    const kernel_index = getKernelIndex(T, reduce, has_alpha, has_beta, op_a, op_b, epilogue_index);
+    if (kernels_set.kernels.?[kernel_index]) |v| return v;
+
+    var kernel: cl.kernel.Kernel = undefined;
+    var program: cl.program.Program = undefined;
+
+    const reduce_size: u64 = if (reduce) getReduceSize(command_queue) else 1;
+
+    var epilogue_buf: [128]u8 = undefined;
+    const allocator = command_queue.context.allocator;
+    const extra_args: []u8 = try std.fmt.allocPrint(
+        allocator,
+        "-DREDUCE_SIZE={d} -DHAS_ALPHA={d} -DHAS_BETA={d} -DA_TRANS={d} -DB_TRANS={d} -DA_CONJ={d} -DB_CONJ={d}{s}",
+        .{
+            reduce_size,
+            @intFromBool(has_alpha),
+            @intFromBool(has_beta),
+            @intFromBool(type_op_a.isTransposed()),
+            @intFromBool(type_op_b.isTransposed()),
+            @intFromBool(type_op_a.isConjugated()),
+            @intFromBool(type_op_b.isConjugated()),
+            gemm_module.getEpilogueArgs(&epilogue_buf, epilogue_index),
+        },
+    );
+    defer allocator.free(extra_args);
+
+    try KernelsSet.compileKernel(
+        T,
+        command_queue,
+        .{
+            .vectors_enabled = false,
+            .kernel_name = "gemv",
+            .extra_args = extra_args,
+        },
+        &kernel,
+        &program,
+        GEMV_KERNEL,
+    );
+
+    kernels_set.kernels.?[kernel_index] = kernel;
+    kernels_set.programs.?[kernel_index] = program;
+
+    return kernel;
+}
+
+// Sizes and pitches (in elements) of the product, vectors are described as matrices with a single
+// row or column
+const Product = struct {
+    rows: u64,
+    cols: u64,
+    k_size: u64,
+    batches: u64,
+
+    a_row_pitch: u64,
+    b_row_pitch: u64,
+    c_row_pitch: u64,
+
+    a_batch_pitch: u64 = 0,
+    b_batch_pitch: u64 = 0,
+    c_batch_pitch: u64 = 0,
+};
+
+fn enqueue(
+    comptime T: type,
+    pipeline: *Pipeline,
+    alpha: ?T,
+    a: *Tensor(T),
+    op_a: Operation,
+    b: *Tensor(T),
+    op_b: Operation,
+    beta: ?T,
+    c: *Tensor(T),
+    product: Product,
+    epilogue: Epilogue(T),
+) TensorErrors!void {
+    const command_queue = pipeline.command_queue;
+
+    const has_alpha = (alpha != null or beta != null);
+    const has_beta = (beta != null);
+
+    // Reducing over K only pays off when the operand read along the longest side of the result
+    // is contiguous along K, otherwise neighbouring work-items already read neighbouring elements
+    const reduce_size = getReduceSize(command_queue);
+    const contiguous_k = if (product.rows <= product.cols) op_b.isTransposed() else !op_a.isTransposed();
+    const reduce = (reduce_size > 1 and contiguous_k and product.k_size >= reduce_size);
+
+    const kernel = try getKernel(
+        T,
+        command_queue,
+        reduce,
+        has_alpha,
+        has_beta,
+        op_a,
+        op_b,
+        epilogue.getIndex(),
+    );
+
+    // Every work-group of the reduction computes a single element, so its global size is never
+    // padded. Otherwise the tuned local size pads it, the kernel skips what is out of C.
+    const global_work_items = [3]u64{ product.rows, product.cols, product.batches };
+    var padded_global_work_items: [3]u64 = undefined;
+    var local_work_items: [3]u64 = undefined;
+    if (reduce) {
+        padded_global_work_items = .{ product.rows * reduce_size, product.cols, product.batches };
+        local_work_items = .{ reduce_size, 1, 1 };
+    } else {
+        core.WorkGroupTuner.getLocalWorkItems(
+            command_queue,
+            "gemv",
+            getKernelIndex(T, reduce, has_alpha, has_beta, op_a, op_b, epilogue.getIndex()),
+            &global_work_items,
+            &padded_global_work_items,
+            &local_work_items,
+        );
+    }
+
+    c.markModified();
+    if (epilogue.derivative) |v| v.markModified();
+
+    const prev_events = pipeline.prevEvents();
+
+    const setArg = cl.kernel.setArg;
+    const cl_mem_size = @sizeOf(cl.buffer.Mem);
+
+    try setArg(kernel, 0, cl_mem_size, @ptrCast(&a.buffer));
+    try setArg(kernel, 1, cl_mem_size, @ptrCast(&b.buffer));
+    try setArg(kernel, 2, cl_mem_size, @ptrCast(&c.buffer));
+
+    try setArg(kernel, 3, @sizeOf(u64), @ptrCast(&product.a_row_pitch));
+    try setArg(kernel, 4, @sizeOf(u64), @ptrCast(&product.b_row_pitch));
+    try setArg(kernel, 5, @sizeOf(u64), @ptrCast(&product.c_row_pitch));
+
+    try setArg(kernel, 6, @sizeOf(u64), @ptrCast(&product.a_batch_pitch));
+    try setArg(kernel, 7, @sizeOf(u64), @ptrCast(&product.b_batch_pitch));
+    try setArg(kernel, 8, @sizeOf(u64), @ptrCast(&product.c_batch_pitch));
+
+    try setArg(kernel, 9, @sizeOf(u64), @ptrCast(&product.k_size));
+
+    for (global_work_items, 10..) |g, arg_index| {
+        try setArg(kernel, @intCast(arg_index), @sizeOf(u64), @ptrCast(&g));
+    }
+
+    if (has_alpha) {
+        const alpha_val: T = alpha orelse if (comptime core.types.isComplex(T))
+            .{ .real = 1, .imag = 0 }
+        else
+            1;
+        try setArg(kernel, 13, @sizeOf(T), @ptrCast(&alpha_val));
+
+        if (has_beta) {
+            const beta_val = beta.?;
+            try setArg(kernel, 14, @sizeOf(T), @ptrCast(&beta_val));
+        }
+    }
+
+    try gemm_module.setEpilogueArgs(T, kernel, 13 + @as(u32, @intFromBool(has_alpha)) + @intFromBool(has_beta), c, epilogue);
+
+    var new_event: cl.event.Event = undefined;
+    try cl.kernel.enqueueNdRange(
+        command_queue.cl_command_queue,
+        kernel,
+        null,
+        &padded_global_work_items,
+        &local_work_items,
+        prev_events,
+        &new_event,
+    );
+    errdefer tensor_module.helpers.releaseEvent(new_event);
+
+    try pipeline.append(&.{new_event});
+}
+
+/// Whether `gemm` computes the product of the result `c` with the GEMV kernel.
+pub fn isSkinny(comptime T: type, c: *Tensor(T)) bool {
+    const shape = c.dimensions.shape;
+    return (gemm_module.getRows(shape) <= MAX_SKINNY_SIZE or gemm_module.getCols(shape) <= MAX_SKINNY_SIZE);
+}
+
+/// GEMM of `gemm` for skinny results, the tensors must have been validated already.
+pub fn skinnyGemm(
+    comptime T: type,
+    pipeline: *Pipeline,
+    alpha: ?T,
+    a: *Tensor(T),
+    op_a: Operation,
+    b: *Tensor(T),
+    op_b: Operation,
+    beta: ?T,
+    c: *Tensor(T),
+    epilogue: Epilogue(T),
+) TensorErrors!void {
+    const a_shape = a.dimensions.shape;
+    const c_shape = c.dimensions.shape;
+
+    try enqueue(T, pipeline, alpha, a, op_a, b, op_b, beta, c, .{
+        .rows = gemm_module.getRows(c_shape),
+        .cols = gemm_module.getCols(c_shape),
+        .k_size = a_shape[a_shape.len - 1 - @intFromBool(op_a.isTransposed())],
+        .batches = gemm_module.getBatches(c_shape),
+
+        .a_row_pitch = a.memory_layout.row_pitch,
+        .b_row_pitch = b.memory_layout.row_pitch,
+        .c_row_pitch = c.memory_layout.row_pitch,
+
+        .a_batch_pitch = gemm_module.getBatchPitch(T, a, false),
+        .b_batch_pitch = gemm_module.getBatchPitch(T, b, false),
+        .c_batch_pitch = c.memory_layout.slice_pitch,
+    }, epilogue);
+}
+
+/// `y = alpha * op_a(a) * x + beta * y`, where `a` is a matrix and `x` and `y` are vectors with as
+/// many elements as `op_a(a)` has columns and rows.
+pub fn gemv(
+    comptime T: type,
+    pipeline: *Pipeline,
+    alpha: ?T,
+    a: *Tensor(T),
+    op_a: Operation,
+    x: *Tensor(T),
+    beta: ?T,
+    y: *Tensor(T),
+) TensorErrors!void {
+    if (a.context != x.context or a.context != y.context) {
+        return tensor_module.Errors.UnqualTensorsContext;
+    }
+
+    const a_shape = a.dimensions.shape;
+    const x_shape = x.dimensions.shape;
+    const y_shape = y.dimensions.shape;
+    if (a_shape.len != 2 or x_shape.len != 1 or y_shape.len != 1) {
+        return tensor_module.Errors.InvalidValue;
+    }
+
+    const transposed = op_a.isTransposed();
+    const rows = a_shape[@intFromBool(transposed)];
+    const k_size = a_shape[1 - @intFromBool(transposed)];
+    if (x_shape[0] != k_size or y_shape[0] != rows) {
+        return tensor_module.Errors.InvalidValue;
+    }
+
+    // x is read as a transposed matrix with a single row and y is written as a column, one element
+    // after the other
+    try enqueue(T, pipeline, alpha, a, op_a, x, .transpose, beta, y, .{
+        .rows = rows,
+        .cols = 1,
+        .k_size = k_size,
+        .batches = 1,
+
+        .a_row_pitch = a.memory_layout.row_pitch,
+        .b_row_pitch = x.memory_layout.row_pitch,
+        .c_row_pitch = 1,
+    }, .{});
+}
+
+// -----------------------------------------------------------------------------
+// Unit Tests
+const testing = std.testing;
+
+const memory = tensor_module.memory;
+
+test "gemv - matrix vector products" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const m = 37;
+    const k = 150;
+
+    const a = try Tensor(f32).alloc(context, pipeline, &.{ m, k }, .{});
+    defer a.release(pipeline);
+
+    const x = try Tensor(f32).alloc(context, pipeline, &.{k}, .{});
+    defer x.release(pipeline);
+
+    const x_t = try Tensor(f32).alloc(context, pipeline, &.{m}, .{});
+    defer x_t.release(pipeline);
+
+    const y = try Tensor(f32).alloc(context, pipeline, &.{m}, .{});
+    defer y.release(pipeline);
+
+    const y_t = try Tensor(f32).alloc(context, pipeline, &.{k}, .{});
+    defer y_t.release(pipeline);
+
+    var a_values: [m * k]f32 = undefined;
+    for (&a_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i % 7)) * 0.5 - 1.5;
+
+    var x_values: [k]f32 = undefined;
+    for (&x_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i % 5)) - 2;
+
+    var x_t_values: [m]f32 = undefined;
+    for (&x_t_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i % 3)) - 1;
+
+    const y_values = [_]f32{1} ** m;
+
+    try memory.readFromBuffer(f32, pipeline, a, &a_values);
+    try memory.readFromBuffer(f32, pipeline, x, &x_values);
+    try memory.readFromBuffer(f32, pipeline, x_t, &x_t_values);
+    try memory.readFromBuffer(f32, pipeline, y, &y_values);
+
+    // y = 2 * a * x + 3 * y and y_t = a^T * x_t
+    try gemv(f32, pipeline, 2, a, .no_transpose, x, 3, y);
+    try gemv(f32, pipeline, null, a, .transpose, x_t, null, y_t);
+
+    var result: [m]f32 = undefined;
+    var result_t: [k]f32 = undefined;
+    try memory.writeToBuffer(f32, pipeline, y, &result);
+    try memory.writeToBuffer(f32, pipeline, y_t, &result_t);
+    pipeline.waitAndCleanup();
+
+    for (0..m) |i| {
+        var expected: f32 = 0;
+        for (0..k) |l| expected += a_values[i * k + l] * x_values[l];
+        try testing.expectApproxEqAbs(2 * expected + 3, result[i], 1e-2);
+    }
+
+    for (0..k) |l| {
+        var expected: f32 = 0;
+        for (0..m) |i| expected += a_values[i * k + l] * x_t_values[i];
+        try testing.expectApproxEqAbs(expected, result_t[l], 1e-2);
+    }
+
+    try testing.expectError(TensorErrors.InvalidValue, gemv(f32, pipeline, null, a, .transpose, x, null, y));
+}
+
+test "gemv - skinny products through gemm" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const k = 70;
+    const n = 33;
+
+    // Single sample through a layer: c = input * weight^T + bias
+    const input = try Tensor(f32).alloc(context, pipeline, &.{ 1, k }, .{});
+    defer input.release(pipeline);
+
+    const weight = try Tensor(f32).alloc(context, pipeline, &.{ n, k }, .{});
+    defer weight.release(pipeline);
+
+    const bias = try Tensor(f32).alloc(context, pipeline, &.{n}, .{});
+    defer bias.release(pipeline);
+
+    const c_mat = try Tensor(f32).alloc(context, pipeline, &.{ 1, n }, .{});
+    defer c_mat.release(pipeline);
+
+    const c_t = try Tensor(f32).alloc(context, pipeline, &.{ n, 1 }, .{});
+    defer c_t.release(pipeline);
+
+    var input_values: [k]f32 = undefined;
+    for (&input_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i % 4)) * 0.25;
+
+    var weight_values: [n * k]f32 = undefined;
+    for (&weight_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i % 9)) * 0.1 - 0.4;
+
+    var bias_values: [n]f32 = undefined;
+    for (&bias_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i)) * 0.05;
+
+    try memory.readFromBuffer(f32, pipeline, input, &input_values);
+    try memory.readFromBuffer(f32, pipeline, weight, &weight_values);
+    try memory.readFromBuffer(f32, pipeline, bias, &bias_values);
+
+    try testing.expect(isSkinny(f32, c_mat));
+
+    try gemm_module.gemmWithEpilogue(f32, pipeline, null, input, .no_transpose, weight, .transpose, null, c_mat, null, .{
+        .bias = bias,
+    });
+
+    // Same product transposed: c_t = weight * input^T
+    try gemm_module.gemm(f32, pipeline, null, weight, .no_transpose, input, .transpose, null, c_t, null);
+
+    var result: [n]f32 = undefined;
+    var result_t: [n]f32 = undefined;
+    try memory.writeToBuffer(f32, pipeline, c_mat, &result);
+    try memory.writeToBuffer(f32, pipeline, c_t, &result_t);
+    pipeline.waitAndCleanup();
+
+    for (0..n) |j| {
+        var expected: f32 = 0;
+        for (0..k) |l| expected += input_values[l] * weight_values[j * k + l];
+        try testing.expectApproxEqAbs(expected + bias_values[j], result[j], 1e-3);
+        try testing.expectApproxEqAbs(expected, result_t[j], 1e-3);
+    }
+}
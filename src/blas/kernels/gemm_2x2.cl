@@ -9,33 +9,45 @@
  * buffers. Supports optional transpose on A and/or B via compile-time flags.
  *
  * Computes: C = alpha * op(A) * op(B) + beta * C
- * where op(X) = X or X^T depending on A_TRANS / B_TRANS flags.
+ * where op(X) = X, X^T, conj(X) or X^H depending on the A_TRANS / B_TRANS and
+ * A_CONJ / B_CONJ flags.
  *
  * COMPILE-TIME PARAMETERS
  * -----------------------
  * A_TRANS          - 0: A is row-major, 1: A is transposed
  * B_TRANS          - 0: B is column-major access, 1: B is row-major
+ * A_CONJ           - 1: complex A is conjugated while it is loaded
+ * B_CONJ           - 1: complex B is conjugated while it is loaded
  * HAS_ALPHA        - 0: alpha=1 (omitted), 1: alpha scaling is applied
  * HAS_BETA         - 0: no beta term, 1: beta * C_old is added (requires HAS_ALPHA)
+ * WK_GEMM_EPILOGUE - Bias and activation epilogue, see GEMM EPILOGUE in wekua.h
  * WK_COMPLEX       - 0: scalar/vector types, 1: complex arithmetic
  * WK_VECTOR_WIDTH  - SIMD vector width (1, 2, 4, 8, 16)
  *
  * KERNEL PARAMETERS
  * -----------------
- * A                - Input matrix A (__global, read-only)
- * B                - Input matrix B (__global, read-only)
- * C                - Output matrix C (__global, read-write, scalar type wks)
+ * A_matrices       - Input matrices A (__global, read-only)
+ * B_matrices       - Input matrices B (__global, read-only)
+ * C_matrices       - Output matrices C (__global, read-write, scalar type wks)
  * A_row_pitch      - Elements per row in A
  * B_row_pitch      - Elements per row in B
  * C_row_pitch      - Elements per row in C
+ * A_batch_pitch    - Elements between the matrices of A in the batch (0: broadcast)
+ * B_batch_pitch    - Elements between the matrices of B in the batch (0: broadcast)
+ * C_batch_pitch    - Elements between the matrices of C in the batch
  * cols             - Shared dimension K (number of columns of op(A) / rows of op(B))
  * alpha            - Scalar multiplier (conditional on HAS_ALPHA)
  * beta             - Scalar multiplier for existing C (conditional on HAS_BETA)
+ * C_rows           - Rows of C, without padding (conditional on WK_GEMM_EPILOGUE)
+ * C_cols           - Columns of C, without padding (conditional on WK_GEMM_EPILOGUE)
+ * bias             - Row vector added to every row of C (conditional on WK_GEMM_BIAS)
+ * derivatives      - Derivatives of the activation, same layout as C (conditional on WK_GEMM_DERIVATIVE)
  *
- * NDRANGE (2D)
+ * NDRANGE (3D)
  * ------------
  * dim 0 (i)  - Output row index / 2  (each WI covers 2 rows)
  * dim 1 (j)  - Output column index / 2  (each WI covers 2 columns)
+ * dim 2 (b)  - Index of the product in the batch
  * Global IDs are shifted << 1 to get the actual row/column.
  *
  * ALGORITHM
@@ -63,15 +75,19 @@
 #include "wekua.h"
 
 __kernel void gemm(
-    __global const wk *const restrict A,
-    __global const wk *const restrict B,
+    __global const wk *const restrict A_matrices,
+    __global const wk *const restrict B_matrices,
 
-    __global wks *const restrict C,
+    __global wks *const restrict C_matrices,
 
     const ulong A_row_pitch,
     const ulong B_row_pitch,
     const ulong C_row_pitch,
 
+    const ulong A_batch_pitch,
+    const ulong B_batch_pitch,
+    const ulong C_batch_pitch,
+
     const ulong cols
 
 #if HAS_ALPHA
@@ -80,7 +96,25 @@ __kernel void gemm(
     , const wks beta
 #endif
 #endif
+
+#ifdef WK_GEMM_EPILOGUE
+    , const ulong C_rows
+    , const ulong C_cols
+#if WK_GEMM_BIAS
+    , __global const wks *const restrict bias
+#endif
+#if WK_GEMM_DERIVATIVE
+    , __global wks *const restrict derivatives
+#endif
+#endif
 ) {
+    // Matrices of the product computed by this work-item, operands broadcast across the batch
+    // have a batch pitch of 0
+    const ulong batch = get_global_id(2);
+    __global const wk *const restrict A = A_matrices + batch*A_batch_pitch;
+    __global const wk *const restrict B = B_matrices + batch*B_batch_pitch;
+    __global wks *const restrict C = C_matrices + batch*C_batch_pitch;
+
     // Each work-item computes a 2x2 block; shift IDs to get top-left corner
     const ulong i = get_global_id(0) << 1;
     const ulong j = get_global_id(1) << 1;
@@ -125,15 +159,15 @@ __kernel void gemm(
         const ulong A_index = k*A_row_pitch + i;
         const ulong A_index2 = A_index + A_row_pitch;
 
-        const wk A11 = A[A_index];
-        const wk A21 = A[A_index + 1];
-        const wk A12 = A[A_index2];
-        const wk A22 = A[A_index2 + 1];
+        const wk A11 = GEMM_LOAD_A(A[A_index]);
+        const wk A21 = GEMM_LOAD_A(A[A_index + 1]);
+        const wk A12 = GEMM_LOAD_A(A[A_index2]);
+        const wk A22 = GEMM_LOAD_A(A[A_index2 + 1]);
 #else
-        const wk A11 = A[row_A + k];
-        const wk A12 = A[row_A + k + 1];
-        const wk A21 = A[next_row_A + k];
-        const wk A22 = A[next_row_A + k + 1];
+        const wk A11 = GEMM_LOAD_A(A[row_A + k]);
+        const wk A12 = GEMM_LOAD_A(A[row_A + k + 1]);
+        const wk A21 = GEMM_LOAD_A(A[next_row_A + k]);
+        const wk A22 = GEMM_LOAD_A(A[next_row_A + k + 1]);
 #endif
 
         // B_TRANS=1: B is stored transposed, read row j of B^T (= column j of B).
@@ -141,18 +175,18 @@ __kernel void gemm(
         // Note: B11/B12/B21/B22 naming matches the 2x2 sub-block of op(B),
         // where B_ij means row i, col j of the effective (possibly transposed) B.
 #if B_TRANS
-        const wk B11 = B[row_B + k];
-        const wk B21 = B[row_B + k + 1];
-        const wk B12 = B[next_row_B + k];
-        const wk B22 = B[next_row_B + k + 1];
+        const wk B11 = GEMM_LOAD_B(B[row_B + k]);
+        const wk B21 = GEMM_LOAD_B(B[row_B + k + 1]);
+        const wk B12 = GEMM_LOAD_B(B[next_row_B + k]);
+        const wk B22 = GEMM_LOAD_B(B[next_row_B + k + 1]);
 #else
         const ulong B_index = k*B_row_pitch + j;
         const ulong B_index2 = B_index + B_row_pitch;
 
-        const wk B11 = B[B_index];
-        const wk B12 = B[B_index + 1];
-        const wk B21 = B[B_index2];
-        const wk B22 = B[B_index2 + 1];
+        const wk B11 = GEMM_LOAD_B(B[B_index]);
+        const wk B12 = GEMM_LOAD_B(B[B_index + 1]);
+        const wk B21 = GEMM_LOAD_B(B[B_index2]);
+        const wk B22 = GEMM_LOAD_B(B[B_index2 + 1]);
 #endif
 
 #if WK_COMPLEX
@@ -238,40 +272,40 @@ __kernel void gemm(
 #elif WK_VECTOR_WIDTH == 1
 #if HAS_ALPHA
 #if HAS_BETA
-    C[C_index] = alpha*C11 + beta*C[C_index];
-    C[C_index + 1] = alpha*C12 + beta*C[C_index + 1];
-    C[C_index2] = alpha*C21 + beta*C[C_index2];
-    C[C_index2 + 1] = alpha*C22 + beta*C[C_index2 + 1];
+    GEMM_STORE(C_index, i, j, alpha*C11 + beta*C[C_index]);
+    GEMM_STORE(C_index + 1, i, j + 1, alpha*C12 + beta*C[C_index + 1]);
+    GEMM_STORE(C_index2, i + 1, j, alpha*C21 + beta*C[C_index2]);
+    GEMM_STORE(C_index2 + 1, i + 1, j + 1, alpha*C22 + beta*C[C_index2 + 1]);
 #else
-    C[C_index] = alpha*C11;
-    C[C_index + 1] = alpha*C12;
-    C[C_index2] = alpha*C21;
-    C[C_index2 + 1] = alpha*C22;
+    GEMM_STORE(C_index, i, j, alpha*C11);
+    GEMM_STORE(C_index + 1, i, j + 1, alpha*C12);
+    GEMM_STORE(C_index2, i + 1, j, alpha*C21);
+    GEMM_STORE(C_index2 + 1, i + 1, j + 1, alpha*C22);
 #endif
 #else
-    C[C_index] = C11;
-    C[C_index + 1] = C12;
-    C[C_index2] = C21;
-    C[C_index2 + 1] = C22;
+    GEMM_STORE(C_index, i, j, C11);
+    GEMM_STORE(C_index + 1, i, j + 1, C12);
+    GEMM_STORE(C_index2, i + 1, j, C21);
+    GEMM_STORE(C_index2 + 1, i + 1, j + 1, C22);
 #endif
 #else
 #if HAS_ALPHA
 #if HAS_BETA
-    C[C_index] = alpha*sum(C11) + beta*C[C_index];
-    C[C_index + 1] = alpha*sum(C12) + beta*C[C_index + 1];
-    C[C_index2] = alpha*sum(C21) + beta*C[C_index2];
-    C[C_index2 + 1] = alpha*sum(C22) + beta*C[C_index2 + 1];
+    GEMM_STORE(C_index, i, j, alpha*sum(C11) + beta*C[C_index]);
+    GEMM_STORE(C_index + 1, i, j + 1, alpha*sum(C12) + beta*C[C_index + 1]);
+    GEMM_STORE(C_index2, i + 1, j, alpha*sum(C21) + beta*C[C_index2]);
+    GEMM_STORE(C_index2 + 1, i + 1, j + 1, alpha*sum(C22) + beta*C[C_index2 + 1]);
 #else
-    C[C_index] = alpha*sum(C11);
-    C[C_index + 1] = alpha*sum(C12);
-    C[C_index2] = alpha*sum(C21);
-    C[C_index2 + 1] = alpha*sum(C22);
+    GEMM_STORE(C_index, i, j, alpha*sum(C11));
+    GEMM_STORE(C_index + 1, i, j + 1, alpha*sum(C12));
+    GEMM_STORE(C_index2, i + 1, j, alpha*sum(C21));
+    GEMM_STORE(C_index2 + 1, i + 1, j + 1, alpha*sum(C22));
 #endif
 #else
-    C[C_index] = sum(C11);
-    C[C_index + 1] = sum(C12);
-    C[C_index2] = sum(C21);
-    C[C_index2 + 1] = sum(C22);
+    GEMM_STORE(C_index, i, j, sum(C11));
+    GEMM_STORE(C_index + 1, i, j + 1, sum(C12));
+    GEMM_STORE(C_index2, i + 1, j, sum(C21));
+    GEMM_STORE(C_index2 + 1, i + 1, j + 1, sum(C22));
 #endif
 #endif
 }
@@ -4,8 +4,11 @@
  * =============================================================================
  *
  * General-purpose CPU GEMM kernel supporting any BLOCK_SIZE (4, 8, 16, 32, 64).
- * Each work-item computes one BLOCK_SIZE x BLOCK_SIZE tile of C using private
- * memory buffers for A, B, and C tiles. Two micro-kernel variants are selected
+ * Each work-item computes one BLOCK_ROWS x BLOCK_COLS tile of C using private
+ * memory buffers for A, B, and C tiles, stepping over K by BLOCK_SIZE. Tiles
+ * are square unless BLOCK_ROWS and BLOCK_COLS are given, rectangular ones fit
+ * results whose rows and columns don't share a large power of two, then
+ * BLOCK_SIZE is their shorter side. Two micro-kernel variants are selected
  * at compile time based on vector width:
  *   - 2x2 micro-kernel: used when WK_VECTOR_WIDTH <= 8 or WK_COMPLEX
  *   - 4x4 micro-kernel: used when WK_VECTOR_WIDTH > 8 (e.g., 16-wide vectors)
@@ -15,37 +18,51 @@
  *
  * COMPILE-TIME PARAMETERS
  * -----------------------
- * BLOCK_SIZE        - Tile dimension (4, 8, 16, 32, 64)
+ * BLOCK_SIZE        - Tile dimension (4, 8, 16, 32, 64), the step over K
+ * BLOCK_ROWS        - Rows of the tile of C (optional, defaults to BLOCK_SIZE)
+ * BLOCK_COLS        - Columns of the tile of C (optional, defaults to BLOCK_SIZE)
  * STRIDE            - log2(BLOCK_SIZE), used for bit-shift addressing
  * A_TRANS           - 0: A is row-major, 1: A is transposed
  * B_TRANS           - 0: B is column-major access, 1: B is row-major
+ * A_CONJ            - 1: complex A is conjugated while it is loaded
+ * B_CONJ            - 1: complex B is conjugated while it is loaded
  * HAS_ALPHA         - 0: alpha=1 (omitted), 1: alpha scaling is applied
  * HAS_BETA          - 0: no beta term, 1: beta * C_old is added
+ * WK_GEMM_EPILOGUE  - Bias and activation epilogue, see GEMM EPILOGUE in wekua.h
  * WK_COMPLEX        - 0: scalar/vector types, 1: complex arithmetic
  * WK_VECTOR_WIDTH   - SIMD vector width (1, 2, 4, 8, 16)
  * WK_CACHE_LINE_SIZE - Alignment for private tile buffers
  *
  * KERNEL PARAMETERS
  * -----------------
- * A                - Input matrix A (__global, read-only)
- * B                - Input matrix B (__global, read-only)
- * C                - Output matrix C (__global, read-write, scalar type wks)
+ * A_matrices       - Input matrices A (__global, read-only)
+ * B_matrices       - Input matrices B (__global, read-only)
+ * C_matrices       - Output matrices C (__global, read-write, scalar type wks)
  * A_row_pitch      - Elements per row in A
  * B_row_pitch      - Elements per row in B
  * C_row_pitch      - Elements per row in C
+ * A_batch_pitch    - Elements between the matrices of A in the batch (0: broadcast)
+ * B_batch_pitch    - Elements between the matrices of B in the batch (0: broadcast)
+ * C_batch_pitch    - Elements between the matrices of C in the batch
  * cols             - Shared dimension K (padded to multiple of BLOCK_SIZE)
  * alpha            - Scalar multiplier (conditional on HAS_ALPHA)
  * beta             - Scalar multiplier for existing C (conditional on HAS_BETA)
+ * C_rows           - Rows of C, without padding (conditional on WK_GEMM_EPILOGUE)
+ * C_cols           - Columns of C, without padding (conditional on WK_GEMM_EPILOGUE)
+ * bias             - Row vector added to every row of C (conditional on WK_GEMM_BIAS)
+ * derivatives      - Derivatives of the activation, same layout as C (conditional on WK_GEMM_DERIVATIVE)
  *
- * NDRANGE (2D)
+ * NDRANGE (3D)
  * ------------
- * dim 0 (i)  - Output tile-row index  (actual row = global_id(0) << STRIDE)
- * dim 1 (j)  - Output tile-col index  (actual col = global_id(1) << STRIDE)
+ * dim 0 (i)  - Output tile-row index  (actual row = global_id(0) * BLOCK_ROWS)
+ * dim 1 (j)  - Output tile-col index  (actual col = global_id(1) * BLOCK_COLS)
+ * dim 2 (b)  - Index of the product in the batch
  *
  * ALGORITHM
  * ---------
- * 1. Map work-item to output tile at (i, j) via global_id << STRIDE
- * 2. Allocate private A_tmp, B_tmp, C_tmp buffers (BLOCK_SIZE^2 each)
+ * 1. Map work-item to output tile at (i, j) via global_id * BLOCK_ROWS/BLOCK_COLS
+ * 2. Allocate private A_tmp (BLOCK_ROWS x BLOCK_SIZE), B_tmp (BLOCK_COLS x
+ *    BLOCK_SIZE) and C_tmp (BLOCK_ROWS x BLOCK_COLS) buffers
  * 3. Loop k from 0 to cols in steps of BLOCK_SIZE:
  *    a. Load A tile using FILL_TILE (normal) or FILL_TRANSPOSED_TILE (transposed)
  *    b. Load B tile — B is always stored transposed in B_tmp_buffer so that the
@@ -68,19 +85,27 @@
 
 #include "wekua.h"
 
+#ifndef BLOCK_ROWS
+#define BLOCK_ROWS BLOCK_SIZE
+#endif
+
+#ifndef BLOCK_COLS
+#define BLOCK_COLS BLOCK_SIZE
+#endif
+
 /**
- * FILL_TILE — Load a BLOCK_SIZE x BLOCK_SIZE tile from global memory (row-major)
+ * FILL_TILE — Load a tile_rows x BLOCK_SIZE tile from global memory (row-major)
  *
  * Copies a contiguous block of the source matrix into a private tile buffer.
  * Used for A when A_TRANS=0, and for B when B_TRANS=1 (B^T is row-major in
  * the output column direction).
  */
-#define FILL_TILE(tile, values, row_index, col_index, row_pitch) \
+#define FILL_TILE(tile, values, row_index, col_index, row_pitch, load, tile_rows) \
     base_index = row_index * row_pitch + col_index; \
-    for (ulong y = 0; y < BLOCK_SIZE; y += 1) { \
+    for (ulong y = 0; y < tile_rows; y += 1) { \
         __attribute__((opencl_unroll_hint)) \
         for (ulong x = 0; x < BLOCK_SIZE; x += 1) { \
-            tile[y * BLOCK_SIZE + x] = values[base_index + x]; \
+            tile[y * BLOCK_SIZE + x] = load(values[base_index + x]); \
         } \
         base_index += row_pitch; \
     }
@@ -94,26 +119,30 @@
  * - B when B_TRANS=0: transposes B so the micro-kernel can read B columns
  *   as contiguous rows, which improves spatial locality
  */
-#define FILL_TRANSPOSED_TILE(tile, values, row_index, col_index, row_pitch) \
-    for (ulong y = 0; y < BLOCK_SIZE; y += 1) { \
+#define FILL_TRANSPOSED_TILE(tile, values, row_index, col_index, row_pitch, load, tile_rows) \
+    for (ulong y = 0; y < tile_rows; y += 1) { \
         base_index = row_index * row_pitch + col_index + y; \
         __attribute__((opencl_unroll_hint)) \
         for (ulong x = 0; x < BLOCK_SIZE; x += 1) { \
-            tile[y * BLOCK_SIZE + x] = values[base_index]; \
+            tile[y * BLOCK_SIZE + x] = load(values[base_index]); \
             base_index += row_pitch; \
         } \
     }
 
 __kernel void gemm(
-    __global const wk *const restrict A,
-    __global const wk *const restrict B,
+    __global const wk *const restrict A_matrices,
+    __global const wk *const restrict B_matrices,
 
-    __global wks *const restrict C,
+    __global wks *const restrict C_matrices,
 
     const ulong A_row_pitch,
     const ulong B_row_pitch,
     const ulong C_row_pitch,
 
+    const ulong A_batch_pitch,
+    const ulong B_batch_pitch,
+    const ulong C_batch_pitch,
+
     const ulong cols
 
 #if HAS_ALPHA
@@ -122,13 +151,31 @@ __kernel void gemm(
     , const wks beta
 #endif
 #endif
+
+#ifdef WK_GEMM_EPILOGUE
+    , const ulong C_rows
+    , const ulong C_cols
+#if WK_GEMM_BIAS
+    , __global const wks *const restrict bias
+#endif
+#if WK_GEMM_DERIVATIVE
+    , __global wks *const restrict derivatives
+#endif
+#endif
 ) {
-    const ulong i = get_global_id(0) << STRIDE;
-    const ulong j = get_global_id(1) << STRIDE;
+    // Matrices of the product computed by this work-item, operands broadcast across the batch
+    // have a batch pitch of 0
+    const ulong batch = get_global_id(2);
+    __global const wk *const restrict A = A_matrices + batch*A_batch_pitch;
+    __global const wk *const restrict B = B_matrices + batch*B_batch_pitch;
+    __global wks *const restrict C = C_matrices + batch*C_batch_pitch;
+
+    const ulong i = get_global_id(0) * BLOCK_ROWS;
+    const ulong j = get_global_id(1) * BLOCK_COLS;
 
-    private wk A_tmp_buffer[BLOCK_SIZE * BLOCK_SIZE] __attribute__((aligned(WK_CACHE_LINE_SIZE)));
-    private wk B_tmp_buffer[BLOCK_SIZE * BLOCK_SIZE] __attribute__((aligned(WK_CACHE_LINE_SIZE)));
-    private wk C_tmp_buffer[BLOCK_SIZE * BLOCK_SIZE] __attribute__((aligned(WK_CACHE_LINE_SIZE))) = {0};
+    private wk A_tmp_buffer[BLOCK_ROWS * BLOCK_SIZE] __attribute__((aligned(WK_CACHE_LINE_SIZE)));
+    private wk B_tmp_buffer[BLOCK_COLS * BLOCK_SIZE] __attribute__((aligned(WK_CACHE_LINE_SIZE)));
+    private wk C_tmp_buffer[BLOCK_ROWS * BLOCK_COLS] __attribute__((aligned(WK_CACHE_LINE_SIZE))) = {0};
 
 #if WK_COMPLEX
     COMPLEX_MUL_K(T)
@@ -139,9 +186,9 @@ __kernel void gemm(
         // A_TRANS=1: A is stored transposed, so we read it transposed to get the
         // correct orientation. A_TRANS=0: normal row-major read.
 #if A_TRANS
-        FILL_TRANSPOSED_TILE(A_tmp_buffer, A, k, i, A_row_pitch)
+        FILL_TRANSPOSED_TILE(A_tmp_buffer, A, k, i, A_row_pitch, GEMM_LOAD_A, BLOCK_ROWS)
 #else
-        FILL_TILE(A_tmp_buffer, A, i, k, A_row_pitch)
+        FILL_TILE(A_tmp_buffer, A, i, k, A_row_pitch, GEMM_LOAD_A, BLOCK_ROWS)
 #endif
 
         // B is ALWAYS stored transposed in B_tmp_buffer regardless of B_TRANS.
@@ -149,17 +196,17 @@ __kernel void gemm(
         // B_TRANS=1: B is already transposed in memory, use normal FILL_TILE.
         // B_TRANS=0: B is row-major, transpose during load.
 #if B_TRANS
-        FILL_TILE(B_tmp_buffer, B, j, k, B_row_pitch)
+        FILL_TILE(B_tmp_buffer, B, j, k, B_row_pitch, GEMM_LOAD_B, BLOCK_COLS)
 #else
-        FILL_TRANSPOSED_TILE(B_tmp_buffer, B, k, j, B_row_pitch)
+        FILL_TRANSPOSED_TILE(B_tmp_buffer, B, k, j, B_row_pitch, GEMM_LOAD_B, BLOCK_COLS)
 #endif
 
         // Select micro-kernel size based on vector width:
         // - 2x2: for narrow vectors (<=8) or complex types; 4 accumulators
         // - 4x4: for wide vectors (>8), 16 accumulators to better fill SIMD lanes
 #if WK_VECTOR_WIDTH <= 8 || WK_COMPLEX
-        for (ulong y = 0; y < BLOCK_SIZE; y += 2) {
-            for (ulong x = 0; x < BLOCK_SIZE; x += 2) {
+        for (ulong y = 0; y < BLOCK_ROWS; y += 2) {
+            for (ulong x = 0; x < BLOCK_COLS; x += 2) {
 #if WK_VECTOR_WIDTH == 1
 
 #if WK_COMPLEX
@@ -228,7 +275,7 @@ __kernel void gemm(
                 }
 
                 // Accumulate 2x2 result into the full C tile
-                base_index = y * BLOCK_SIZE + x;
+                base_index = y * BLOCK_COLS + x;
 #if WK_COMPLEX
                 wk prev_value = C_tmp_buffer[base_index];
                 prev_value.real += C11.real; prev_value.imag += C11.imag;
@@ -238,18 +285,18 @@ __kernel void gemm(
                 prev_value.real += C12.real; prev_value.imag += C12.imag;
                 C_tmp_buffer[base_index + 1] = prev_value;
 
-                prev_value = C_tmp_buffer[base_index + BLOCK_SIZE];
+                prev_value = C_tmp_buffer[base_index + BLOCK_COLS];
                 prev_value.real += C21.real; prev_value.imag += C21.imag;
-                C_tmp_buffer[base_index + BLOCK_SIZE] = prev_value;
+                C_tmp_buffer[base_index + BLOCK_COLS] = prev_value;
                 
-                prev_value = C_tmp_buffer[base_index + BLOCK_SIZE + 1];
+                prev_value = C_tmp_buffer[base_index + BLOCK_COLS + 1];
                 prev_value.real += C22.real; prev_value.imag += C22.imag;
-                C_tmp_buffer[base_index + BLOCK_SIZE + 1] = prev_value;
+                C_tmp_buffer[base_index + BLOCK_COLS + 1] = prev_value;
 #else
                 C_tmp_buffer[base_index] += C11;
                 C_tmp_buffer[base_index + 1] += C12;
-                C_tmp_buffer[base_index + BLOCK_SIZE] += C21;
-                C_tmp_buffer[base_index + BLOCK_SIZE + 1] += C22;
+                C_tmp_buffer[base_index + BLOCK_COLS] += C21;
+                C_tmp_buffer[base_index + BLOCK_COLS + 1] += C22;
 #endif
             }
         }
@@ -257,8 +304,8 @@ __kernel void gemm(
         // With 16-wide vectors, a 4x4 micro-kernel does 4*4*4 = 64 MADs per
         // inner iteration, giving better arithmetic intensity per register load.
 #else
-        for (ulong y = 0; y < BLOCK_SIZE; y += 4) {
-            for (ulong x = 0; x < BLOCK_SIZE; x += 4) {
+        for (ulong y = 0; y < BLOCK_ROWS; y += 4) {
+            for (ulong x = 0; x < BLOCK_COLS; x += 4) {
                 wk C11 = (wk)(0);
                 wk C12 = (wk)(0);
                 wk C13 = (wk)(0);
@@ -347,25 +394,25 @@ __kernel void gemm(
                     C44 = A41 * B14 + A42 * B24 + A43 * B34 + A44 * B44 + C44;
                 }
 
-                base_index = y * BLOCK_SIZE + x;
+                base_index = y * BLOCK_COLS + x;
                 C_tmp_buffer[base_index] += C11;
                 C_tmp_buffer[base_index + 1] += C12;
                 C_tmp_buffer[base_index + 2] += C13;
                 C_tmp_buffer[base_index + 3] += C14;
 
-                base_index += BLOCK_SIZE;
+                base_index += BLOCK_COLS;
                 C_tmp_buffer[base_index] += C21;
                 C_tmp_buffer[base_index + 1] += C22;
                 C_tmp_buffer[base_index + 2] += C23;
                 C_tmp_buffer[base_index + 3] += C24;
 
-                base_index += BLOCK_SIZE;
+                base_index += BLOCK_COLS;
                 C_tmp_buffer[base_index] += C31;
                 C_tmp_buffer[base_index + 1] += C32;
                 C_tmp_buffer[base_index + 2] += C33;
                 C_tmp_buffer[base_index + 3] += C34;
 
-                base_index += BLOCK_SIZE;
+                base_index += BLOCK_COLS;
                 C_tmp_buffer[base_index] += C41;
                 C_tmp_buffer[base_index + 1] += C42;
                 C_tmp_buffer[base_index + 2] += C43;
@@ -377,12 +424,12 @@ __kernel void gemm(
 
     ulong C_base = i * C_row_pitch + j;
     __attribute__((opencl_unroll_hint))
-    for (ulong y = 0; y < BLOCK_SIZE; y += 1) {
+    for (ulong y = 0; y < BLOCK_ROWS; y += 1) {
         __attribute__((opencl_unroll_hint))
-        for (ulong x = 0; x < BLOCK_SIZE; x += 1) {
+        for (ulong x = 0; x < BLOCK_COLS; x += 1) {
 #if WK_COMPLEX
 #if HAS_ALPHA
-            wk tmp_val = C_tmp_buffer[y * BLOCK_SIZE + x];
+            wk tmp_val = C_tmp_buffer[y * BLOCK_COLS + x];
             wk scaled;
             COMPLEX_MUL(tmp_val, alpha, scaled);
 #if HAS_BETA
@@ -394,27 +441,27 @@ __kernel void gemm(
             C[C_base + x] = scaled;
 #endif
 #else
-            C[C_base + x] = C_tmp_buffer[y * BLOCK_SIZE + x];
+            C[C_base + x] = C_tmp_buffer[y * BLOCK_COLS + x];
 #endif
 #elif WK_VECTOR_WIDTH == 1
 #if HAS_ALPHA
 #if HAS_BETA
-            C[C_base + x] = alpha * C_tmp_buffer[y * BLOCK_SIZE + x] + beta * C[C_base + x];
+            GEMM_STORE(C_base + x, i + y, j + x, alpha * C_tmp_buffer[y * BLOCK_COLS + x] + beta * C[C_base + x]);
 #else
-            C[C_base + x] = alpha * C_tmp_buffer[y * BLOCK_SIZE + x];
+            GEMM_STORE(C_base + x, i + y, j + x, alpha * C_tmp_buffer[y * BLOCK_COLS + x]);
 #endif
 #else
-            C[C_base + x] = C_tmp_buffer[y * BLOCK_SIZE + x];
+            GEMM_STORE(C_base + x, i + y, j + x, C_tmp_buffer[y * BLOCK_COLS + x]);
 #endif
 #else
 #if HAS_ALPHA
 #if HAS_BETA
-            C[C_base + x] = alpha * sum(C_tmp_buffer[y * BLOCK_SIZE + x]) + beta * C[C_base + x];
+            GEMM_STORE(C_base + x, i + y, j + x, alpha * sum(C_tmp_buffer[y * BLOCK_COLS + x]) + beta * C[C_base + x]);
 #else
-            C[C_base + x] = alpha * sum(C_tmp_buffer[y * BLOCK_SIZE + x]);
+            GEMM_STORE(C_base + x, i + y, j + x, alpha * sum(C_tmp_buffer[y * BLOCK_COLS + x]));
 #endif
 #else
-            C[C_base + x] = sum(C_tmp_buffer[y * BLOCK_SIZE + x]);
+            GEMM_STORE(C_base + x, i + y, j + x, sum(C_tmp_buffer[y * BLOCK_COLS + x]));
 #endif
 #endif
         }
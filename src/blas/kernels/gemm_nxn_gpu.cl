@@ -21,28 +21,39 @@
  * BLOCK_SIZE        - Tile dimension (2, 4, 8, 16, 32, 64)
  * A_TRANS           - 0: A is row-major, 1: A is transposed
  * B_TRANS           - 0: B is column-major access, 1: B is row-major
+ * A_CONJ            - 1: complex A is conjugated while it is loaded
+ * B_CONJ            - 1: complex B is conjugated while it is loaded
  * HAS_ALPHA         - 0: alpha=1 (omitted), 1: alpha scaling is applied
  * HAS_BETA          - 0: no beta term, 1: beta * C_old is added
+ * WK_GEMM_EPILOGUE  - Bias and activation epilogue, see GEMM EPILOGUE in wekua.h
  * WK_COMPLEX        - 0: scalar/vector types, 1: complex arithmetic
  * WK_VECTOR_WIDTH   - SIMD vector width (1, 2, 4, 8, 16)
  * WK_CACHE_LINE_SIZE - Alignment for local tile buffers
  *
  * KERNEL PARAMETERS
  * -----------------
- * A                - Input matrix A (__global, read-only)
- * B                - Input matrix B (__global, read-only)
- * C                - Output matrix C (__global, read-write, scalar type wks)
+ * A_matrices       - Input matrices A (__global, read-only)
+ * B_matrices       - Input matrices B (__global, read-only)
+ * C_matrices       - Output matrices C (__global, read-write, scalar type wks)
  * A_row_pitch      - Elements per row in A
  * B_row_pitch      - Elements per row in B
  * C_row_pitch      - Elements per row in C
+ * A_batch_pitch    - Elements between the matrices of A in the batch (0: broadcast)
+ * B_batch_pitch    - Elements between the matrices of B in the batch (0: broadcast)
+ * C_batch_pitch    - Elements between the matrices of C in the batch
  * cols             - Shared dimension K (padded to multiple of BLOCK_SIZE)
  * alpha            - Scalar multiplier (conditional on HAS_ALPHA)
  * beta             - Scalar multiplier for existing C (conditional on HAS_BETA)
+ * C_rows           - Rows of C, without padding (conditional on WK_GEMM_EPILOGUE)
+ * C_cols           - Columns of C, without padding (conditional on WK_GEMM_EPILOGUE)
+ * bias             - Row vector added to every row of C (conditional on WK_GEMM_BIAS)
+ * derivatives      - Derivatives of the activation, same layout as C (conditional on WK_GEMM_DERIVATIVE)
  *
- * NDRANGE (2D)
+ * NDRANGE (3D)
  * ------------
  * dim 0  - Row tile index / 2  (global_size = M / 2, local_size = BLOCK_SIZE / 2)
  * dim 1  - Col tile index / 2  (global_size = N / 2, local_size = BLOCK_SIZE / 2)
+ * dim 2  - Index of the product in the batch (global_size = batches, local_size = 1)
  * Each work-item maps to a 2x2 output block at (global_id(0)<<1, global_id(1)<<1).
  *
  * ALGORITHM
@@ -80,15 +91,19 @@
 #include "wekua.h"
 
 __kernel void gemm(
-    __global const wk *const restrict A,
-    __global const wk *const restrict B,
+    __global const wk *const restrict A_matrices,
+    __global const wk *const restrict B_matrices,
 
-    __global wks *const restrict C,
+    __global wks *const restrict C_matrices,
 
     const ulong A_row_pitch,
     const ulong B_row_pitch,
     const ulong C_row_pitch,
 
+    const ulong A_batch_pitch,
+    const ulong B_batch_pitch,
+    const ulong C_batch_pitch,
+
     const ulong cols
 
 #if HAS_ALPHA
@@ -97,7 +112,25 @@ __kernel void gemm(
     , const wks beta
 #endif
 #endif
+
+#ifdef WK_GEMM_EPILOGUE
+    , const ulong C_rows
+    , const ulong C_cols
+#if WK_GEMM_BIAS
+    , __global const wks *const restrict bias
+#endif
+#if WK_GEMM_DERIVATIVE
+    , __global wks *const restrict derivatives
+#endif
+#endif
 ) {
+    // Matrices of the product computed by this work-item, operands broadcast across the batch
+    // have a batch pitch of 0
+    const ulong batch = get_global_id(2);
+    __global const wk *const restrict A = A_matrices + batch*A_batch_pitch;
+    __global const wk *const restrict B = B_matrices + batch*B_batch_pitch;
+    __global wks *const restrict C = C_matrices + batch*C_batch_pitch;
+
     // 2x2 register tiling: each WI covers 2 rows and 2 columns
     const ulong i = get_global_id(0) << 1;
     const ulong j = get_global_id(1) << 1;
@@ -149,16 +182,16 @@ __kernel void gemm(
         // A_TRANS=0: row i of A, columns k+lj and k+lj+1 are adjacent.
 #if A_TRANS
         base_index = (k + lj) * A_row_pitch + i;
-        A_tmp_buffer[A_local_tile_index] = A[base_index];
-        A_tmp_buffer[A_local_tile_index + 1] = A[base_index + A_row_pitch];
-        A_tmp_buffer[A_local_tile_index + BLOCK_SIZE] = A[base_index + 1];
-        A_tmp_buffer[A_local_tile_index + BLOCK_SIZE + 1] = A[base_index + A_row_pitch + 1];
+        A_tmp_buffer[A_local_tile_index] = GEMM_LOAD_A(A[base_index]);
+        A_tmp_buffer[A_local_tile_index + 1] = GEMM_LOAD_A(A[base_index + A_row_pitch]);
+        A_tmp_buffer[A_local_tile_index + BLOCK_SIZE] = GEMM_LOAD_A(A[base_index + 1]);
+        A_tmp_buffer[A_local_tile_index + BLOCK_SIZE + 1] = GEMM_LOAD_A(A[base_index + A_row_pitch + 1]);
 #else
         base_index = i * A_row_pitch + k + lj;
-        A_tmp_buffer[A_local_tile_index] = A[base_index];
-        A_tmp_buffer[A_local_tile_index + 1] = A[base_index + 1];
-        A_tmp_buffer[A_local_tile_index + BLOCK_SIZE] = A[base_index + A_row_pitch];
-        A_tmp_buffer[A_local_tile_index + BLOCK_SIZE + 1] = A[base_index + A_row_pitch + 1];
+        A_tmp_buffer[A_local_tile_index] = GEMM_LOAD_A(A[base_index]);
+        A_tmp_buffer[A_local_tile_index + 1] = GEMM_LOAD_A(A[base_index + 1]);
+        A_tmp_buffer[A_local_tile_index + BLOCK_SIZE] = GEMM_LOAD_A(A[base_index + A_row_pitch]);
+        A_tmp_buffer[A_local_tile_index + BLOCK_SIZE + 1] = GEMM_LOAD_A(A[base_index + A_row_pitch + 1]);
 #endif
 
         // B loading: stored transposed in local memory (B_local_tile_index swaps row/col).
@@ -167,16 +200,16 @@ __kernel void gemm(
         //            B columns as contiguous rows.
 #if B_TRANS
         base_index = j * B_row_pitch + k + li;
-        B_tmp_buffer[B_local_tile_index] = B[base_index];
-        B_tmp_buffer[B_local_tile_index + 1] = B[base_index + 1];
-        B_tmp_buffer[B_local_tile_index + BLOCK_SIZE] = B[base_index + B_row_pitch];
-        B_tmp_buffer[B_local_tile_index + BLOCK_SIZE + 1] = B[base_index + B_row_pitch + 1];
+        B_tmp_buffer[B_local_tile_index] = GEMM_LOAD_B(B[base_index]);
+        B_tmp_buffer[B_local_tile_index + 1] = GEMM_LOAD_B(B[base_index + 1]);
+        B_tmp_buffer[B_local_tile_index + BLOCK_SIZE] = GEMM_LOAD_B(B[base_index + B_row_pitch]);
+        B_tmp_buffer[B_local_tile_index + BLOCK_SIZE + 1] = GEMM_LOAD_B(B[base_index + B_row_pitch + 1]);
 #else
         base_index = (k + li) * B_row_pitch + j;
-        B_tmp_buffer[B_local_tile_index] = B[base_index];
-        B_tmp_buffer[B_local_tile_index + 1] = B[base_index + B_row_pitch];
-        B_tmp_buffer[B_local_tile_index + BLOCK_SIZE] = B[base_index + 1];
-        B_tmp_buffer[B_local_tile_index + BLOCK_SIZE + 1] = B[base_index + B_row_pitch + 1];
+        B_tmp_buffer[B_local_tile_index] = GEMM_LOAD_B(B[base_index]);
+        B_tmp_buffer[B_local_tile_index + 1] = GEMM_LOAD_B(B[base_index + B_row_pitch]);
+        B_tmp_buffer[B_local_tile_index + BLOCK_SIZE] = GEMM_LOAD_B(B[base_index + 1]);
+        B_tmp_buffer[B_local_tile_index + BLOCK_SIZE + 1] = GEMM_LOAD_B(B[base_index + B_row_pitch + 1]);
 #endif
         // Ensure all WIs have finished loading before computing
         barrier(CLK_LOCAL_MEM_FENCE);
@@ -280,40 +313,40 @@ __kernel void gemm(
 #elif WK_VECTOR_WIDTH == 1
 #if HAS_ALPHA
 #if HAS_BETA
-    C[C_index] = alpha*C11 + beta*C[C_index];
-    C[C_index + 1] = alpha*C12 + beta*C[C_index + 1];
-    C[C_index2] = alpha*C21 + beta*C[C_index2];
-    C[C_index2 + 1] = alpha*C22 + beta*C[C_index2 + 1];
+    GEMM_STORE(C_index, i, j, alpha*C11 + beta*C[C_index]);
+    GEMM_STORE(C_index + 1, i, j + 1, alpha*C12 + beta*C[C_index + 1]);
+    GEMM_STORE(C_index2, i + 1, j, alpha*C21 + beta*C[C_index2]);
+    GEMM_STORE(C_index2 + 1, i + 1, j + 1, alpha*C22 + beta*C[C_index2 + 1]);
 #else
-    C[C_index] = alpha*C11;
-    C[C_index + 1] = alpha*C12;
-    C[C_index2] = alpha*C21;
-    C[C_index2 + 1] = alpha*C22;
+    GEMM_STORE(C_index, i, j, alpha*C11);
+    GEMM_STORE(C_index + 1, i, j + 1, alpha*C12);
+    GEMM_STORE(C_index2, i + 1, j, alpha*C21);
+    GEMM_STORE(C_index2 + 1, i + 1, j + 1, alpha*C22);
 #endif
 #else
-    C[C_index] = C11;
-    C[C_index + 1] = C12;
-    C[C_index2] = C21;
-    C[C_index2 + 1] = C22;
+    GEMM_STORE(C_index, i, j, C11);
+    GEMM_STORE(C_index + 1, i, j + 1, C12);
+    GEMM_STORE(C_index2, i + 1, j, C21);
+    GEMM_STORE(C_index2 + 1, i + 1, j + 1, C22);
 #endif
 #else
 #if HAS_ALPHA
 #if HAS_BETA
-    C[C_index] = alpha*sum(C11) + beta*C[C_index];
-    C[C_index + 1] = alpha*sum(C12) + beta*C[C_index + 1];
-    C[C_index2] = alpha*sum(C21) + beta*C[C_index2];
-    C[C_index2 + 1] = alpha*sum(C22) + beta*C[C_index2 + 1];
+    GEMM_STORE(C_index, i, j, alpha*sum(C11) + beta*C[C_index]);
+    GEMM_STORE(C_index + 1, i, j + 1, alpha*sum(C12) + beta*C[C_index + 1]);
+    GEMM_STORE(C_index2, i + 1, j, alpha*sum(C21) + beta*C[C_index2]);
+    GEMM_STORE(C_index2 + 1, i + 1, j + 1, alpha*sum(C22) + beta*C[C_index2 + 1]);
 #else
-    C[C_index] = alpha*sum(C11);
-    C[C_index + 1] = alpha*sum(C12);
-    C[C_index2] = alpha*sum(C21);
-    C[C_index2 + 1] = alpha*sum(C22);
+    GEMM_STORE(C_index, i, j, alpha*sum(C11));
+    GEMM_STORE(C_index + 1, i, j + 1, alpha*sum(C12));
+    GEMM_STORE(C_index2, i + 1, j, alpha*sum(C21));
+    GEMM_STORE(C_index2 + 1, i + 1, j + 1, alpha*sum(C22));
 #endif
 #else
-    C[C_index] = sum(C11);
-    C[C_index + 1] = sum(C12);
-    C[C_index2] = sum(C21);
-    C[C_index2 + 1] = sum(C22);
+    GEMM_STORE(C_index, i, j, sum(C11));
+    GEMM_STORE(C_index + 1, i, j + 1, sum(C12));
+    GEMM_STORE(C_index2, i + 1, j, sum(C21));
+    GEMM_STORE(C_index2 + 1, i + 1, j + 1, sum(C22));
 #endif
 #endif
 }
@@ -20,28 +20,37 @@
  * STRIDE            - log2(BLOCK_SIZE), used for bit-shift addressing
  * HAS_ALPHA         - 0: alpha=1 (omitted), 1: alpha scaling is applied
  * HAS_BETA          - 0: no beta term, 1: beta * C_old is added
+ * WK_GEMM_EPILOGUE  - Bias and activation epilogue, see GEMM EPILOGUE in wekua.h
  * WK_COMPLEX        - 0: scalar/vector types, 1: complex arithmetic
  * WK_VECTOR_WIDTH   - SIMD vector width (1, 2, 4, 8, 16)
  * WK_CACHE_LINE_SIZE - Alignment for private tile buffers
  *
  * KERNEL PARAMETERS
  * -----------------
- * A_packed         - Packed matrix A (__global, read-only)
- * B_packed         - Packed matrix B (__global, read-only)
- * C                - Output matrix C in row-major layout (__global, read-write)
+ * A_packed_matrices - Packed matrices A (__global, read-only)
+ * B_packed_matrices - Packed matrices B (__global, read-only)
+ * C_matrices       - Output matrices C in row-major layout (__global, read-write)
  * A_slice_pitch    - Stride between tile-groups of A (one per output tile-row)
  * A_row_pitch      - Stride between consecutive k-tiles within an A tile-group
  * B_slice_pitch    - Stride between tile-groups of B (one per output tile-col)
  * B_row_pitch      - Stride between consecutive k-tiles within a B tile-group
  * C_row_pitch      - Elements per row in output C
+ * A_batch_pitch    - Elements between the matrices of A in the batch (0: broadcast)
+ * B_batch_pitch    - Elements between the matrices of B in the batch (0: broadcast)
+ * C_batch_pitch    - Elements between the matrices of C in the batch
  * cols             - Number of k-tiles to iterate over
  * alpha            - Scalar multiplier (conditional on HAS_ALPHA)
  * beta             - Scalar multiplier for existing C (conditional on HAS_BETA)
+ * C_rows           - Rows of C, without padding (conditional on WK_GEMM_EPILOGUE)
+ * C_cols           - Columns of C, without padding (conditional on WK_GEMM_EPILOGUE)
+ * bias             - Row vector added to every row of C (conditional on WK_GEMM_BIAS)
+ * derivatives      - Derivatives of the activation, same layout as C (conditional on WK_GEMM_DERIVATIVE)
  *
- * NDRANGE (2D)
+ * NDRANGE (3D)
  * ------------
  * dim 0 (i)  - Tile-row index  (actual row = i << STRIDE)
  * dim 1 (j)  - Tile-col index  (actual col = j << STRIDE)
+ * dim 2 (b)  - Index of the product in the batch
  *
  * ALGORITHM
  * ---------
@@ -66,10 +75,10 @@
 #include "wekua.h"
 
 __kernel void gemm(
-    __global const wk *const restrict A_packed,
-    __global const wk *const restrict B_packed,
+    __global const wk *const restrict A_packed_matrices,
+    __global const wk *const restrict B_packed_matrices,
 
-    __global wks *const restrict C,
+    __global wks *const restrict C_matrices,
 
     const ulong A_slice_pitch,
     const ulong A_row_pitch,
@@ -79,6 +88,10 @@ __kernel void gemm(
 
     const ulong C_row_pitch,
 
+    const ulong A_batch_pitch,
+    const ulong B_batch_pitch,
+    const ulong C_batch_pitch,
+
     const ulong cols
 
 #if HAS_ALPHA
@@ -87,7 +100,25 @@ __kernel void gemm(
     , const wks beta
 #endif
 #endif
+
+#ifdef WK_GEMM_EPILOGUE
+    , const ulong C_rows
+    , const ulong C_cols
+#if WK_GEMM_BIAS
+    , __global const wks *const restrict bias
+#endif
+#if WK_GEMM_DERIVATIVE
+    , __global wks *const restrict derivatives
+#endif
+#endif
 ) {
+    // Matrices of the product computed by this work-item, operands broadcast across the batch
+    // have a batch pitch of 0
+    const ulong batch = get_global_id(2);
+    __global const wk *const restrict A_packed = A_packed_matrices + batch*A_batch_pitch;
+    __global const wk *const restrict B_packed = B_packed_matrices + batch*B_batch_pitch;
+    __global wks *const restrict C = C_matrices + batch*C_batch_pitch;
+
     const ulong i = get_global_id(0);
     const ulong j = get_global_id(1);
 
@@ -369,22 +400,22 @@ __kernel void gemm(
 #elif WK_VECTOR_WIDTH == 1
 #if HAS_ALPHA
 #if HAS_BETA
-            C[C_base + x] = alpha * C_tmp_buffer[y * BLOCK_SIZE + x] + beta * C[C_base + x];
+            GEMM_STORE(C_base + x, C_row + y, C_col + x, alpha * C_tmp_buffer[y * BLOCK_SIZE + x] + beta * C[C_base + x]);
 #else
-            C[C_base + x] = alpha * C_tmp_buffer[y * BLOCK_SIZE + x];
+            GEMM_STORE(C_base + x, C_row + y, C_col + x, alpha * C_tmp_buffer[y * BLOCK_SIZE + x]);
 #endif
 #else
-            C[C_base + x] = C_tmp_buffer[y * BLOCK_SIZE + x];
+            GEMM_STORE(C_base + x, C_row + y, C_col + x, C_tmp_buffer[y * BLOCK_SIZE + x]);
 #endif
 #else
 #if HAS_ALPHA
 #if HAS_BETA
-            C[C_base + x] = alpha * sum(C_tmp_buffer[y * BLOCK_SIZE + x]) + beta * C[C_base + x];
+            GEMM_STORE(C_base + x, C_row + y, C_col + x, alpha * sum(C_tmp_buffer[y * BLOCK_SIZE + x]) + beta * C[C_base + x]);
 #else
-            C[C_base + x] = alpha * sum(C_tmp_buffer[y * BLOCK_SIZE + x]);
+            GEMM_STORE(C_base + x, C_row + y, C_col + x, alpha * sum(C_tmp_buffer[y * BLOCK_SIZE + x]));
 #endif
 #else
-            C[C_base + x] = sum(C_tmp_buffer[y * BLOCK_SIZE + x]);
+            GEMM_STORE(C_base + x, C_row + y, C_col + x, sum(C_tmp_buffer[y * BLOCK_SIZE + x]));
 #endif
 #endif
         }
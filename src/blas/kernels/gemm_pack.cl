@@ -6,27 +6,35 @@
  * Packs a source matrix into a tiled format for efficient GEMM computation.
  * Each tile is a contiguous BLOCK_SIZE x BLOCK_SIZE block stored sequentially
  * in memory. When TRANSPOSE is set, the source is read transposed during
- * packing, so the packed result is already in the correct orientation.
+ * packing, so the packed result is already in the correct orientation. When
+ * CONJUGATE is set, complex elements are conjugated as they are copied. With
+ * WK_STORAGE_TYPE the source is an f16 or bf16 tensor and the elements are
+ * widened to float as they are copied, for mixed precision products.
  *
  * COMPILE-TIME PARAMETERS
  * -----------------------
  * BLOCK_SIZE       - Tile dimension (e.g., 2, 4, 8, 16, 32, 64)
  * WK_VECTOR_WIDTH  - Vector width for element addressing
  * TRANSPOSE        - 0: normal copy, 1: transpose during packing
+ * CONJUGATE        - 1: conjugate complex elements during packing
+ * WK_STORAGE_TYPE  - Optional storage type of the source (0: f16, 1: bf16), see wekua.h
  *
  * KERNEL PARAMETERS
  * -----------------
- * src              - Source matrix in row-major layout (__global, read-only)
+ * src              - Source matrices in row-major layout (__global, read-only)
  * dst              - Destination buffer in tile layout (__global, write-only)
+ * src_slice_pitch  - Elements between the source matrices of the batch (0: broadcast)
  * src_row_pitch    - Number of elements per row in the source matrix
  * dst_slice_pitch  - Stride between tile groups along the outer axis
  * dst_row_pitch    - Stride between consecutive k-tiles within a tile group
  * src_rows         - Number of rows in the source matrix (for bounds checking)
  * src_cols         - Number of columns in the source matrix (for bounds checking)
+ * tiles_per_matrix - Tile groups of every matrix of the batch along the outer axis
  *
  * NDRANGE (3D)
  * ------------
- * dim 0 (i)  - Tile index along the row/outer axis
+ * dim 0 (i)  - Tile index along the row/outer axis, tiles of the matrices of the batch
+ *              follow each other
  * dim 1 (j)  - Tile index along the k/inner axis
  * dim 2 (k)  - Element index within the tile (flattened BLOCK_SIZE x BLOCK_SIZE)
  *
@@ -35,12 +43,14 @@
  * 1. Compute destination index: i * dst_slice_pitch + j * dst_row_pitch + k
  * 2. Decompose k into (tile_row, tile_col) within the BLOCK_SIZE tile
  * 3. If tile_row >= BLOCK_SIZE, early-exit (padding work-items)
- * 4. Map (tile_row, tile_col) to source coordinates:
- *    - TRANSPOSE=0: src_row = i*BLOCK_SIZE + tile_row, src_col = j*BLOCK_SIZE*VW + tile_col
- *    - TRANSPOSE=1: src_row = j*BLOCK_SIZE*VW + tile_col, src_col = i*BLOCK_SIZE + tile_row
+ * 4. Split i into the matrix of the batch and the tile t inside of it, then map
+ *    (tile_row, tile_col) to source coordinates:
+ *    - TRANSPOSE=0: src_row = t*BLOCK_SIZE + tile_row, src_col = j*BLOCK_SIZE*VW + tile_col
+ *    - TRANSPOSE=1: src_row = j*BLOCK_SIZE*VW + tile_col, src_col = t*BLOCK_SIZE + tile_row
  * 5. Bounds-check against src_rows/src_cols (needed when dimensions are not
  *    a multiple of BLOCK_SIZE, so edge tiles may reference out-of-bounds elements)
- * 6. Copy: dst[dst_index] = src[src_row * src_row_pitch + src_col]
+ * 6. Copy: dst[dst_index] = src[batch * src_slice_pitch + src_row * src_row_pitch + src_col],
+ *    conjugated with CONJUGATE or widened with WK_STORAGE_TYPE
  *
  * =============================================================================
  */
@@ -48,7 +58,11 @@
 #include "wekua.h"
 
 __kernel void pack(
+#ifdef WK_STORAGE_TYPE
+    __global const st *const restrict src,
+#else
     __global const wks *const restrict src,
+#endif
     __global wks *const restrict dst,
 
     const ulong src_row_pitch,
@@ -56,7 +70,10 @@ __kernel void pack(
     const ulong dst_row_pitch,
 
     const ulong src_rows,
-    const ulong src_cols
+    const ulong src_cols,
+
+    const ulong src_slice_pitch,
+    const ulong tiles_per_matrix
 ) {
     const ulong i = get_global_id(0);
     const ulong j = get_global_id(1);
@@ -74,23 +91,32 @@ __kernel void pack(
         return;
     }
 
+    const ulong batch = i / tiles_per_matrix;
+    const ulong tile = i - batch * tiles_per_matrix;
+
     // Map tile-local coordinates to source matrix coordinates.
     // TRANSPOSE=0: tiles partition the matrix naturally (rows from i, cols from j).
     // TRANSPOSE=1: rows and columns are swapped, so the packed result stores
     //              the transpose without needing a separate transpose pass.
 #if TRANSPOSE == 0
-    const ulong src_row = i * BLOCK_SIZE + tile_row;
+    const ulong src_row = tile * BLOCK_SIZE + tile_row;
     const ulong src_col = j * (BLOCK_SIZE * WK_VECTOR_WIDTH) + tile_col;
 #else
     const ulong src_row = j * (BLOCK_SIZE * WK_VECTOR_WIDTH) + tile_col;
-    const ulong src_col = i * BLOCK_SIZE + tile_row;
+    const ulong src_col = tile * BLOCK_SIZE + tile_row;
 #endif
     // Edge tiles may extend beyond the actual matrix dimensions
     if (src_col >= src_cols || src_row >= src_rows) {
         return;
     }
 
-    const ulong src_base = src_row * src_row_pitch + src_col;
+    const ulong src_base = batch * src_slice_pitch + src_row * src_row_pitch + src_col;
 
+#if defined(WK_STORAGE_TYPE)
+    dst[dst_base] = load_storage(src, src_base);
+#elif WK_COMPLEX && CONJUGATE
+    dst[dst_base] = COMPLEX_CONJ(src[src_base]);
+#else
     dst[dst_base] = src[src_base];
+#endif
 }
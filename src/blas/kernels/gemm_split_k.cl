@@ -0,0 +1,104 @@
+/**
+ * =============================================================================
+ * GEMM SPLIT-K REDUCTION — Second pass of products split along K
+ * =============================================================================
+ *
+ * When C has fewer tiles than the device has compute units, but K is long,
+ * the product is computed as SPLITS products over consecutive chunks of K by
+ * the tile kernels, each one writing its own matrix of partial sums. This
+ * kernel adds them up and finishes C with alpha, beta and the epilogue, so
+ * the result doesn't depend on the order the chunks were computed in.
+ *
+ * The partial matrices have the layout of C, padding included, and every
+ * element of the padding is reduced too: it keeps the value the tile kernels
+ * would have written there.
+ *
+ * COMPILE-TIME PARAMETERS
+ * -----------------------
+ * HAS_ALPHA        - 0: alpha=1 (omitted), 1: alpha scaling is applied
+ * HAS_BETA         - 0: no beta term, 1: beta * C_old is added (requires HAS_ALPHA)
+ * WK_GEMM_EPILOGUE - Bias and activation epilogue, see GEMM EPILOGUE in wekua.h
+ *
+ * KERNEL PARAMETERS
+ * -----------------
+ * partials         - Partial products, one matrix per split (__global, read-only)
+ * C                - Output matrix C (__global, read-write)
+ * C_row_pitch      - Elements per row in C and in the partial products
+ * partials_pitch   - Elements between the partial products
+ * splits           - Number of partial products
+ * padded_rows      - Rows of C, padding included
+ * alpha            - Scalar multiplier (conditional on HAS_ALPHA)
+ * beta             - Scalar multiplier for existing C (conditional on HAS_BETA)
+ * C_rows           - Rows of C (conditional on WK_GEMM_EPILOGUE)
+ * C_cols           - Columns of C (conditional on WK_GEMM_EPILOGUE)
+ * bias             - Row vector added to every row of C (conditional on WK_GEMM_BIAS)
+ * derivatives      - Derivatives of the activation, same layout as C (conditional on WK_GEMM_DERIVATIVE)
+ *
+ * NDRANGE (2D)
+ * ------------
+ * dim 0 (i)  - Row index of C, padding included
+ * dim 1 (j)  - Column index of C, padding included
+ *
+ * The NDRange is padded to a multiple of the local size, the work-items out of
+ * padded_rows x C_row_pitch return early.
+ *
+ * =============================================================================
+ */
+
+#include "wekua.h"
+
+__kernel void gemm_split_k_reduce(
+    __global const wks *const restrict partials,
+    __global wks *const restrict C,
+
+    const ulong C_row_pitch,
+    const ulong partials_pitch,
+    const ulong splits,
+    const ulong padded_rows
+
+#if HAS_ALPHA
+    , const wks alpha
+#if HAS_BETA
+    , const wks beta
+#endif
+#endif
+
+#ifdef WK_GEMM_EPILOGUE
+    , const ulong C_rows
+    , const ulong C_cols
+#if WK_GEMM_BIAS
+    , __global const wks *const restrict bias
+#endif
+#if WK_GEMM_DERIVATIVE
+    , __global wks *const restrict derivatives
+#endif
+#endif
+) {
+    const ulong i = get_global_id(0);
+    const ulong j = get_global_id(1);
+
+    if (i >= padded_rows || j >= C_row_pitch) return;
+
+    const ulong C_index = i*C_row_pitch + j;
+
+    wks acc = 0;
+    for (ulong s = 0; s < splits; s++) {
+        acc += partials[s*partials_pitch + C_index];
+    }
+
+#ifdef WK_GEMM_EPILOGUE
+    // A single product, the epilogue offsets the derivatives by the index in the batch
+    const ulong batch = 0;
+    const ulong C_batch_pitch = 0;
+#endif
+
+#if HAS_ALPHA
+#if HAS_BETA
+    GEMM_STORE(C_index, i, j, alpha*acc + beta*C[C_index]);
+#else
+    GEMM_STORE(C_index, i, j, alpha*acc);
+#endif
+#else
+    GEMM_STORE(C_index, i, j, acc);
+#endif
+}
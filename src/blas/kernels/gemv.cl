@@ -0,0 +1,206 @@
+/**
+ * =============================================================================
+ * GEMV — Products where C has very few rows or columns
+ * =============================================================================
+ *
+ * Computes C = alpha * op(A) * op(B) + beta * C when C is (almost) a vector,
+ * as in single sample inference. The tile kernels would pad such products to
+ * their block size and spend nearly all their work on the padding, here every
+ * element of C is a dot product of its own over K and nothing is padded.
+ *
+ * With REDUCE_SIZE > 1 a work-group of REDUCE_SIZE work-items computes each
+ * element: they split K, stepping over it together so their reads of the
+ * operand that is contiguous along K are coalesced, and the partial sums are
+ * reduced in local memory. With REDUCE_SIZE = 1 every work-item computes one
+ * element on its own, which suits CPUs and operands contiguous along the
+ * output instead.
+ *
+ * COMPILE-TIME PARAMETERS
+ * -----------------------
+ * REDUCE_SIZE      - Work-items reducing each element (power of two, 1: no reduction)
+ * A_TRANS          - 0: A is row-major, 1: A is transposed
+ * B_TRANS          - 0: B is row-major, 1: B is transposed
+ * A_CONJ           - 1: complex A is conjugated while it is loaded
+ * B_CONJ           - 1: complex B is conjugated while it is loaded
+ * HAS_ALPHA        - 0: alpha=1 (omitted), 1: alpha scaling is applied
+ * HAS_BETA         - 0: no beta term, 1: beta * C_old is added (requires HAS_ALPHA)
+ * WK_GEMM_EPILOGUE - Bias and activation epilogue, see GEMM EPILOGUE in wekua.h
+ * WK_COMPLEX       - 0: scalar types, 1: complex arithmetic
+ *
+ * KERNEL PARAMETERS
+ * -----------------
+ * A_matrices       - Input matrices A (__global, read-only)
+ * B_matrices       - Input matrices B (__global, read-only)
+ * C_matrices       - Output matrices C (__global, read-write)
+ * A_row_pitch      - Elements per row in A
+ * B_row_pitch      - Elements per row in B
+ * C_row_pitch      - Elements per row in C
+ * A_batch_pitch    - Elements between the matrices of A in the batch (0: broadcast)
+ * B_batch_pitch    - Elements between the matrices of B in the batch (0: broadcast)
+ * C_batch_pitch    - Elements between the matrices of C in the batch
+ * cols             - Shared dimension K, without padding
+ * rows_of_C        - Rows of C, without padding
+ * cols_of_C        - Columns of C, without padding
+ * batches          - Number of products in the batch
+ * alpha            - Scalar multiplier (conditional on HAS_ALPHA)
+ * beta             - Scalar multiplier for existing C (conditional on HAS_BETA)
+ * C_rows           - Rows of C (conditional on WK_GEMM_EPILOGUE)
+ * C_cols           - Columns of C (conditional on WK_GEMM_EPILOGUE)
+ * bias             - Row vector added to every row of C (conditional on WK_GEMM_BIAS)
+ * derivatives      - Derivatives of the activation, same layout as C (conditional on WK_GEMM_DERIVATIVE)
+ *
+ * NDRANGE (3D)
+ * ------------
+ * dim 0 (i)  - Output row index, times REDUCE_SIZE (local size REDUCE_SIZE)
+ * dim 1 (j)  - Output column index
+ * dim 2 (b)  - Index of the product in the batch
+ *
+ * Without the reduction the NDRange is padded to a multiple of the local size,
+ * the work-items out of rows_of_C x cols_of_C x batches return early. With it
+ * every work-group computes a whole element and is never padded.
+ *
+ * =============================================================================
+ */
+
+#include "wekua.h"
+
+__kernel void gemv(
+    __global const wks *const restrict A_matrices,
+    __global const wks *const restrict B_matrices,
+
+    __global wks *const restrict C_matrices,
+
+    const ulong A_row_pitch,
+    const ulong B_row_pitch,
+    const ulong C_row_pitch,
+
+    const ulong A_batch_pitch,
+    const ulong B_batch_pitch,
+    const ulong C_batch_pitch,
+
+    const ulong cols,
+
+    const ulong rows_of_C,
+    const ulong cols_of_C,
+    const ulong batches
+
+#if HAS_ALPHA
+    , const wks alpha
+#if HAS_BETA
+    , const wks beta
+#endif
+#endif
+
+#ifdef WK_GEMM_EPILOGUE
+    , const ulong C_rows
+    , const ulong C_cols
+#if WK_GEMM_BIAS
+    , __global const wks *const restrict bias
+#endif
+#if WK_GEMM_DERIVATIVE
+    , __global wks *const restrict derivatives
+#endif
+#endif
+) {
+#if REDUCE_SIZE > 1
+    __local wks partial_sums[REDUCE_SIZE];
+
+    const ulong lk = get_local_id(0);
+    const ulong i = get_group_id(0);
+#else
+    const ulong lk = 0;
+    const ulong i = get_global_id(0);
+#endif
+    const ulong j = get_global_id(1);
+    const ulong batch = get_global_id(2);
+
+    // The same for the whole work-group, so no barrier of the reduction is left half-way
+    if (i >= rows_of_C || j >= cols_of_C || batch >= batches) return;
+
+    __global const wks *const restrict A = A_matrices + batch*A_batch_pitch;
+    __global const wks *const restrict B = B_matrices + batch*B_batch_pitch;
+    __global wks *const restrict C = C_matrices + batch*C_batch_pitch;
+
+    // Row i of op(A) and column j of op(B), each one either contiguous or strided
+#if A_TRANS
+    __global const wks *const restrict A_row = A + i;
+    const ulong A_step = A_row_pitch;
+#else
+    __global const wks *const restrict A_row = A + i*A_row_pitch;
+    const ulong A_step = 1;
+#endif
+
+#if B_TRANS
+    __global const wks *const restrict B_col = B + j*B_row_pitch;
+    const ulong B_step = 1;
+#else
+    __global const wks *const restrict B_col = B + j;
+    const ulong B_step = B_row_pitch;
+#endif
+
+#if WK_COMPLEX
+    COMPLEX_MUL_K(T)
+
+    wks acc = {0, 0};
+    for (ulong k = lk; k < cols; k += REDUCE_SIZE) {
+        const wks a = GEMM_LOAD_A(A_row[k*A_step]);
+        const wks b = GEMM_LOAD_B(B_col[k*B_step]);
+
+        wks prod;
+        COMPLEX_MUL(a, b, prod);
+        acc.real += prod.real;
+        acc.imag += prod.imag;
+    }
+#else
+    wks acc = 0;
+    for (ulong k = lk; k < cols; k += REDUCE_SIZE) {
+        acc += A_row[k*A_step] * B_col[k*B_step];
+    }
+#endif
+
+#if REDUCE_SIZE > 1
+    // Tree reduction of the partial sums of the work-group
+    partial_sums[lk] = acc;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (ulong s = REDUCE_SIZE/2; s > 0; s >>= 1) {
+        if (lk < s) {
+#if WK_COMPLEX
+            partial_sums[lk].real += partial_sums[lk + s].real;
+            partial_sums[lk].imag += partial_sums[lk + s].imag;
+#else
+            partial_sums[lk] += partial_sums[lk + s];
+#endif
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if (lk != 0) return;
+    acc = partial_sums[0];
+#endif
+
+    const ulong C_index = i*C_row_pitch + j;
+
+#if HAS_ALPHA
+#if WK_COMPLEX
+    wks result;
+    COMPLEX_MUL(acc, alpha, result);
+#if HAS_BETA
+    const wks old_val = C[C_index];
+    wks beta_scaled;
+    COMPLEX_MUL(old_val, beta, beta_scaled);
+    result.real += beta_scaled.real;
+    result.imag += beta_scaled.imag;
+#endif
+    C[C_index] = result;
+#else
+#if HAS_BETA
+    GEMM_STORE(C_index, i, j, alpha*acc + beta*C[C_index]);
+#else
+    GEMM_STORE(C_index, i, j, alpha*acc);
+#endif
+#endif
+#else
+    GEMM_STORE(C_index, i, j, acc);
+#endif
+}
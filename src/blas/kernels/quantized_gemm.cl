@@ -0,0 +1,204 @@
+/**
+ * =============================================================================
+ * QUANTIZED GEMM — Products of i8/u8 matrices with int accumulation
+ * =============================================================================
+ *
+ * Every element q of A and B stands for scale * (q - zero_point). The products
+ * are accumulated in int and the zero points are applied once per element of C
+ * with
+ *
+ *   sum_k (a - za)(b - zb) = sum_k a*b - zb*sum_k a - za*sum_k b + K*za*zb
+ *
+ * so the inner loop only multiplies the raw integers. The result is then either
+ * dequantized to float or requantized to the type of A and B.
+ *
+ * When A and B are both contiguous along K (A not transposed and B transposed,
+ * the layout of the weights of a linear layer), K is read 4 elements at a time
+ * and, on devices with the OpenCL 3.0 integer dot product feature, every group
+ * of 4 is reduced with a single dot instruction.
+ *
+ * COMPILE-TIME PARAMETERS
+ * -----------------------
+ * A_TRANS          - 0: A is row-major, 1: A is transposed
+ * B_TRANS          - 0: B is row-major, 1: B is transposed
+ * ZERO_POINTS      - 1: zero points are applied, 0: both of them are 0
+ * PER_CHANNEL      - 1: every column of C has a scale of its own
+ * HAS_BIAS         - 1: a float row vector is added to every row of C before requantizing
+ * REQUANTIZE       - 0: C is float, 1: C has the type of A and B
+ *
+ * KERNEL PARAMETERS
+ * -----------------
+ * A_matrices       - Input matrices A (__global, read-only)
+ * B_matrices       - Input matrices B (__global, read-only)
+ * C_matrices       - Output matrices C (__global, write-only)
+ * A_row_pitch      - Elements per row in A
+ * B_row_pitch      - Elements per row in B
+ * C_row_pitch      - Elements per row in C
+ * A_batch_pitch    - Elements between the matrices of A in the batch (0: broadcast)
+ * B_batch_pitch    - Elements between the matrices of B in the batch (0: broadcast)
+ * C_batch_pitch    - Elements between the matrices of C in the batch
+ * cols             - Shared dimension K
+ * rows_of_C        - Rows of C, without padding
+ * cols_of_C        - Columns of C, without padding
+ * batches          - Number of products in the batch
+ * a_zero_point     - Zero point of A (conditional on ZERO_POINTS)
+ * b_zero_point     - Zero point of B (conditional on ZERO_POINTS)
+ * scale            - Scale of the accumulators, the product of the scales of A and B
+ * channel_scales   - Scales of the columns of C, times scale (conditional on PER_CHANNEL)
+ * bias             - Row vector added to every row of C (conditional on HAS_BIAS)
+ * inv_c_scale      - Inverse of the scale of C (conditional on REQUANTIZE)
+ * c_zero_point     - Zero point of C (conditional on REQUANTIZE)
+ *
+ * NDRANGE (3D)
+ * ------------
+ * dim 0 (i)  - Output row index
+ * dim 1 (j)  - Output column index
+ * dim 2 (b)  - Index of the product in the batch
+ *
+ * The NDRange is padded to a multiple of the local size, the work-items out of
+ * rows_of_C x cols_of_C x batches return early.
+ *
+ * =============================================================================
+ */
+
+#include "wekua.h"
+
+#if WK_DTYPE_ID == 0
+typedef char4 qgemm_vec;
+#else
+typedef uchar4 qgemm_vec;
+#endif
+
+#if defined(__opencl_c_integer_dot_product_input_4x8bit)
+#define QGEMM_DOT4(a, b) ((int)dot(a, b))
+#else
+#define QGEMM_DOT4(a, b) qgemm_dot4(convert_int4(a), convert_int4(b))
+
+inline int qgemm_dot4(const int4 a, const int4 b) {
+    const int4 prod = a * b;
+    return prod.x + prod.y + prod.z + prod.w;
+}
+#endif
+
+#if REQUANTIZE
+typedef wks qgemm_out;
+#else
+typedef float qgemm_out;
+#endif
+
+__kernel void quantized_gemm(
+    __global const wks *const restrict A_matrices,
+    __global const wks *const restrict B_matrices,
+
+    __global qgemm_out *const restrict C_matrices,
+
+    const ulong A_row_pitch,
+    const ulong B_row_pitch,
+    const ulong C_row_pitch,
+
+    const ulong A_batch_pitch,
+    const ulong B_batch_pitch,
+    const ulong C_batch_pitch,
+
+    const ulong cols,
+
+    const ulong rows_of_C,
+    const ulong cols_of_C,
+    const ulong batches
+
+#if ZERO_POINTS
+    , const int a_zero_point
+    , const int b_zero_point
+#endif
+
+    , const float scale
+
+#if PER_CHANNEL
+    , __global const float *const restrict channel_scales
+#endif
+#if HAS_BIAS
+    , __global const float *const restrict bias
+#endif
+#if REQUANTIZE
+    , const float inv_c_scale
+    , const int c_zero_point
+#endif
+) {
+    const ulong i = get_global_id(0);
+    const ulong j = get_global_id(1);
+    const ulong batch = get_global_id(2);
+
+    if (i >= rows_of_C || j >= cols_of_C || batch >= batches) return;
+
+    __global const wks *const restrict A = A_matrices + batch*A_batch_pitch;
+    __global const wks *const restrict B = B_matrices + batch*B_batch_pitch;
+    __global qgemm_out *const restrict C = C_matrices + batch*C_batch_pitch;
+
+#if A_TRANS
+    __global const wks *const restrict A_row = A + i;
+    const ulong A_step = A_row_pitch;
+#else
+    __global const wks *const restrict A_row = A + i*A_row_pitch;
+    const ulong A_step = 1;
+#endif
+
+#if B_TRANS
+    __global const wks *const restrict B_col = B + j*B_row_pitch;
+    const ulong B_step = 1;
+#else
+    __global const wks *const restrict B_col = B + j;
+    const ulong B_step = B_row_pitch;
+#endif
+
+    int acc = 0;
+#if ZERO_POINTS
+    int sum_a = 0;
+    int sum_b = 0;
+#endif
+
+    ulong k = 0;
+#if !A_TRANS && B_TRANS
+    // Both operands are contiguous along K
+    const qgemm_vec ones = (qgemm_vec)(1);
+    for (; k + 4 <= cols; k += 4) {
+        const qgemm_vec a = vload4(0, A_row + k);
+        const qgemm_vec b = vload4(0, B_col + k);
+        acc += QGEMM_DOT4(a, b);
+#if ZERO_POINTS
+        sum_a += QGEMM_DOT4(a, ones);
+        sum_b += QGEMM_DOT4(b, ones);
+#endif
+    }
+#endif
+
+    for (; k < cols; k++) {
+        const int a = (int)A_row[k*A_step];
+        const int b = (int)B_col[k*B_step];
+        acc += a * b;
+#if ZERO_POINTS
+        sum_a += a;
+        sum_b += b;
+#endif
+    }
+
+#if ZERO_POINTS
+    acc += (int)cols * a_zero_point * b_zero_point - b_zero_point * sum_a - a_zero_point * sum_b;
+#endif
+
+#if PER_CHANNEL
+    float result = (scale * channel_scales[j]) * (float)acc;
+#else
+    float result = scale * (float)acc;
+#endif
+
+#if HAS_BIAS
+    result += bias[j];
+#endif
+
+    const ulong C_index = i*C_row_pitch + j;
+#if REQUANTIZE
+    C[C_index] = convert_T((int)rint(result * inv_c_scale) + c_zero_point);
+#else
+    C[C_index] = result;
+#endif
+}
@@ -0,0 +1,61 @@
+/**
+ * =============================================================================
+ * STRASSEN COMBINE — Sums of blocks of matrices for Strassen-Winograd GEMM
+ * =============================================================================
+ *
+ * Computes Z = X + y_scale * Y element by element, where X, Y and Z are
+ * blocks inside larger matrices: each one starts at an offset of its buffer
+ * and its rows are row_pitch elements apart. The operands of the seven
+ * products of every level of the recursion and the blocks of C are combined
+ * with it, in place when Z is X or Y.
+ *
+ * KERNEL PARAMETERS
+ * -----------------
+ * X                - First operand (__global, read-only)
+ * Y                - Second operand (__global, read-only)
+ * Z                - Result (__global, write-only)
+ * X_offset         - Element of X where the block starts
+ * Y_offset         - Element of Y where the block starts
+ * Z_offset         - Element of Z where the block starts
+ * X_row_pitch      - Elements per row in X
+ * Y_row_pitch      - Elements per row in Y
+ * Z_row_pitch      - Elements per row in Z
+ * y_scale          - Scalar multiplier of Y (1, -1 or beta)
+ * block_size       - Rows and columns of the blocks
+ *
+ * NDRANGE (2D)
+ * ------------
+ * dim 0 (i)  - Row index inside the block
+ * dim 1 (j)  - Column index inside the block
+ *
+ * The NDRange is padded to a multiple of the local size, the work-items out of
+ * the block return early.
+ *
+ * =============================================================================
+ */
+
+#include "wekua.h"
+
+__kernel void strassen_combine(
+    __global const wks *const X,
+    __global const wks *const Y,
+    __global wks *const Z,
+
+    const ulong X_offset,
+    const ulong Y_offset,
+    const ulong Z_offset,
+
+    const ulong X_row_pitch,
+    const ulong Y_row_pitch,
+    const ulong Z_row_pitch,
+
+    const wks y_scale,
+    const ulong block_size
+) {
+    const ulong i = get_global_id(0);
+    const ulong j = get_global_id(1);
+
+    if (i >= block_size || j >= block_size) return;
+
+    Z[Z_offset + i*Z_row_pitch + j] = X[X_offset + i*X_row_pitch + j] + y_scale * Y[Y_offset + i*Y_row_pitch + j];
+}
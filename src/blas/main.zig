@@ -1,13 +1,30 @@
 const axpy_module = @import("axpy.zig");
 const gemm_module = @import("gemm.zig");
+const gemv_module = @import("gemv.zig");
+const split_k_module = @import("split_k.zig");
+pub const planar = @import("planar.zig");
+pub const mixed = @import("mixed.zig");
+pub const quantized = @import("quantized.zig");
+pub const strassen = @import("strassen.zig");
 
 pub const axpy = axpy_module.axpy;
 pub const gemm = gemm_module.gemm;
+pub const gemmWithEpilogue = gemm_module.gemmWithEpilogue;
+pub const GemmEpilogue = gemm_module.Epilogue;
+pub const GemmEpilogueActivation = gemm_module.EpilogueActivation;
+pub const gemmTune = gemm_module.tune;
 pub const GemmPackedTensors = gemm_module.PackedTensors;
 pub const GemmOperation = gemm_module.Operation;
+pub const gemv = gemv_module.gemv;
 
 test {
     _ = axpy_module;
     _ = gemm_module;
+    _ = gemv_module;
+    _ = split_k_module;
+    _ = planar;
+    _ = mixed;
+    _ = quantized;
+    _ = strassen;
     _ = @import("test_helpers.zig");
 }
@@ -0,0 +1,183 @@
+const std = @import("std");
+const cl = @import("opencl");
+
+const core = @import("core");
+const Pipeline = core.Pipeline;
+
+const tensor_module = @import("tensor");
+const Tensor = tensor_module.Tensor;
+const TensorErrors = tensor_module.Errors;
+
+const convertions = tensor_module.convertions;
+
+const gemm_module = @import("gemm.zig");
+const Operation = gemm_module.Operation;
+const PackedTensors = gemm_module.PackedTensors;
+
+fn checkStorageType(comptime S: type) void {
+    if (comptime !core.types.isStorageType(S)) {
+        @compileError("Mixed precision products take f16 or bf16 operands");
+    }
+}
+
+/// `c = alpha * op_a(a) * op_b(b) + beta * c` with f16 or bf16 operands and an f32 result. The
+/// operands are widened to f32 while they are packed and the products are accumulated in f32 by
+/// the packed f32 kernels, so only half of the bytes of the operands are read from the tensors.
+/// Packing can't be skipped here: it is where the conversion happens.
+pub fn gemm(
+    comptime S: type,
+    pipeline: *Pipeline,
+    alpha: ?f32,
+    a: *Tensor(S),
+    op_a: Operation,
+    b: *Tensor(S),
+    op_b: Operation,
+    beta: ?f32,
+    c: *Tensor(f32),
+    packed_tensors: *PackedTensors(f32),
+) TensorErrors!void {
+    checkStorageType(S);
+
+    try gemm_module.validateTensors(S, f32, a, b, c, op_a, op_b);
+    if (packed_tensors.batches != gemm_module.getBatches(c.dimensions.shape)) {
+        return TensorErrors.InvalidValue;
+    }
+
+    try packed_tensors.packStorage(S, pipeline, a, op_a, b, op_b);
+    try gemm_module.gemmPackedOperands(f32, pipeline, alpha, op_a, op_b, beta, c, packed_tensors, .{});
+}
+
+/// `gemm` with a result of the storage type too. The product is accumulated in `accumulator`, an
+/// f32 tensor with the shape of `c`, and rounded once into `c`. With `beta`, `c` is widened into
+/// `accumulator` first.
+pub fn gemmToStorage(
+    comptime S: type,
+    pipeline: *Pipeline,
+    alpha: ?f32,
+    a: *Tensor(S),
+    op_a: Operation,
+    b: *Tensor(S),
+    op_b: Operation,
+    beta: ?f32,
+    c: *Tensor(S),
+    accumulator: *Tensor(f32),
+    packed_tensors: *PackedTensors(f32),
+) TensorErrors!void {
+    checkStorageType(S);
+
+    if (beta != null) {
+        try convertions.fromStorage(S, pipeline, c, accumulator);
+    }
+
+    try gemm(S, pipeline, alpha, a, op_a, b, op_b, beta, accumulator, packed_tensors);
+    try convertions.toStorage(S, pipeline, accumulator, c);
+}
+
+// -----------------------------------------------------------------------------
+// Unit Tests
+const testing = std.testing;
+
+const memory = tensor_module.memory;
+
+fn roundToStorage(comptime S: type, value: f32) f32 {
+    return if (S == core.types.BF16) core.types.BF16.fromF32(value).toF32() else @floatCast(@as(f16, @floatCast(value)));
+}
+
+fn allocStorage(
+    comptime S: type,
+    pipeline: *Pipeline,
+    shape: []const u64,
+    values: []const f32,
+) !*Tensor(S) {
+    const context = pipeline.command_queue.context;
+
+    const src = try Tensor(f32).alloc(context, pipeline, shape, .{});
+    defer src.release(pipeline);
+
+    const dst = try Tensor(S).alloc(context, pipeline, shape, .{});
+    errdefer dst.release(pipeline);
+
+    try memory.readFromBuffer(f32, pipeline, src, values);
+    try convertions.toStorage(S, pipeline, src, dst);
+    pipeline.waitAndCleanup();
+
+    return dst;
+}
+
+test "mixed - gemm with f16 and bf16 operands accumulates in f32" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const m = 6;
+    const k = 10;
+    const n = 8;
+
+    var a_values: [m * k]f32 = undefined;
+    for (&a_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i % 7)) * 0.3 - 1;
+
+    var b_values: [n * k]f32 = undefined;
+    for (&b_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i % 5)) * 0.7 - 1.1;
+
+    var c_values: [m * n]f32 = undefined;
+    for (&c_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i % 3)) - 1;
+
+    const c = try Tensor(f32).alloc(context, pipeline, &.{ m, n }, .{});
+    defer c.release(pipeline);
+
+    const packed_tensors = try PackedTensors(f32).init(pipeline, c, k, true);
+    defer packed_tensors.deinit(pipeline);
+
+    inline for (core.types.STORAGE_TYPES) |S| {
+        // b is transposed, as the weights of a linear layer
+        const a = try allocStorage(S, pipeline, &.{ m, k }, &a_values);
+        defer a.release(pipeline);
+
+        const b = try allocStorage(S, pipeline, &.{ n, k }, &b_values);
+        defer b.release(pipeline);
+
+        var expected: [m * n]f32 = undefined;
+        for (0..m) |i| {
+            for (0..n) |j| {
+                var acc: f32 = 0;
+                for (0..k) |l| {
+                    acc += roundToStorage(S, a_values[i * k + l]) * roundToStorage(S, b_values[j * k + l]);
+                }
+                expected[i * n + j] = 2 * acc - c_values[i * n + j];
+            }
+        }
+
+        try memory.readFromBuffer(f32, pipeline, c, &c_values);
+        try gemm(S, pipeline, 2, a, .no_transpose, b, .transpose, -1, c, packed_tensors);
+
+        var result: [m * n]f32 = undefined;
+        try memory.writeToBuffer(f32, pipeline, c, &result);
+        pipeline.waitAndCleanup();
+
+        for (expected, result) |e, r| {
+            try testing.expectApproxEqAbs(e, r, 1e-3);
+        }
+
+        // Same product rounded into a storage type result
+        const c_storage = try allocStorage(S, pipeline, &.{ m, n }, &c_values);
+        defer c_storage.release(pipeline);
+
+        try gemmToStorage(S, pipeline, 2, a, .no_transpose, b, .transpose, -1, c_storage, c, packed_tensors);
+        try convertions.fromStorage(S, pipeline, c_storage, c);
+        try memory.writeToBuffer(f32, pipeline, c, &result);
+        pipeline.waitAndCleanup();
+
+        // Within an ulp of the storage type, the sums may round differently on the device
+        const epsilon: f32 = if (S == core.types.BF16) 0x1p-7 else 0x1p-10;
+        for (expected, result) |e, r| {
+            try testing.expectApproxEqAbs(e, r, @max(@abs(e), 1) * epsilon);
+        }
+    }
+}
@@ -0,0 +1,184 @@
+const std = @import("std");
+const cl = @import("opencl");
+
+const core = @import("core");
+const Pipeline = core.Pipeline;
+
+const tensor_module = @import("tensor");
+const PlanarComplex = tensor_module.PlanarComplex;
+const TensorErrors = tensor_module.Errors;
+
+const axpy_module = @import("axpy.zig");
+const gemm_module = @import("gemm.zig");
+const Operation = gemm_module.Operation;
+
+/// `y += alpha * x` for planar complex tensors. Runs as real AXPYs on the parts, two of them when
+/// `alpha` is null or real and four otherwise.
+pub fn axpy(
+    comptime T: type,
+    pipeline: *Pipeline,
+    x: PlanarComplex(T),
+    alpha: ?core.types.Complex(T),
+    y: PlanarComplex(T),
+) TensorErrors!void {
+    const a = alpha orelse {
+        try axpy_module.axpy(T, pipeline, x.real, null, y.real);
+        try axpy_module.axpy(T, pipeline, x.imag, null, y.imag);
+        return;
+    };
+
+    try axpy_module.axpy(T, pipeline, x.real, a.real, y.real);
+    try axpy_module.axpy(T, pipeline, x.imag, a.real, y.imag);
+
+    if (a.imag != 0) {
+        try axpy_module.axpy(T, pipeline, x.imag, -a.imag, y.real);
+        try axpy_module.axpy(T, pipeline, x.real, a.imag, y.imag);
+    }
+}
+
+/// `c = op_a(a) * op_b(b)` for planar complex tensors, computed as four real GEMMs on the parts:
+///   c.real = a.real * b.real - a.imag * b.imag
+///   c.imag = a.real * b.imag + a.imag * b.real
+/// Conjugated operands only flip the sign of the terms with their imaginary part.
+pub fn gemm(
+    comptime T: type,
+    pipeline: *Pipeline,
+    a: PlanarComplex(T),
+    op_a: Operation,
+    b: PlanarComplex(T),
+    op_b: Operation,
+    c: PlanarComplex(T),
+) TensorErrors!void {
+    const real_gemm = gemm_module.gemm;
+
+    const sign_a: T = if (op_a.isConjugated()) -1 else 1;
+    const sign_b: T = if (op_b.isConjugated()) -1 else 1;
+
+    try real_gemm(T, pipeline, null, a.real, op_a, b.real, op_b, null, c.real, null);
+    try real_gemm(T, pipeline, -sign_a * sign_b, a.imag, op_a, b.imag, op_b, 1, c.real, null);
+
+    const alpha_b: ?T = if (sign_b == 1) null else sign_b;
+    try real_gemm(T, pipeline, alpha_b, a.real, op_a, b.imag, op_b, null, c.imag, null);
+    try real_gemm(T, pipeline, sign_a, a.imag, op_a, b.real, op_b, 1, c.imag, null);
+}
+
+// -----------------------------------------------------------------------------
+// Unit Tests
+const testing = std.testing;
+
+const Tensor = tensor_module.Tensor;
+const ComplexF32 = core.types.ComplexF32;
+
+fn readInterleaved(
+    pipeline: *Pipeline,
+    planar: PlanarComplex(f32),
+    values: []const ComplexF32,
+) !void {
+    const context = pipeline.command_queue.context;
+    const interleaved = try Tensor(ComplexF32).alloc(context, pipeline, planar.real.dimensions.shape, .{});
+    defer interleaved.release(pipeline);
+
+    try tensor_module.memory.readFromBuffer(ComplexF32, pipeline, interleaved, values);
+    try planar.fromInterleaved(pipeline, interleaved);
+    pipeline.waitAndCleanup();
+}
+
+fn writeInterleaved(
+    pipeline: *Pipeline,
+    planar: PlanarComplex(f32),
+    values: []ComplexF32,
+) !void {
+    const context = pipeline.command_queue.context;
+    const interleaved = try Tensor(ComplexF32).alloc(context, pipeline, planar.real.dimensions.shape, .{});
+    defer interleaved.release(pipeline);
+
+    try planar.toInterleaved(pipeline, interleaved);
+    try tensor_module.memory.writeToBuffer(ComplexF32, pipeline, interleaved, values);
+    pipeline.waitAndCleanup();
+}
+
+fn mulComplex(a: ComplexF32, b: ComplexF32) ComplexF32 {
+    return .{
+        .real = a.real * b.real - a.imag * b.imag,
+        .imag = a.real * b.imag + a.imag * b.real,
+    };
+}
+
+test "planar - axpy and gemm" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(ComplexF32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const m = 6;
+    const k = 4;
+    const n = 10;
+
+    const a = try PlanarComplex(f32).alloc(context, pipeline, &.{ m, k }, .{});
+    defer a.release(pipeline);
+
+    const b = try PlanarComplex(f32).alloc(context, pipeline, &.{ k, n }, .{});
+    defer b.release(pipeline);
+
+    const c = try PlanarComplex(f32).alloc(context, pipeline, &.{ m, n }, .{});
+    defer c.release(pipeline);
+
+    var a_values: [m * k]ComplexF32 = undefined;
+    for (&a_values, 0..) |*v, i| {
+        v.* = .{ .real = @floatFromInt(i % 5), .imag = @floatFromInt(i % 3) };
+    }
+
+    var b_values: [k * n]ComplexF32 = undefined;
+    for (&b_values, 0..) |*v, i| {
+        v.* = .{ .real = @floatFromInt(i % 4), .imag = -@as(f32, @floatFromInt(i % 2)) };
+    }
+
+    try readInterleaved(pipeline, a, &a_values);
+    try readInterleaved(pipeline, b, &b_values);
+
+    try gemm(f32, pipeline, a, .no_transpose, b, .no_transpose, c);
+
+    var result: [m * n]ComplexF32 = undefined;
+    try writeInterleaved(pipeline, c, &result);
+
+    var expected: [m * n]ComplexF32 = undefined;
+    for (0..m) |i| {
+        for (0..n) |j| {
+            var acc = ComplexF32{ .real = 0, .imag = 0 };
+            for (0..k) |l| {
+                const p = mulComplex(a_values[i * k + l], b_values[l * n + j]);
+                acc.real += p.real;
+                acc.imag += p.imag;
+            }
+            expected[i * n + j] = acc;
+        }
+    }
+
+    for (expected, result) |e, r| {
+        try testing.expectApproxEqAbs(e.real, r.real, 1e-4);
+        try testing.expectApproxEqAbs(e.imag, r.imag, 1e-4);
+    }
+
+    // c += (2 - 3i) * c
+    const alpha = ComplexF32{ .real = 2, .imag = -3 };
+    const c_copy = try PlanarComplex(f32).alloc(context, pipeline, &.{ m, n }, .{});
+    defer c_copy.release(pipeline);
+
+    try tensor_module.memory.copy(f32, pipeline, c.real, c_copy.real);
+    try tensor_module.memory.copy(f32, pipeline, c.imag, c_copy.imag);
+    try axpy(f32, pipeline, c_copy, alpha, c);
+
+    try writeInterleaved(pipeline, c, &result);
+
+    for (expected, result) |e, r| {
+        const p = mulComplex(alpha, e);
+        try testing.expectApproxEqAbs(e.real + p.real, r.real, 1e-3);
+        try testing.expectApproxEqAbs(e.imag + p.imag, r.imag, 1e-3);
+    }
+}
@@ -0,0 +1,387 @@
+const std = @import("std");
+const cl = @import("opencl");
+
+const core = @import("core");
+const Pipeline = core.Pipeline;
+const CommandQueue = core.CommandQueue;
+const KernelsSet = core.KernelsSet;
+
+const tensor_module = @import("tensor");
+const Tensor = tensor_module.Tensor;
+const TensorErrors = tensor_module.Errors;
+
+const gemm_module = @import("gemm.zig");
+const Operation = gemm_module.Operation;
+
+const QUANTIZED_GEMM_KERNEL: []const u8 = @embedFile("kernels/quantized_gemm.cl");
+
+/// Affine quantization of a tensor: an element `q` stands for `scale * (q - zero_point)`.
+pub const Quantization = struct {
+    scale: f32 = 1,
+    zero_point: i32 = 0,
+};
+
+/// Work done on the accumulators before they are written. `channel_scales`, a row vector with as
+/// many elements as `c` has columns, replaces the scale of `b` with a scale per column of `c`
+/// (per output channel when `b` holds weights). `bias`, with the same shape, is added to every
+/// row of the dequantized result.
+pub const Epilogue = struct {
+    channel_scales: ?*Tensor(f32) = null,
+    bias: ?*Tensor(f32) = null,
+};
+
+fn getTypeIndex(comptime T: type) usize {
+    return switch (T) {
+        i8 => 0,
+        u8 => 1,
+        else => @compileError("Quantized products take i8 or u8 tensors"),
+    };
+}
+
+fn getKernelIndex(
+    comptime T: type,
+    requantize: bool,
+    zero_points: bool,
+    per_channel: bool,
+    has_bias: bool,
+    op_a: Operation,
+    op_b: Operation,
+) usize {
+    var kernel_index: usize = @intFromBool(requantize) * (2 * 2 * 2 * 2 * 2 * 2);
+    kernel_index += @intFromBool(zero_points) * (2 * 2 * 2 * 2 * 2);
+    kernel_index += @intFromBool(per_channel) * (2 * 2 * 2 * 2);
+    kernel_index += @intFromBool(has_bias) * (2 * 2 * 2);
+    kernel_index += @intFromBool(op_a.isTransposed()) * (2 * 2);
+    kernel_index += @intFromBool(op_b.isTransposed()) * 2;
+    kernel_index += getTypeIndex(T);
+
+    return kernel_index;
+}
+
+fn getKernel(
+    comptime T: type,
+    command_queue: *const CommandQueue,
+    requantize: bool,
+    zero_points: bool,
+    per_channel: bool,
+    has_bias: bool,
+    op_a: Operation,
+    op_b: Operation,
+) TensorErrors!cl.kernel.Kernel {
+    const kernels_set = try KernelsSet.getKernelSet(command_queue, .QuantizedGEMM, 2 * 2 * 2 * 2 * 2 * 2 * 2);
+
+    const kernel_index = getKernelIndex(T, requantize, zero_points, per_channel, has_bias, op_a, op_b);
+    if (kernels_set.kernels.?[kernel_index]) |v| return v;
+
+    var kernel: cl.kernel.Kernel = undefined;
+    var program: cl.program.Program = undefined;
+
+    const allocator = command_queue.context.allocator;
+    const extra_args: []u8 = try std.fmt.allocPrint(
+        allocator,
+        "-DREQUANTIZE={d} -DZERO_POINTS={d} -DPER_CHANNEL={d} -DHAS_BIAS={d} -DA_TRANS={d} -DB_TRANS={d}",
+        .{
+            @intFromBool(requantize),
+            @intFromBool(zero_points),
+            @intFromBool(per_channel),
+            @intFromBool(has_bias),
+            @intFromBool(op_a.isTransposed()),
+            @intFromBool(op_b.isTransposed()),
+        },
+    );
+    defer allocator.free(extra_args);
+
+    try KernelsSet.compileKernel(
+        T,
+        command_queue,
+        .{
+            .vectors_enabled = false,
+            .kernel_name = "quantized_gemm",
+            .extra_args = extra_args,
+        },
+        &kernel,
+        &program,
+        QUANTIZED_GEMM_KERNEL,
+    );
+
+    kernels_set.kernels.?[kernel_index] = kernel;
+    kernels_set.programs.?[kernel_index] = program;
+
+    return kernel;
+}
+
+fn validateRowVector(context: *const core.Context, cols: u64, x: ?*Tensor(f32)) TensorErrors!void {
+    const v = x orelse return;
+    if (v.context != context) return TensorErrors.UnqualTensorsContext;
+
+    const shape = v.dimensions.shape;
+    if (shape[shape.len - 1] != cols or v.dimensions.number_of_elements_without_padding != cols) {
+        return TensorErrors.InvalidValue;
+    }
+}
+
+/// Quantized `c = op_a(a) * op_b(b)` of i8 or u8 tensors. The products are accumulated in i32,
+/// then dequantized with the scales of `a` and `b`. `R` is the type of the result: f32 writes the
+/// dequantized values and `T` requantizes them with `c_quantization`, which f32 results ignore.
+/// Batches work as in `gemm`.
+///
+/// The accumulators overflow past about 2^31 / 128^2 = 131072 products for i8 and 2^31 / 255^2
+/// = 33025 for u8, which bounds the shared dimension.
+pub fn gemm(
+    comptime T: type,
+    comptime R: type,
+    pipeline: *Pipeline,
+    a: *Tensor(T),
+    a_quantization: Quantization,
+    op_a: Operation,
+    b: *Tensor(T),
+    b_quantization: Quantization,
+    op_b: Operation,
+    c: *Tensor(R),
+    c_quantization: Quantization,
+    epilogue: Epilogue,
+) TensorErrors!void {
+    if (comptime (R != f32 and R != T)) {
+        @compileError("Quantized products write f32 or requantized results");
+    }
+
+    try gemm_module.validateTensors(T, R, a, b, c, op_a, op_b);
+
+    const c_shape = c.dimensions.shape;
+    const cols = gemm_module.getCols(c_shape);
+    try validateRowVector(c.context, cols, epilogue.channel_scales);
+    try validateRowVector(c.context, cols, epilogue.bias);
+
+    const requantize = (R == T);
+    if (requantize and c_quantization.scale == 0) return TensorErrors.InvalidValue;
+
+    const zero_points = (a_quantization.zero_point != 0 or b_quantization.zero_point != 0);
+    const per_channel = (epilogue.channel_scales != null);
+    const has_bias = (epilogue.bias != null);
+
+    const command_queue = pipeline.command_queue;
+    const kernel = try getKernel(T, command_queue, requantize, zero_points, per_channel, has_bias, op_a, op_b);
+
+    const global_work_items = [3]u64{ gemm_module.getRows(c_shape), cols, gemm_module.getBatches(c_shape) };
+    var padded_global_work_items: [3]u64 = undefined;
+    var local_work_items: [3]u64 = undefined;
+    core.WorkGroupTuner.getLocalWorkItems(
+        command_queue,
+        "quantized_gemm",
+        getKernelIndex(T, requantize, zero_points, per_channel, has_bias, op_a, op_b),
+        &global_work_items,
+        &padded_global_work_items,
+        &local_work_items,
+    );
+
+    c.markModified();
+
+    const prev_events = pipeline.prevEvents();
+
+    const setArg = cl.kernel.setArg;
+    const cl_mem_size = @sizeOf(cl.buffer.Mem);
+
+    try setArg(kernel, 0, cl_mem_size, @ptrCast(&a.buffer));
+    try setArg(kernel, 1, cl_mem_size, @ptrCast(&b.buffer));
+    try setArg(kernel, 2, cl_mem_size, @ptrCast(&c.buffer));
+
+    try setArg(kernel, 3, @sizeOf(u64), @ptrCast(&a.memory_layout.row_pitch));
+    try setArg(kernel, 4, @sizeOf(u64), @ptrCast(&b.memory_layout.row_pitch));
+    try setArg(kernel, 5, @sizeOf(u64), @ptrCast(&c.memory_layout.row_pitch));
+
+    const a_batch_pitch = gemm_module.getBatchPitch(T, a, false);
+    const b_batch_pitch = gemm_module.getBatchPitch(T, b, false);
+    try setArg(kernel, 6, @sizeOf(u64), @ptrCast(&a_batch_pitch));
+    try setArg(kernel, 7, @sizeOf(u64), @ptrCast(&b_batch_pitch));
+    try setArg(kernel, 8, @sizeOf(u64), @ptrCast(&c.memory_layout.slice_pitch));
+
+    const a_shape = a.dimensions.shape;
+    const k_size = a_shape[a_shape.len - 1 - @intFromBool(op_a.isTransposed())];
+    try setArg(kernel, 9, @sizeOf(u64), @ptrCast(&k_size));
+
+    for (global_work_items, 10..) |g, size_arg_index| {
+        try setArg(kernel, @intCast(size_arg_index), @sizeOf(u64), @ptrCast(&g));
+    }
+
+    var arg_index: u32 = 13;
+    if (zero_points) {
+        try setArg(kernel, arg_index, @sizeOf(i32), @ptrCast(&a_quantization.zero_point));
+        try setArg(kernel, arg_index + 1, @sizeOf(i32), @ptrCast(&b_quantization.zero_point));
+        arg_index += 2;
+    }
+
+    // Channel scales take the place of the scale of b
+    const scale: f32 = a_quantization.scale * (if (per_channel) 1 else b_quantization.scale);
+    try setArg(kernel, arg_index, @sizeOf(f32), @ptrCast(&scale));
+    arg_index += 1;
+
+    if (epilogue.channel_scales) |channel_scales| {
+        try setArg(kernel, arg_index, cl_mem_size, @ptrCast(&channel_scales.buffer));
+        arg_index += 1;
+    }
+
+    if (epilogue.bias) |bias| {
+        try setArg(kernel, arg_index, cl_mem_size, @ptrCast(&bias.buffer));
+        arg_index += 1;
+    }
+
+    if (requantize) {
+        const inv_c_scale: f32 = 1 / c_quantization.scale;
+        try setArg(kernel, arg_index, @sizeOf(f32), @ptrCast(&inv_c_scale));
+        try setArg(kernel, arg_index + 1, @sizeOf(i32), @ptrCast(&c_quantization.zero_point));
+    }
+
+    var new_event: cl.event.Event = undefined;
+    try cl.kernel.enqueueNdRange(
+        command_queue.cl_command_queue,
+        kernel,
+        null,
+        &padded_global_work_items,
+        &local_work_items,
+        prev_events,
+        &new_event,
+    );
+    errdefer tensor_module.helpers.releaseEvent(new_event);
+
+    try pipeline.append(&.{new_event});
+}
+
+// -----------------------------------------------------------------------------
+// Unit Tests
+const testing = std.testing;
+
+const memory = tensor_module.memory;
+
+fn testQuantizedGemm(
+    comptime T: type,
+    pipeline: *Pipeline,
+    op_b: Operation,
+) !void {
+    const context = pipeline.command_queue.context;
+
+    const m = 5;
+    const k = 23;
+    const n = 7;
+
+    const b_shape: [2]u64 = if (op_b.isTransposed()) .{ n, k } else .{ k, n };
+
+    const a = try Tensor(T).alloc(context, pipeline, &.{ m, k }, .{});
+    defer a.release(pipeline);
+
+    const b = try Tensor(T).alloc(context, pipeline, &b_shape, .{});
+    defer b.release(pipeline);
+
+    const c = try Tensor(f32).alloc(context, pipeline, &.{ m, n }, .{});
+    defer c.release(pipeline);
+
+    const c_quantized = try Tensor(T).alloc(context, pipeline, &.{ m, n }, .{});
+    defer c_quantized.release(pipeline);
+
+    const channel_scales = try Tensor(f32).alloc(context, pipeline, &.{n}, .{});
+    defer channel_scales.release(pipeline);
+
+    const bias = try Tensor(f32).alloc(context, pipeline, &.{n}, .{});
+    defer bias.release(pipeline);
+
+    const min: i32 = std.math.minInt(T);
+    var a_values: [m * k]T = undefined;
+    for (&a_values, 0..) |*v, i| v.* = @intCast(min + @as(i32, @intCast((i * 37) % 256)));
+
+    var b_values: [k * n]T = undefined;
+    for (&b_values, 0..) |*v, i| v.* = @intCast(min + @as(i32, @intCast((i * 91 + 13) % 256)));
+
+    var scales_values: [n]f32 = undefined;
+    var bias_values: [n]f32 = undefined;
+    for (&scales_values, &bias_values, 0..) |*s, *bv, j| {
+        s.* = 0.01 + @as(f32, @floatFromInt(j)) * 0.002;
+        bv.* = @as(f32, @floatFromInt(j)) - 3;
+    }
+
+    try memory.readFromBuffer(T, pipeline, a, &a_values);
+    try memory.readFromBuffer(T, pipeline, b, &b_values);
+    try memory.readFromBuffer(f32, pipeline, channel_scales, &scales_values);
+    try memory.readFromBuffer(f32, pipeline, bias, &bias_values);
+
+    const a_quantization = Quantization{ .scale = 0.05, .zero_point = 3 };
+    const b_quantization = Quantization{ .scale = 0.02, .zero_point = -5 };
+    const c_quantization = Quantization{ .scale = 0.5, .zero_point = 10 };
+
+    var accumulators: [m * n]i32 = undefined;
+    for (0..m) |i| {
+        for (0..n) |j| {
+            var acc: i32 = 0;
+            for (0..k) |l| {
+                const b_value = if (op_b.isTransposed()) b_values[j * k + l] else b_values[l * n + j];
+                acc += (@as(i32, a_values[i * k + l]) - a_quantization.zero_point) *
+                    (@as(i32, b_value) - b_quantization.zero_point);
+            }
+            accumulators[i * n + j] = acc;
+        }
+    }
+
+    var result: [m * n]f32 = undefined;
+    var quantized_result: [m * n]T = undefined;
+
+    // Per tensor scales, dequantized
+    try gemm(T, f32, pipeline, a, a_quantization, .no_transpose, b, b_quantization, op_b, c, .{}, .{});
+    try memory.writeToBuffer(f32, pipeline, c, &result);
+    pipeline.waitAndCleanup();
+
+    for (accumulators, result) |acc, r| {
+        const expected = a_quantization.scale * b_quantization.scale * @as(f32, @floatFromInt(acc));
+        try testing.expectApproxEqRel(expected, r, 1e-5);
+    }
+
+    // Per channel scales and bias, requantized
+    const epilogue = Epilogue{ .channel_scales = channel_scales, .bias = bias };
+    try gemm(T, T, pipeline, a, a_quantization, .no_transpose, b, b_quantization, op_b, c_quantized, c_quantization, epilogue);
+    try memory.writeToBuffer(T, pipeline, c_quantized, &quantized_result);
+    pipeline.waitAndCleanup();
+
+    for (accumulators, quantized_result, 0..) |acc, r, idx| {
+        const j = idx % n;
+        const value = a_quantization.scale * scales_values[j] * @as(f32, @floatFromInt(acc)) + bias_values[j];
+        const q = @round(value / c_quantization.scale) + @as(f32, @floatFromInt(c_quantization.zero_point));
+        const expected: T = @intFromFloat(std.math.clamp(q, std.math.minInt(T), std.math.maxInt(T)));
+
+        // Halfway values may round either way
+        try testing.expect(@abs(@as(i32, expected) - @as(i32, r)) <= 1);
+    }
+}
+
+test "quantized - gemm with i32 accumulation" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    inline for (.{ i8, u8 }) |T| {
+        for ([_]Operation{ .no_transpose, .transpose }) |op_b| {
+            try testQuantizedGemm(T, pipeline, op_b);
+        }
+    }
+
+    // Per channel scales need one scale per column of c
+    const a = try Tensor(i8).alloc(context, pipeline, &.{ 4, 6 }, .{});
+    defer a.release(pipeline);
+
+    const b = try Tensor(i8).alloc(context, pipeline, &.{ 6, 8 }, .{});
+    defer b.release(pipeline);
+
+    const c = try Tensor(f32).alloc(context, pipeline, &.{ 4, 8 }, .{});
+    defer c.release(pipeline);
+
+    const scales = try Tensor(f32).alloc(context, pipeline, &.{4}, .{});
+    defer scales.release(pipeline);
+
+    try testing.expectError(
+        TensorErrors.InvalidValue,
+        gemm(i8, f32, pipeline, a, .{}, .no_transpose, b, .{}, .no_transpose, c, .{}, .{ .channel_scales = scales }),
+    );
+}
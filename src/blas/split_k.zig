@@ -0,0 +1,495 @@
+const std = @import("std");
+const cl = @import("opencl");
+
+const core = @import("core");
+const Pipeline = core.Pipeline;
+const CommandQueue = core.CommandQueue;
+const KernelsSet = core.KernelsSet;
+
+const tensor_module = @import("tensor");
+const Tensor = tensor_module.Tensor;
+const TensorErrors = tensor_module.Errors;
+const GemmAlgorithm = tensor_module.GemmAlgorithm;
+
+const gemm_module = @import("gemm.zig");
+const Operation = gemm_module.Operation;
+const Epilogue = gemm_module.Epilogue;
+
+const GEMM_SPLIT_K_KERNEL: []const u8 = @embedFile("kernels/gemm_split_k.cl");
+
+/// Most chunks K is split into, every one of them adds a matrix of partial sums to the reduction.
+pub const MAX_SPLITS = 16;
+
+// Fewest elements of K (vectors of them when vectors are enabled) multiplied by every chunk, below
+// this the second pass costs more than the compute units it keeps busy
+const MIN_CHUNK_SIZE = 256;
+
+/// How a product is split along K.
+pub const Split = struct {
+    splits: u64,
+    chunk_size: u64,
+    vectors_enabled: bool,
+    algorithm: GemmAlgorithm,
+};
+
+// Chunks of K for a product with `k_size` elements in K whose launch has `groups` work-groups.
+// Every chunk has the same even size, so the tile kernels multiply them without overlapping.
+fn countSplits(command_queue: *const CommandQueue, groups: u64, k_size: u64, max_splits: u64) u64 {
+    const compute_units: u64 = command_queue.compute_units;
+    if (groups == 0 or groups >= compute_units) return 1;
+
+    var splits = @min(compute_units / groups, k_size / MIN_CHUNK_SIZE, max_splits);
+    while (splits > 1 and (k_size % (2 * splits)) != 0) {
+        splits -= 1;
+    }
+
+    return @max(splits, 1);
+}
+
+// Work-groups of the unpacked launch of `c`, 0 when `c` has no work items for `algorithm`
+fn getGroups(comptime T: type, command_queue: *const CommandQueue, c: *Tensor(T), algorithm: GemmAlgorithm) u64 {
+    if (!gemm_module.hasGemmWorkItems(T, c, algorithm)) return 0;
+
+    var global_work_items: [3]u64 = undefined;
+    var local_work_items: [3]u64 = undefined;
+    gemm_module.getBatchedWorkItems(T, c, command_queue.wekua_id, algorithm, &global_work_items, &local_work_items);
+
+    return (global_work_items[0] / local_work_items[0]) * (global_work_items[1] / local_work_items[1]);
+}
+
+/// Allocates the matrices of partial sums of the products of `c` with `k_size` elements in K when
+/// they are worth splitting, that is when the launch has fewer work-groups than the device has
+/// compute units and K is long. Only real types and results with a single matrix are split.
+pub fn allocPartials(
+    comptime T: type,
+    pipeline: *Pipeline,
+    c: *Tensor(T),
+    k_size: u64,
+) TensorErrors!?*Tensor(T) {
+    if (comptime core.types.isComplex(T)) return null;
+
+    const shape = c.dimensions.shape;
+    if (gemm_module.getBatches(shape) != 1) return null;
+
+    const command_queue = pipeline.command_queue;
+    const default_algorithm = c.work_configuration.gemm_algorithm_per_device[command_queue.wekua_id];
+
+    // Without vectors K has the most elements, so no product of `c` gets more chunks than this
+    const padded_k_size = k_size + k_size % 2;
+    const algorithm = gemm_module.getAlgorithm(default_algorithm, padded_k_size);
+    const splits = countSplits(command_queue, getGroups(T, command_queue, c, algorithm), padded_k_size, MAX_SPLITS);
+    if (splits < 2) return null;
+
+    return try Tensor(T).alloc(
+        command_queue.context,
+        pipeline,
+        &.{ splits, gemm_module.getRows(shape), gemm_module.getCols(shape) },
+        .{ .vectors_enabled = c.flags.vectors_enabled },
+    );
+}
+
+/// How the product of `gemm` is split with `partials`, null when it isn't worth splitting (or
+/// `partials` doesn't fit `c` anymore).
+pub fn getSplit(
+    comptime T: type,
+    command_queue: *const CommandQueue,
+    a: *Tensor(T),
+    op_a: Operation,
+    b: *Tensor(T),
+    op_b: Operation,
+    c: *Tensor(T),
+    partials: *Tensor(T),
+) ?Split {
+    const c_shape = c.dimensions.shape;
+    if (gemm_module.getBatches(c_shape) != 1 or partials.memory_layout.row_pitch != c.memory_layout.row_pitch or
+        gemm_module.getRows(partials.dimensions.shape) < gemm_module.getRows(c_shape))
+    {
+        return null;
+    }
+
+    const layout = gemm_module.getLayoutWithoutPacking(T, command_queue, a, op_a, b, op_b);
+    const k_size = layout.k_size;
+
+    const default_algorithm = c.work_configuration.gemm_algorithm_per_device[command_queue.wekua_id];
+    const groups = getGroups(T, command_queue, c, gemm_module.getAlgorithm(default_algorithm, k_size));
+    const splits = countSplits(command_queue, groups, k_size, partials.dimensions.shape[0]);
+    if (splits < 2) return null;
+
+    const chunk_size = k_size / splits;
+    const algorithm = gemm_module.getAlgorithm(default_algorithm, chunk_size);
+    if (!gemm_module.hasGemmWorkItems(T, c, algorithm)) return null;
+
+    return .{
+        .splits = splits,
+        .chunk_size = chunk_size,
+        .vectors_enabled = layout.vectors_enabled,
+        .algorithm = algorithm,
+    };
+}
+
+const REDUCE_KERNELS_PER_EPILOGUE = 2 * 2 * core.types.SUPPORTED_TYPES.len;
+
+fn getReduceKernelIndex(comptime T: type, has_alpha: bool, has_beta: bool, epilogue_index: usize) usize {
+    const SUPPORTED_TYPES = core.types.SUPPORTED_TYPES;
+
+    var kernel_index: usize = epilogue_index * REDUCE_KERNELS_PER_EPILOGUE;
+    kernel_index += @intFromBool(has_alpha) * (2 * SUPPORTED_TYPES.len);
+    kernel_index += @intFromBool(has_beta) * SUPPORTED_TYPES.len;
+    kernel_index += @as(usize, core.types.getTypeIndex(T));
+
+    return kernel_index;
+}
+
+fn getReduceKernel(
+    comptime T: type,
+    command_queue: *const CommandQueue,
+    has_alpha: bool,
+    has_beta: bool,
+    epilogue_index: usize,
+) TensorErrors!cl.kernel.Kernel {
+    const kernels_set = try KernelsSet.getKernelSet(
+        command_queue,
+        .GEMMSplitKReduce,
+        gemm_module.EPILOGUE_VARIANTS * REDUCE_KERNELS_PER_EPILOGUE,
+    );
+
+    const kernel_index = getReduceKernelIndex(T, has_alpha, has_beta, epilogue_index);
+    if (kernels_set.kernels.?[kernel_index]) |v| return v;
+
+    var kernel: cl.kernel.Kernel = undefined;
+    var program: cl.program.Program = undefined;
+
+    var epilogue_buf: [128]u8 = undefined;
+    const allocator = command_queue.context.allocator;
+    const extra_args: []u8 = try std.fmt.allocPrint(
+        allocator,
+        "-DHAS_ALPHA={d} -DHAS_BETA={d}{s}",
+        .{
+            @intFromBool(has_alpha),
+            @intFromBool(has_beta),
+            gemm_module.getEpilogueArgs(&epilogue_buf, epilogue_index),
+        },
+    );
+    defer allocator.free(extra_args);
+
+    try KernelsSet.compileKernel(
+        T,
+        command_queue,
+        .{
+            .vectors_enabled = false,
+            .kernel_name = "gemm_split_k_reduce",
+            .extra_args = extra_args,
+        },
+        &kernel,
+        &program,
+        GEMM_SPLIT_K_KERNEL,
+    );
+
+    kernels_set.kernels.?[kernel_index] = kernel;
+    kernels_set.programs.?[kernel_index] = program;
+
+    return kernel;
+}
+
+// First pass: the product of every chunk of K is written to its own matrix of `partials` by the
+// unpacked tile kernel, launched as a batch whose operands step along K
+fn enqueuePartialProducts(
+    comptime T: type,
+    pipeline: *Pipeline,
+    a: *Tensor(T),
+    op_a: Operation,
+    b: *Tensor(T),
+    op_b: Operation,
+    c: *Tensor(T),
+    partials: *Tensor(T),
+    split: Split,
+) TensorErrors!void {
+    const command_queue = pipeline.command_queue;
+    const vectors_enabled = split.vectors_enabled;
+
+    const kernel = try gemm_module.getGemmKernelWithoutPacking(
+        T,
+        command_queue,
+        vectors_enabled,
+        false,
+        false,
+        op_a,
+        op_b,
+        split.algorithm,
+        null,
+        0,
+    );
+
+    var a_row_pitch: u64 = undefined;
+    var b_row_pitch: u64 = undefined;
+    if (vectors_enabled) {
+        a_row_pitch = a.memory_layout.row_pitch_for_vectors;
+        b_row_pitch = b.memory_layout.row_pitch_for_vectors;
+    } else {
+        a_row_pitch = a.memory_layout.row_pitch;
+        b_row_pitch = b.memory_layout.row_pitch;
+    }
+
+    // K runs along the rows of A and the columns of B, unless they are transposed
+    const chunk_size = split.chunk_size;
+    const a_batch_pitch = if (op_a.isTransposed()) chunk_size * a_row_pitch else chunk_size;
+    const b_batch_pitch = if (op_b.isTransposed()) chunk_size else chunk_size * b_row_pitch;
+    const c_batch_pitch = partials.memory_layout.slice_pitch;
+
+    var global_work_items: [3]u64 = undefined;
+    var local_work_items: [3]u64 = undefined;
+    gemm_module.getBatchedWorkItems(T, c, command_queue.wekua_id, split.algorithm, &global_work_items, &local_work_items);
+    global_work_items[2] = split.splits;
+
+    const prev_events = pipeline.prevEvents();
+
+    const setArg = cl.kernel.setArg;
+    const cl_mem_size = @sizeOf(cl.buffer.Mem);
+
+    try setArg(kernel, 0, cl_mem_size, @ptrCast(&a.buffer));
+    try setArg(kernel, 1, cl_mem_size, @ptrCast(&b.buffer));
+    try setArg(kernel, 2, cl_mem_size, @ptrCast(&partials.buffer));
+
+    try setArg(kernel, 3, @sizeOf(u64), @ptrCast(&a_row_pitch));
+    try setArg(kernel, 4, @sizeOf(u64), @ptrCast(&b_row_pitch));
+    try setArg(kernel, 5, @sizeOf(u64), @ptrCast(&partials.memory_layout.row_pitch));
+
+    try setArg(kernel, 6, @sizeOf(u64), @ptrCast(&a_batch_pitch));
+    try setArg(kernel, 7, @sizeOf(u64), @ptrCast(&b_batch_pitch));
+    try setArg(kernel, 8, @sizeOf(u64), @ptrCast(&c_batch_pitch));
+
+    try setArg(kernel, 9, @sizeOf(u64), @ptrCast(&chunk_size));
+
+    var new_event: cl.event.Event = undefined;
+    try cl.kernel.enqueueNdRange(
+        command_queue.cl_command_queue,
+        kernel,
+        null,
+        &global_work_items,
+        &local_work_items,
+        prev_events,
+        &new_event,
+    );
+    errdefer tensor_module.helpers.releaseEvent(new_event);
+
+    try pipeline.append(&.{new_event});
+}
+
+// Second pass: `c = alpha * sum(partials) + beta * c`, with the epilogue applied before the store
+fn enqueueReduction(
+    comptime T: type,
+    pipeline: *Pipeline,
+    alpha: ?T,
+    beta: ?T,
+    c: *Tensor(T),
+    partials: *Tensor(T),
+    splits: u64,
+    epilogue: Epilogue(T),
+) TensorErrors!void {
+    const command_queue = pipeline.command_queue;
+
+    const has_alpha = (alpha != null or beta != null);
+    const has_beta = (beta != null);
+
+    const kernel = try getReduceKernel(T, command_queue, has_alpha, has_beta, epilogue.getIndex());
+
+    const row_pitch = c.memory_layout.row_pitch;
+    const global_work_items = [2]u64{ c.memory_layout.slice_pitch / row_pitch, row_pitch };
+    var padded_global_work_items: [2]u64 = undefined;
+    var local_work_items: [2]u64 = undefined;
+    core.WorkGroupTuner.getLocalWorkItems(
+        command_queue,
+        "gemm_split_k_reduce",
+        getReduceKernelIndex(T, has_alpha, has_beta, epilogue.getIndex()),
+        &global_work_items,
+        &padded_global_work_items,
+        &local_work_items,
+    );
+
+    c.markModified();
+    if (epilogue.derivative) |v| v.markModified();
+
+    const prev_events = pipeline.prevEvents();
+
+    const setArg = cl.kernel.setArg;
+    const cl_mem_size = @sizeOf(cl.buffer.Mem);
+
+    try setArg(kernel, 0, cl_mem_size, @ptrCast(&partials.buffer));
+    try setArg(kernel, 1, cl_mem_size, @ptrCast(&c.buffer));
+
+    try setArg(kernel, 2, @sizeOf(u64), @ptrCast(&row_pitch));
+    try setArg(kernel, 3, @sizeOf(u64), @ptrCast(&partials.memory_layout.slice_pitch));
+    try setArg(kernel, 4, @sizeOf(u64), @ptrCast(&splits));
+    try setArg(kernel, 5, @sizeOf(u64), @ptrCast(&global_work_items[0]));
+
+    if (has_alpha) {
+        const alpha_val: T = alpha orelse 1;
+        try setArg(kernel, 6, @sizeOf(T), @ptrCast(&alpha_val));
+
+        if (has_beta) {
+            const beta_val = beta.?;
+            try setArg(kernel, 7, @sizeOf(T), @ptrCast(&beta_val));
+        }
+    }
+
+    try gemm_module.setEpilogueArgs(T, kernel, 6 + @as(u32, @intFromBool(has_alpha)) + @intFromBool(has_beta), c, epilogue);
+
+    var new_event: cl.event.Event = undefined;
+    try cl.kernel.enqueueNdRange(
+        command_queue.cl_command_queue,
+        kernel,
+        null,
+        &padded_global_work_items,
+        &local_work_items,
+        prev_events,
+        &new_event,
+    );
+    errdefer tensor_module.helpers.releaseEvent(new_event);
+
+    try pipeline.append(&.{new_event});
+}
+
+/// GEMM of `gemm` split along K as described by `split` (see `getSplit`), the tensors must have
+/// been validated already.
+pub fn splitKGemm(
+    comptime T: type,
+    pipeline: *Pipeline,
+    alpha: ?T,
+    a: *Tensor(T),
+    op_a: Operation,
+    b: *Tensor(T),
+    op_b: Operation,
+    beta: ?T,
+    c: *Tensor(T),
+    partials: *Tensor(T),
+    split: Split,
+    epilogue: Epilogue(T),
+) TensorErrors!void {
+    try enqueuePartialProducts(T, pipeline, a, op_a, b, op_b, c, partials, split);
+    try enqueueReduction(T, pipeline, alpha, beta, c, partials, split.splits, epilogue);
+}
+
+// -----------------------------------------------------------------------------
+// Unit Tests
+const testing = std.testing;
+
+const memory = tensor_module.memory;
+
+test "split-K - chunks of K" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (command_queue.compute_units < 2) return;
+
+    // A launch that already fills the device isn't split
+    try testing.expectEqual(1, countSplits(command_queue, command_queue.compute_units, 1 << 16, MAX_SPLITS));
+
+    // Nor is a short K
+    try testing.expectEqual(1, countSplits(command_queue, 1, MIN_CHUNK_SIZE, MAX_SPLITS));
+
+    const k_sizes = [_]u64{ 4096, 3000, 1030, 1 << 16 };
+    for (k_sizes) |k_size| {
+        const splits = countSplits(command_queue, 1, k_size, MAX_SPLITS);
+        try testing.expect(splits >= 1 and splits <= MAX_SPLITS and splits <= command_queue.compute_units);
+        try testing.expectEqual(0, k_size % (2 * splits));
+        if (splits > 1) try testing.expect(k_size / splits >= MIN_CHUNK_SIZE);
+    }
+}
+
+test "split-K - small results with a long K" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    // The gradient of the weights of a small layer over a large batch: c = a^T * b
+    const m = 10;
+    const n = 12;
+    const k = 4000;
+
+    const a = try Tensor(f32).alloc(context, pipeline, &.{ k, m }, .{});
+    defer a.release(pipeline);
+
+    const b = try Tensor(f32).alloc(context, pipeline, &.{ k, n }, .{});
+    defer b.release(pipeline);
+
+    const bias = try Tensor(f32).alloc(context, pipeline, &.{n}, .{});
+    defer bias.release(pipeline);
+
+    const c_mat = try Tensor(f32).alloc(context, pipeline, &.{ m, n }, .{});
+    defer c_mat.release(pipeline);
+
+    const a_values = try allocator.alloc(f32, k * m);
+    defer allocator.free(a_values);
+    for (a_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i % 7)) * 0.125 - 0.375;
+
+    const b_values = try allocator.alloc(f32, k * n);
+    defer allocator.free(b_values);
+    for (b_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i % 5)) * 0.25 - 0.5;
+
+    var bias_values: [n]f32 = undefined;
+    for (&bias_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i)) * 0.5;
+
+    const c_values = [_]f32{1} ** (m * n);
+
+    try memory.readFromBuffer(f32, pipeline, a, a_values);
+    try memory.readFromBuffer(f32, pipeline, b, b_values);
+    try memory.readFromBuffer(f32, pipeline, bias, &bias_values);
+
+    const packed_tensors = try gemm_module.PackedTensors(f32).init(pipeline, c_mat, k, true);
+    defer packed_tensors.deinit(pipeline);
+
+    // The split chosen for the device (if any) and a forced one, so the partial products and the
+    // reduction run even on devices whose compute units are already filled by the tiles of C
+    const forced_splits = 4;
+    const forced_partials = try Tensor(f32).alloc(context, pipeline, &.{ forced_splits, m, n }, .{});
+    defer forced_partials.release(pipeline);
+
+    const default_algorithm = c_mat.work_configuration.gemm_algorithm_per_device[command_queue.wekua_id];
+    const forced_split: Split = .{
+        .splits = forced_splits,
+        .chunk_size = k / forced_splits,
+        .vectors_enabled = false,
+        .algorithm = gemm_module.getAlgorithm(default_algorithm, k / forced_splits),
+    };
+
+    for ([_]bool{ false, true }) |forced| {
+        try memory.readFromBuffer(f32, pipeline, c_mat, &c_values);
+
+        const epilogue: Epilogue(f32) = .{ .bias = bias, .activation = .relu };
+        if (forced) {
+            try splitKGemm(f32, pipeline, 2, a, .transpose, b, .no_transpose, -1, c_mat, forced_partials, forced_split, epilogue);
+        } else {
+            try gemm_module.gemmWithEpilogue(f32, pipeline, 2, a, .transpose, b, .no_transpose, -1, c_mat, packed_tensors, epilogue);
+        }
+
+        var result: [m * n]f32 = undefined;
+        try memory.writeToBuffer(f32, pipeline, c_mat, &result);
+        pipeline.waitAndCleanup();
+
+        for (0..m) |i| {
+            for (0..n) |j| {
+                var acc: f32 = 0;
+                for (0..k) |l| acc += a_values[l * m + i] * b_values[l * n + j];
+
+                const expected = @max(2 * acc - 1 + bias_values[j], 0);
+                try testing.expectApproxEqAbs(expected, result[i * n + j], 1e-2);
+            }
+        }
+    }
+
+    if (packed_tensors.split_k_partials) |partials| {
+        const split = getSplit(f32, command_queue, a, .transpose, b, .no_transpose, c_mat, partials).?;
+        try testing.expect(split.splits >= 2);
+        try testing.expectEqual(@as(u64, k), split.splits * split.chunk_size);
+    }
+}
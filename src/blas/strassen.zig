@@ -0,0 +1,674 @@
+const std = @import("std");
+const cl = @import("opencl");
+
+const core = @import("core");
+const Pipeline = core.Pipeline;
+const CommandQueue = core.CommandQueue;
+const KernelsSet = core.KernelsSet;
+
+const tensor_module = @import("tensor");
+const Tensor = tensor_module.Tensor;
+const TensorErrors = tensor_module.Errors;
+
+const gemm_module = @import("gemm.zig");
+const Operation = gemm_module.Operation;
+
+const STRASSEN_KERNEL: []const u8 = @embedFile("kernels/strassen.cl");
+
+/// Most levels of recursion, every one of them allocates two temporaries of a quarter of the size
+/// of the level above.
+pub const MAX_LEVELS = 4;
+
+// Fewest rows of the blocks multiplied by the tile kernels. Every block is a multiple of this, so
+// the blocks need no padding for any block size of the tile kernels nor for vectors.
+const MIN_BLOCK_SIZE = 64;
+
+/// Products smaller than this are left to the tile kernels when no cutoff has been tuned for the
+/// device (see `tune`).
+pub const DEFAULT_CUTOFF = 2048;
+
+/// Sizes measured by `tune`.
+pub const CUTOFF_CANDIDATES = [_]u64{ 256, 512, 1024, 2048 };
+
+// Levels of recursion of a product of `size` x `size` matrices: one for every halving of the
+// matrices while they are at least `cutoff` and their halves are still whole blocks
+fn countLevels(size: u64, cutoff: u64) usize {
+    var levels: usize = 0;
+    var block_size = size;
+    while (levels < MAX_LEVELS and block_size >= cutoff and (block_size % (2 * MIN_BLOCK_SIZE)) == 0) {
+        block_size /= 2;
+        levels += 1;
+    }
+
+    return levels;
+}
+
+fn writeTuningKey(buf: *[32]u8, comptime T: type) []const u8 {
+    return std.fmt.bufPrint(buf, "strassen/{d}", .{core.types.getTypeIndex(T)}) catch unreachable;
+}
+
+/// Cutoff recorded by `tune` for the type on the device of `command_queue`, if any.
+pub fn getTunedCutoff(comptime T: type, command_queue: *const CommandQueue) ?u64 {
+    var key_buf: [32]u8 = undefined;
+    const entry = core.WorkGroupTuner.getByKey(command_queue, writeTuningKey(&key_buf, T)) orelse return null;
+    return entry[0];
+}
+
+/// Temporaries of the Strassen-Winograd products of square matrices with the size of the result
+/// they were created for.
+pub fn Workspace(comptime T: type) type {
+    if (@typeInfo(T) != .float) {
+        @compileError("Strassen-Winograd products are only computed for real floating point types");
+    }
+
+    const TensorT = Tensor(T);
+
+    return struct {
+        size: u64,
+
+        // The operands of the sums of level `i` are blocks of `size / 2^(i + 1)` rows
+        x_tensors: [MAX_LEVELS]*TensorT,
+        y_tensors: [MAX_LEVELS]*TensorT,
+        levels: usize,
+
+        // The product of `gemm` when it has a beta, C is combined with it afterwards. Only
+        // allocated the first time it is needed.
+        product: ?*TensorT,
+
+        const Self = @This();
+
+        /// Creates the workspace for `result_tensor` with the cutoff tuned for the device, or
+        /// `DEFAULT_CUTOFF` when there is none.
+        pub fn init(pipeline: *Pipeline, result_tensor: *TensorT) TensorErrors!*Self {
+            const cutoff = getTunedCutoff(T, pipeline.command_queue) orelse DEFAULT_CUTOFF;
+            return initWithCutoff(pipeline, result_tensor, cutoff);
+        }
+
+        /// Creates the workspace for `result_tensor`, a square matrix, recursing while the
+        /// matrices are at least `cutoff` rows. Results too small (or with sizes that can't be
+        /// halved into whole blocks) get no levels and `gemm` computes them with the tile kernels.
+        pub fn initWithCutoff(pipeline: *Pipeline, result_tensor: *TensorT, cutoff: u64) TensorErrors!*Self {
+            const shape = result_tensor.dimensions.shape;
+            if (shape.len != 2 or shape[0] != shape[1] or result_tensor.flags.compact) {
+                return tensor_module.Errors.InvalidValue;
+            }
+
+            const size = shape[0];
+            const levels = countLevels(size, cutoff);
+
+            const self = try pipeline.allocator.create(Self);
+            errdefer pipeline.allocator.destroy(self);
+
+            self.* = .{
+                .size = size,
+                .x_tensors = undefined,
+                .y_tensors = undefined,
+                .levels = 0,
+                .product = null,
+            };
+            errdefer self.releaseTensors(pipeline);
+
+            const context = pipeline.command_queue.context;
+            const vectors_enabled = result_tensor.flags.vectors_enabled;
+            for (0..levels) |level| {
+                const block_size = size >> @intCast(level + 1);
+
+                const x = try TensorT.alloc(context, pipeline, &.{ block_size, block_size }, .{
+                    .vectors_enabled = vectors_enabled,
+                });
+                errdefer x.release(pipeline);
+
+                const y = try TensorT.alloc(context, pipeline, &.{ block_size, block_size }, .{
+                    .vectors_enabled = vectors_enabled,
+                });
+
+                self.x_tensors[level] = x;
+                self.y_tensors[level] = y;
+                self.levels += 1;
+            }
+
+            return self;
+        }
+
+        fn releaseTensors(self: *Self, pipeline: *Pipeline) void {
+            for (self.x_tensors[0..self.levels], self.y_tensors[0..self.levels]) |x, y| {
+                x.release(pipeline);
+                y.release(pipeline);
+            }
+            if (self.product) |v| v.release(pipeline);
+        }
+
+        pub fn deinit(self: *Self, pipeline: *Pipeline) void {
+            self.releaseTensors(pipeline);
+            pipeline.allocator.destroy(self);
+        }
+
+        fn getProduct(self: *Self, pipeline: *Pipeline, c: *TensorT) TensorErrors!*TensorT {
+            if (self.product) |v| return v;
+
+            const product = try TensorT.alloc(pipeline.command_queue.context, pipeline, &.{ self.size, self.size }, .{
+                .vectors_enabled = c.flags.vectors_enabled,
+            });
+            self.product = product;
+            return product;
+        }
+
+        // Whether the tensors of a validated product are the ones this workspace was created for
+        fn fits(self: *const Self, a: *TensorT, op_a: Operation, b: *TensorT, c: *TensorT) bool {
+            if (self.levels == 0) return false;
+
+            const a_shape = a.dimensions.shape;
+            const c_shape = c.dimensions.shape;
+            if (a_shape.len != 2 or b.dimensions.shape.len != 2 or c_shape.len != 2) return false;
+
+            const k_size = a_shape[1 - @intFromBool(op_a.isTransposed())];
+            return c_shape[0] == self.size and c_shape[1] == self.size and k_size == self.size;
+        }
+
+        // `c = alpha * op_a(a) * op_b(b)` for blocks of `size >> level` rows. At the last level the
+        // blocks are multiplied by the tile kernels, above it with the seven products and fifteen
+        // sums of Winograd's variant, scheduled so that only two temporaries are needed per level.
+        fn multiply(
+            self: *const Self,
+            pipeline: *Pipeline,
+            alpha: ?T,
+            a: View(T),
+            op_a: Operation,
+            b: View(T),
+            op_b: Operation,
+            c: View(T),
+            level: usize,
+        ) TensorErrors!void {
+            if (level == self.levels) {
+                // The temporaries of the level above have the shape of the blocks of this one
+                return enqueueBlockProduct(T, pipeline, alpha, a, op_a, b, op_b, c, self.x_tensors[level - 1]);
+            }
+
+            const block_size = self.size >> @intCast(level + 1);
+            const next = level + 1;
+
+            const a11 = a.quadrant(op_a, 0, 0, block_size);
+            const a12 = a.quadrant(op_a, 0, 1, block_size);
+            const a21 = a.quadrant(op_a, 1, 0, block_size);
+            const a22 = a.quadrant(op_a, 1, 1, block_size);
+
+            const b11 = b.quadrant(op_b, 0, 0, block_size);
+            const b12 = b.quadrant(op_b, 0, 1, block_size);
+            const b21 = b.quadrant(op_b, 1, 0, block_size);
+            const b22 = b.quadrant(op_b, 1, 1, block_size);
+
+            const c11 = c.quadrant(.no_transpose, 0, 0, block_size);
+            const c12 = c.quadrant(.no_transpose, 0, 1, block_size);
+            const c21 = c.quadrant(.no_transpose, 1, 0, block_size);
+            const c22 = c.quadrant(.no_transpose, 1, 1, block_size);
+
+            // The sums of blocks of A and B keep their layout, they are multiplied with `op_a` and
+            // `op_b` like the blocks themselves
+            const x: View(T) = .{ .tensor = self.x_tensors[level], .offset = 0 };
+            const y: View(T) = .{ .tensor = self.y_tensors[level], .offset = 0 };
+
+            // C21 = M7 = (A11 - A21) * (B22 - B12)
+            try enqueueCombine(T, pipeline, x, a11, a21, -1, block_size);
+            try enqueueCombine(T, pipeline, y, b22, b12, -1, block_size);
+            try self.multiply(pipeline, alpha, x, op_a, y, op_b, c21, next);
+
+            // C22 = M5 = (A21 + A22) * (B12 - B11)
+            try enqueueCombine(T, pipeline, x, a21, a22, 1, block_size);
+            try enqueueCombine(T, pipeline, y, b12, b11, -1, block_size);
+            try self.multiply(pipeline, alpha, x, op_a, y, op_b, c22, next);
+
+            // C12 = M6 = (S1 - A11) * (B22 - T1)
+            try enqueueCombine(T, pipeline, x, x, a11, -1, block_size);
+            try enqueueCombine(T, pipeline, y, b22, y, -1, block_size);
+            try self.multiply(pipeline, alpha, x, op_a, y, op_b, c12, next);
+
+            // C11 = M3 = (A12 - S2) * B22
+            try enqueueCombine(T, pipeline, x, a12, x, -1, block_size);
+            try self.multiply(pipeline, alpha, x, op_a, b22, op_b, c11, next);
+
+            // X = M1 = A11 * B11
+            try self.multiply(pipeline, alpha, a11, op_a, b11, op_b, x, next);
+
+            // C12 = U2 = M1 + M6, C21 = U3 = U2 + M7, C12 = U4 = U2 + M5, C22 = U3 + M5 and
+            // C12 = U4 + M3
+            try enqueueCombine(T, pipeline, c12, x, c12, 1, block_size);
+            try enqueueCombine(T, pipeline, c21, c12, c21, 1, block_size);
+            try enqueueCombine(T, pipeline, c12, c12, c22, 1, block_size);
+            try enqueueCombine(T, pipeline, c22, c21, c22, 1, block_size);
+            try enqueueCombine(T, pipeline, c12, c12, c11, 1, block_size);
+
+            // C21 = U3 - M4, with M4 = A22 * (T2 - B21)
+            try enqueueCombine(T, pipeline, y, y, b21, -1, block_size);
+            try self.multiply(pipeline, alpha, a22, op_a, y, op_b, c11, next);
+            try enqueueCombine(T, pipeline, c21, c21, c11, -1, block_size);
+
+            // C11 = M1 + M2, with M2 = A12 * B21
+            try self.multiply(pipeline, alpha, a12, op_a, b21, op_b, c11, next);
+            try enqueueCombine(T, pipeline, c11, x, c11, 1, block_size);
+        }
+    };
+}
+
+// A square block of a matrix, its rows are the row pitch of the tensor apart
+fn View(comptime T: type) type {
+    return struct {
+        tensor: *Tensor(T),
+        offset: u64,
+
+        const Self = @This();
+
+        // Block (i, j) of op(view) with `block_size` rows. The blocks of a transposed operand are
+        // read from the opposite corner of its layout.
+        fn quadrant(self: Self, op: Operation, i: u64, j: u64, block_size: u64) Self {
+            const row, const col = if (op.isTransposed()) .{ j, i } else .{ i, j };
+            return .{
+                .tensor = self.tensor,
+                .offset = self.offset + (row * self.tensor.memory_layout.row_pitch + col) * block_size,
+            };
+        }
+    };
+}
+
+fn getCombineKernel(comptime T: type, command_queue: *const CommandQueue) TensorErrors!cl.kernel.Kernel {
+    const kernels_set = try KernelsSet.getKernelSet(command_queue, .StrassenCombine, core.types.SUPPORTED_TYPES.len);
+
+    const kernel_index: usize = @as(usize, core.types.getTypeIndex(T));
+    if (kernels_set.kernels.?[kernel_index]) |v| return v;
+
+    var kernel: cl.kernel.Kernel = undefined;
+    var program: cl.program.Program = undefined;
+
+    try KernelsSet.compileKernel(
+        T,
+        command_queue,
+        .{
+            .vectors_enabled = false,
+            .kernel_name = "strassen_combine",
+        },
+        &kernel,
+        &program,
+        STRASSEN_KERNEL,
+    );
+
+    kernels_set.kernels.?[kernel_index] = kernel;
+    kernels_set.programs.?[kernel_index] = program;
+
+    return kernel;
+}
+
+// `z = x + y_scale * y` for blocks of `block_size` rows, `z` may be `x` or `y`
+fn enqueueCombine(
+    comptime T: type,
+    pipeline: *Pipeline,
+    z: View(T),
+    x: View(T),
+    y: View(T),
+    y_scale: T,
+    block_size: u64,
+) TensorErrors!void {
+    const command_queue = pipeline.command_queue;
+    const kernel = try getCombineKernel(T, command_queue);
+
+    const global_work_items = [2]u64{ block_size, block_size };
+    var padded_global_work_items: [2]u64 = undefined;
+    var local_work_items: [2]u64 = undefined;
+    core.WorkGroupTuner.getLocalWorkItems(
+        command_queue,
+        "strassen_combine",
+        core.types.getTypeIndex(T),
+        &global_work_items,
+        &padded_global_work_items,
+        &local_work_items,
+    );
+
+    z.tensor.markModified();
+
+    const prev_events = pipeline.prevEvents();
+
+    const setArg = cl.kernel.setArg;
+    const cl_mem_size = @sizeOf(cl.buffer.Mem);
+
+    try setArg(kernel, 0, cl_mem_size, @ptrCast(&x.tensor.buffer));
+    try setArg(kernel, 1, cl_mem_size, @ptrCast(&y.tensor.buffer));
+    try setArg(kernel, 2, cl_mem_size, @ptrCast(&z.tensor.buffer));
+
+    try setArg(kernel, 3, @sizeOf(u64), @ptrCast(&x.offset));
+    try setArg(kernel, 4, @sizeOf(u64), @ptrCast(&y.offset));
+    try setArg(kernel, 5, @sizeOf(u64), @ptrCast(&z.offset));
+
+    try setArg(kernel, 6, @sizeOf(u64), @ptrCast(&x.tensor.memory_layout.row_pitch));
+    try setArg(kernel, 7, @sizeOf(u64), @ptrCast(&y.tensor.memory_layout.row_pitch));
+    try setArg(kernel, 8, @sizeOf(u64), @ptrCast(&z.tensor.memory_layout.row_pitch));
+
+    try setArg(kernel, 9, @sizeOf(T), @ptrCast(&y_scale));
+    try setArg(kernel, 10, @sizeOf(u64), @ptrCast(&block_size));
+
+    var new_event: cl.event.Event = undefined;
+    try cl.kernel.enqueueNdRange(
+        command_queue.cl_command_queue,
+        kernel,
+        null,
+        &padded_global_work_items,
+        &local_work_items,
+        prev_events,
+        &new_event,
+    );
+    errdefer tensor_module.helpers.releaseEvent(new_event);
+
+    try pipeline.append(&.{new_event});
+}
+
+// Product of blocks by the unpacked tile kernel. The kernel has no offsets of its own, so the
+// blocks are passed as the second matrix of a batch whose pitches are their offsets: the launch
+// covers a single matrix starting at index 1 of the batch dimension. `layout` is a tensor with the
+// shape of the blocks, its work items are the ones of the launch.
+fn enqueueBlockProduct(
+    comptime T: type,
+    pipeline: *Pipeline,
+    alpha: ?T,
+    a: View(T),
+    op_a: Operation,
+    b: View(T),
+    op_b: Operation,
+    c: View(T),
+    layout: *Tensor(T),
+) TensorErrors!void {
+    const command_queue = pipeline.command_queue;
+    const block_size = gemm_module.getRows(layout.dimensions.shape);
+
+    const vectors_enabled = gemm_module.getLayoutWithoutPacking(T, command_queue, a.tensor, op_a, b.tensor, op_b).vectors_enabled;
+
+    var a_row_pitch: u64 = a.tensor.memory_layout.row_pitch;
+    var b_row_pitch: u64 = b.tensor.memory_layout.row_pitch;
+    var a_offset: u64 = a.offset;
+    var b_offset: u64 = b.offset;
+    var k_size: u64 = block_size;
+    if (vectors_enabled) {
+        // Blocks start at multiples of MIN_BLOCK_SIZE, always on a whole vector
+        const vector_width: u64 = @intCast(command_queue.vector_widths[core.types.getTypeId(T)]);
+        a_row_pitch = a.tensor.memory_layout.row_pitch_for_vectors;
+        b_row_pitch = b.tensor.memory_layout.row_pitch_for_vectors;
+        a_offset /= vector_width;
+        b_offset /= vector_width;
+        k_size /= vector_width;
+    }
+
+    const default_algorithm = layout.work_configuration.gemm_algorithm_per_device[command_queue.wekua_id];
+    const algorithm = gemm_module.getAlgorithm(default_algorithm, k_size);
+
+    const has_alpha = (alpha != null);
+    const kernel = try gemm_module.getGemmKernelWithoutPacking(
+        T,
+        command_queue,
+        vectors_enabled,
+        has_alpha,
+        false,
+        op_a,
+        op_b,
+        algorithm,
+        null,
+        0,
+    );
+
+    var global_work_items: [3]u64 = undefined;
+    var local_work_items: [3]u64 = undefined;
+    gemm_module.getBatchedWorkItems(T, layout, command_queue.wekua_id, algorithm, &global_work_items, &local_work_items);
+    const global_work_offset: [3]u64 = .{ 0, 0, 1 };
+
+    c.tensor.markModified();
+
+    const prev_events = pipeline.prevEvents();
+
+    const setArg = cl.kernel.setArg;
+    const cl_mem_size = @sizeOf(cl.buffer.Mem);
+
+    try setArg(kernel, 0, cl_mem_size, @ptrCast(&a.tensor.buffer));
+    try setArg(kernel, 1, cl_mem_size, @ptrCast(&b.tensor.buffer));
+    try setArg(kernel, 2, cl_mem_size, @ptrCast(&c.tensor.buffer));
+
+    try setArg(kernel, 3, @sizeOf(u64), @ptrCast(&a_row_pitch));
+    try setArg(kernel, 4, @sizeOf(u64), @ptrCast(&b_row_pitch));
+    try setArg(kernel, 5, @sizeOf(u64), @ptrCast(&c.tensor.memory_layout.row_pitch));
+
+    try setArg(kernel, 6, @sizeOf(u64), @ptrCast(&a_offset));
+    try setArg(kernel, 7, @sizeOf(u64), @ptrCast(&b_offset));
+    try setArg(kernel, 8, @sizeOf(u64), @ptrCast(&c.offset));
+
+    try setArg(kernel, 9, @sizeOf(u64), @ptrCast(&k_size));
+
+    if (alpha) |alpha_val| {
+        try setArg(kernel, 10, @sizeOf(T), @ptrCast(&alpha_val));
+    }
+
+    var new_event: cl.event.Event = undefined;
+    try cl.kernel.enqueueNdRange(
+        command_queue.cl_command_queue,
+        kernel,
+        &global_work_offset,
+        &global_work_items,
+        &local_work_items,
+        prev_events,
+        &new_event,
+    );
+    errdefer tensor_module.helpers.releaseEvent(new_event);
+
+    try pipeline.append(&.{new_event});
+}
+
+/// `c = alpha * op_a(a) * op_b(b) + beta * c` like `gemm`, computed with Strassen-Winograd
+/// recursion for square matrices of the size `workspace` was created for: 7 products of half the
+/// size per level instead of 8, down to the cutoff of the workspace, where the tile kernels take
+/// over. Any other product is computed by `gemm` itself.
+///
+/// The sums of the recursion round differently than the tile kernels do, the error grows with the
+/// number of levels.
+pub fn gemm(
+    comptime T: type,
+    pipeline: *Pipeline,
+    alpha: ?T,
+    a: *Tensor(T),
+    op_a: Operation,
+    b: *Tensor(T),
+    op_b: Operation,
+    beta: ?T,
+    c: *Tensor(T),
+    workspace: *Workspace(T),
+) TensorErrors!void {
+    try gemm_module.validateTensors(T, T, a, b, c, op_a, op_b);
+    if (!workspace.fits(a, op_a, b, c)) {
+        return gemm_module.gemm(T, pipeline, alpha, a, op_a, b, op_b, beta, c, null);
+    }
+
+    const a_view: View(T) = .{ .tensor = a, .offset = 0 };
+    const b_view: View(T) = .{ .tensor = b, .offset = 0 };
+    const c_view: View(T) = .{ .tensor = c, .offset = 0 };
+
+    if (beta) |beta_val| {
+        const product = try workspace.getProduct(pipeline, c);
+        const product_view: View(T) = .{ .tensor = product, .offset = 0 };
+
+        try workspace.multiply(pipeline, alpha, a_view, op_a, b_view, op_b, product_view, 0);
+        try enqueueCombine(T, pipeline, c_view, product_view, c_view, beta_val, workspace.size);
+    } else {
+        try workspace.multiply(pipeline, alpha, a_view, op_a, b_view, op_b, c_view, 0);
+    }
+}
+
+fn measureProducts(
+    comptime T: type,
+    pipeline: *Pipeline,
+    a: *Tensor(T),
+    b: *Tensor(T),
+    c: *Tensor(T),
+    workspace: ?*Workspace(T),
+    iterations: usize,
+) TensorErrors!u64 {
+    var timer: std.time.Timer = undefined;
+
+    // The first run is a warm up, it also compiles the kernels
+    for (0..(iterations + 1)) |i| {
+        if (i == 1) {
+            pipeline.waitAndCleanup();
+            timer = std.time.Timer.start() catch unreachable;
+        }
+
+        if (workspace) |v| {
+            try gemm(T, pipeline, null, a, .no_transpose, b, .no_transpose, null, c, v);
+        } else {
+            try gemm_module.gemm(T, pipeline, null, a, .no_transpose, b, .no_transpose, null, c, null);
+        }
+    }
+    pipeline.waitAndCleanup();
+
+    return timer.read();
+}
+
+/// Finds the smallest size in `CUTOFF_CANDIDATES` whose products are faster with one level of
+/// Strassen-Winograd recursion than with the tile kernels alone, and records it as the cutoff of
+/// the type for `Workspace.init` on the device of the pipeline. When none of them is, the
+/// recursion is disabled for the type. The cutoff lives in the tuning table of the command queue
+/// and is persisted with `core.WorkGroupTuner.save`/`load`.
+///
+/// Allocates matrices of the largest candidate size and blocks until the measurements are done.
+pub fn tune(comptime T: type, pipeline: *Pipeline, iterations: usize) TensorErrors!void {
+    if (iterations == 0) return tensor_module.Errors.InvalidValue;
+
+    const command_queue = pipeline.command_queue;
+    const context = command_queue.context;
+
+    var cutoff: u64 = std.math.maxInt(u64);
+    for (CUTOFF_CANDIDATES) |size| {
+        const a = try Tensor(T).alloc(context, pipeline, &.{ size, size }, .{});
+        defer a.release(pipeline);
+
+        const b = try Tensor(T).alloc(context, pipeline, &.{ size, size }, .{});
+        defer b.release(pipeline);
+
+        const c = try Tensor(T).alloc(context, pipeline, &.{ size, size }, .{});
+        defer c.release(pipeline);
+
+        const workspace = try Workspace(T).initWithCutoff(pipeline, c, size);
+        defer workspace.deinit(pipeline);
+
+        const tiles_time = try measureProducts(T, pipeline, a, b, c, null, iterations);
+        const strassen_time = try measureProducts(T, pipeline, a, b, c, workspace, iterations);
+        if (strassen_time < tiles_time) {
+            cutoff = size;
+            break;
+        }
+    }
+
+    var key_buf: [32]u8 = undefined;
+    try core.WorkGroupTuner.putByKey(command_queue, writeTuningKey(&key_buf, T), .{ cutoff, 1, 1 });
+}
+
+// -----------------------------------------------------------------------------
+// Unit Tests
+const testing = std.testing;
+
+const memory = tensor_module.memory;
+
+test "strassen - levels of recursion" {
+    try testing.expectEqual(0, countLevels(1024, DEFAULT_CUTOFF));
+    try testing.expectEqual(1, countLevels(2048, DEFAULT_CUTOFF));
+    try testing.expectEqual(2, countLevels(256, 128));
+
+    // Halves must be whole blocks
+    try testing.expectEqual(0, countLevels(1000, 128));
+    try testing.expectEqual(1, countLevels(384, 128));
+
+    try testing.expectEqual(MAX_LEVELS, countLevels(1 << 16, 128));
+}
+
+fn testProduct(
+    comptime T: type,
+    pipeline: *Pipeline,
+    size: u64,
+    cutoff: u64,
+    alpha: ?T,
+    op_a: Operation,
+    op_b: Operation,
+    beta: ?T,
+) !void {
+    const allocator = testing.allocator;
+    const context = pipeline.command_queue.context;
+
+    const a = try Tensor(T).alloc(context, pipeline, &.{ size, size }, .{});
+    defer a.release(pipeline);
+
+    const b = try Tensor(T).alloc(context, pipeline, &.{ size, size }, .{});
+    defer b.release(pipeline);
+
+    const c = try Tensor(T).alloc(context, pipeline, &.{ size, size }, .{});
+    defer c.release(pipeline);
+
+    // Small integers, so every sum and product is exact
+    const a_values = try allocator.alloc(T, size * size);
+    defer allocator.free(a_values);
+    for (a_values, 0..) |*v, i| v.* = @as(T, @floatFromInt(i % 5)) - 2;
+
+    const b_values = try allocator.alloc(T, size * size);
+    defer allocator.free(b_values);
+    for (b_values, 0..) |*v, i| v.* = @as(T, @floatFromInt((i * 7) % 3)) - 1;
+
+    const c_values = try allocator.alloc(T, size * size);
+    defer allocator.free(c_values);
+    for (c_values, 0..) |*v, i| v.* = @floatFromInt(i % 4);
+
+    try memory.readFromBuffer(T, pipeline, a, a_values);
+    try memory.readFromBuffer(T, pipeline, b, b_values);
+    try memory.readFromBuffer(T, pipeline, c, c_values);
+
+    const workspace = try Workspace(T).initWithCutoff(pipeline, c, cutoff);
+    defer workspace.deinit(pipeline);
+
+    try gemm(T, pipeline, alpha, a, op_a, b, op_b, beta, c, workspace);
+
+    const result = try allocator.alloc(T, size * size);
+    defer allocator.free(result);
+
+    try memory.writeToBuffer(T, pipeline, c, result);
+    pipeline.waitAndCleanup();
+
+    for (0..size) |i| {
+        for (0..size) |j| {
+            var acc: T = 0;
+            for (0..size) |k| {
+                const a_val = if (op_a.isTransposed()) a_values[k * size + i] else a_values[i * size + k];
+                const b_val = if (op_b.isTransposed()) b_values[j * size + k] else b_values[k * size + j];
+                acc += a_val * b_val;
+            }
+
+            var expected = (alpha orelse 1) * acc;
+            if (beta) |beta_val| expected += beta_val * c_values[i * size + j];
+
+            try testing.expectEqual(expected, result[i * size + j]);
+        }
+    }
+}
+
+test "strassen - products of square matrices" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    // Two levels, the tile kernels multiply blocks of 64 rows
+    try testProduct(f32, pipeline, 256, 128, null, .no_transpose, .no_transpose, null);
+    try testProduct(f32, pipeline, 256, 128, 2, .transpose, .no_transpose, null);
+    try testProduct(f32, pipeline, 256, 128, null, .no_transpose, .transpose, 3);
+    try testProduct(f32, pipeline, 256, 128, -1, .transpose, .transpose, 0.5);
+
+    // No levels, computed by gemm
+    try testProduct(f32, pipeline, 100, 128, 2, .no_transpose, .no_transpose, -1);
+
+    if (command_queue.isTypeSupported(f64)) {
+        try testProduct(f64, pipeline, 256, 128, 2, .no_transpose, .transpose, -1);
+    }
+}
@@ -4,6 +4,7 @@ const cl = @import("opencl");
 const types = @import("types.zig");
 const Context = @import("context.zig");
 const KernelsSet = @import("kernel.zig");
+const WorkGroupTuner = @import("work_group_tuner.zig");
 
 pub const Errors = cl.errors.OpenCLError || error{OutOfMemory};
 
@@ -16,6 +17,8 @@ device_vendor_id: u32,
 device_type: cl.device.Type,
 
 kernels: [KernelsSet.TOTAL_NUMBER_OF_KERNELS]KernelsSet,
+custom_kernels: std.StringHashMapUnmanaged(KernelsSet.CustomKernel),
+work_group_tuner: WorkGroupTuner,
 headers: KernelsSet,
 
 local_mem_type: cl.device.LocalMemType,
@@ -153,6 +156,8 @@ pub fn init(
     for (&self.kernels) |*k| {
         k.* = .{};
     }
+    self.custom_kernels = .empty;
+    self.work_group_tuner = .empty;
 
     try self.get_device_info(allocator, device);
 }
@@ -204,6 +209,15 @@ pub fn deinit(self: *CommandQueue) void {
         }
     }
 
+    var custom_kernels_iterator = self.custom_kernels.iterator();
+    while (custom_kernels_iterator.next()) |entry| {
+        cl.kernel.release(entry.value_ptr.kernel);
+        cl.program.release(entry.value_ptr.program);
+        allocator.free(entry.key_ptr.*);
+    }
+    self.custom_kernels.deinit(allocator);
+    self.work_group_tuner.deinit(allocator);
+
     for (self.headers.programs.?) |program| {
         if (program) |v| cl.program.release(v);
     }
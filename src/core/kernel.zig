@@ -10,21 +10,36 @@ pub const Errors = error{TypeNotSupported} || cl.errors.OpenCLError || std.mem.A
 
 pub const KernelsID = enum(u16) {
     Fill,
+    FillBlock,
     RandomUniform,
     RandRange,
     Transpose,
+    TransposeInPlace,
     ToComplex,
     ToReal,
+    ToStorage,
+    FromStorage,
+    ChangeDtype,
     AXPY,
     Identity,
+    Gather,
+    Scatter,
     PackGEMMTiles,
+    PackGEMMStorageTiles,
     GEMM,
     GEMMPack,
+    GEMMEpilogue,
+    GEMMPackEpilogue,
+    GEMV,
+    GEMMSplitKReduce,
+    QuantizedGEMM,
+    StrassenCombine,
 
     // --- Math kernels ---
     // Basic
     Dot,
     Sum,
+    Binary,
 
     // Trigonometric
     Sin,
@@ -34,13 +49,17 @@ pub const KernelsID = enum(u16) {
     Cosh,
     Tanh,
 
+    // Planar complex
+    PlanarMul,
+    PlanarSin,
+    PlanarCos,
+
     // --- Activation kernels ---
     Sigmoid,
     SigmoidDev,
     TanhDev,
 
     // --- Layer kernels ---
-    LinearBias,
     LinearBiasStep,
 
     // --- Loss kernels ---
@@ -297,6 +316,39 @@ pub fn getKernelSet(
     return kernels_set;
 }
 
+pub const CustomKernel = struct {
+    kernel: cl.kernel.Kernel,
+    program: cl.program.Program,
+};
+
+/// Kernels generated at runtime (e.g. fused expressions) can't be indexed by `KernelsID`, so
+/// they are cached per command queue by a signature that fully describes the generated source.
+pub fn getCustomKernel(
+    command_queue: *const CommandQueue,
+    signature: []const u8,
+) ?cl.kernel.Kernel {
+    const custom_kernel = command_queue.custom_kernels.get(signature) orelse return null;
+    return custom_kernel.kernel;
+}
+
+pub fn putCustomKernel(
+    command_queue: *const CommandQueue,
+    signature: []const u8,
+    kernel: cl.kernel.Kernel,
+    program: cl.program.Program,
+) Errors!void {
+    const allocator = command_queue.context.allocator;
+    const custom_kernels = &@constCast(command_queue).custom_kernels;
+
+    const key = try allocator.dupe(u8, signature);
+    errdefer allocator.free(key);
+
+    try custom_kernels.putNoClobber(allocator, key, .{
+        .kernel = kernel,
+        .program = program,
+    });
+}
+
 pub fn createAndGetKernel(
     comptime T: type,
     command_queue: *const CommandQueue,
@@ -333,6 +385,13 @@ pub fn createAndGetKernel(
     return kernel;
 }
 
+/// Index of the build of `T` that `getClKernel` returns, also the variant to give to the
+/// work-group tuner when launching it.
+pub fn getClKernelIndex(comptime T: type, vectors_enabled: bool) usize {
+    return (@intFromBool(vectors_enabled) * core.types.SUPPORTED_TYPES.len +
+        @as(usize, core.types.getTypeIndex(T)));
+}
+
 pub fn getClKernel(
     comptime T: type,
     command_queue: *const CommandQueue,
@@ -342,8 +401,7 @@ pub fn getClKernel(
     kernel_source: []const u8,
     extra_args: ?[]const u8,
 ) Errors!cl.kernel.Kernel {
-    const kernel_index = (@intFromBool(vectors_enabled) * core.types.SUPPORTED_TYPES.len +
-        @as(usize, core.types.getTypeIndex(T)));
+    const kernel_index = getClKernelIndex(T, vectors_enabled);
 
     return createAndGetKernel(
         T,
@@ -2,6 +2,7 @@ pub const Context = @import("context.zig");
 pub const CommandQueue = @import("command_queue.zig");
 pub const KernelsSet = @import("kernel.zig");
 pub const Pipeline = @import("pipeline.zig");
+pub const WorkGroupTuner = @import("work_group_tuner.zig");
 
 pub const types = @import("types.zig");
 
@@ -1,3 +1,5 @@
+const std = @import("std");
+
 pub const Space = enum(u8) {
     real,
     imag,
@@ -21,6 +23,25 @@ pub const ComplexU64 = Complex(u64);
 pub const ComplexF32 = Complex(f32);
 pub const ComplexF64 = Complex(f64);
 
+/// Brain floating point: the 16 most significant bits of an f32. Stored as raw bits, kernels
+/// convert it to f32 to operate on it.
+pub const BF16 = packed struct(u16) {
+    bits: u16,
+
+    /// Rounds to the nearest value, ties to even
+    pub fn fromF32(value: f32) BF16 {
+        const bits: u32 = @bitCast(value);
+        if (std.math.isNan(value)) return .{ .bits = @intCast((bits >> 16) | 0x40) };
+
+        const rounding: u32 = 0x7fff + ((bits >> 16) & 1);
+        return .{ .bits = @intCast((bits +% rounding) >> 16) };
+    }
+
+    pub fn toF32(self: BF16) f32 {
+        return @bitCast(@as(u32, self.bits) << 16);
+    }
+};
+
 pub inline fn getComplexOne(comptime T: type) T {
     return T{ .real = 1, .imag = 0 };
 }
@@ -57,6 +78,31 @@ pub const SUPPORTED_TYPES: [20]type = .{
     ComplexF64,
 };
 
+/// Reduced precision floats used only to store tensors. They have no kernels of their own: they
+/// are filled and copied as 16 bits words, converted from and to f32 with
+/// `tensor.convertions.toStorage`/`fromStorage`, and fused expressions load them as f32.
+pub const STORAGE_TYPES: [2]type = .{
+    f16,
+    BF16,
+};
+
+pub fn isStorageType(comptime T: type) bool {
+    return (T == f16 or T == BF16);
+}
+
+pub fn getStorageTypeIndex(comptime T: type) comptime_int {
+    return switch (T) {
+        f16 => 0,
+        BF16 => 1,
+        else => @compileError("Type is not a storage type"),
+    };
+}
+
+/// Type in which the values of `T` are computed
+pub fn getComputeType(comptime T: type) type {
+    return if (isStorageType(T)) f32 else T;
+}
+
 pub fn getTypeIndex(comptime T: type) comptime_int {
     // NOTE: This is for avoiding @setEvalBranchQuota
     return switch (T) {
@@ -92,7 +138,8 @@ pub fn getTypeId(comptime T: type) comptime_int {
         i8, ComplexI8 => 0,
         u8, ComplexU8 => 1,
         i16, ComplexI16 => 2,
-        u16, ComplexU16 => 3,
+        // Storage types are moved as 16 bits words
+        u16, ComplexU16, f16, BF16 => 3,
         i32, ComplexI32 => 4,
         u32, ComplexU32 => 5,
         i64, ComplexI64 => 6,
@@ -111,5 +158,21 @@ pub fn isComplex(comptime T: type) bool {
 }
 
 pub fn getType(comptime T: type) type {
+    if (isStorageType(T)) return T;
     return SUPPORTED_TYPES[getTypeId(T)];
 }
+
+// Unit Tests
+const testing = std.testing;
+
+test "BF16 - conversion from and to f32" {
+    const exact = [_]f32{ 0, 1, -2, 0.5, 0x1p100, -std.math.inf(f32) };
+    for (exact) |v| {
+        try testing.expectEqual(v, BF16.fromF32(v).toF32());
+    }
+
+    // 1 + 2^-8 is halfway between 1 and 1 + 2^-7, ties go to the even one
+    try testing.expectEqual(@as(f32, 1), BF16.fromF32(1 + 0x1p-8).toF32());
+    try testing.expectEqual(@as(f32, 1 + 0x1p-7), BF16.fromF32(1 + 0x1p-8 + 0x1p-10).toF32());
+    try testing.expect(std.math.isNan(BF16.fromF32(std.math.nan(f32)).toF32()));
+}
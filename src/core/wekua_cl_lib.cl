@@ -12,6 +12,10 @@
  * WK_VECTOR_WIDTH - Vector width (1, 2, 4, 8, 16), determines SIMD operations
  * WK_COMPLEX      - Complex number flag (0 or 1), enables complex arithmetic
  * WK_DTYPE_ID     - Type family identifier (0-9), groups scalar/complex pairs
+ * WK_STORAGE_TYPE - Optional storage type (0: f16, 1: bf16) of kernels that load or store
+ *                   reduced precision tensors, see STORAGE TYPES below
+ * WK_GEMM_EPILOGUE - Optional bias and activation applied by the GEMM kernels, see
+ *                   GEMM EPILOGUE below
  *
  * TYPE DEFINITIONS
  * ----------------
@@ -21,6 +25,7 @@
  * uwks            - Unsigned work scalar (for integer types)
  * wk              - Work vector type (matches WK_VECTOR_WIDTH)
  * wk2, wk4, wk8   - Fixed-width vector types (when supported by WK_VECTOR_WIDTH)
+ * st              - Element type of storage tensors (half or ushort, with WK_STORAGE_TYPE)
  *
  * MACROS
  * ------
@@ -28,8 +33,14 @@
  * WK_UINT_MAX     - Maximum value for unsigned integer types
  * WKS_IS_UNSIGNED - Flag (0 or 1) indicating if wks is unsigned
  * convert_T       - Type conversion macro with saturation and rounding
+ * convert_wk      - convert_T for the vector type wk (real types only)
  * COMPLEX_MUL_K   - Declares temporaries for complex multiplication
  * COMPLEX_MUL     - Performs complex multiplication using Karatsuba algorithm
+ * COMPLEX_CONJ    - Complex conjugate of a complex number
+ * GEMM_LOAD_A/B   - Loads an element of a GEMM operand, conjugating it with A_CONJ/B_CONJ
+ * load_storage    - Loads an element of a storage type tensor as float
+ * store_storage   - Stores a float in a storage type tensor
+ * GEMM_STORE      - Stores an element of C, applying the GEMM epilogue with WK_GEMM_EPILOGUE
  *
  * WK_DTYPE MAPPING
  * ----------------
@@ -55,6 +66,19 @@
  * =============================================================================
  */
 
+#define WK_CONCAT_(a, b, c, d) a##b##c##d
+#define WK_CONCAT(a, b, c, d) WK_CONCAT_(a, b, c, d)
+
+/**
+ * WK_VECTOR_CONVERT - Name of the conversion builtin to type##WK_VECTOR_WIDTH with the
+ * given saturation and rounding suffix (e.g. convert_char4_sat_rte)
+ */
+#if WK_VECTOR_WIDTH == 1
+#define WK_VECTOR_CONVERT(type, mode) convert_##type##mode
+#else
+#define WK_VECTOR_CONVERT(type, mode) WK_CONCAT(convert_, type, WK_VECTOR_WIDTH, mode)
+#endif
+
 #if WK_DTYPE == 0
 
 #define WK_INT_MAX CHAR_MAX
@@ -91,6 +115,7 @@ typedef char16 wk;
 #endif
 
 #define convert_T convert_char_sat_rte
+#define convert_wk WK_VECTOR_CONVERT(char, _sat_rte)
 
 #elif WK_DTYPE == 1
 
@@ -128,6 +153,7 @@ typedef uchar16 wk;
 #endif
 
 #define convert_T convert_uchar_sat_rte
+#define convert_wk WK_VECTOR_CONVERT(uchar, _sat_rte)
 
 #elif WK_DTYPE == 2
 
@@ -165,6 +191,7 @@ typedef short16 wk;
 #endif
 
 #define convert_T convert_short_sat_rte
+#define convert_wk WK_VECTOR_CONVERT(short, _sat_rte)
 
 #elif WK_DTYPE == 3
 
@@ -202,6 +229,7 @@ typedef ushort16 wk;
 #endif
 
 #define convert_T convert_ushort_sat_rte
+#define convert_wk WK_VECTOR_CONVERT(ushort, _sat_rte)
 
 #elif WK_DTYPE == 4
 
@@ -239,6 +267,7 @@ typedef int16 wk;
 #endif
 
 #define convert_T convert_int_sat_rte
+#define convert_wk WK_VECTOR_CONVERT(int, _sat_rte)
 
 #elif WK_DTYPE == 5
 
@@ -276,6 +305,7 @@ typedef uint16 wk;
 #endif
 
 #define convert_T convert_uint_sat_rte
+#define convert_wk WK_VECTOR_CONVERT(uint, _sat_rte)
 
 #elif WK_DTYPE == 6
 
@@ -313,6 +343,7 @@ typedef long16 wk;
 #endif
 
 #define convert_T convert_long_sat_rte
+#define convert_wk WK_VECTOR_CONVERT(long, _sat_rte)
 
 #elif WK_DTYPE == 7
 
@@ -350,6 +381,7 @@ typedef ulong16 wk;
 #endif
 
 #define convert_T convert_ulong_sat_rte
+#define convert_wk WK_VECTOR_CONVERT(ulong, _sat_rte)
 
 #elif WK_DTYPE == 8
 
@@ -381,6 +413,7 @@ typedef float16 wk;
 #endif
 
 #define convert_T convert_float
+#define convert_wk WK_VECTOR_CONVERT(float, )
 
 #elif WK_DTYPE == 9
 
@@ -412,6 +445,7 @@ typedef double16 wk;
 #endif
 
 #define convert_T convert_double
+#define convert_wk WK_VECTOR_CONVERT(double, )
 
 #elif WK_DTYPE == 10
 
@@ -652,6 +686,12 @@ inline wks sum(wk a) {
 	res.real = k1 - k3; \
 	res.imag = k1 + k2;
 
+/**
+ * COMPLEX_CONJ - Complex conjugate of a complex number
+ * @a: Complex number (has .real and .imag fields)
+ */
+#define COMPLEX_CONJ(a) ((wks){ (a).real, -(a).imag })
+
 #endif
 
 /* #define COMPLEX_S_MUL_K(T) \ */
@@ -663,3 +703,155 @@ inline wks sum(wk a) {
 /* 	k3_s = b*(c + d); \ */
 /* 	a = k1_s - k3_s; \ */
 /* 	b = k1_s + k2_s; \ */
+
+
+/**
+ * =============================================================================
+ * STORAGE TYPES
+ * =============================================================================
+ *
+ * f16 and bf16 tensors are only used to store data, kernels work with them in
+ * float. f16 goes through vload_half/vstore_half, which don't need cl_khr_fp16.
+ * bf16 is kept as the upper 16 bits of a float in an ushort.
+ */
+
+/**
+ * bf16_to_float - Widens a bf16 value, exact
+ */
+inline float bf16_to_float(const ushort x) {
+    return as_float(((uint)x) << 16);
+}
+
+/**
+ * float_to_bf16 - Rounds a float to bf16, to the nearest value with ties to even
+ */
+inline ushort float_to_bf16(const float x) {
+    const uint bits = as_uint(x);
+    if (isnan(x)) return (ushort)((bits >> 16) | 0x40);
+
+    return (ushort)((bits + 0x7fff + ((bits >> 16) & 1)) >> 16);
+}
+
+#ifdef WK_STORAGE_TYPE
+
+#if WK_STORAGE_TYPE == 0
+
+typedef half st;
+
+#define load_storage(p, i) vload_half(i, p)
+#define store_storage(p, i, v) vstore_half_rte(v, i, p)
+
+#else
+
+typedef ushort st;
+
+#define load_storage(p, i) bf16_to_float((p)[i])
+#define store_storage(p, i, v) (p)[i] = float_to_bf16(v)
+
+#endif
+
+#endif
+
+/**
+ * =============================================================================
+ * GEMM OPERANDS
+ * =============================================================================
+ *
+ * The unpacked GEMM kernels read their operands through GEMM_LOAD_A and
+ * GEMM_LOAD_B. With A_CONJ / B_CONJ set, complex operands are conjugated as
+ * they are loaded, so conj(X) and X^H need no pass of their own.
+ */
+
+#if WK_COMPLEX && A_CONJ
+#define GEMM_LOAD_A(x) COMPLEX_CONJ(x)
+#else
+#define GEMM_LOAD_A(x) (x)
+#endif
+
+#if WK_COMPLEX && B_CONJ
+#define GEMM_LOAD_B(x) COMPLEX_CONJ(x)
+#else
+#define GEMM_LOAD_B(x) (x)
+#endif
+
+/**
+ * =============================================================================
+ * GEMM EPILOGUE
+ * =============================================================================
+ *
+ * With WK_GEMM_EPILOGUE the GEMM kernels finish every value of C in registers,
+ * before its only store, saving the passes of separate bias and activation
+ * kernels:
+ * WK_GEMM_BIAS        - 1: adds bias[col], a row broadcast over every row of C
+ * WK_GEMM_ACTIVATION  - 0: none, 1: sigmoid, 2: tanh, 3: relu
+ * WK_GEMM_DERIVATIVE  - 1: also writes the derivative of the activation, computed
+ *                       from its output as the activation layers do
+ * Only elements inside the C_rows x C_cols matrix are touched, the padding keeps
+ * the value of the product. Real types only.
+ *
+ * The kernels store every element of C with GEMM_STORE, which is a plain store
+ * without WK_GEMM_EPILOGUE.
+ */
+
+#ifdef WK_GEMM_EPILOGUE
+
+// Value of C at (row, col), stored at `index`, once the epilogue is applied to `value`
+inline wks gemm_epilogue(
+    wks value,
+    __global wks *const derivative,
+    __global const wks *const bias,
+    const ulong index,
+    const ulong row, const ulong col,
+    const ulong C_rows, const ulong C_cols
+) {
+    if (row >= C_rows || col >= C_cols) return value;
+
+#if WK_GEMM_BIAS
+    value += bias[col];
+#endif
+
+#if WK_GEMM_ACTIVATION == 1
+    value = (wks)1 / ((wks)1 + exp(-value));
+#elif WK_GEMM_ACTIVATION == 2
+    value = tanh(value);
+#elif WK_GEMM_ACTIVATION == 3
+    value = (value > (wks)0) ? value : (wks)0;
+#endif
+
+#if WK_GEMM_DERIVATIVE
+#if WK_GEMM_ACTIVATION == 1
+    derivative[index] = value * ((wks)1 - value);
+#elif WK_GEMM_ACTIVATION == 2
+    derivative[index] = (wks)1 - value*value;
+#elif WK_GEMM_ACTIVATION == 3
+    derivative[index] = (value > (wks)0) ? (wks)1 : (wks)0;
+#else
+    derivative[index] = (wks)1;
+#endif
+#endif
+
+    return value;
+}
+
+#if WK_GEMM_BIAS
+#define WK_GEMM_BIAS_PTR bias
+#else
+#define WK_GEMM_BIAS_PTR 0
+#endif
+
+#if WK_GEMM_DERIVATIVE
+#define WK_GEMM_DERIVATIVE_PTR (derivatives + batch*C_batch_pitch)
+#else
+#define WK_GEMM_DERIVATIVE_PTR 0
+#endif
+
+// Stores `value` at `index` of C, the element at (row, col). The names are the ones of the
+// arguments of the GEMM kernels
+#define GEMM_STORE(index, row, col, value) \
+    C[index] = gemm_epilogue(value, WK_GEMM_DERIVATIVE_PTR, WK_GEMM_BIAS_PTR, index, row, col, C_rows, C_cols)
+
+#else
+
+#define GEMM_STORE(index, row, col, value) C[index] = (value)
+
+#endif
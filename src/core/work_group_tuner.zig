@@ -0,0 +1,365 @@
+const std = @import("std");
+const cl = @import("opencl");
+
+const utils = @import("utils");
+
+const CommandQueue = @import("command_queue.zig");
+const KernelsSet = @import("kernel.zig");
+
+pub const Errors = KernelsSet.Errors || std.fs.File.OpenError || std.fs.File.ReadError ||
+    std.fs.File.WriteError || error{ FileTooBig, StreamTooLong, InvalidValue, InvalidTuningTable };
+
+pub const MAX_DIMENSIONS = 3;
+
+pub const Entry = [MAX_DIMENSIONS]u64;
+
+/// Local work sizes measured for (kernel, variant, shape class) triples on one device.
+///
+/// The variant tells apart the builds of a kernel (type, vectors, compile-time options, see
+/// `getLocalWorkItems`), every one of them has its own work-group limits. The shape class of a launch is the ceil(log2) of every global size, so a single measurement
+/// covers every batch size of the same order of magnitude. Kernels that use the tuner must be
+/// launched with padded global sizes and guard against out of range work items (see
+/// `utils.calculatePaddedWorkItems`); when a class has not been tuned, that heuristic is used.
+entries: std.StringHashMapUnmanaged(Entry),
+
+const WorkGroupTuner = @This();
+
+pub const empty: WorkGroupTuner = .{ .entries = .empty };
+
+pub fn deinit(self: *WorkGroupTuner, allocator: std.mem.Allocator) void {
+    var iterator = self.entries.keyIterator();
+    while (iterator.next()) |key| {
+        allocator.free(key.*);
+    }
+    self.entries.deinit(allocator);
+}
+
+fn writeKey(
+    buf: []u8,
+    kernel_name: []const u8,
+    variant: u64,
+    global_work_items: []const u64,
+) error{NoSpaceLeft}![]const u8 {
+    var stream = std.io.fixedBufferStream(buf);
+    const writer = stream.writer();
+
+    try writer.print("{s}/{d}", .{ kernel_name, variant });
+    for (global_work_items) |g| {
+        try writer.print("/{d}", .{std.math.log2_int_ceil(u64, @max(g, 1))});
+    }
+
+    return stream.getWritten();
+}
+
+/// Fills `local_work_items` and `padded_global_work_items` for a launch of `kernel_name`.
+/// `variant` identifies the build of the kernel being launched (e.g. its index in the kernel set),
+/// a size tuned for one build may exceed the work-group limit of another one, so they are never
+/// shared between variants.
+pub fn getLocalWorkItems(
+    command_queue: *const CommandQueue,
+    kernel_name: []const u8,
+    variant: u64,
+    global_work_items: []const u64,
+    padded_global_work_items: []u64,
+    local_work_items: []u64,
+) void {
+    var key_buf: [256]u8 = undefined;
+    const key = writeKey(&key_buf, kernel_name, variant, global_work_items) catch null;
+
+    if (key) |k| {
+        if (command_queue.work_group_tuner.entries.get(k)) |entry| {
+            for (global_work_items, entry[0..global_work_items.len], local_work_items, padded_global_work_items) |g, e, *l, *p| {
+                l.* = @min(e, g);
+                p.* = (std.math.divCeil(u64, g, l.*) catch unreachable) * l.*;
+            }
+            return;
+        }
+    }
+
+    utils.calculatePaddedWorkItems(
+        global_work_items,
+        padded_global_work_items,
+        local_work_items,
+        command_queue.max_work_group_size,
+    );
+}
+
+fn measure(
+    command_queue: *const CommandQueue,
+    kernel: cl.kernel.Kernel,
+    padded_global_work_items: []const u64,
+    local_work_items: []const u64,
+    iterations: usize,
+) Errors!u64 {
+    const cmd = command_queue.cl_command_queue;
+
+    // Warm up, this also makes sure that nothing else is queued before timing
+    try cl.kernel.enqueueNdRange(cmd, kernel, null, padded_global_work_items, local_work_items, null, null);
+    try cl.command_queue.finish(cmd);
+
+    var timer = std.time.Timer.start() catch unreachable;
+    for (0..iterations) |_| {
+        try cl.kernel.enqueueNdRange(cmd, kernel, null, padded_global_work_items, local_work_items, null, null);
+    }
+    try cl.command_queue.finish(cmd);
+
+    return timer.read();
+}
+
+/// Benchmarks candidate local sizes for `kernel` (its arguments must be already set, and running
+/// it several times must be harmless) and stores the fastest one for `variant` (the one
+/// `getLocalWorkItems` is given for the same build) and the shape class of `global_work_items`.
+/// Blocks until the measurements are done.
+pub fn tune(
+    command_queue: *const CommandQueue,
+    kernel: cl.kernel.Kernel,
+    kernel_name: []const u8,
+    variant: u64,
+    global_work_items: []const u64,
+    iterations: usize,
+) Errors!void {
+    const ndim = global_work_items.len;
+    if (ndim == 0 or ndim > MAX_DIMENSIONS) return error.InvalidValue;
+
+    const max_work_group_size = command_queue.max_work_group_size;
+
+    var padded: [MAX_DIMENSIONS]u64 = undefined;
+    var local: [MAX_DIMENSIONS]u64 = undefined;
+
+    // The heuristic is the baseline, a candidate must beat it
+    utils.calculatePaddedWorkItems(global_work_items, padded[0..ndim], local[0..ndim], max_work_group_size);
+    var best_local: Entry = .{ 1, 1, 1 };
+    @memcpy(best_local[0..ndim], local[0..ndim]);
+    var best_time = try measure(command_queue, kernel, padded[0..ndim], local[0..ndim], iterations);
+
+    // Every combination of powers of two that fits in the work group
+    var exponents = [_]u6{0} ** MAX_DIMENSIONS;
+    outer: while (true) {
+        var size: u64 = 1;
+        var useful = true;
+        for (global_work_items, exponents[0..ndim], local[0..ndim], padded[0..ndim]) |g, e, *l, *p| {
+            l.* = @as(u64, 1) << e;
+            // Don't try local sizes that are mostly padding
+            if (l.* > 1 and l.* / 2 >= g) useful = false;
+            p.* = (std.math.divCeil(u64, g, l.*) catch unreachable) * l.*;
+            size *= l.*;
+        }
+
+        if (useful and size <= max_work_group_size) {
+            // Some devices have per dimension or kernel specific limits, those candidates are
+            // just skipped
+            const time: ?u64 = measure(command_queue, kernel, padded[0..ndim], local[0..ndim], iterations) catch null;
+
+            if (time) |t| {
+                if (t < best_time) {
+                    best_time = t;
+                    @memcpy(best_local[0..ndim], local[0..ndim]);
+                }
+            }
+        }
+
+        // Next combination
+        var d: usize = 0;
+        while (d < ndim) : (d += 1) {
+            exponents[d] += 1;
+            if ((@as(u64, 1) << exponents[d]) <= max_work_group_size) continue :outer;
+            exponents[d] = 0;
+        }
+        break;
+    }
+
+    try put(command_queue, kernel_name, variant, global_work_items, best_local);
+}
+
+fn put(
+    command_queue: *const CommandQueue,
+    kernel_name: []const u8,
+    variant: u64,
+    global_work_items: []const u64,
+    local_work_items: Entry,
+) Errors!void {
+    var key_buf: [256]u8 = undefined;
+    const key = writeKey(&key_buf, kernel_name, variant, global_work_items) catch return error.InvalidValue;
+    try putByKey(command_queue, key, local_work_items);
+}
+
+/// Raw access to the table. Other tuners (e.g. the GEMM algorithm selection in `blas`) keep their
+/// decisions here under their own key prefix so they are saved and loaded with the rest. Values
+/// must be non-zero.
+pub fn getByKey(command_queue: *const CommandQueue, key: []const u8) ?Entry {
+    return command_queue.work_group_tuner.entries.get(key);
+}
+
+pub fn putByKey(command_queue: *const CommandQueue, key: []const u8, local_work_items: Entry) error{OutOfMemory}!void {
+    const allocator = command_queue.context.allocator;
+    const entries = &@constCast(command_queue).work_group_tuner.entries;
+
+    const result = try entries.getOrPut(allocator, key);
+    if (!result.found_existing) {
+        result.key_ptr.* = allocator.dupe(u8, key) catch |err| {
+            entries.removeByPtr(result.key_ptr);
+            return err;
+        };
+    }
+    result.value_ptr.* = local_work_items;
+}
+
+/// Serializes the table as text, one `device<TAB>key<TAB>l0 l1 l2` line per entry, so tables of
+/// several devices can live in the same file.
+pub fn save(command_queue: *const CommandQueue, writer: anytype) !void {
+    var iterator = command_queue.work_group_tuner.entries.iterator();
+    while (iterator.next()) |entry| {
+        const l = entry.value_ptr.*;
+        try writer.print("{s}\t{s}\t{d} {d} {d}\n", .{
+            std.mem.trimRight(u8, command_queue.device_name, "\x00"),
+            entry.key_ptr.*,
+            l[0],
+            l[1],
+            l[2],
+        });
+    }
+}
+
+/// Loads the entries of this device from a table produced by `save`. Entries of other devices
+/// are ignored.
+pub fn load(command_queue: *const CommandQueue, content: []const u8) Errors!void {
+    const device_name = std.mem.trimRight(u8, command_queue.device_name, "\x00");
+
+    var lines = std.mem.tokenizeScalar(u8, content, '\n');
+    while (lines.next()) |line| {
+        var fields = std.mem.splitScalar(u8, line, '\t');
+        const device = fields.next() orelse return error.InvalidTuningTable;
+        const key = fields.next() orelse return error.InvalidTuningTable;
+        const values = fields.next() orelse return error.InvalidTuningTable;
+
+        if (!std.mem.eql(u8, device, device_name)) continue;
+
+        var entry: Entry = undefined;
+        var numbers = std.mem.tokenizeScalar(u8, values, ' ');
+        for (&entry) |*e| {
+            const number = numbers.next() orelse return error.InvalidTuningTable;
+            e.* = std.fmt.parseInt(u64, number, 10) catch return error.InvalidTuningTable;
+            if (e.* == 0) return error.InvalidTuningTable;
+        }
+
+        try putByKey(command_queue, key, entry);
+    }
+}
+
+pub fn saveToFile(command_queue: *const CommandQueue, path: []const u8) Errors!void {
+    const allocator = command_queue.context.allocator;
+
+    var content: std.ArrayList(u8) = .empty;
+    defer content.deinit(allocator);
+
+    try save(command_queue, content.writer(allocator));
+
+    const file = try std.fs.cwd().createFile(path, .{});
+    defer file.close();
+
+    try file.writeAll(content.items);
+}
+
+pub fn loadFromFile(command_queue: *const CommandQueue, path: []const u8) Errors!void {
+    const allocator = command_queue.context.allocator;
+
+    const content = try std.fs.cwd().readFileAlloc(allocator, path, 16 * 1024 * 1024);
+    defer allocator.free(content);
+
+    try load(command_queue, content);
+}
+
+// Unit Tests
+const testing = std.testing;
+const core = @import("main.zig");
+
+test "WorkGroupTuner - untuned classes use the padded heuristic" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+
+    var padded: [2]u64 = undefined;
+    var local: [2]u64 = undefined;
+    getLocalWorkItems(command_queue, "test", 0, &.{ 13, 1021 }, &padded, &local);
+
+    for (padded, local, [_]u64{ 13, 1021 }) |p, l, g| {
+        try testing.expect(p >= g);
+        try testing.expectEqual(@as(u64, 0), p % l);
+    }
+    try testing.expect(local[0] * local[1] <= command_queue.max_work_group_size);
+}
+
+test "WorkGroupTuner - tune, save and load" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const source =
+        \\__kernel void tuner_test(__global float *const x, const ulong n) {
+        \\    const ulong i = get_global_id(0);
+        \\    if (i >= n) return;
+        \\    x[i] = 1.0f;
+        \\}
+    ;
+
+    var kernel: cl.kernel.Kernel = undefined;
+    var program: cl.program.Program = undefined;
+    try KernelsSet.compileKernel(
+        f32,
+        command_queue,
+        .{ .vectors_enabled = false, .kernel_name = "tuner_test" },
+        &kernel,
+        &program,
+        source,
+    );
+    defer {
+        cl.kernel.release(kernel);
+        cl.program.release(program);
+    }
+
+    const n: u64 = 1021;
+    const buffer = try cl.buffer.create(context.cl_context, cl.buffer.MemFlag.read_write, n * @sizeOf(f32), null);
+    defer cl.buffer.release(buffer);
+
+    try cl.kernel.setArg(kernel, 0, @sizeOf(cl.buffer.Mem), @ptrCast(&buffer));
+    try cl.kernel.setArg(kernel, 1, @sizeOf(u64), @ptrCast(&n));
+
+    try tune(command_queue, kernel, "tuner_test", 0, &.{n}, 2);
+    try testing.expectEqual(@as(u32, 1), command_queue.work_group_tuner.entries.count());
+
+    var table: std.ArrayList(u8) = .empty;
+    defer table.deinit(allocator);
+    try save(command_queue, table.writer(allocator));
+
+    var padded: [1]u64 = undefined;
+    var local: [1]u64 = undefined;
+    getLocalWorkItems(command_queue, "tuner_test", 0, &.{1000}, &padded, &local);
+    const tuned_local = local[0];
+
+    // Other builds of the kernel don't share it
+    var other_padded: [1]u64 = undefined;
+    var other_local: [1]u64 = undefined;
+    getLocalWorkItems(command_queue, "tuner_test", 1, &.{1000}, &other_padded, &other_local);
+    var heuristic_padded: [1]u64 = undefined;
+    var heuristic_local: [1]u64 = undefined;
+    utils.calculatePaddedWorkItems(&.{1000}, &heuristic_padded, &heuristic_local, command_queue.max_work_group_size);
+    try testing.expectEqual(heuristic_local[0], other_local[0]);
+
+    // Same class, loading the saved table back must give the same local size
+    command_queue.work_group_tuner.deinit(allocator);
+    command_queue.work_group_tuner = .empty;
+    try load(command_queue, table.items);
+
+    getLocalWorkItems(command_queue, "tuner_test", 0, &.{1000}, &padded, &local);
+    try testing.expectEqual(tuned_local, local[0]);
+    try testing.expectEqual(@as(u64, 0), padded[0] % local[0]);
+
+    try testing.expectError(error.InvalidTuningTable, load(command_queue, "broken line\n"));
+}
@@ -6,8 +6,6 @@ const Pipeline = core.Pipeline;
 const CommandQueue = core.CommandQueue;
 const KernelsSet = core.KernelsSet;
 
-const utils = @import("utils");
-
 const tensor_module = @import("tensor");
 const Tensor = tensor_module.Tensor;
 const TensorErrors = tensor_module.Errors;
@@ -36,6 +34,8 @@ pub fn dot(
         null,
     );
 
+    x.markModified();
+
     const prev_events = pipeline.prevEvents();
 
     const setArg = cl.kernel.setArg;
@@ -44,30 +44,44 @@ pub fn dot(
     try setArg(kernel, 0, cl_mem_size, @ptrCast(&x.buffer));
     try setArg(kernel, 1, cl_mem_size, @ptrCast(&y.buffer));
 
-    const wekua_id = command_queue.wekua_id;
     var global_work_items: []const u64 = undefined;
-    var local_work_items: []const u64 = undefined;
 
     if (vectors_enabled) {
         global_work_items = @as([*]u64, @ptrCast(&x.memory_layout.number_of_vectors))[0..1];
-        local_work_items = x.work_configuration.local_work_items_for_vectors_1d[wekua_id .. wekua_id + 1];
+
+        try setArg(kernel, 2, @sizeOf(u64), @ptrCast(&x.memory_layout.number_of_vectors));
     } else {
         global_work_items = &x.work_configuration.global_work_items;
-        local_work_items = &x.work_configuration.local_work_items[wekua_id];
 
         try setArg(kernel, 2, @sizeOf(u64), @ptrCast(&x.memory_layout.slice_pitch_for_vectors));
         try setArg(kernel, 3, @sizeOf(u64), @ptrCast(&x.memory_layout.row_pitch_for_vectors));
         try setArg(kernel, 4, @sizeOf(u64), @ptrCast(&y.memory_layout.slice_pitch_for_vectors));
         try setArg(kernel, 5, @sizeOf(u64), @ptrCast(&y.memory_layout.row_pitch_for_vectors));
+
+        for (global_work_items, 6..) |g, arg_index| {
+            try setArg(kernel, @intCast(arg_index), @sizeOf(u64), @ptrCast(&g));
+        }
     }
 
+    const work_dims = global_work_items.len;
+    var padded_global_work_items: [3]u64 = undefined;
+    var local_work_items: [3]u64 = undefined;
+    core.WorkGroupTuner.getLocalWorkItems(
+        command_queue,
+        "dot_kernel",
+        KernelsSet.getClKernelIndex(T, vectors_enabled),
+        global_work_items,
+        padded_global_work_items[0..work_dims],
+        local_work_items[0..work_dims],
+    );
+
     var new_event: cl.event.Event = undefined;
     try cl.kernel.enqueueNdRange(
         command_queue.cl_command_queue,
         kernel,
         null,
-        global_work_items,
-        local_work_items,
+        padded_global_work_items[0..work_dims],
+        local_work_items[0..work_dims],
         prev_events,
         &new_event,
     );
@@ -94,12 +108,22 @@ fn executeSum(
         null,
     );
 
+    result.markModified();
+
     const prev_events = pipeline.prevEvents();
 
     const global_work_items: []const u64 = x.work_configuration.global_work_items[0..2];
-    var local_work_items: [2]u64 = undefined;
 
-    utils.calculateWorkItems(global_work_items, &local_work_items, command_queue.max_work_group_size);
+    var padded_global_work_items: [2]u64 = undefined;
+    var local_work_items: [2]u64 = undefined;
+    core.WorkGroupTuner.getLocalWorkItems(
+        command_queue,
+        "sum_kernel",
+        KernelsSet.getClKernelIndex(T, x.flags.vectors_enabled),
+        global_work_items,
+        &padded_global_work_items,
+        &local_work_items,
+    );
 
     const setArg = cl.kernel.setArg;
     const cl_mem_size = @sizeOf(cl.buffer.Mem);
@@ -109,13 +133,14 @@ fn executeSum(
     try setArg(kernel, 2, @sizeOf(u64), @ptrCast(&x.memory_layout.row_pitch_for_vectors));
     try setArg(kernel, 3, @sizeOf(u64), @ptrCast(&x.memory_layout.slice_pitch_for_vectors));
     try setArg(kernel, 4, @sizeOf(u64), @ptrCast(&global_work_items[1]));
+    try setArg(kernel, 5, @sizeOf(u64), @ptrCast(&global_work_items[0]));
 
     var new_event: cl.event.Event = undefined;
     try cl.kernel.enqueueNdRange(
         command_queue.cl_command_queue,
         kernel,
         null,
-        global_work_items,
+        &padded_global_work_items,
         &local_work_items,
         prev_events,
         &new_event,
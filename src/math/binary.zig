@@ -0,0 +1,630 @@
+const std = @import("std");
+const cl = @import("opencl");
+
+const core = @import("core");
+const Pipeline = core.Pipeline;
+const CommandQueue = core.CommandQueue;
+const KernelsSet = core.KernelsSet;
+
+const tensor_module = @import("tensor");
+const Tensor = tensor_module.Tensor;
+const TensorErrors = tensor_module.Errors;
+
+const binary_cl_kernel: []const u8 = @embedFile("kernels/binary.cl");
+
+pub const Operation = enum(u8) {
+    add,
+    sub,
+    mul,
+    div,
+    min,
+    max,
+};
+
+const NUMBER_OF_OPERATIONS = @typeInfo(Operation).@"enum".fields.len;
+
+// Index of the build of the kernel in its set, also the variant of its tuned local sizes
+fn getKernelIndex(
+    comptime T: type,
+    operation: Operation,
+    vectors_enabled: bool,
+    a_col_broadcast: bool,
+    b_col_broadcast: bool,
+) usize {
+    const SUPPORTED_TYPES = core.types.SUPPORTED_TYPES;
+
+    var kernel_index: usize = @as(usize, @intFromEnum(operation)) * (2 * 2 * 2 * SUPPORTED_TYPES.len);
+    kernel_index += @intFromBool(vectors_enabled) * (2 * 2 * SUPPORTED_TYPES.len);
+    kernel_index += @intFromBool(a_col_broadcast) * (2 * SUPPORTED_TYPES.len);
+    kernel_index += @intFromBool(b_col_broadcast) * SUPPORTED_TYPES.len;
+    kernel_index += @as(usize, core.types.getTypeIndex(T));
+
+    return kernel_index;
+}
+
+fn getKernel(
+    comptime T: type,
+    command_queue: *const CommandQueue,
+    operation: Operation,
+    vectors_enabled: bool,
+    a_col_broadcast: bool,
+    b_col_broadcast: bool,
+) TensorErrors!cl.kernel.Kernel {
+    const kernels_set = try KernelsSet.getKernelSet(
+        command_queue,
+        .Binary,
+        NUMBER_OF_OPERATIONS * 2 * 2 * 2 * core.types.SUPPORTED_TYPES.len,
+    );
+
+    const kernel_index = getKernelIndex(T, operation, vectors_enabled, a_col_broadcast, b_col_broadcast);
+
+    if (kernels_set.kernels.?[kernel_index]) |v| return v;
+
+    var kernel: cl.kernel.Kernel = undefined;
+    var program: cl.program.Program = undefined;
+
+    const allocator = command_queue.context.allocator;
+    const extra_args: []u8 = try std.fmt.allocPrint(
+        allocator,
+        "-DOPERATION={d} -DA_COL_BROADCAST={d} -DB_COL_BROADCAST={d}",
+        .{
+            @intFromEnum(operation),
+            @intFromBool(a_col_broadcast),
+            @intFromBool(b_col_broadcast),
+        },
+    );
+    defer allocator.free(extra_args);
+
+    try KernelsSet.compileKernel(
+        T,
+        command_queue,
+        .{
+            .vectors_enabled = vectors_enabled,
+            .kernel_name = "binary",
+            .extra_args = extra_args,
+        },
+        &kernel,
+        &program,
+        binary_cl_kernel,
+    );
+
+    kernels_set.kernels.?[kernel_index] = kernel;
+    kernels_set.programs.?[kernel_index] = program;
+
+    return kernel;
+}
+
+// Pitches of `x` aligned to the right with `shape`. Dimensions that are broadcast (or that have
+// a single element) get a pitch of 0.
+fn getBroadcastPitches(
+    comptime T: type,
+    x: *Tensor(T),
+    shape: []const u64,
+    pitches: []u64,
+) TensorErrors!void {
+    const x_shape = x.dimensions.shape;
+    if (x_shape.len > shape.len) {
+        return TensorErrors.UnqualTensorsDimension;
+    }
+
+    const offset = shape.len - x_shape.len;
+    @memset(pitches[0..offset], 0);
+
+    for (x_shape, x.dimensions.pitches, shape[offset..], pitches[offset..]) |xs, xp, s, *p| {
+        if (xs == s) {
+            p.* = if (s == 1) 0 else xp;
+        } else if (xs == 1) {
+            p.* = 0;
+        } else {
+            return TensorErrors.UnqualTensorsShape;
+        }
+    }
+}
+
+/// Computes `result = a OP b` element-wise following NumPy broadcasting rules: shapes are
+/// aligned to the right and every dimension of `a` and `b` must either match the one of
+/// `result` or be 1. `result` must have exactly the broadcast shape and may alias `a` or `b`
+/// when they have the same shape.
+///
+/// One kernel is compiled per (operation, dtype, vectors, column broadcast pattern). Broadcast
+/// along any other dimension is just a pitch of 0, so no temporary expanded tensor is created.
+pub fn apply(
+    comptime T: type,
+    comptime operation: Operation,
+    pipeline: *Pipeline,
+    a: *Tensor(T),
+    b: *Tensor(T),
+    result: *Tensor(T),
+) TensorErrors!void {
+    if (comptime core.types.isComplex(T)) {
+        switch (operation) {
+            .min, .max => @compileError("min and max are not defined for complex numbers"),
+            else => {},
+        }
+    }
+
+    const command_queue = pipeline.command_queue;
+    const allocator = command_queue.context.allocator;
+
+    const shape = result.dimensions.shape;
+    const ndim = shape.len;
+
+    const pitches = try allocator.alloc(u64, ndim * 3);
+    defer allocator.free(pitches);
+
+    const a_pitches = pitches[0..ndim];
+    const b_pitches = pitches[ndim..(2 * ndim)];
+    const c_pitches = pitches[(2 * ndim)..];
+
+    try getBroadcastPitches(T, a, shape, a_pitches);
+    try getBroadcastPitches(T, b, shape, b_pitches);
+
+    for (shape, result.dimensions.pitches, a_pitches, b_pitches, c_pitches) |s, p, ap, bp, *cp| {
+        if (s > 1 and ap == 0 and bp == 0) {
+            return TensorErrors.UnqualTensorsShape;
+        }
+        cp.* = if (s == 1) 0 else p;
+    }
+
+    const last_element_index = ndim - 1;
+    const cols = shape[last_element_index];
+    const a_col_broadcast = (cols > 1 and a_pitches[last_element_index] == 0);
+    const b_col_broadcast = (cols > 1 and b_pitches[last_element_index] == 0);
+
+    var rows: u64 = 1;
+    var row_pitches = [3]u64{ 0, 0, 0 };
+    if (ndim >= 2) {
+        const penultimate_element_index = last_element_index - 1;
+        rows = shape[penultimate_element_index];
+        row_pitches = .{
+            a_pitches[penultimate_element_index],
+            b_pitches[penultimate_element_index],
+            c_pitches[penultimate_element_index],
+        };
+    }
+
+    // The innermost run of leading dimensions that can be addressed with a single pitch per
+    // operand is collapsed into the first dimension of the NDRange. Whatever remains (only
+    // happens when broadcast and non broadcast leading dimensions are interleaved) is walked
+    // from the host, one launch per outer index.
+    var depth: u64 = 1;
+    var depth_pitches = [3]u64{ 0, 0, 0 };
+    var outer_dims: usize = ndim -| 2;
+    while (outer_dims > 0) {
+        const d = outer_dims - 1;
+        const s = shape[d];
+        if (s == 1) {
+            outer_dims -= 1;
+            continue;
+        }
+
+        const dim_pitches = [3]u64{ a_pitches[d], b_pitches[d], c_pitches[d] };
+        if (depth > 1) {
+            var mergeable = true;
+            for (dim_pitches, depth_pitches) |p, dp| {
+                if (p != dp * depth) {
+                    mergeable = false;
+                    break;
+                }
+            }
+            if (!mergeable) break;
+        } else {
+            depth_pitches = dim_pitches;
+        }
+
+        depth *= s;
+        outer_dims -= 1;
+    }
+
+    // Vectors are only used when every row of the result is made of whole vectors, otherwise
+    // the padding lanes would be written.
+    const vector_width = result.memory_layout.row_pitch / result.memory_layout.row_pitch_for_vectors;
+    var vectors_enabled = (result.flags.vectors_enabled and vector_width > 1 and cols % vector_width == 0);
+    if (!a_col_broadcast) vectors_enabled = vectors_enabled and a.flags.vectors_enabled;
+    if (!b_col_broadcast) vectors_enabled = vectors_enabled and b.flags.vectors_enabled;
+
+    const units = [3]u64{
+        if (vectors_enabled and !a_col_broadcast) vector_width else 1,
+        if (vectors_enabled and !b_col_broadcast) vector_width else 1,
+        if (vectors_enabled) vector_width else 1,
+    };
+
+    const kernel = try getKernel(
+        T,
+        command_queue,
+        operation,
+        vectors_enabled,
+        a_col_broadcast,
+        b_col_broadcast,
+    );
+
+    const setArg = cl.kernel.setArg;
+    const cl_mem_size = @sizeOf(cl.buffer.Mem);
+
+    try setArg(kernel, 0, cl_mem_size, @ptrCast(&a.buffer));
+    try setArg(kernel, 1, cl_mem_size, @ptrCast(&b.buffer));
+    try setArg(kernel, 2, cl_mem_size, @ptrCast(&result.buffer));
+
+    for (0..3) |x| {
+        const arg_index: u32 = @intCast(3 + x * 3);
+        const depth_pitch = depth_pitches[x] / units[x];
+        const row_pitch = row_pitches[x] / units[x];
+
+        try setArg(kernel, arg_index + 1, @sizeOf(u64), @ptrCast(&depth_pitch));
+        try setArg(kernel, arg_index + 2, @sizeOf(u64), @ptrCast(&row_pitch));
+    }
+
+    const global_work_items = [3]u64{ depth, rows, cols / units[2] };
+    for (global_work_items, 12..) |g, arg_index| {
+        try setArg(kernel, @intCast(arg_index), @sizeOf(u64), @ptrCast(&g));
+    }
+
+    var padded_global_work_items: [3]u64 = undefined;
+    var local_work_items: [3]u64 = undefined;
+    core.WorkGroupTuner.getLocalWorkItems(
+        command_queue,
+        "binary",
+        getKernelIndex(T, operation, vectors_enabled, a_col_broadcast, b_col_broadcast),
+        &global_work_items,
+        &padded_global_work_items,
+        &local_work_items,
+    );
+
+    var outer_count: u64 = 1;
+    for (shape[0..outer_dims]) |s| outer_count *= s;
+
+    const events = try allocator.alloc(cl.event.Event, outer_count);
+    defer allocator.free(events);
+
+    var events_enqueued: usize = 0;
+    errdefer {
+        for (events[0..events_enqueued]) |event| {
+            tensor_module.helpers.releaseEvent(event);
+        }
+    }
+
+    result.markModified();
+
+    const prev_events = pipeline.prevEvents();
+    for (events, 0..) |*event, outer_index| {
+        var offsets = [3]u64{ 0, 0, 0 };
+        var remaining: u64 = outer_index;
+        var d: usize = outer_dims;
+        while (d > 0) {
+            d -= 1;
+            const coordinate = remaining % shape[d];
+            remaining /= shape[d];
+
+            offsets[0] += coordinate * a_pitches[d];
+            offsets[1] += coordinate * b_pitches[d];
+            offsets[2] += coordinate * c_pitches[d];
+        }
+
+        for (offsets, units, 0..) |offset, unit, x| {
+            const arg_index: u32 = @intCast(3 + x * 3);
+            const offset_in_units = offset / unit;
+            try setArg(kernel, arg_index, @sizeOf(u64), @ptrCast(&offset_in_units));
+        }
+
+        try cl.kernel.enqueueNdRange(
+            command_queue.cl_command_queue,
+            kernel,
+            null,
+            &padded_global_work_items,
+            &local_work_items,
+            prev_events,
+            event,
+        );
+        events_enqueued += 1;
+    }
+
+    try pipeline.append(events);
+}
+
+pub fn add(
+    comptime T: type,
+    pipeline: *Pipeline,
+    a: *Tensor(T),
+    b: *Tensor(T),
+    result: *Tensor(T),
+) TensorErrors!void {
+    try apply(T, .add, pipeline, a, b, result);
+}
+
+pub fn sub(
+    comptime T: type,
+    pipeline: *Pipeline,
+    a: *Tensor(T),
+    b: *Tensor(T),
+    result: *Tensor(T),
+) TensorErrors!void {
+    try apply(T, .sub, pipeline, a, b, result);
+}
+
+pub fn mul(
+    comptime T: type,
+    pipeline: *Pipeline,
+    a: *Tensor(T),
+    b: *Tensor(T),
+    result: *Tensor(T),
+) TensorErrors!void {
+    try apply(T, .mul, pipeline, a, b, result);
+}
+
+pub fn div(
+    comptime T: type,
+    pipeline: *Pipeline,
+    a: *Tensor(T),
+    b: *Tensor(T),
+    result: *Tensor(T),
+) TensorErrors!void {
+    try apply(T, .div, pipeline, a, b, result);
+}
+
+pub fn min(
+    comptime T: type,
+    pipeline: *Pipeline,
+    a: *Tensor(T),
+    b: *Tensor(T),
+    result: *Tensor(T),
+) TensorErrors!void {
+    try apply(T, .min, pipeline, a, b, result);
+}
+
+pub fn max(
+    comptime T: type,
+    pipeline: *Pipeline,
+    a: *Tensor(T),
+    b: *Tensor(T),
+    result: *Tensor(T),
+) TensorErrors!void {
+    try apply(T, .max, pipeline, a, b, result);
+}
+
+// -----------------------------------------------------------------------------
+// Unit Tests
+const testing = std.testing;
+
+const memory = tensor_module.memory;
+
+fn castInt(comptime T: type, val: anytype) T {
+    if (comptime core.types.isComplex(T)) {
+        const SubType = core.types.getType(T);
+        return .{ .real = castInt(SubType, val), .imag = 0 };
+    }
+
+    return switch (@typeInfo(T)) {
+        .float => @floatFromInt(val),
+        .int => @intCast(val),
+        else => unreachable,
+    };
+}
+
+fn testBinary(
+    comptime T: type,
+    comptime operation: Operation,
+    pipeline: *Pipeline,
+    a_shape: []const u64,
+    b_shape: []const u64,
+    c_shape: []const u64,
+) !void {
+    const config = tensor_module.CreateConfig{};
+    try testBinaryWithConfigs(T, operation, pipeline, a_shape, b_shape, c_shape, .{ config, config, config });
+}
+
+fn testBinaryWithConfigs(
+    comptime T: type,
+    comptime operation: Operation,
+    pipeline: *Pipeline,
+    a_shape: []const u64,
+    b_shape: []const u64,
+    c_shape: []const u64,
+    configs: [3]tensor_module.CreateConfig,
+) !void {
+    const allocator = testing.allocator;
+    const context = pipeline.command_queue.context;
+
+    const a = try Tensor(T).alloc(context, pipeline, a_shape, configs[0]);
+    defer a.release(pipeline);
+
+    const b = try Tensor(T).alloc(context, pipeline, b_shape, configs[1]);
+    defer b.release(pipeline);
+
+    const c = try Tensor(T).alloc(context, pipeline, c_shape, configs[2]);
+    defer c.release(pipeline);
+
+    const a_buf = try allocator.alloc(T, a.dimensions.number_of_elements_without_padding);
+    defer allocator.free(a_buf);
+
+    const b_buf = try allocator.alloc(T, b.dimensions.number_of_elements_without_padding);
+    defer allocator.free(b_buf);
+
+    const c_buf = try allocator.alloc(T, c.dimensions.number_of_elements_without_padding);
+    defer allocator.free(c_buf);
+
+    // Small values so that every operation stays in range for all the integer types
+    for (a_buf, 0..) |*v, i| v.* = castInt(T, (i % 5) + 6);
+    for (b_buf, 0..) |*v, i| v.* = castInt(T, (i % 3) + 1);
+
+    try memory.readFromBuffer(T, pipeline, a, a_buf);
+    try memory.readFromBuffer(T, pipeline, b, b_buf);
+
+    try apply(T, operation, pipeline, a, b, c);
+
+    try memory.writeToBuffer(T, pipeline, c, c_buf);
+    pipeline.waitAndCleanup();
+
+    const ndim = c_shape.len;
+    const coordinates = try allocator.alloc(u64, ndim);
+    defer allocator.free(coordinates);
+
+    for (c_buf, 0..) |value, index| {
+        var remaining: u64 = index;
+        var d: usize = ndim;
+        while (d > 0) {
+            d -= 1;
+            coordinates[d] = remaining % c_shape[d];
+            remaining /= c_shape[d];
+        }
+
+        var a_index: u64 = 0;
+        for (a_shape, coordinates[(ndim - a_shape.len)..]) |s, coor| {
+            a_index = a_index * s + (if (s == 1) 0 else coor);
+        }
+
+        var b_index: u64 = 0;
+        for (b_shape, coordinates[(ndim - b_shape.len)..]) |s, coor| {
+            b_index = b_index * s + (if (s == 1) 0 else coor);
+        }
+
+        const x = (a_index % 5) + 6;
+        const y = (b_index % 3) + 1;
+        const expected: u64 = switch (operation) {
+            .add => x + y,
+            .sub => x - y,
+            .mul => x * y,
+            .div => x / y,
+            .min => @min(x, y),
+            .max => @max(x, y),
+        };
+
+        if (comptime core.types.isComplex(T)) {
+            const SubType = core.types.getType(T);
+            if (operation == .div and @typeInfo(SubType) == .float) {
+                const exact: f64 = @as(f64, @floatFromInt(x)) / @as(f64, @floatFromInt(y));
+                try testing.expectApproxEqAbs(exact, @as(f64, @floatCast(value.real)), 1e-5);
+            } else {
+                try testing.expectEqual(castInt(SubType, expected), value.real);
+            }
+            try testing.expectEqual(@as(SubType, 0), value.imag);
+        } else if (operation == .div and @typeInfo(T) == .float) {
+            const exact: f64 = @as(f64, @floatFromInt(x)) / @as(f64, @floatFromInt(y));
+            try testing.expectApproxEqAbs(exact, @as(f64, @floatCast(value)), 1e-5);
+        } else {
+            try testing.expectEqual(castInt(T, expected), value);
+        }
+    }
+}
+
+test "binary - same shape" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    inline for (core.types.SUPPORTED_TYPES) |T| {
+        if (command_queue.isTypeSupported(T)) {
+            try testBinary(T, .add, pipeline, &.{ 3, 16 }, &.{ 3, 16 }, &.{ 3, 16 });
+            try testBinary(T, .sub, pipeline, &.{ 2, 3, 5 }, &.{ 2, 3, 5 }, &.{ 2, 3, 5 });
+            try testBinary(T, .mul, pipeline, &.{7}, &.{7}, &.{7});
+            try testBinary(T, .div, pipeline, &.{ 4, 4 }, &.{ 4, 4 }, &.{ 4, 4 });
+
+            if (comptime !core.types.isComplex(T)) {
+                try testBinary(T, .min, pipeline, &.{ 3, 9 }, &.{ 3, 9 }, &.{ 3, 9 });
+                try testBinary(T, .max, pipeline, &.{ 3, 9 }, &.{ 3, 9 }, &.{ 3, 9 });
+            }
+        }
+    }
+}
+
+test "binary - row, column and scalar broadcast" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    inline for (core.types.SUPPORTED_TYPES) |T| {
+        if (command_queue.isTypeSupported(T)) {
+            try testBinary(T, .add, pipeline, &.{ 5, 16 }, &.{16}, &.{ 5, 16 });
+            try testBinary(T, .add, pipeline, &.{ 5, 7 }, &.{ 1, 7 }, &.{ 5, 7 });
+            try testBinary(T, .mul, pipeline, &.{ 5, 16 }, &.{ 5, 1 }, &.{ 5, 16 });
+            try testBinary(T, .sub, pipeline, &.{ 5, 1 }, &.{ 1, 6 }, &.{ 5, 6 });
+            try testBinary(T, .div, pipeline, &.{ 3, 4, 8 }, &.{1}, &.{ 3, 4, 8 });
+
+            if (comptime !core.types.isComplex(T)) {
+                try testBinary(T, .max, pipeline, &.{ 4, 3 }, &.{3}, &.{ 4, 3 });
+            }
+        }
+    }
+}
+
+test "binary - leading dimensions broadcast" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    inline for (core.types.SUPPORTED_TYPES) |T| {
+        if (command_queue.isTypeSupported(T)) {
+            try testBinary(T, .add, pipeline, &.{ 2, 3, 4, 8 }, &.{ 4, 8 }, &.{ 2, 3, 4, 8 });
+            try testBinary(T, .mul, pipeline, &.{ 2, 1, 3, 5 }, &.{ 1, 4, 3, 5 }, &.{ 2, 4, 3, 5 });
+            try testBinary(T, .sub, pipeline, &.{ 3, 2, 4, 6 }, &.{ 3, 1, 4, 1 }, &.{ 3, 2, 4, 6 });
+        }
+    }
+}
+
+test "binary - compact tensors" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const compact = tensor_module.CreateConfig{ .compact = true };
+    const padded = tensor_module.CreateConfig{};
+
+    inline for (core.types.SUPPORTED_TYPES) |T| {
+        if (command_queue.isTypeSupported(T)) {
+            const all_compact = [3]tensor_module.CreateConfig{ compact, compact, compact };
+            try testBinaryWithConfigs(T, .add, pipeline, &.{ 2, 5, 3 }, &.{ 2, 5, 3 }, &.{ 2, 5, 3 }, all_compact);
+            try testBinaryWithConfigs(T, .mul, pipeline, &.{ 5, 7 }, &.{7}, &.{ 5, 7 }, all_compact);
+            try testBinaryWithConfigs(T, .sub, pipeline, &.{ 3, 5, 1 }, &.{ 5, 4 }, &.{ 3, 5, 4 }, all_compact);
+
+            // Compact and padded operands mixed
+            try testBinaryWithConfigs(T, .add, pipeline, &.{ 3, 5, 6 }, &.{ 3, 5, 6 }, &.{ 3, 5, 6 }, .{ compact, padded, compact });
+            try testBinaryWithConfigs(T, .div, pipeline, &.{ 5, 9 }, &.{ 5, 9 }, &.{ 5, 9 }, .{ padded, compact, padded });
+        }
+    }
+}
+
+test "binary - invalid shapes" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const a = try Tensor(f32).alloc(context, pipeline, &.{ 3, 4 }, .{});
+    defer a.release(pipeline);
+
+    const b = try Tensor(f32).alloc(context, pipeline, &.{3}, .{});
+    defer b.release(pipeline);
+
+    const c = try Tensor(f32).alloc(context, pipeline, &.{ 3, 4 }, .{});
+    defer c.release(pipeline);
+
+    const d = try Tensor(f32).alloc(context, pipeline, &.{ 2, 3, 4 }, .{});
+    defer d.release(pipeline);
+
+    try testing.expectError(TensorErrors.UnqualTensorsShape, add(f32, pipeline, a, b, c));
+    try testing.expectError(TensorErrors.UnqualTensorsDimension, add(f32, pipeline, d, a, c));
+    try testing.expectError(TensorErrors.UnqualTensorsShape, add(f32, pipeline, a, c, d));
+}
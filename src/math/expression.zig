@@ -0,0 +1,706 @@
+const std = @import("std");
+const cl = @import("opencl");
+
+const core = @import("core");
+const Pipeline = core.Pipeline;
+const CommandQueue = core.CommandQueue;
+const KernelsSet = core.KernelsSet;
+
+const tensor_module = @import("tensor");
+const Tensor = tensor_module.Tensor;
+const TensorErrors = tensor_module.Errors;
+
+const binary_module = @import("binary.zig");
+
+pub const BinaryOperation = binary_module.Operation;
+
+pub const UnaryOperation = enum(u8) {
+    neg,
+    relu,
+
+    // Only for floats
+    exp,
+    log,
+    sqrt,
+    sin,
+    cos,
+    tanh,
+    sigmoid,
+};
+
+/// Lazy element-wise expression. Operations only record nodes in a small DAG; nothing is
+/// executed until `materialize` is called, which generates a single OpenCL kernel that reads
+/// every input once and writes the result once, instead of one pass over memory per operation.
+///
+/// Generated kernels are compiled through `KernelsSet.compileKernel` and cached in the command
+/// queue by the expression signature, so rebuilding the same expression (e.g. every training
+/// step) doesn't recompile anything.
+///
+/// All the inputs must have the same shape as the result. Use `math.binary` for broadcasting.
+///
+/// Expressions over storage types (f16, bf16) load every input as f32, compute in f32 and round
+/// the result once when storing it. Their scalars are f32 and they don't use vectors.
+pub fn Expression(comptime T: type) type {
+    if (core.types.isComplex(T)) {
+        @compileError("Fused expressions don't support complex types");
+    }
+
+    const TensorT = Tensor(T);
+    const ComputeT = core.types.getComputeType(T);
+    const is_storage = core.types.isStorageType(T);
+    const is_float = (@typeInfo(ComputeT) == .float);
+
+    // Storage types are kept apart from SUPPORTED_TYPES in the signature
+    const type_key = if (is_storage)
+        core.types.SUPPORTED_TYPES.len + core.types.getStorageTypeIndex(T)
+    else
+        core.types.getTypeIndex(T);
+
+    // Element type of the tensors in the generated source
+    const element_type = if (is_storage) "st" else "wk";
+
+    return struct {
+        pub const Ref = u32;
+
+        const Node = union(enum) {
+            input: u32,
+            scalar: u32,
+            unary: struct {
+                operation: UnaryOperation,
+                x: Ref,
+            },
+            binary: struct {
+                operation: BinaryOperation,
+                a: Ref,
+                b: Ref,
+            },
+        };
+
+        allocator: std.mem.Allocator,
+        nodes: std.ArrayList(Node),
+        inputs: std.ArrayList(*TensorT),
+        scalars: std.ArrayList(ComputeT),
+
+        const Self = @This();
+
+        pub fn init(allocator: std.mem.Allocator) Self {
+            return .{
+                .allocator = allocator,
+                .nodes = .empty,
+                .inputs = .empty,
+                .scalars = .empty,
+            };
+        }
+
+        pub fn deinit(self: *Self) void {
+            const allocator = self.allocator;
+            self.nodes.deinit(allocator);
+            self.inputs.deinit(allocator);
+            self.scalars.deinit(allocator);
+        }
+
+        pub fn reset(self: *Self) void {
+            self.nodes.clearRetainingCapacity();
+            self.inputs.clearRetainingCapacity();
+            self.scalars.clearRetainingCapacity();
+        }
+
+        fn appendNode(self: *Self, node: Node) std.mem.Allocator.Error!Ref {
+            const index: Ref = @intCast(self.nodes.items.len);
+            try self.nodes.append(self.allocator, node);
+            return index;
+        }
+
+        pub fn input(self: *Self, tensor: *TensorT) std.mem.Allocator.Error!Ref {
+            for (self.nodes.items, 0..) |node, index| {
+                switch (node) {
+                    .input => |i| if (self.inputs.items[i] == tensor) return @intCast(index),
+                    else => {},
+                }
+            }
+
+            const input_index: u32 = @intCast(self.inputs.items.len);
+            try self.inputs.append(self.allocator, tensor);
+            errdefer _ = self.inputs.pop();
+
+            return try self.appendNode(.{ .input = input_index });
+        }
+
+        /// Scalars are passed as kernel arguments, so changing their value doesn't change the
+        /// signature of the expression.
+        pub fn scalar(self: *Self, value: ComputeT) std.mem.Allocator.Error!Ref {
+            const scalar_index: u32 = @intCast(self.scalars.items.len);
+            try self.scalars.append(self.allocator, value);
+            errdefer _ = self.scalars.pop();
+
+            return try self.appendNode(.{ .scalar = scalar_index });
+        }
+
+        pub fn unary(self: *Self, comptime operation: UnaryOperation, x: Ref) std.mem.Allocator.Error!Ref {
+            switch (operation) {
+                .neg, .relu => {},
+                else => if (!is_float) @compileError("Operation only supported for floats"),
+            }
+
+            return try self.appendNode(.{ .unary = .{ .operation = operation, .x = x } });
+        }
+
+        pub fn binary(
+            self: *Self,
+            comptime operation: BinaryOperation,
+            a: Ref,
+            b: Ref,
+        ) std.mem.Allocator.Error!Ref {
+            return try self.appendNode(.{ .binary = .{ .operation = operation, .a = a, .b = b } });
+        }
+
+        pub fn add(self: *Self, a: Ref, b: Ref) std.mem.Allocator.Error!Ref {
+            return try self.binary(.add, a, b);
+        }
+
+        pub fn sub(self: *Self, a: Ref, b: Ref) std.mem.Allocator.Error!Ref {
+            return try self.binary(.sub, a, b);
+        }
+
+        pub fn mul(self: *Self, a: Ref, b: Ref) std.mem.Allocator.Error!Ref {
+            return try self.binary(.mul, a, b);
+        }
+
+        pub fn div(self: *Self, a: Ref, b: Ref) std.mem.Allocator.Error!Ref {
+            return try self.binary(.div, a, b);
+        }
+
+        // Nodes are appended after their operands, so the node list is already in topological
+        // order and the reachable set can be computed in a single backwards pass.
+        fn markReachable(self: *const Self, root: Ref, reachable: []bool) void {
+            @memset(reachable, false);
+            reachable[root] = true;
+
+            var index: usize = root + 1;
+            while (index > 0) {
+                index -= 1;
+                if (!reachable[index]) continue;
+
+                switch (self.nodes.items[index]) {
+                    .input, .scalar => {},
+                    .unary => |u| reachable[u.x] = true,
+                    .binary => |b| {
+                        reachable[b.a] = true;
+                        reachable[b.b] = true;
+                    },
+                }
+            }
+        }
+
+        fn writeSignature(
+            self: *const Self,
+            writer: anytype,
+            root: Ref,
+            reachable: []const bool,
+            vectors_enabled: bool,
+        ) !void {
+            try writer.print("{d}:{d}:{d}:{d}", .{
+                type_key,
+                @intFromBool(vectors_enabled),
+                self.inputs.items.len,
+                self.scalars.items.len,
+            });
+
+            for (self.nodes.items[0..(root + 1)], reachable[0..(root + 1)]) |node, r| {
+                if (!r) {
+                    try writer.writeAll(";_");
+                    continue;
+                }
+
+                switch (node) {
+                    .input => |i| try writer.print(";i{d}", .{i}),
+                    .scalar => |s| try writer.print(";s{d}", .{s}),
+                    .unary => |u| try writer.print(";u{d},{d}", .{ @intFromEnum(u.operation), u.x }),
+                    .binary => |b| try writer.print(";b{d},{d},{d}", .{ @intFromEnum(b.operation), b.a, b.b }),
+                }
+            }
+        }
+
+        fn writeSource(
+            self: *const Self,
+            writer: anytype,
+            root: Ref,
+            reachable: []const bool,
+        ) !void {
+            try writer.print(
+                \\#include "wekua.h"
+                \\
+                \\__kernel void fused_expression(
+                \\    const ulong depth,
+                \\    const ulong rows,
+                \\    const ulong cols,
+                \\    __global {s} *const out,
+                \\    const ulong out_slice_pitch,
+                \\    const ulong out_row_pitch
+            , .{element_type});
+
+            for (0..self.inputs.items.len) |i| {
+                try writer.print(
+                    \\,
+                    \\    __global const {s} *const x{d},
+                    \\    const ulong x{d}_slice_pitch,
+                    \\    const ulong x{d}_row_pitch
+                , .{ element_type, i, i, i });
+            }
+
+            for (0..self.scalars.items.len) |s| {
+                try writer.print(",\n    const wks s{d}", .{s});
+            }
+
+            try writer.writeAll(
+                \\
+                \\) {
+                \\    const ulong i = get_global_id(0);
+                \\    const ulong j = get_global_id(1);
+                \\    const ulong k = get_global_id(2);
+                \\
+                \\    if (i >= depth || j >= rows || k >= cols) return;
+                \\
+                \\
+            );
+
+            for (self.nodes.items[0..(root + 1)], reachable[0..(root + 1)], 0..) |node, r, index| {
+                if (!r) continue;
+
+                try writer.print("    const wk v{d} = ", .{index});
+                switch (node) {
+                    .input => |x| if (is_storage) try writer.print(
+                        "load_storage(x{d}, i * x{d}_slice_pitch + j * x{d}_row_pitch + k)",
+                        .{ x, x, x },
+                    ) else try writer.print(
+                        "x{d}[i * x{d}_slice_pitch + j * x{d}_row_pitch + k]",
+                        .{ x, x, x },
+                    ),
+                    .scalar => |s| try writer.print("(wk)(s{d})", .{s}),
+                    .unary => |u| switch (u.operation) {
+                        .neg => try writer.print("-v{d}", .{u.x}),
+                        .relu => try writer.print("max(v{d}, (wk)(0))", .{u.x}),
+                        .sigmoid => try writer.print("(wk)(1) / ((wk)(1) + exp(-v{d}))", .{u.x}),
+                        else => try writer.print("{s}(v{d})", .{ @tagName(u.operation), u.x }),
+                    },
+                    .binary => |b| switch (b.operation) {
+                        .add => try writer.print("v{d} + v{d}", .{ b.a, b.b }),
+                        .sub => try writer.print("v{d} - v{d}", .{ b.a, b.b }),
+                        .mul => try writer.print("v{d} * v{d}", .{ b.a, b.b }),
+                        .div => try writer.print("v{d} / v{d}", .{ b.a, b.b }),
+                        .min, .max => try writer.print("{s}(v{d}, v{d})", .{ @tagName(b.operation), b.a, b.b }),
+                    },
+                }
+                try writer.writeAll(";\n");
+            }
+
+            if (is_storage) {
+                try writer.print(
+                    \\
+                    \\    store_storage(out, i * out_slice_pitch + j * out_row_pitch + k, v{d});
+                    \\}}
+                    \\
+                , .{root});
+            } else {
+                try writer.print(
+                    \\
+                    \\    out[i * out_slice_pitch + j * out_row_pitch + k] = v{d};
+                    \\}}
+                    \\
+                , .{root});
+            }
+        }
+
+        // `variant` gets the hash of the signature of the kernel, the variant of its tuned local
+        // sizes
+        fn getKernel(
+            self: *const Self,
+            command_queue: *const CommandQueue,
+            root: Ref,
+            vectors_enabled: bool,
+            variant: *u64,
+        ) TensorErrors!cl.kernel.Kernel {
+            const allocator = self.allocator;
+
+            const reachable = try allocator.alloc(bool, root + 1);
+            defer allocator.free(reachable);
+
+            self.markReachable(root, reachable);
+
+            var signature: std.ArrayList(u8) = .empty;
+            defer signature.deinit(allocator);
+
+            try self.writeSignature(signature.writer(allocator), root, reachable, vectors_enabled);
+            variant.* = std.hash.Wyhash.hash(0, signature.items);
+
+            if (KernelsSet.getCustomKernel(command_queue, signature.items)) |kernel| {
+                return kernel;
+            }
+
+            var source: std.ArrayList(u8) = .empty;
+            defer source.deinit(allocator);
+
+            try self.writeSource(source.writer(allocator), root, reachable);
+
+            var kernel: cl.kernel.Kernel = undefined;
+            var program: cl.program.Program = undefined;
+
+            const extra_args: ?[]const u8 = if (is_storage)
+                std.fmt.comptimePrint("-DWK_STORAGE_TYPE={d}", .{core.types.getStorageTypeIndex(T)})
+            else
+                null;
+
+            try KernelsSet.compileKernel(
+                ComputeT,
+                command_queue,
+                .{
+                    .vectors_enabled = vectors_enabled,
+                    .kernel_name = "fused_expression",
+                    .extra_args = extra_args,
+                },
+                &kernel,
+                &program,
+                source.items,
+            );
+            errdefer {
+                cl.kernel.release(kernel);
+                cl.program.release(program);
+            }
+
+            try KernelsSet.putCustomKernel(command_queue, signature.items, kernel, program);
+
+            return kernel;
+        }
+
+        /// Evaluates the expression rooted at `root` into `result`. `result` can be one of the
+        /// inputs of the expression.
+        pub fn materialize(
+            self: *const Self,
+            pipeline: *Pipeline,
+            root: Ref,
+            result: *TensorT,
+        ) TensorErrors!void {
+            if (root >= self.nodes.items.len) {
+                return TensorErrors.InvalidValue;
+            }
+
+            for (self.inputs.items) |x| {
+                try tensor_module.helpers.eqlTensorsShape(T, x, result);
+            }
+
+            const command_queue = pipeline.command_queue;
+
+            // Same rule as math.binary: vectors only when the rows are made of whole vectors
+            const shape = result.dimensions.shape;
+            const cols = shape[shape.len - 1];
+            const vector_width = result.memory_layout.row_pitch / result.memory_layout.row_pitch_for_vectors;
+
+            var vectors_enabled = (!is_storage and result.flags.vectors_enabled and vector_width > 1 and cols % vector_width == 0);
+            for (self.inputs.items) |x| {
+                vectors_enabled = vectors_enabled and x.flags.vectors_enabled;
+            }
+
+            var variant: u64 = undefined;
+            const kernel = try self.getKernel(command_queue, root, vectors_enabled, &variant);
+
+            const setArg = cl.kernel.setArg;
+            const cl_mem_size = @sizeOf(cl.buffer.Mem);
+
+            var global_work_items = result.work_configuration.global_work_items_without_vectors;
+            if (vectors_enabled) global_work_items[2] /= vector_width;
+
+            for (global_work_items, 0..) |g, arg_index| {
+                try setArg(kernel, @intCast(arg_index), @sizeOf(u64), @ptrCast(&g));
+            }
+
+            const tensors_count = self.inputs.items.len + 1;
+            for (0..tensors_count) |index| {
+                const tensor = if (index == 0) result else self.inputs.items[index - 1];
+                const arg_index: u32 = @intCast(3 + index * 3);
+
+                try setArg(kernel, arg_index, cl_mem_size, @ptrCast(&tensor.buffer));
+                if (vectors_enabled) {
+                    try setArg(kernel, arg_index + 1, @sizeOf(u64), @ptrCast(&tensor.memory_layout.slice_pitch_for_vectors));
+                    try setArg(kernel, arg_index + 2, @sizeOf(u64), @ptrCast(&tensor.memory_layout.row_pitch_for_vectors));
+                } else {
+                    try setArg(kernel, arg_index + 1, @sizeOf(u64), @ptrCast(&tensor.memory_layout.slice_pitch));
+                    try setArg(kernel, arg_index + 2, @sizeOf(u64), @ptrCast(&tensor.memory_layout.row_pitch));
+                }
+            }
+
+            for (self.scalars.items, 0..) |*s, index| {
+                const arg_index: u32 = @intCast(3 + tensors_count * 3 + index);
+                try setArg(kernel, arg_index, @sizeOf(ComputeT), @ptrCast(s));
+            }
+
+            var padded_global_work_items: [3]u64 = undefined;
+            var local_work_items: [3]u64 = undefined;
+            core.WorkGroupTuner.getLocalWorkItems(
+                command_queue,
+                "fused_expression",
+                variant,
+                &global_work_items,
+                &padded_global_work_items,
+                &local_work_items,
+            );
+
+            result.markModified();
+
+            const prev_events = pipeline.prevEvents();
+
+            var new_event: cl.event.Event = undefined;
+            try cl.kernel.enqueueNdRange(
+                command_queue.cl_command_queue,
+                kernel,
+                null,
+                &padded_global_work_items,
+                &local_work_items,
+                prev_events,
+                &new_event,
+            );
+            errdefer tensor_module.helpers.releaseEvent(new_event);
+
+            try pipeline.append(&.{new_event});
+        }
+    };
+}
+
+// -----------------------------------------------------------------------------
+// Unit Tests
+const testing = std.testing;
+
+const memory = tensor_module.memory;
+
+fn castInt(comptime T: type, val: anytype) T {
+    return switch (@typeInfo(T)) {
+        .float => @floatFromInt(val),
+        .int => @intCast(val),
+        else => unreachable,
+    };
+}
+
+test "Expression - fused arithmetic for all real types" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const shapes = [_][]const u64{ &.{ 3, 16 }, &.{ 2, 3, 5 } };
+
+    inline for (core.types.SUPPORTED_TYPES) |T| {
+        if (comptime core.types.isComplex(T)) continue;
+
+        if (command_queue.isTypeSupported(T)) {
+            for (shapes) |shape| {
+                const x = try Tensor(T).alloc(context, pipeline, shape, .{});
+                defer x.release(pipeline);
+
+                const y = try Tensor(T).alloc(context, pipeline, shape, .{});
+                defer y.release(pipeline);
+
+                const n = x.dimensions.number_of_elements_without_padding;
+
+                const x_buf = try allocator.alloc(T, n);
+                defer allocator.free(x_buf);
+
+                const y_buf = try allocator.alloc(T, n);
+                defer allocator.free(y_buf);
+
+                for (x_buf, y_buf, 0..) |*xv, *yv, i| {
+                    xv.* = castInt(T, i % 7);
+                    yv.* = castInt(T, (i % 3) + 1);
+                }
+
+                try memory.readFromBuffer(T, pipeline, x, x_buf);
+                try memory.readFromBuffer(T, pipeline, y, y_buf);
+
+                // y = max(x * y + 2, y), evaluated in place
+                var expr = Expression(T).init(allocator);
+                defer expr.deinit();
+
+                const xr = try expr.input(x);
+                const yr = try expr.input(y);
+                const two = try expr.scalar(castInt(T, 2));
+                const root = try expr.binary(.max, try expr.add(try expr.mul(xr, yr), two), yr);
+
+                try expr.materialize(pipeline, root, y);
+
+                try memory.writeToBuffer(T, pipeline, y, y_buf);
+                pipeline.waitAndCleanup();
+
+                for (y_buf, 0..) |v, i| {
+                    const a = i % 7;
+                    const b = (i % 3) + 1;
+                    try testing.expectEqual(castInt(T, @max(a * b + 2, b)), v);
+                }
+            }
+        }
+    }
+}
+
+test "Expression - kernel is reused for the same signature" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const x = try Tensor(f32).alloc(context, pipeline, &.{ 4, 8 }, .{});
+    defer x.release(pipeline);
+
+    var expr = Expression(f32).init(allocator);
+    defer expr.deinit();
+
+    var root = try expr.unary(.sigmoid, try expr.input(x));
+    try expr.materialize(pipeline, root, x);
+    try testing.expectEqual(@as(u32, 1), command_queue.custom_kernels.count());
+
+    // Same structure with different scalars must not compile a new kernel
+    for (0..2) |i| {
+        expr.reset();
+        const xr = try expr.input(x);
+        root = try expr.mul(xr, try expr.scalar(@floatFromInt(i + 1)));
+        try expr.materialize(pipeline, root, x);
+    }
+    try testing.expectEqual(@as(u32, 2), command_queue.custom_kernels.count());
+
+    const buf = try allocator.alloc(f32, 32);
+    defer allocator.free(buf);
+
+    try memory.writeToBuffer(f32, pipeline, x, buf);
+    pipeline.waitAndCleanup();
+
+    // sigmoid(0) * 1 * 2
+    for (buf) |v| {
+        try testing.expectApproxEqAbs(@as(f32, 1.0), v, 1e-5);
+    }
+}
+
+test "Expression - sigmoid derivative chain" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    inline for (.{ f32, f64 }) |T| {
+        if (command_queue.isTypeSupported(T)) {
+            const shape = [_]u64{ 5, 3 };
+
+            const output = try Tensor(T).alloc(context, pipeline, &shape, .{});
+            defer output.release(pipeline);
+
+            const sensitivity = try Tensor(T).alloc(context, pipeline, &shape, .{});
+            defer sensitivity.release(pipeline);
+
+            const output_buf = try allocator.alloc(T, 15);
+            defer allocator.free(output_buf);
+
+            const sensitivity_buf = try allocator.alloc(T, 15);
+            defer allocator.free(sensitivity_buf);
+
+            for (output_buf, sensitivity_buf, 0..) |*o, *s, i| {
+                o.* = @as(T, @floatFromInt(i)) / 16;
+                s.* = @as(T, @floatFromInt(i)) - 7;
+            }
+
+            try memory.readFromBuffer(T, pipeline, output, output_buf);
+            try memory.readFromBuffer(T, pipeline, sensitivity, sensitivity_buf);
+
+            // sensitivity *= output * (1 - output), without materializing the derivative
+            var expr = Expression(T).init(allocator);
+            defer expr.deinit();
+
+            const o = try expr.input(output);
+            const s = try expr.input(sensitivity);
+            const derivative = try expr.mul(o, try expr.sub(try expr.scalar(1), o));
+            try expr.materialize(pipeline, try expr.mul(s, derivative), sensitivity);
+
+            const result = try allocator.alloc(T, 15);
+            defer allocator.free(result);
+
+            try memory.writeToBuffer(T, pipeline, sensitivity, result);
+            pipeline.waitAndCleanup();
+
+            for (result, output_buf, sensitivity_buf) |r, ov, sv| {
+                try testing.expectApproxEqAbs(sv * ov * (1 - ov), r, 1e-5);
+            }
+        }
+    }
+}
+
+test "Expression - storage types compute in f32" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const shape = [_]u64{ 3, 5 };
+
+    const x = try Tensor(f32).alloc(context, pipeline, &shape, .{});
+    defer x.release(pipeline);
+
+    const y = try Tensor(f32).alloc(context, pipeline, &shape, .{});
+    defer y.release(pipeline);
+
+    var x_values: [15]f32 = undefined;
+    var y_values: [15]f32 = undefined;
+    for (&x_values, &y_values, 0..) |*xv, *yv, i| {
+        const f: f32 = @floatFromInt(i);
+        xv.* = f * 0.25 - 1;
+        yv.* = 0.5 + f * 0.125;
+    }
+
+    try memory.readFromBuffer(f32, pipeline, x, &x_values);
+    try memory.readFromBuffer(f32, pipeline, y, &y_values);
+
+    inline for (core.types.STORAGE_TYPES) |S| {
+        const a = try Tensor(S).alloc(context, pipeline, &shape, .{});
+        defer a.release(pipeline);
+
+        const b = try Tensor(S).alloc(context, pipeline, &shape, .{});
+        defer b.release(pipeline);
+
+        try tensor_module.convertions.toStorage(S, pipeline, x, a);
+        try tensor_module.convertions.toStorage(S, pipeline, y, b);
+
+        // a = a * b + 0.5
+        var expr = Expression(S).init(allocator);
+        defer expr.deinit();
+
+        const product = try expr.mul(try expr.input(a), try expr.input(b));
+        try expr.materialize(pipeline, try expr.add(product, try expr.scalar(0.5)), a);
+
+        const result = try Tensor(f32).alloc(context, pipeline, &shape, .{});
+        defer result.release(pipeline);
+
+        try tensor_module.convertions.fromStorage(S, pipeline, a, result);
+
+        var values: [15]f32 = undefined;
+        try memory.writeToBuffer(f32, pipeline, result, &values);
+        pipeline.waitAndCleanup();
+
+        const tolerance: f32 = if (S == f16) 1e-2 else 5e-2;
+        for (values, x_values, y_values) |v, xv, yv| {
+            try testing.expectApproxEqAbs(xv * yv + 0.5, v, tolerance);
+        }
+    }
+}
@@ -0,0 +1,123 @@
+#include "wekua.h"
+
+/**
+ * =============================================================================
+ * Broadcasting binary element-wise kernel: c = a OP b
+ * =============================================================================
+ *
+ * COMPILE-TIME PARAMETERS
+ * -----------------------
+ * OPERATION        - 0: add, 1: sub, 2: mul, 3: div, 4: min, 5: max
+ * A_COL_BROADCAST  - 1 if `a` has a single column that must be repeated along
+ *                    the last dimension of `c`
+ * B_COL_BROADCAST  - Same as A_COL_BROADCAST for `b`
+ *
+ * KERNEL PARAMETERS
+ * -----------------
+ * a, b, c                - Operands and result
+ * x_offset               - Offset of the current block of work for operand x
+ * x_depth_pitch          - Pitch of the collapsed leading dimensions of x
+ * x_row_pitch            - Pitch of the penultimate dimension of x
+ * depth, rows, cols      - Real size of the NDRange
+ *
+ * Broadcast dimensions (except the last one) are expressed by a pitch of 0.
+ * Offsets and pitches are expressed in `wk` units, except for operands with
+ * column broadcast, that are read one scalar at a time and are expressed in
+ * `wks` units.
+ *
+ * NDRANGE
+ * -------
+ * (depth, rows, columns / WK_VECTOR_WIDTH), padded up to a multiple of the local size.
+ *
+ * Work items outside of the real range return early, so padding is never written.
+ * =============================================================================
+ */
+
+#if WK_VECTOR_WIDTH > 1
+#define SPLAT(x) ((wk)(x))
+#else
+#define SPLAT(x) (x)
+#endif
+
+#if WK_COMPLEX
+
+inline wks binary_op(const wks x, const wks y) {
+    wks res;
+#if OPERATION == 0
+    res.real = x.real + y.real;
+    res.imag = x.imag + y.imag;
+#elif OPERATION == 1
+    res.real = x.real - y.real;
+    res.imag = x.imag - y.imag;
+#elif OPERATION == 2
+    COMPLEX_MUL_K(T)
+    COMPLEX_MUL(x, y, res)
+#elif OPERATION == 3
+    const T den = y.real * y.real + y.imag * y.imag;
+    res.real = (x.real * y.real + x.imag * y.imag) / den;
+    res.imag = (x.imag * y.real - x.real * y.imag) / den;
+#endif
+    return res;
+}
+
+#define BINARY_OP(x, y) binary_op(x, y)
+
+#else
+
+#if OPERATION == 0
+#define BINARY_OP(x, y) ((x) + (y))
+#elif OPERATION == 1
+#define BINARY_OP(x, y) ((x) - (y))
+#elif OPERATION == 2
+#define BINARY_OP(x, y) ((x) * (y))
+#elif OPERATION == 3
+#define BINARY_OP(x, y) ((x) / (y))
+#elif OPERATION == 4
+#define BINARY_OP(x, y) min(x, y)
+#elif OPERATION == 5
+#define BINARY_OP(x, y) max(x, y)
+#endif
+
+#endif
+
+__kernel void binary(
+    __global const wk *const a,
+    __global const wk *const b,
+    __global wk *const c,
+
+    const ulong a_offset,
+    const ulong a_depth_pitch,
+    const ulong a_row_pitch,
+
+    const ulong b_offset,
+    const ulong b_depth_pitch,
+    const ulong b_row_pitch,
+
+    const ulong c_offset,
+    const ulong c_depth_pitch,
+    const ulong c_row_pitch,
+
+    const ulong depth,
+    const ulong rows,
+    const ulong cols
+) {
+    const ulong i = get_global_id(0);
+    const ulong j = get_global_id(1);
+    const ulong k = get_global_id(2);
+
+    if (i >= depth || j >= rows || k >= cols) return;
+
+#if A_COL_BROADCAST
+    const wk a_value = SPLAT(((__global const wks *)a)[a_offset + i * a_depth_pitch + j * a_row_pitch]);
+#else
+    const wk a_value = a[a_offset + i * a_depth_pitch + j * a_row_pitch + k];
+#endif
+
+#if B_COL_BROADCAST
+    const wk b_value = SPLAT(((__global const wks *)b)[b_offset + i * b_depth_pitch + j * b_row_pitch]);
+#else
+    const wk b_value = b[b_offset + i * b_depth_pitch + j * b_row_pitch + k];
+#endif
+
+    c[c_offset + i * c_depth_pitch + j * c_row_pitch + k] = BINARY_OP(a_value, b_value);
+}
@@ -1,5 +1,7 @@
 #include "wekua.h"
 
+// The NDRange is padded to a multiple of the local size, work items outside of the real one return
+// early.
 __kernel void dot_kernel(
     __global wk *const restrict x,
     __global const wk *const restrict y
@@ -9,17 +11,27 @@ __kernel void dot_kernel(
     const ulong x_row_pitch,
 
     const ulong y_slice_pitch,
-    const ulong y_row_pitch
+    const ulong y_row_pitch,
+
+    const ulong depth,
+    const ulong rows,
+    const ulong cols
+#else
+    , const ulong n
 #endif
 ) {
 #if WK_VECTOR_WIDTH > 1
     const ulong x_index = get_global_id(0);
+    if (x_index >= n) return;
+
     const ulong y_index = x_index;
 #else
     const ulong i = get_global_id(0);
     const ulong j = get_global_id(1);
     const ulong k = get_global_id(2);
 
+    if (i >= depth || j >= rows || k >= cols) return;
+
     const ulong x_index = i * x_slice_pitch + j * x_row_pitch + k;
     const ulong y_index = i * y_slice_pitch + j * y_row_pitch + k;
 #endif
@@ -0,0 +1,57 @@
+#include "wekua.h"
+
+// Planar complex tensors: the real and imaginary parts live in two tensors with the same layout,
+// so every kernel works on whole vectors of each part. The NDRange is padded to a multiple of the
+// local size, work items past `n` return early.
+
+__kernel void planar_mul_kernel(
+    __global wk *const restrict x_real,
+    __global wk *const restrict x_imag,
+    __global const wk *const restrict y_real,
+    __global const wk *const restrict y_imag,
+
+    const ulong n
+) {
+    const ulong index = get_global_id(0);
+    if (index >= n) return;
+
+    const wk a = x_real[index];
+    const wk b = x_imag[index];
+    const wk c = y_real[index];
+    const wk d = y_imag[index];
+
+    x_real[index] = a * c - b * d;
+    x_imag[index] = a * d + b * c;
+}
+
+__kernel void planar_sin_kernel(
+    __global wk *const restrict real,
+    __global wk *const restrict imag,
+
+    const ulong n
+) {
+    const ulong index = get_global_id(0);
+    if (index >= n) return;
+
+    const wk a = real[index];
+    const wk b = imag[index];
+
+    real[index] = sin(a) * cosh(b);
+    imag[index] = cos(a) * sinh(b);
+}
+
+__kernel void planar_cos_kernel(
+    __global wk *const restrict real,
+    __global wk *const restrict imag,
+
+    const ulong n
+) {
+    const ulong index = get_global_id(0);
+    if (index >= n) return;
+
+    const wk a = real[index];
+    const wk b = imag[index];
+
+    real[index] = cos(a) * cosh(b);
+    imag[index] = -sin(a) * sinh(b);
+}
@@ -7,11 +7,15 @@ __kernel void sum_kernel(
     const ulong row_pitch,
     const ulong slice_pitch,
 
-    const ulong row_pitch2
+    const ulong row_pitch2,
+    const ulong depth
 ) {
     const ulong i = get_global_id(0);
     const ulong j = get_global_id(1);
 
+    // The NDRange is padded to a multiple of the local size, row_pitch2 is the number of rows
+    if (i >= depth || j >= row_pitch2) return;
+
     const ulong index = i * slice_pitch + j * row_pitch;
 
 #if WK_COMPLEX
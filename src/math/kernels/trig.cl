@@ -1,7 +1,11 @@
 #include "wekua.h"
 
-__kernel void sin_kernel(__global wk *const restrict input) {
+// The NDRange is padded to a multiple of the local size, work items past `n` return early.
+
+__kernel void sin_kernel(__global wk *const restrict input, const ulong n) {
     const ulong index = get_global_id(0);
+    if (index >= n) return;
+
 #if WK_COMPLEX
     const wk val = input[index];
     input[index] = (wk){ sin(val.real) * cosh(val.imag), cos(val.real) * sinh(val.imag) };
@@ -10,8 +14,10 @@ __kernel void sin_kernel(__global wk *const restrict input) {
 #endif
 }
 
-__kernel void cos_kernel(__global wk *const restrict input) {
+__kernel void cos_kernel(__global wk *const restrict input, const ulong n) {
     const ulong index = get_global_id(0);
+    if (index >= n) return;
+
 #if WK_COMPLEX
     const wk val = input[index];
     input[index] = (wk){ cos(val.real) * cosh(val.imag), -sin(val.real) * sinh(val.imag) };
@@ -20,8 +26,10 @@ __kernel void cos_kernel(__global wk *const restrict input) {
 #endif
 }
 
-__kernel void tan_kernel(__global wk *const restrict input) {
+__kernel void tan_kernel(__global wk *const restrict input, const ulong n) {
     const ulong index = get_global_id(0);
+    if (index >= n) return;
+
 #if WK_COMPLEX
     const wk val = input[index];
     const T two_a = 2 * val.real;
@@ -33,8 +41,10 @@ __kernel void tan_kernel(__global wk *const restrict input) {
 #endif
 }
 
-__kernel void sinh_kernel(__global wk *const restrict input) {
+__kernel void sinh_kernel(__global wk *const restrict input, const ulong n) {
     const ulong index = get_global_id(0);
+    if (index >= n) return;
+
 #if WK_COMPLEX
     const wk val = input[index];
     input[index] = (wk){ sinh(val.real) * cos(val.imag), cosh(val.real) * sin(val.imag) };
@@ -43,8 +53,10 @@ __kernel void sinh_kernel(__global wk *const restrict input) {
 #endif
 }
 
-__kernel void cosh_kernel(__global wk *const restrict input) {
+__kernel void cosh_kernel(__global wk *const restrict input, const ulong n) {
     const ulong index = get_global_id(0);
+    if (index >= n) return;
+
 #if WK_COMPLEX
     const wk val = input[index];
     input[index] = (wk){ cosh(val.real) * cos(val.imag), sinh(val.real) * sin(val.imag) };
@@ -53,8 +65,10 @@ __kernel void cosh_kernel(__global wk *const restrict input) {
 #endif
 }
 
-__kernel void tanh_kernel(__global wk *const restrict input) {
+__kernel void tanh_kernel(__global wk *const restrict input, const ulong n) {
     const ulong index = get_global_id(0);
+    if (index >= n) return;
+
 #if WK_COMPLEX
     const wk val = input[index];
     const T two_a = 2 * val.real;
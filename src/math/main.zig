@@ -1,5 +1,8 @@
 pub const trig = @import("trig.zig");
 pub const basic = @import("basic.zig");
+pub const binary = @import("binary.zig");
+pub const expression = @import("expression.zig");
+pub const planar = @import("planar.zig");
 
 pub const sin = trig.sin;
 pub const cos = trig.cos;
@@ -12,7 +15,19 @@ pub const dot = basic.dot;
 pub const sum = basic.sum;
 pub const mean = basic.mean;
 
+pub const add = binary.add;
+pub const sub = binary.sub;
+pub const mul = binary.mul;
+pub const div = binary.div;
+pub const min = binary.min;
+pub const max = binary.max;
+
+pub const Expression = expression.Expression;
+
 test {
     _ = trig;
     _ = basic;
+    _ = binary;
+    _ = expression;
+    _ = planar;
 }
@@ -0,0 +1,187 @@
+const std = @import("std");
+const cl = @import("opencl");
+
+const core = @import("core");
+const Pipeline = core.Pipeline;
+const KernelsSet = core.KernelsSet;
+
+const tensor_module = @import("tensor");
+const PlanarComplex = tensor_module.PlanarComplex;
+const TensorErrors = tensor_module.Errors;
+
+const planar_cl_kernel: []const u8 = @embedFile("kernels/planar.cl");
+
+fn enqueue(
+    comptime T: type,
+    pipeline: *Pipeline,
+    kernel_id: KernelsSet.KernelsID,
+    kernel_name: []const u8,
+    tensors: []const PlanarComplex(T),
+) TensorErrors!void {
+    const x = tensors[0];
+    for (tensors[1..]) |t| {
+        if (!x.sameLayout(t)) return TensorErrors.UnqualTensorsAttribute;
+    }
+
+    const command_queue = pipeline.command_queue;
+    const vectors_enabled = x.real.flags.vectors_enabled;
+
+    const kernel = try KernelsSet.getClKernel(
+        T,
+        command_queue,
+        vectors_enabled,
+        kernel_id,
+        kernel_name,
+        planar_cl_kernel,
+        null,
+    );
+
+    // The result is written to the first operand
+    x.real.markModified();
+    x.imag.markModified();
+
+    const prev_events = pipeline.prevEvents();
+
+    const setArg = cl.kernel.setArg;
+    const cl_mem_size = @sizeOf(cl.buffer.Mem);
+
+    for (tensors, 0..) |t, i| {
+        try setArg(kernel, @intCast(2 * i), cl_mem_size, @ptrCast(&t.real.buffer));
+        try setArg(kernel, @intCast(2 * i + 1), cl_mem_size, @ptrCast(&t.imag.buffer));
+    }
+
+    const global_work_items = [1]u64{
+        if (vectors_enabled) x.real.memory_layout.number_of_vectors else x.real.dimensions.number_of_elements,
+    };
+    try setArg(kernel, @intCast(2 * tensors.len), @sizeOf(u64), @ptrCast(&global_work_items[0]));
+
+    var padded_global_work_items: [1]u64 = undefined;
+    var local_work_items: [1]u64 = undefined;
+    core.WorkGroupTuner.getLocalWorkItems(
+        command_queue,
+        kernel_name,
+        KernelsSet.getClKernelIndex(T, vectors_enabled),
+        &global_work_items,
+        &padded_global_work_items,
+        &local_work_items,
+    );
+
+    var new_event: cl.event.Event = undefined;
+    try cl.kernel.enqueueNdRange(
+        command_queue.cl_command_queue,
+        kernel,
+        null,
+        &padded_global_work_items,
+        &local_work_items,
+        prev_events,
+        &new_event,
+    );
+    errdefer tensor_module.helpers.releaseEvent(new_event);
+
+    try pipeline.append(&.{new_event});
+}
+
+/// Element-wise complex product `x *= y`. Both tensors must have the same layout.
+pub fn mul(
+    comptime T: type,
+    pipeline: *Pipeline,
+    x: PlanarComplex(T),
+    y: PlanarComplex(T),
+) TensorErrors!void {
+    try enqueue(T, pipeline, .PlanarMul, "planar_mul_kernel", &.{ x, y });
+}
+
+pub fn sin(
+    comptime T: type,
+    pipeline: *Pipeline,
+    x: PlanarComplex(T),
+) TensorErrors!void {
+    try enqueue(T, pipeline, .PlanarSin, "planar_sin_kernel", &.{x});
+}
+
+pub fn cos(
+    comptime T: type,
+    pipeline: *Pipeline,
+    x: PlanarComplex(T),
+) TensorErrors!void {
+    try enqueue(T, pipeline, .PlanarCos, "planar_cos_kernel", &.{x});
+}
+
+// -----------------------------------------------------------------------------
+// Unit Tests
+const testing = std.testing;
+
+const Tensor = tensor_module.Tensor;
+const ComplexF32 = core.types.ComplexF32;
+
+const basic = @import("basic.zig");
+const trig = @import("trig.zig");
+
+test "planar - mul, sin and cos match the interleaved kernels" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(ComplexF32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const shape = [_]u64{ 3, 7 };
+
+    const x = try Tensor(ComplexF32).alloc(context, pipeline, &shape, .{});
+    defer x.release(pipeline);
+
+    const y = try Tensor(ComplexF32).alloc(context, pipeline, &shape, .{});
+    defer y.release(pipeline);
+
+    var x_values: [21]ComplexF32 = undefined;
+    var y_values: [21]ComplexF32 = undefined;
+    for (&x_values, &y_values, 0..) |*xv, *yv, i| {
+        const f: f32 = @floatFromInt(i);
+        xv.* = .{ .real = f * 0.1, .imag = 0.5 - f * 0.05 };
+        yv.* = .{ .real = 1 - f * 0.02, .imag = f * 0.03 };
+    }
+
+    try tensor_module.memory.readFromBuffer(ComplexF32, pipeline, x, &x_values);
+    try tensor_module.memory.readFromBuffer(ComplexF32, pipeline, y, &y_values);
+
+    const planar_x = try PlanarComplex(f32).alloc(context, pipeline, &shape, .{});
+    defer planar_x.release(pipeline);
+
+    const planar_y = try PlanarComplex(f32).alloc(context, pipeline, &shape, .{});
+    defer planar_y.release(pipeline);
+
+    try planar_x.fromInterleaved(pipeline, x);
+    try planar_y.fromInterleaved(pipeline, y);
+
+    // Same operations on both forms
+    try basic.dot(ComplexF32, pipeline, x, y);
+    try trig.sin(ComplexF32, pipeline, x);
+    try trig.cos(ComplexF32, pipeline, x);
+
+    try mul(f32, pipeline, planar_x, planar_y);
+    try sin(f32, pipeline, planar_x);
+    try cos(f32, pipeline, planar_x);
+
+    const result = try Tensor(ComplexF32).alloc(context, pipeline, &shape, .{});
+    defer result.release(pipeline);
+    try planar_x.toInterleaved(pipeline, result);
+
+    var expected: [21]ComplexF32 = undefined;
+    var values: [21]ComplexF32 = undefined;
+    try tensor_module.memory.writeToBuffer(ComplexF32, pipeline, x, &expected);
+    try tensor_module.memory.writeToBuffer(ComplexF32, pipeline, result, &values);
+    pipeline.waitAndCleanup();
+
+    for (expected, values) |e, v| {
+        try testing.expectApproxEqAbs(e.real, v.real, 1e-4);
+        try testing.expectApproxEqAbs(e.imag, v.imag, 1e-4);
+    }
+
+    const other = try PlanarComplex(f32).alloc(context, pipeline, &.{ 7, 3 }, .{});
+    defer other.release(pipeline);
+    try testing.expectError(TensorErrors.UnqualTensorsAttribute, mul(f32, pipeline, planar_x, other));
+}
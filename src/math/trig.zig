@@ -31,6 +31,8 @@ fn genericTrigFunction(
         null,
     );
 
+    tensor.markModified();
+
     const prev_events = pipeline.prevEvents();
 
     const setArg = cl.kernel.setArg;
@@ -38,25 +40,29 @@ fn genericTrigFunction(
 
     try setArg(kernel, 0, cl_mem_size, @ptrCast(&tensor.buffer));
 
-    const wekua_id = command_queue.wekua_id;
-    var global_work_items: [1]u64 = undefined;
-    var local_work_items: []const u64 = undefined;
+    const global_work_items = [1]u64{
+        if (tensor.flags.vectors_enabled) tensor.memory_layout.number_of_vectors else tensor.dimensions.number_of_elements,
+    };
+    try setArg(kernel, 1, @sizeOf(u64), @ptrCast(&global_work_items[0]));
 
-    if (tensor.flags.vectors_enabled) {
-        global_work_items = .{tensor.memory_layout.number_of_vectors};
-        local_work_items = tensor.work_configuration.local_work_items_for_vectors_1d[wekua_id .. wekua_id + 1];
-    } else {
-        global_work_items = .{tensor.dimensions.number_of_elements};
-        local_work_items = tensor.work_configuration.local_work_items_1d[wekua_id .. wekua_id + 1];
-    }
+    var padded_global_work_items: [1]u64 = undefined;
+    var local_work_items: [1]u64 = undefined;
+    core.WorkGroupTuner.getLocalWorkItems(
+        command_queue,
+        kernel_name,
+        KernelsSet.getClKernelIndex(T, tensor.flags.vectors_enabled),
+        &global_work_items,
+        &padded_global_work_items,
+        &local_work_items,
+    );
 
     var new_event: cl.event.Event = undefined;
     try cl.kernel.enqueueNdRange(
         command_queue.cl_command_queue,
         kernel,
         null,
-        &global_work_items,
-        local_work_items,
+        &padded_global_work_items,
+        &local_work_items,
         prev_events,
         &new_event,
     );
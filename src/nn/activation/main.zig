@@ -10,6 +10,8 @@ const Pipeline = core.Pipeline;
 const tensor_module = @import("tensor");
 const TensorErrors = tensor_module.Errors;
 
+const blas = @import("blas");
+
 const Tensor = tensor_module.Tensor;
 
 // TODO: Implement activations for integers
@@ -36,6 +38,10 @@ pub fn Activation(comptime T: type) type {
         ptr: *anyopaque,
         vtable: VTable,
 
+        // Same activation done by the epilogue of the GEMM kernels, layers producing their output
+        // with a GEMM use it instead of `run` when it isn't `.none`
+        gemm_activation: blas.GemmEpilogueActivation = .none,
+
         const Self = @This();
 
         pub inline fn run(
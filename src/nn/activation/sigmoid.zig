@@ -31,6 +31,7 @@ pub fn Sigmoid(comptime T: type) type {
                     .getDerivative = &getDerivative,
                 },
                 .ptr = undefined,
+                .gemm_activation = .sigmoid,
             };
         }
 
@@ -49,6 +50,8 @@ pub fn Sigmoid(comptime T: type) type {
                 null,
             );
 
+            net_output.markModified();
+
             const prev_events = pipeline.prevEvents();
 
             const setArg = cl.kernel.setArg;
@@ -102,6 +105,8 @@ pub fn Sigmoid(comptime T: type) type {
                 null,
             );
 
+            derivative.markModified();
+
             const prev_events = pipeline.prevEvents();
 
             const setArg = cl.kernel.setArg;
@@ -49,6 +49,8 @@ pub fn Tanh(comptime T: type) type {
                 null,
             );
 
+            derivative.markModified();
+
             const prev_events = pipeline.prevEvents();
 
             const setArg = cl.kernel.setArg;
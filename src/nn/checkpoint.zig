@@ -0,0 +1,283 @@
+const std = @import("std");
+
+const core = @import("core");
+const Pipeline = core.Pipeline;
+
+const tensor_module = @import("tensor");
+const tensor_checkpoint = tensor_module.checkpoint;
+
+const layer_module = @import("layer/main.zig");
+const optimizer_module = @import("optimizers/main.zig");
+
+pub const Errors = tensor_checkpoint.Errors;
+pub const SaveOptions = tensor_checkpoint.SaveOptions;
+pub const LoadOptions = tensor_checkpoint.LoadOptions;
+
+// Weights, then the bias that are enabled, then every state group of the optimizer. The order
+// only depends on the architecture, so a checkpoint can be loaded in a model built the same way.
+fn collectTensors(
+    comptime T: type,
+    allocator: std.mem.Allocator,
+    model: layer_module.Layer(T),
+    optimizer: ?optimizer_module.Optimizer(T),
+) error{OutOfMemory}![]*tensor_module.Tensor(T) {
+    var tensors: std.ArrayList(*tensor_module.Tensor(T)) = .empty;
+    errdefer tensors.deinit(allocator);
+
+    try tensors.appendSlice(allocator, model.getWeights());
+
+    if (model.getBias()) |bias| {
+        for (bias) |b| {
+            if (b) |v| try tensors.append(allocator, v);
+        }
+    }
+
+    if (optimizer) |o| {
+        var index: usize = 0;
+        while (o.getState(index)) |state| : (index += 1) {
+            try tensors.appendSlice(allocator, state);
+        }
+    }
+
+    return try tensors.toOwnedSlice(allocator);
+}
+
+/// Saves the parameters of `model` (e.g. a `Sequential`) and, if given, the state of
+/// `optimizer` with `tensor.checkpoint.save`.
+pub fn save(
+    comptime T: type,
+    pipeline: *Pipeline,
+    model: layer_module.Layer(T),
+    optimizer: ?optimizer_module.Optimizer(T),
+    path: []const u8,
+    options: SaveOptions,
+) Errors!void {
+    const allocator = pipeline.command_queue.context.allocator;
+
+    const tensors = try collectTensors(T, allocator, model, optimizer);
+    defer allocator.free(tensors);
+
+    try tensor_checkpoint.save(T, pipeline, tensors, path, options);
+}
+
+/// Loads a checkpoint written by `save` in a model (and optimizer) with the same architecture.
+pub fn load(
+    comptime T: type,
+    pipeline: *Pipeline,
+    model: layer_module.Layer(T),
+    optimizer: ?optimizer_module.Optimizer(T),
+    path: []const u8,
+    options: LoadOptions,
+) Errors!void {
+    const allocator = pipeline.command_queue.context.allocator;
+
+    const tensors = try collectTensors(T, allocator, model, optimizer);
+    defer allocator.free(tensors);
+
+    try tensor_checkpoint.load(T, pipeline, tensors, path, options);
+}
+
+// -----------------------------------------------------------------------------
+// Unit Tests
+const cl = @import("opencl");
+const testing = std.testing;
+
+const Linear = layer_module.linear_module.Linear;
+const Sequential = layer_module.sequential_module.Sequential;
+const Cache = layer_module.Cache;
+const mse = @import("loss/main.zig").mse;
+
+fn expectEqualTensors(
+    pipeline: *Pipeline,
+    expected: []const *tensor_module.Tensor(f32),
+    result: []const *tensor_module.Tensor(f32),
+) !void {
+    const allocator = testing.allocator;
+
+    try testing.expectEqual(expected.len, result.len);
+
+    for (expected, result) |e, r| {
+        const n = e.dimensions.number_of_elements_without_padding;
+
+        const expected_values = try allocator.alloc(f32, n);
+        defer allocator.free(expected_values);
+        const values = try allocator.alloc(f32, n);
+        defer allocator.free(values);
+
+        try tensor_module.memory.writeToBuffer(f32, pipeline, e, expected_values);
+        try tensor_module.memory.writeToBuffer(f32, pipeline, r, values);
+        pipeline.waitAndCleanup();
+
+        try testing.expectEqualSlices(f32, expected_values, values);
+    }
+}
+
+fn trainStep(
+    pipeline: *Pipeline,
+    model: layer_module.Layer(f32),
+    optimizer: optimizer_module.Optimizer(f32),
+    cache: *const Cache(f32),
+    input: *tensor_module.Tensor(f32),
+    expected: *tensor_module.Tensor(f32),
+) !void {
+    const layer_cache = cache.getLayerCache(0);
+
+    const output = try model.forward(pipeline, input, layer_cache);
+    try mse(f32, true, pipeline, output, expected, cache, null);
+    try model.backward(pipeline, layer_cache, input, null);
+    try optimizer.step(pipeline, cache);
+}
+
+test "checkpoint - save and load a sequential model" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    var tmp = testing.tmpDir(.{});
+    defer tmp.cleanup();
+
+    const path = try std.fmt.allocPrint(allocator, ".zig-cache/tmp/{s}/model.wkc", .{tmp.sub_path});
+    defer allocator.free(path);
+
+    var models: [2]*Sequential(f32) = undefined;
+    for (&models) |*m| {
+        m.* = try Sequential(f32).init(allocator);
+        errdefer m.*.deinit(pipeline);
+
+        try m.*.append(try Linear(f32).init(context, pipeline, 7, 5, null, .{}));
+        try m.*.append(try Linear(f32).init(context, pipeline, 5, 3, null, .{ .enable_bias = false }));
+    }
+    defer {
+        for (models) |m| m.deinit(pipeline);
+    }
+
+    try save(f32, pipeline, models[0].layer(), null, path, .{});
+    try load(f32, pipeline, models[1].layer(), null, path, .{});
+
+    const saved = try collectTensors(f32, allocator, models[0].layer(), null);
+    defer allocator.free(saved);
+
+    const loaded = try collectTensors(f32, allocator, models[1].layer(), null);
+    defer allocator.free(loaded);
+
+    // Two weights and one bias
+    try testing.expectEqual(@as(usize, 3), saved.len);
+
+    for (saved, loaded) |s, l| {
+        const n = s.dimensions.number_of_elements_without_padding;
+
+        const expected = try allocator.alloc(f32, n);
+        defer allocator.free(expected);
+        const result = try allocator.alloc(f32, n);
+        defer allocator.free(result);
+
+        try tensor_module.memory.writeToBuffer(f32, pipeline, s, expected);
+        try tensor_module.memory.writeToBuffer(f32, pipeline, l, result);
+        pipeline.waitAndCleanup();
+
+        try testing.expectEqualSlices(f32, expected, result);
+    }
+}
+
+test "checkpoint - save and load a model with the state of its optimizer" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    var tmp = testing.tmpDir(.{});
+    defer tmp.cleanup();
+
+    const path = try std.fmt.allocPrint(allocator, ".zig-cache/tmp/{s}/model.wkc", .{tmp.sub_path});
+    defer allocator.free(path);
+
+    const batch = 4;
+
+    var models: [2]*Sequential(f32) = undefined;
+    for (&models) |*m| {
+        m.* = try Sequential(f32).init(allocator);
+        errdefer m.*.deinit(pipeline);
+
+        try m.*.append(try Linear(f32).init(context, pipeline, 7, 5, null, .{}));
+        try m.*.append(try Linear(f32).init(context, pipeline, 5, 3, null, .{}));
+    }
+    defer {
+        for (models) |m| m.deinit(pipeline);
+    }
+
+    const model_layers = [2]layer_module.Layer(f32){ models[0].layer(), models[1].layer() };
+
+    var caches: [2]Cache(f32) = undefined;
+    for (&caches, &model_layers, 0..) |*c, *l, i| {
+        errdefer for (caches[0..i]) |prev| prev.deinit(pipeline);
+        c.* = try Cache(f32).init(context, pipeline, batch, &.{l});
+    }
+    defer {
+        for (caches) |c| c.deinit(pipeline);
+    }
+
+    var optimizers: [2]optimizer_module.Optimizer(f32) = undefined;
+    for (&optimizers, &caches, 0..) |*o, *c, i| {
+        errdefer for (optimizers[0..i]) |prev| prev.deinit(pipeline);
+        o.* = try optimizer_module.Optimizer(f32).GDM.init(context, pipeline, c, .{ .lr = 0.1 });
+    }
+    defer {
+        for (optimizers) |o| o.deinit(pipeline);
+    }
+
+    const input = try tensor_module.Tensor(f32).alloc(context, pipeline, &.{ batch, 7 }, .{});
+    defer input.release(pipeline);
+
+    const expected = try tensor_module.Tensor(f32).alloc(context, pipeline, &.{ batch, 3 }, .{});
+    defer expected.release(pipeline);
+
+    var input_values: [batch * 7]f32 = undefined;
+    for (&input_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i % 9)) / 8 - 0.5;
+    try tensor_module.memory.readFromBuffer(f32, pipeline, input, &input_values);
+
+    var expected_values: [batch * 3]f32 = undefined;
+    for (&expected_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i % 3)) / 2;
+    try tensor_module.memory.readFromBuffer(f32, pipeline, expected, &expected_values);
+
+    // The velocities are only worth saving once a step has been taken
+    try trainStep(pipeline, model_layers[0], optimizers[0], &caches[0], input, expected);
+
+    try save(f32, pipeline, model_layers[0], optimizers[0], path, .{});
+    try load(f32, pipeline, model_layers[1], optimizers[1], path, .{});
+
+    const saved = try collectTensors(f32, allocator, model_layers[0], optimizers[0]);
+    defer allocator.free(saved);
+
+    const loaded = try collectTensors(f32, allocator, model_layers[1], optimizers[1]);
+    defer allocator.free(loaded);
+
+    // Two weights, two bias, and a velocity for each one of them
+    try testing.expectEqual(@as(usize, 8), saved.len);
+    try expectEqualTensors(pipeline, saved, loaded);
+
+    // Both optimizers continue from the same state
+    for (model_layers, optimizers, &caches) |l, o, *c| {
+        try trainStep(pipeline, l, o, c, input, expected);
+    }
+
+    const weights = try collectTensors(f32, allocator, model_layers[0], null);
+    defer allocator.free(weights);
+
+    const loaded_weights = try collectTensors(f32, allocator, model_layers[1], null);
+    defer allocator.free(loaded_weights);
+
+    try expectEqualTensors(pipeline, weights, loaded_weights);
+}
@@ -60,6 +60,15 @@ pub fn Cache(comptime T: type) type {
             };
         }
 
+        /// Runs the layers with a batch of `number_of_elements`, up to the one the cache was
+        /// created for, without reallocating anything.
+        pub fn setBatchSize(self: *const Self, pipeline: *Pipeline, number_of_elements: u64) TensorErrors!void {
+            for (self.slots) |c| {
+                try c.layer.setBatchSize(pipeline, c.cache, number_of_elements);
+            }
+            try self.error_tensor.resize(pipeline, number_of_elements);
+        }
+
         pub inline fn getLayerCache(self: *const Self, index: usize) *anyopaque {
             return self.slots[index].cache;
         }
@@ -75,7 +84,109 @@ pub fn Cache(comptime T: type) type {
     };
 }
 
+// -----------------------------------------------------------------------------
+// Unit Tests
+const cl = @import("opencl");
+const testing = std.testing;
+
+const Linear = layer.linear_module.Linear;
+const Sequential = layer.sequential_module.Sequential;
+const Sigmoid = @import("../activation/main.zig").Sigmoid;
+const mse = @import("../loss/main.zig").mse;
+
 test {
     std.testing.refAllDecls(Cache(f32));
     std.testing.refAllDecls(Cache(f64));
 }
+
+fn expectEqualTensors(pipeline: *Pipeline, expected: *tensor_module.Tensor(f32), result: *tensor_module.Tensor(f32)) !void {
+    const allocator = testing.allocator;
+
+    try testing.expectEqualSlices(u64, expected.dimensions.shape, result.dimensions.shape);
+
+    const n = expected.dimensions.number_of_elements_without_padding;
+
+    const expected_values = try allocator.alloc(f32, n);
+    defer allocator.free(expected_values);
+    const values = try allocator.alloc(f32, n);
+    defer allocator.free(values);
+
+    try tensor_module.memory.writeToBuffer(f32, pipeline, expected, expected_values);
+    try tensor_module.memory.writeToBuffer(f32, pipeline, result, values);
+    pipeline.waitAndCleanup();
+
+    for (expected_values, values) |e, v| {
+        try testing.expectApproxEqAbs(e, v, 1e-4);
+    }
+}
+
+test "Cache.setBatchSize - a shrunk cache gives the results of one built for the batch" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const max_batch = 12;
+    const batch = 5;
+
+    const model = try Sequential(f32).init(allocator);
+    defer model.deinit(pipeline);
+
+    // The sigmoid keeps its derivatives in the cache too, so they are resized as well
+    try model.append(try Linear(f32).init(context, pipeline, 7, 6, Sigmoid(f32).init(), .{}));
+    try model.append(try Linear(f32).init(context, pipeline, 6, 3, null, .{}));
+
+    const model_layer = model.layer();
+    const layers = [_]*const layer.Layer(f32){&model_layer};
+
+    const shrunk = try Cache(f32).init(context, pipeline, max_batch, &layers);
+    defer shrunk.deinit(pipeline);
+
+    const direct = try Cache(f32).init(context, pipeline, batch, &layers);
+    defer direct.deinit(pipeline);
+
+    try shrunk.setBatchSize(pipeline, batch);
+
+    const input = try tensor_module.Tensor(f32).alloc(context, pipeline, &.{ batch, 7 }, .{});
+    defer input.release(pipeline);
+
+    const expected = try tensor_module.Tensor(f32).alloc(context, pipeline, &.{ batch, 3 }, .{});
+    defer expected.release(pipeline);
+
+    var input_values: [batch * 7]f32 = undefined;
+    for (&input_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i % 11)) / 10 - 0.5;
+    try tensor_module.memory.readFromBuffer(f32, pipeline, input, &input_values);
+
+    var expected_values: [batch * 3]f32 = undefined;
+    for (&expected_values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i % 4)) / 4;
+    try tensor_module.memory.readFromBuffer(f32, pipeline, expected, &expected_values);
+
+    var outputs: [2]*tensor_module.Tensor(f32) = undefined;
+    for ([_]*const Cache(f32){ &shrunk, &direct }, &outputs) |cache, *output| {
+        const layer_cache = cache.getLayerCache(0);
+
+        output.* = try model_layer.forward(pipeline, input, layer_cache);
+        try mse(f32, true, pipeline, output.*, expected, cache, null);
+        try model_layer.backward(pipeline, layer_cache, input, null);
+    }
+
+    try expectEqualTensors(pipeline, outputs[1], outputs[0]);
+
+    const shrunk_gradients = model_layer.getGradients(shrunk.getLayerCache(0));
+    const direct_gradients = model_layer.getGradients(direct.getLayerCache(0));
+    for (direct_gradients, shrunk_gradients) |d, s| {
+        try expectEqualTensors(pipeline, d, s);
+    }
+
+    const shrunk_bias_gradients = model_layer.getBiasGradients(shrunk.getLayerCache(0)).?;
+    const direct_bias_gradients = model_layer.getBiasGradients(direct.getLayerCache(0)).?;
+    for (direct_bias_gradients, shrunk_bias_gradients) |d, s| {
+        try expectEqualTensors(pipeline, d.?, s.?);
+    }
+}
@@ -17,7 +17,6 @@ const math = @import("math");
 const activation_module = @import("../activation/main.zig");
 const layer_module = @import("main.zig");
 
-const bias_cl_kernel: []const u8 = @embedFile("kernels/bias.cl");
 const bias_step_cl_kernel: []const u8 = @embedFile("kernels/bias_step.cl");
 
 pub const ExtraParams = struct {
@@ -168,6 +167,7 @@ pub fn Linear(
                     .getBias = &getBias,
                     .prepareCache = &prepareCache,
                     .releaseCache = &releaseCache,
+                    .setBatchSize = &setBatchSize,
                     .forward = &forward,
                     .getSensitivity = &getSensitivity,
                     .backward = &backward,
@@ -272,10 +272,12 @@ pub fn Linear(
             ) |w, *o, *s, *ad, *g, *gb, *gb_li| {
                 const weight_output = w.dimensions.shape[0];
 
-                o.* = try TensorT.alloc(context, pipeline, &.{ number_of_elements, weight_output }, .{});
+                // Outputs and gradients are fully written by GEMM and the sensitivities are filled
+                // right away, only their padding needs to be zero
+                o.* = try TensorT.alloc(context, pipeline, &.{ number_of_elements, weight_output }, .{ .initialization = .padding });
                 errdefer o.*.release(pipeline);
 
-                s.* = try TensorT.alloc(context, pipeline, &.{ number_of_elements, weight_output }, .{});
+                s.* = try TensorT.alloc(context, pipeline, &.{ number_of_elements, weight_output }, .{ .initialization = .padding });
                 errdefer s.*.release(pipeline);
 
                 ad.* = try TensorT.alloc(context, pipeline, &.{ number_of_elements, weight_output }, .{});
@@ -288,7 +290,7 @@ pub fn Linear(
 
                 try tensor_module.fill.constant(T, pipeline, s.*, one_val);
 
-                g.* = try TensorT.alloc(context, pipeline, w.dimensions.shape, .{});
+                g.* = try TensorT.alloc(context, pipeline, w.dimensions.shape, .{ .initialization = .padding });
                 errdefer g.*.release(pipeline);
 
                 gb.* = try TensorT.alloc(context, pipeline, &.{weight_output}, .{});
@@ -317,6 +319,9 @@ pub fn Linear(
             for (self.weights, outputs, forward_packed) |w, o, *fp| {
                 fp.* = try GemmPackedTensors.init(pipeline, o, w.dimensions.shape[1], true);
                 forward_packed_created += 1;
+
+                // The weights are only packed again after they change, not on every forward
+                fp.*.setPersistentB(true);
             }
 
             const grad_packed = try self.allocator.alloc(*GemmPackedTensors, num_layers);
@@ -421,60 +426,50 @@ pub fn Linear(
             allocator.destroy(cache_data);
         }
 
-        fn addBias(
+        fn setBatchSize(
+            ptr: *const anyopaque,
             pipeline: *Pipeline,
-            output: *TensorT,
-            bias_tensor: *TensorT,
+            cache: *anyopaque,
+            number_of_elements: u64,
         ) TensorErrors!void {
-            const command_queue = pipeline.command_queue;
-
-            const vectors_enabled = output.flags.vectors_enabled;
-            const kernel = try KernelsSet.getClKernel(
-                T,
-                command_queue,
-                vectors_enabled,
-                .LinearBias,
-                "bias",
-                bias_cl_kernel,
-                null,
-            );
-
-            const prev_events = pipeline.prevEvents();
-            var row_pitch: u64 = undefined;
-            var num_elements: u64 = undefined;
-            var work_items: u64 = undefined;
-
-            const setArg = cl.kernel.setArg;
-            const cl_mem_size = @sizeOf(cl.buffer.Mem);
-            const wekua_id = command_queue.wekua_id;
+            const self: *const Self = @ptrCast(@alignCast(ptr));
+            const cache_data: *LinearCache = @ptrCast(@alignCast(cache));
 
-            if (vectors_enabled) {
-                row_pitch = output.memory_layout.row_pitch_for_vectors;
-                num_elements = output.memory_layout.number_of_vectors;
-                work_items = output.work_configuration.local_work_items_for_vectors_1d[wekua_id];
-            }else{
-                row_pitch = output.memory_layout.row_pitch;
-                num_elements = output.dimensions.number_of_elements;
-                work_items = output.work_configuration.local_work_items_1d[wekua_id];
+            for (
+                cache_data.outputs,
+                cache_data.sensitivities,
+                cache_data.acti_derivatives,
+            ) |o, s, ad| {
+                try o.resize(pipeline, number_of_elements);
+                try s.resize(pipeline, number_of_elements);
+                try ad.resize(pipeline, number_of_elements);
             }
 
-            try setArg(kernel, 0, cl_mem_size, @ptrCast(&output.buffer));
-            try setArg(kernel, 1, cl_mem_size, @ptrCast(&bias_tensor.buffer));
-            try setArg(kernel, 2, @sizeOf(u64), @ptrCast(&row_pitch));
-
-            var new_event: cl.event.Event = undefined;
-            try cl.kernel.enqueueNdRange(
-                command_queue.cl_command_queue,
-                kernel,
-                null,
-                &.{num_elements},
-                &.{work_items},
-                prev_events,
-                &new_event,
-            );
-            errdefer tensor_module.helpers.releaseEvent(new_event);
+            for (
+                self.weights,
+                cache_data.forward_packed,
+                cache_data.grad_packed,
+                cache_data.sensitivity_packed,
+            ) |w, fp, gp, sp| {
+                const weight_output = w.dimensions.shape[0];
+                const weight_input = w.dimensions.shape[1];
+
+                // output = input * w^T
+                try fp.resize(pipeline, number_of_elements, weight_output, weight_input);
+                // gradient = sensitivity^T * input, the batch is the inner dimension
+                try gp.resize(pipeline, weight_output, weight_input, number_of_elements);
+                // previous sensitivity = sensitivity * w
+                try sp.resize(pipeline, number_of_elements, weight_input, weight_output);
+            }
+        }
 
-            try pipeline.append(&.{new_event});
+        fn addBias(
+            pipeline: *Pipeline,
+            output: *TensorT,
+            bias_tensor: *TensorT,
+        ) TensorErrors!void {
+            // The bias is a row vector broadcast over every row of the output
+            try math.binary.add(T, pipeline, output, bias_tensor, output);
         }
 
         fn forward(
@@ -495,8 +490,23 @@ pub fn Linear(
 
             const activation_layer = self.activation;
 
+            // Bias and activation are done by the GEMM kernels when they can, saving two passes
+            // over the output
+            const fuse_bias = comptime !core.types.isComplex(T);
+            const gemm_activation: blas.GemmEpilogueActivation = blk: {
+                if (!fuse_bias) break :blk .none;
+                if (activation_layer) |*act| break :blk act.gemm_activation;
+                break :blk .none;
+            };
+            const fuse_activation = (gemm_activation != .none);
+
             for (self.weights, outputs_cached, linear_cache.forward_packed, 0..) |weight, output, fwd_pt, index| {
-                try blas.gemm(
+                var epilogue: blas.GemmEpilogue(T) = .{ .activation = gemm_activation };
+                if (fuse_bias and bias_enabled) {
+                    epilogue.bias = bias_slice[index].?;
+                }
+
+                try blas.gemmWithEpilogue(
                     T,
                     pipeline,
                     null,
@@ -507,15 +517,17 @@ pub fn Linear(
                     null,
                     output,
                     fwd_pt,
+                    epilogue,
                 );
 
-                // TODO: avoid this repeated condition
-                if (bias_enabled) {
+                if (!fuse_bias and bias_enabled) {
                     try addBias(pipeline, output, bias_slice[index].?);
                 }
 
-                if (activation_layer) |*act| {
-                    try act.run(pipeline, output);
+                if (!fuse_activation) {
+                    if (activation_layer) |*act| {
+                        try act.run(pipeline, output);
+                    }
                 }
 
                 input = output;
@@ -550,6 +562,8 @@ pub fn Linear(
                 null,
             );
 
+            bias_gradient.markModified();
+
             const prev_events = pipeline.prevEvents();
 
             const setArg = cl.kernel.setArg;
@@ -34,6 +34,13 @@ pub fn Layer(comptime T: type) type {
                 cache: *const anyopaque,
             ) void,
 
+            setBatchSize: *const fn (
+                ptr: *const anyopaque,
+                pipeline: *Pipeline,
+                cache: *anyopaque,
+                number_of_elements: u64,
+            ) TensorErrors!void,
+
             forward: *const fn (
                 ptr: *const anyopaque,
                 pipeline: *Pipeline,
@@ -92,6 +99,17 @@ pub fn Layer(comptime T: type) type {
             self.vtable.releaseCache(@ptrCast(self.ptr), pipeline, cache);
         }
 
+        /// Sets the batch size of a cache to `number_of_elements`, which can't exceed the one it
+        /// was prepared for. Nothing is allocated.
+        pub inline fn setBatchSize(
+            self: *const Self,
+            pipeline: *Pipeline,
+            cache: *anyopaque,
+            number_of_elements: u64,
+        ) TensorErrors!void {
+            return self.vtable.setBatchSize(@ptrCast(self.ptr), pipeline, cache, number_of_elements);
+        }
+
         pub inline fn forward(
             self: *const Self,
             pipeline: *Pipeline,
@@ -49,6 +49,7 @@ pub fn Sequential(comptime T: type) type {
                     .getBias = &getBias,
                     .prepareCache = &prepareCache,
                     .releaseCache = &releaseCache,
+                    .setBatchSize = &setBatchSize,
                     .forward = &forward,
                     .getSensitivity = &getSensitivity,
                     .backward = &backward,
@@ -208,6 +209,20 @@ pub fn Sequential(comptime T: type) type {
             allocator.destroy(cache_data);
         }
 
+        fn setBatchSize(
+            ptr: *const anyopaque,
+            pipeline: *Pipeline,
+            cache: *anyopaque,
+            number_of_elements: u64,
+        ) TensorErrors!void {
+            const self: *const Self = @ptrCast(@alignCast(ptr));
+            const cache_data: *SequentialCache = @ptrCast(@alignCast(cache));
+
+            for (self.layers.items, cache_data.caches) |l, c| {
+                try l.setBatchSize(pipeline, c, number_of_elements);
+            }
+        }
+
         fn forward(
             ptr: *const anyopaque,
             pipeline: *Pipeline,
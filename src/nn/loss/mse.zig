@@ -85,6 +85,8 @@ pub fn mse(
         vectors_enabled,
     );
 
+    error_tensor.markModified();
+
     const prev_events = pipeline.prevEvents();
 
     const setArg = cl.kernel.setArg;
@@ -97,6 +99,7 @@ pub fn mse(
     if (calculate_derivative) {
         const last_slot = cache.slots[cache.slots.len - 1];
         const sensitivity = last_slot.layer.getSensitivity(last_slot.cache);
+        sensitivity.markModified();
 
         try setArg(kernel, 3, cl_mem_size, @ptrCast(&sensitivity.buffer));
     }
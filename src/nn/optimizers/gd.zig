@@ -20,6 +20,7 @@ pub fn GD(comptime T: type) type {
 
     const Cache = layer_mdoule.Cache(T);
     const Optimizer = optimizer_module.Optimizer(T);
+    const TensorT = tensor_module.Tensor(T);
 
     return struct {
         pub const Config = struct {
@@ -46,6 +47,7 @@ pub fn GD(comptime T: type) type {
                 .vtable = .{
                     .step = &step,
                     .zero = &zero,
+                    .getState = &getState,
                     .deinit = &deinit,
                 },
                 .ptr = self,
@@ -74,6 +76,7 @@ pub fn GD(comptime T: type) type {
                         lr,
                         w,
                     );
+                    w.markModified();
                 }
 
                 if (layer_ref.getBiasGradients(slot.cache)) |bias_gradients| {
@@ -95,6 +98,10 @@ pub fn GD(comptime T: type) type {
 
         fn zero(_: *anyopaque, _: *Pipeline) TensorErrors!void {}
 
+        fn getState(_: *const anyopaque, _: usize) ?[]const *TensorT {
+            return null;
+        }
+
         fn deinit(ptr: *anyopaque, _: *Pipeline) void {
             const self: *const Self = @ptrCast(@alignCast(ptr));
             self.allocator.destroy(self);
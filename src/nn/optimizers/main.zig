@@ -2,6 +2,8 @@ const std = @import("std");
 const core = @import("core");
 const Pipeline = core.Pipeline;
 
+const tensor_module = @import("tensor");
+
 const layer = @import("../layer/main.zig");
 
 const gd_module = @import("gd.zig");
@@ -11,6 +13,7 @@ const rmsprop_module = @import("rmsprop.zig");
 
 pub fn Optimizer(comptime T: type) type {
     const Cache = layer.Cache(T);
+    const Tensor = tensor_module.Tensor(T);
 
     return struct {
         pub const GD = gd_module.GD(T);
@@ -25,6 +28,7 @@ pub fn Optimizer(comptime T: type) type {
                 cache: *const Cache,
             ) anyerror!void,
             zero: *const fn (ptr: *anyopaque, pipeline: *Pipeline) anyerror!void,
+            getState: *const fn (ptr: *const anyopaque, index: usize) ?[]const *Tensor,
             deinit: *const fn (ptr: *anyopaque, pipeline: *Pipeline) void,
         };
 
@@ -48,6 +52,12 @@ pub fn Optimizer(comptime T: type) type {
             try self.vtable.zero(self.ptr, pipeline);
         }
 
+        /// Groups of tensors that hold the state of the optimizer (e.g. velocities), in a fixed
+        /// order. Returns null once `index` is past the last group.
+        pub inline fn getState(self: *const Self, index: usize) ?[]const *Tensor {
+            return self.vtable.getState(self.ptr, index);
+        }
+
         pub inline fn deinit(self: *const Self, pipeline: *Pipeline) void {
             self.vtable.deinit(self.ptr, pipeline);
         }
@@ -102,6 +102,7 @@ pub fn RMSProp(comptime T: type) type {
                 .vtable = .{
                     .step = &step,
                     .zero = &zero,
+                    .getState = &getState,
                     .deinit = &deinit,
                 },
                 .ptr = self,
@@ -181,23 +182,23 @@ pub fn RMSProp(comptime T: type) type {
                 const gradients = layer_ref.getGradients(slot.cache);
                 const weights = layer_ref.getWeights();
 
-                var _index = index;
-                for (weights, gradients) |w, g| {
-                    try self.executeRMSProp(pipeline, w, g, gradient_histories[index]);
-                    _index += 1;
+                // A layer can have several weights (e.g. a Sequential), each one has its own state
+                for (weights, gradients, index..) |w, g, i| {
+                    try self.executeRMSProp(pipeline, w, g, gradient_histories[i]);
+                    w.markModified();
                 }
 
                 if (layer_ref.getBiasGradients(slot.cache)) |bias_gradients| {
-                    _index = index;
                     const bias_slice = layer_ref.getBias();
-                    for (bias_slice.?, bias_gradients) |b, maybe_bg| {
+                    for (bias_slice.?, bias_gradients, index..) |b, maybe_bg, i| {
                         const bg = maybe_bg orelse continue;
 
-                        try self.executeRMSProp(pipeline, b.?, bg, bias_gradient_histories[index]);
+                        try self.executeRMSProp(pipeline, b.?, bg, bias_gradient_histories[i]);
+                        b.?.markModified();
                     }
                 }
 
-                index += _index;
+                index += weights.len;
             }
         }
 
@@ -210,6 +211,16 @@ pub fn RMSProp(comptime T: type) type {
             }
         }
 
+        fn getState(ptr: *const anyopaque, index: usize) ?[]const *TensorT {
+            const self: *const Self = @ptrCast(@alignCast(ptr));
+
+            return switch (index) {
+                0 => self.gradient_histories,
+                1 => self.bias_gradient_histories,
+                else => null,
+            };
+        }
+
         fn deinit(ptr: *anyopaque, pipeline: *Pipeline) void {
             const self: *const Self = @ptrCast(@alignCast(ptr));
 
@@ -0,0 +1,363 @@
+const std = @import("std");
+const builtin = @import("builtin");
+const cl = @import("opencl");
+
+const core = @import("core");
+const Pipeline = core.Pipeline;
+
+const tensor_module = @import("main.zig");
+const Tensor = tensor_module.Tensor;
+
+// File layout (little endian, the byte order of the host):
+//   Header
+//   Entry + shape (ndim u64) for every tensor
+//   Data of every tensor, each one starting at a multiple of ALIGNMENT
+//
+// The data of a tensor is its buffer as it is on the device, padding included, so loading it in a
+// tensor with the same layout is a single write straight from the mapped file. Tensors with a
+// different padding (e.g. other vector width) are loaded with a rect copy.
+
+comptime {
+    // The header, the entries and the data are written and read in host byte order
+    if (builtin.cpu.arch.endian() != .little) @compileError("checkpoints need a little endian host");
+}
+
+pub const MAGIC = "WKTC".*;
+pub const VERSION: u32 = 1;
+pub const ALIGNMENT: u64 = 4096;
+
+pub const Errors = tensor_module.Errors || std.fs.File.OpenError || std.fs.File.PWriteError ||
+    std.fs.File.StatError || std.posix.MMapError || error{
+    InvalidCheckpoint,
+    UnsupportedCheckpointVersion,
+    CheckpointMismatch,
+    ChecksumMismatch,
+};
+
+const Header = extern struct {
+    magic: [4]u8,
+    version: u32,
+    number_of_tensors: u64,
+};
+
+const Entry = extern struct {
+    type_index: u32,
+    ndim: u32,
+    flags: u32,
+    reserved: u32 = 0,
+    row_pitch: u64,
+    slice_pitch: u64,
+    data_offset: u64,
+    data_size: u64,
+    checksum: u64,
+};
+
+const FLAG_VECTORS_ENABLED: u32 = 1;
+const FLAG_HAS_CHECKSUM: u32 = 2;
+
+pub const SaveOptions = struct {
+    checksums: bool = true,
+};
+
+pub const LoadOptions = struct {
+    verify_checksums: bool = true,
+};
+
+fn getTableSize(comptime T: type, tensors: []const *Tensor(T)) u64 {
+    var size: u64 = @sizeOf(Header);
+    for (tensors) |t| {
+        size += @sizeOf(Entry) + t.dimensions.shape.len * @sizeOf(u64);
+    }
+    return size;
+}
+
+fn waitEvent(event: cl.event.Event) void {
+    cl.event.waitForMany(&.{event}) catch |err| {
+        std.debug.panic("Unexpected error ({s}) while waiting for events", .{@errorName(err)});
+    };
+    cl.event.release(event);
+}
+
+/// Saves `tensors` in `path`. Blocks until everything is written.
+pub fn save(
+    comptime T: type,
+    pipeline: *Pipeline,
+    tensors: []const *Tensor(T),
+    path: []const u8,
+    options: SaveOptions,
+) Errors!void {
+    const command_queue = pipeline.command_queue;
+    const allocator = command_queue.context.allocator;
+
+    const file = try std.fs.cwd().createFile(path, .{});
+    defer file.close();
+
+    const table = try allocator.alloc(u8, getTableSize(T, tensors));
+    defer allocator.free(table);
+
+    var table_stream = std.io.fixedBufferStream(table);
+    const table_writer = table_stream.writer();
+
+    table_writer.writeStruct(Header{
+        .magic = MAGIC,
+        .version = VERSION,
+        .number_of_tensors = tensors.len,
+    }) catch unreachable;
+
+    const prev_events = pipeline.prevEvents();
+
+    var data_offset = std.mem.alignForward(u64, table.len, ALIGNMENT);
+    for (tensors) |t| {
+        const data = try allocator.alloc(T, t.memory_layout.size / @sizeOf(T));
+        defer allocator.free(data);
+
+        const bytes = std.mem.sliceAsBytes(data);
+
+        var new_event: cl.event.Event = undefined;
+        try cl.buffer.read(
+            command_queue.cl_command_queue,
+            t.buffer,
+            false,
+            0,
+            bytes.len,
+            bytes.ptr,
+            prev_events,
+            &new_event,
+        );
+        waitEvent(new_event);
+
+        var flags: u32 = 0;
+        if (t.flags.vectors_enabled) flags |= FLAG_VECTORS_ENABLED;
+        if (options.checksums) flags |= FLAG_HAS_CHECKSUM;
+
+        table_writer.writeStruct(Entry{
+            .type_index = core.types.getTypeIndex(T),
+            .ndim = @intCast(t.dimensions.shape.len),
+            .flags = flags,
+            .row_pitch = t.memory_layout.row_pitch,
+            .slice_pitch = t.memory_layout.slice_pitch,
+            .data_offset = data_offset,
+            .data_size = bytes.len,
+            .checksum = if (options.checksums) std.hash.XxHash64.hash(0, bytes) else 0,
+        }) catch unreachable;
+
+        for (t.dimensions.shape) |s| {
+            table_writer.writeInt(u64, s, .little) catch unreachable;
+        }
+
+        try file.pwriteAll(bytes, data_offset);
+        data_offset = std.mem.alignForward(u64, data_offset + bytes.len, ALIGNMENT);
+    }
+
+    try file.pwriteAll(table, 0);
+}
+
+fn loadTensor(
+    comptime T: type,
+    pipeline: *Pipeline,
+    tensor: *Tensor(T),
+    entry: Entry,
+    data: []const u8,
+    prev_events: ?[]const cl.event.Event,
+) Errors!cl.event.Event {
+    const command_queue = pipeline.command_queue;
+    const cmd = command_queue.cl_command_queue;
+
+    tensor.markModified();
+
+    var new_event: cl.event.Event = undefined;
+    if (entry.row_pitch == tensor.memory_layout.row_pitch and
+        entry.slice_pitch == tensor.memory_layout.slice_pitch and
+        entry.data_size == tensor.memory_layout.size)
+    {
+        try cl.buffer.write(cmd, tensor.buffer, false, 0, data.len, data.ptr, prev_events, &new_event);
+        return new_event;
+    }
+
+    // Same tensor with a different padding
+    const shape = tensor.dimensions.shape;
+    const ndim = shape.len;
+    const height: usize = if (ndim >= 2) shape[ndim - 2] else 1;
+
+    var depth: usize = 1;
+    if (ndim >= 3) {
+        for (shape[0..(ndim - 2)]) |e| depth *= e;
+    }
+
+    const origin: [3]usize = .{ 0, 0, 0 };
+    const region: [3]usize = .{ shape[ndim - 1] * @sizeOf(T), height, depth };
+
+    const host_row_pitch = entry.row_pitch * @sizeOf(T);
+    const host_slice_pitch = entry.slice_pitch * @sizeOf(T);
+    if ((depth - 1) * host_slice_pitch + (height - 1) * host_row_pitch + region[0] > data.len) {
+        return error.InvalidCheckpoint;
+    }
+
+    try cl.buffer.writeRect(
+        cmd,
+        tensor.buffer,
+        false,
+        &origin,
+        &origin,
+        &region,
+        tensor.memory_layout.row_pitch * @sizeOf(T),
+        tensor.memory_layout.slice_pitch * @sizeOf(T),
+        host_row_pitch,
+        host_slice_pitch,
+        data.ptr,
+        prev_events,
+        &new_event,
+    );
+    return new_event;
+}
+
+/// Loads a checkpoint written by `save` into `tensors`, that must have the same number of tensors
+/// with the same type and shapes. The file is mapped and every tensor is uploaded straight from
+/// the mapping. Blocks until everything is uploaded.
+pub fn load(
+    comptime T: type,
+    pipeline: *Pipeline,
+    tensors: []const *Tensor(T),
+    path: []const u8,
+    options: LoadOptions,
+) Errors!void {
+    const file = try std.fs.cwd().openFile(path, .{});
+    defer file.close();
+
+    const file_size = (try file.stat()).size;
+    if (file_size < @sizeOf(Header)) return error.InvalidCheckpoint;
+
+    const content = try std.posix.mmap(
+        null,
+        file_size,
+        std.posix.PROT.READ,
+        .{ .TYPE = .PRIVATE },
+        file.handle,
+        0,
+    );
+    defer std.posix.munmap(content);
+
+    var stream = std.io.fixedBufferStream(content);
+    const reader = stream.reader();
+
+    const header = reader.readStruct(Header) catch return error.InvalidCheckpoint;
+    if (!std.mem.eql(u8, &header.magic, &MAGIC)) return error.InvalidCheckpoint;
+    if (header.version != VERSION) return error.UnsupportedCheckpointVersion;
+    if (header.number_of_tensors != tensors.len) return error.CheckpointMismatch;
+
+    const prev_events = pipeline.prevEvents();
+
+    // The mapping must outlive every upload
+    var events: std.ArrayList(cl.event.Event) = .empty;
+    const allocator = pipeline.command_queue.context.allocator;
+    defer {
+        for (events.items) |e| waitEvent(e);
+        events.deinit(allocator);
+    }
+    try events.ensureTotalCapacity(allocator, tensors.len);
+
+    for (tensors) |t| {
+        const entry = reader.readStruct(Entry) catch return error.InvalidCheckpoint;
+        if (entry.type_index != core.types.getTypeIndex(T)) return error.CheckpointMismatch;
+        if (entry.ndim != t.dimensions.shape.len) return error.CheckpointMismatch;
+
+        for (t.dimensions.shape) |s| {
+            const stored = reader.readInt(u64, .little) catch return error.InvalidCheckpoint;
+            if (stored != s) return error.CheckpointMismatch;
+        }
+
+        const end = std.math.add(u64, entry.data_offset, entry.data_size) catch return error.InvalidCheckpoint;
+        if (end > content.len) return error.InvalidCheckpoint;
+
+        const data = content[entry.data_offset..end];
+        if (options.verify_checksums and (entry.flags & FLAG_HAS_CHECKSUM) != 0) {
+            if (std.hash.XxHash64.hash(0, data) != entry.checksum) return error.ChecksumMismatch;
+        }
+
+        const new_event = try loadTensor(T, pipeline, t, entry, data, prev_events);
+        events.appendAssumeCapacity(new_event);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Unit Tests
+const testing = std.testing;
+
+const memory = tensor_module.memory;
+
+test "checkpoint - save and load tensors" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    var tmp = testing.tmpDir(.{});
+    defer tmp.cleanup();
+
+    const path = try std.fmt.allocPrint(allocator, ".zig-cache/tmp/{s}/tensors.wkc", .{tmp.sub_path});
+    defer allocator.free(path);
+
+    const shapes = [_][]const u64{ &.{ 3, 5 }, &.{ 2, 3, 7 }, &.{9} };
+
+    var saved: [shapes.len]*Tensor(f32) = undefined;
+    var loaded: [shapes.len]*Tensor(f32) = undefined;
+    for (shapes, &saved, &loaded, 0..) |shape, *s, *l, i| {
+        s.* = try Tensor(f32).alloc(context, pipeline, shape, .{});
+        l.* = try Tensor(f32).alloc(context, pipeline, shape, .{ .vectors_enabled = (i != 1) });
+
+        const values = try allocator.alloc(f32, s.*.dimensions.number_of_elements_without_padding);
+        defer allocator.free(values);
+        for (values, 0..) |*v, j| v.* = @floatFromInt(j * (i + 1));
+
+        try memory.readFromBuffer(f32, pipeline, s.*, values);
+        pipeline.waitAndCleanup();
+    }
+    defer {
+        for (saved, loaded) |s, l| {
+            s.release(pipeline);
+            l.release(pipeline);
+        }
+    }
+
+    try save(f32, pipeline, &saved, path, .{});
+    try load(f32, pipeline, &loaded, path, .{});
+
+    for (saved, loaded) |s, l| {
+        const n = s.dimensions.number_of_elements_without_padding;
+
+        const expected = try allocator.alloc(f32, n);
+        defer allocator.free(expected);
+        const result = try allocator.alloc(f32, n);
+        defer allocator.free(result);
+
+        try memory.writeToBuffer(f32, pipeline, s, expected);
+        try memory.writeToBuffer(f32, pipeline, l, result);
+        pipeline.waitAndCleanup();
+
+        try testing.expectEqualSlices(f32, expected, result);
+    }
+
+    // Wrong number of tensors and wrong shapes
+    try testing.expectError(error.CheckpointMismatch, load(f32, pipeline, saved[0..2], path, .{}));
+
+    const other = try Tensor(f32).alloc(context, pipeline, &.{ 5, 3 }, .{});
+    defer other.release(pipeline);
+    try testing.expectError(
+        error.CheckpointMismatch,
+        load(f32, pipeline, &.{ other, loaded[1], loaded[2] }, path, .{}),
+    );
+
+    // Corrupted data
+    {
+        const file = try std.fs.cwd().openFile(path, .{ .mode = .read_write });
+        defer file.close();
+        try file.pwriteAll(&.{ 0xff, 0xff, 0xff, 0xff }, ALIGNMENT);
+    }
+    try testing.expectError(error.ChecksumMismatch, load(f32, pipeline, &loaded, path, .{}));
+}
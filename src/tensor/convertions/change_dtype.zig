@@ -0,0 +1,324 @@
+const std = @import("std");
+const cl = @import("opencl");
+
+const core = @import("core");
+const Pipeline = core.Pipeline;
+const CommandQueue = core.CommandQueue;
+const KernelsSet = core.KernelsSet;
+
+const tensor_module = @import("../main.zig");
+const Tensor = tensor_module.Tensor;
+const TensorErrors = tensor_module.Errors;
+
+const helpers = @import("../helpers.zig");
+
+const change_dtype_cl_kernel: []const u8 = @embedFile("kernels/change_dtype.cl");
+
+/// `dst = src * scale + offset`, computed in f64 when one of the types is based on f64 and in
+/// f32 otherwise. For complex numbers the offset is only added to the real part.
+pub const Affine = struct {
+    scale: f64 = 1,
+    offset: f64 = 0,
+};
+
+fn getClTypeName(comptime T: type) []const u8 {
+    return switch (core.types.getType(T)) {
+        i8 => "char",
+        u8 => "uchar",
+        i16 => "short",
+        u16 => "ushort",
+        i32 => "int",
+        u32 => "uint",
+        i64 => "long",
+        u64 => "ulong",
+        f32 => "float",
+        f64 => "double",
+        else => unreachable,
+    };
+}
+
+fn getAffineType(comptime SrcT: type, comptime DstT: type) type {
+    return if (core.types.getType(SrcT) == f64 or core.types.getType(DstT) == f64) f64 else f32;
+}
+
+// Index of the build of the kernel in its set, also the variant of its tuned local sizes
+fn getKernelIndex(comptime SrcT: type, comptime DstT: type, vectors_enabled: bool, has_affine: bool) usize {
+    const SUPPORTED_TYPES = core.types.SUPPORTED_TYPES;
+    const number_of_pairs = SUPPORTED_TYPES.len * SUPPORTED_TYPES.len;
+
+    var kernel_index: usize = @intFromBool(vectors_enabled) * (2 * number_of_pairs);
+    kernel_index += @intFromBool(has_affine) * number_of_pairs;
+    kernel_index += @as(usize, core.types.getTypeIndex(SrcT)) * SUPPORTED_TYPES.len;
+    kernel_index += @as(usize, core.types.getTypeIndex(DstT));
+
+    return kernel_index;
+}
+
+fn getKernel(
+    comptime SrcT: type,
+    comptime DstT: type,
+    command_queue: *const CommandQueue,
+    vectors_enabled: bool,
+    has_affine: bool,
+) TensorErrors!cl.kernel.Kernel {
+    const SUPPORTED_TYPES = core.types.SUPPORTED_TYPES;
+    const number_of_pairs = SUPPORTED_TYPES.len * SUPPORTED_TYPES.len;
+
+    const kernels_set = try KernelsSet.getKernelSet(command_queue, .ChangeDtype, 2 * 2 * number_of_pairs);
+
+    const kernel_index = getKernelIndex(SrcT, DstT, vectors_enabled, has_affine);
+    if (kernels_set.kernels.?[kernel_index]) |v| return v;
+
+    var kernel: cl.kernel.Kernel = undefined;
+    var program: cl.program.Program = undefined;
+    const allocator = command_queue.context.allocator;
+    const extra_args: []u8 = try std.fmt.allocPrint(
+        allocator,
+        "-DSRC_T={s} -DAFFINE_T={s} -DHAS_AFFINE={d} -DCOMPONENTS={d}",
+        .{
+            comptime getClTypeName(SrcT),
+            comptime getClTypeName(getAffineType(SrcT, DstT)),
+            @intFromBool(has_affine),
+            @as(u8, if (comptime core.types.isComplex(DstT)) 2 else 1),
+        },
+    );
+    defer allocator.free(extra_args);
+
+    // Complex numbers are handled by the kernel as pairs of scalars
+    try KernelsSet.compileKernel(
+        core.types.getType(DstT),
+        command_queue,
+        .{
+            .vectors_enabled = vectors_enabled,
+            .kernel_name = "change_dtype",
+            .extra_args = extra_args,
+        },
+        &kernel,
+        &program,
+        change_dtype_cl_kernel,
+    );
+
+    kernels_set.kernels.?[kernel_index] = kernel;
+    kernels_set.programs.?[kernel_index] = program;
+
+    return kernel;
+}
+
+/// Converts every element of `src` to the type of `dst`, with the saturation and rounding (to
+/// nearest even) of OpenCL's `convert_` builtins, optionally applying `affine` first (e.g. to
+/// normalize u8 images to [0, 1]). Both types must be real or both complex, use `toComplex` and
+/// `toReal` to change between them.
+///
+/// Rows made of whole vectors of the destination type are converted a vector at a time.
+pub fn changeDtype(
+    comptime SrcT: type,
+    comptime DstT: type,
+    pipeline: *Pipeline,
+    src: *Tensor(SrcT),
+    dst: *Tensor(DstT),
+    affine: ?Affine,
+) TensorErrors!void {
+    const is_complex = comptime core.types.isComplex(SrcT);
+    if (is_complex != core.types.isComplex(DstT)) {
+        @compileError("Both types must be real or complex, use toComplex or toReal");
+    }
+
+    if (!std.mem.eql(u64, src.dimensions.shape, dst.dimensions.shape)) {
+        return TensorErrors.UnqualTensorsShape;
+    }
+
+    const command_queue = pipeline.command_queue;
+
+    // Same rule as math.binary: vectors only when the rows are made of whole vectors
+    const shape = dst.dimensions.shape;
+    const cols = shape[shape.len - 1];
+    const vector_width: u64 = if (is_complex) 1 else command_queue.vector_widths[core.types.getTypeId(DstT)];
+    const vectors_enabled = (dst.flags.vectors_enabled and vector_width > 1 and cols % vector_width == 0);
+
+    const kernel = try getKernel(SrcT, DstT, command_queue, vectors_enabled, affine != null);
+
+    const setArg = cl.kernel.setArg;
+    const cl_mem_size = @sizeOf(cl.buffer.Mem);
+
+    var global_work_items = dst.work_configuration.global_work_items_without_vectors;
+    if (vectors_enabled) global_work_items[2] /= vector_width;
+
+    for (global_work_items, 0..) |g, arg_index| {
+        try setArg(kernel, @intCast(arg_index), @sizeOf(u64), @ptrCast(&g));
+    }
+
+    try setArg(kernel, 3, cl_mem_size, @ptrCast(&src.buffer));
+    try setArg(kernel, 4, @sizeOf(u64), @ptrCast(&src.memory_layout.slice_pitch));
+    try setArg(kernel, 5, @sizeOf(u64), @ptrCast(&src.memory_layout.row_pitch));
+
+    try setArg(kernel, 6, cl_mem_size, @ptrCast(&dst.buffer));
+    try setArg(kernel, 7, @sizeOf(u64), @ptrCast(&dst.memory_layout.slice_pitch));
+    try setArg(kernel, 8, @sizeOf(u64), @ptrCast(&dst.memory_layout.row_pitch));
+
+    if (affine) |a| {
+        const AffineT = getAffineType(SrcT, DstT);
+        const scale: AffineT = @floatCast(a.scale);
+        const offset: AffineT = @floatCast(a.offset);
+
+        try setArg(kernel, 9, @sizeOf(AffineT), @ptrCast(&scale));
+        try setArg(kernel, 10, @sizeOf(AffineT), @ptrCast(&offset));
+    }
+
+    var padded_global_work_items: [3]u64 = undefined;
+    var local_work_items: [3]u64 = undefined;
+    core.WorkGroupTuner.getLocalWorkItems(
+        command_queue,
+        "change_dtype",
+        getKernelIndex(SrcT, DstT, vectors_enabled, affine != null),
+        &global_work_items,
+        &padded_global_work_items,
+        &local_work_items,
+    );
+
+    dst.markModified();
+
+    const prev_events = pipeline.prevEvents();
+
+    var new_event: cl.event.Event = undefined;
+    try cl.kernel.enqueueNdRange(
+        command_queue.cl_command_queue,
+        kernel,
+        null,
+        &padded_global_work_items,
+        &local_work_items,
+        prev_events,
+        &new_event,
+    );
+    errdefer helpers.releaseEvent(new_event);
+
+    try pipeline.append(&.{new_event});
+}
+
+// -----------------------------------------------------------------------------
+// Unit Tests
+const testing = std.testing;
+
+const memory = tensor_module.memory;
+
+test "changeDtype - u8 to f32 with normalization" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    // Whole vectors and a row with a remainder
+    const shapes = [_][]const u64{ &.{ 3, 16 }, &.{ 2, 3, 5 } };
+
+    for (shapes) |shape| {
+        const src = try Tensor(u8).alloc(context, pipeline, shape, .{});
+        defer src.release(pipeline);
+
+        const dst = try Tensor(f32).alloc(context, pipeline, shape, .{});
+        defer dst.release(pipeline);
+
+        const number_of_elements = src.dimensions.number_of_elements_without_padding;
+
+        const values = try allocator.alloc(u8, number_of_elements);
+        defer allocator.free(values);
+
+        for (values, 0..) |*v, i| v.* = @intCast((i * 37) % 256);
+        try memory.readFromBuffer(u8, pipeline, src, values);
+
+        try changeDtype(u8, f32, pipeline, src, dst, .{ .scale = 1.0 / 255.0, .offset = -0.5 });
+
+        const result = try allocator.alloc(f32, number_of_elements);
+        defer allocator.free(result);
+
+        try memory.writeToBuffer(f32, pipeline, dst, result);
+        pipeline.waitAndCleanup();
+
+        for (values, result) |v, r| {
+            try testing.expectApproxEqAbs(@as(f32, @floatFromInt(v)) / 255 - 0.5, r, 1e-6);
+        }
+    }
+}
+
+test "changeDtype - saturation and rounding" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const values = [_]f32{ -5, 0.5, 1.5, 2.4, 254.5, 300, 7, 8 };
+
+    const src = try Tensor(f32).alloc(context, pipeline, &.{ 1, values.len }, .{});
+    defer src.release(pipeline);
+
+    try memory.readFromBuffer(f32, pipeline, src, &values);
+
+    const to_u8 = try Tensor(u8).alloc(context, pipeline, &.{ 1, values.len }, .{});
+    defer to_u8.release(pipeline);
+
+    try changeDtype(f32, u8, pipeline, src, to_u8, null);
+
+    const to_i16 = try Tensor(i16).alloc(context, pipeline, &.{ 1, values.len }, .{});
+    defer to_i16.release(pipeline);
+
+    try changeDtype(f32, i16, pipeline, src, to_i16, .{ .scale = -200 });
+
+    var u8_result: [values.len]u8 = undefined;
+    var i16_result: [values.len]i16 = undefined;
+    try memory.writeToBuffer(u8, pipeline, to_u8, &u8_result);
+    try memory.writeToBuffer(i16, pipeline, to_i16, &i16_result);
+    pipeline.waitAndCleanup();
+
+    try testing.expectEqualSlices(u8, &.{ 0, 0, 2, 2, 254, 255, 7, 8 }, &u8_result);
+    try testing.expectEqualSlices(i16, &.{ 1000, -100, -300, -480, -32768, -32768, -1400, -1600 }, &i16_result);
+}
+
+test "changeDtype - complex types" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(core.types.ComplexF32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const ComplexF32 = core.types.ComplexF32;
+    const ComplexI32 = core.types.ComplexI32;
+
+    const src = try Tensor(ComplexI32).alloc(context, pipeline, &.{ 2, 3 }, .{});
+    defer src.release(pipeline);
+
+    const dst = try Tensor(ComplexF32).alloc(context, pipeline, &.{ 2, 3 }, .{});
+    defer dst.release(pipeline);
+
+    var values: [6]ComplexI32 = undefined;
+    for (&values, 0..) |*v, i| {
+        const x: i32 = @intCast(i);
+        v.* = .{ .real = x, .imag = -2 * x };
+    }
+    try memory.readFromBuffer(ComplexI32, pipeline, src, &values);
+
+    try changeDtype(ComplexI32, ComplexF32, pipeline, src, dst, .{ .scale = 0.5, .offset = 1 });
+
+    var result: [6]ComplexF32 = undefined;
+    try memory.writeToBuffer(ComplexF32, pipeline, dst, &result);
+    pipeline.waitAndCleanup();
+
+    for (values, result) |v, r| {
+        try testing.expectEqual(@as(f32, @floatFromInt(v.real)) * 0.5 + 1, r.real);
+        try testing.expectEqual(@as(f32, @floatFromInt(v.imag)) * 0.5, r.imag);
+    }
+}
@@ -0,0 +1,64 @@
+#include "wekua.h"
+
+#define CONCAT_(a, b) a##b
+#define CONCAT(a, b) CONCAT_(a, b)
+
+#if WK_VECTOR_WIDTH == 1
+typedef SRC_T src_wk;
+typedef AFFINE_T affine_wk;
+
+#define load_src(i, p) (p)[i]
+#define store_dst(v, i, p) (p)[i] = (v)
+#define convert_affine CONCAT(convert_, AFFINE_T)
+#else
+typedef CONCAT(SRC_T, WK_VECTOR_WIDTH) src_wk;
+typedef CONCAT(AFFINE_T, WK_VECTOR_WIDTH) affine_wk;
+
+#define load_src(i, p) CONCAT(vload, WK_VECTOR_WIDTH)(0, (p) + (i))
+#define store_dst(v, i, p) CONCAT(vstore, WK_VECTOR_WIDTH)(v, 0, (p) + (i))
+#define convert_affine CONCAT(convert_, CONCAT(AFFINE_T, WK_VECTOR_WIDTH))
+#endif
+
+__kernel void change_dtype(
+    const ulong depth,
+    const ulong rows,
+    const ulong cols,
+
+    __global const SRC_T *restrict const src,
+    const ulong src_slice_pitch,
+    const ulong src_row_pitch,
+
+    __global wks *restrict const dst,
+    const ulong dst_slice_pitch,
+    const ulong dst_row_pitch
+
+#if HAS_AFFINE
+    , const AFFINE_T scale,
+    const AFFINE_T offset
+#endif
+) {
+    const ulong i = get_global_id(0);
+    const ulong j = get_global_id(1);
+    const ulong k = get_global_id(2);
+
+    if (i >= depth || j >= rows || k >= cols) return;
+
+    // Complex numbers are converted as COMPONENTS consecutive scalars, vectors are only used with
+    // real numbers
+    const ulong src_index = (i * src_slice_pitch + j * src_row_pitch + k * WK_VECTOR_WIDTH) * COMPONENTS;
+    const ulong dst_index = (i * dst_slice_pitch + j * dst_row_pitch + k * WK_VECTOR_WIDTH) * COMPONENTS;
+
+#pragma unroll
+    for (ulong c = 0; c < COMPONENTS; c++) {
+        const src_wk x = load_src(src_index + c, src);
+#if HAS_AFFINE
+        affine_wk value = convert_affine(x) * scale;
+        // The offset is real, the imaginary part is only scaled
+        if (c == 0) value += offset;
+
+        store_dst(convert_wk(value), dst_index + c, dst);
+#else
+        store_dst(convert_wk(x), dst_index + c, dst);
+#endif
+    }
+}
@@ -0,0 +1,35 @@
+#include "wekua.h"
+
+__kernel void to_storage(
+	__global const wks *restrict const src,
+    __global st *restrict const dst,
+
+	const ulong src_row_pitch,
+	const ulong src_slice_pitch,
+
+    const ulong dst_row_pitch,
+    const ulong dst_slice_pitch
+) {
+	const ulong i = get_global_id(0);
+	const ulong j = get_global_id(1);
+    const ulong k = get_global_id(2);
+
+	store_storage(dst, i * dst_slice_pitch + j * dst_row_pitch + k, src[i * src_slice_pitch + j * src_row_pitch + k]);
+}
+
+__kernel void from_storage(
+	__global const st *restrict const src,
+    __global wks *restrict const dst,
+
+	const ulong src_row_pitch,
+	const ulong src_slice_pitch,
+
+    const ulong dst_row_pitch,
+    const ulong dst_slice_pitch
+) {
+	const ulong i = get_global_id(0);
+	const ulong j = get_global_id(1);
+    const ulong k = get_global_id(2);
+
+	dst[i * dst_slice_pitch + j * dst_row_pitch + k] = load_storage(src, i * src_slice_pitch + j * src_row_pitch + k);
+}
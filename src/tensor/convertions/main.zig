@@ -1,7 +1,16 @@
 pub const toComplex = @import("to_complex.zig").toComplex;
 pub const toReal = @import("to_real.zig").toReal;
+pub const toStorage = @import("storage.zig").toStorage;
+pub const fromStorage = @import("storage.zig").fromStorage;
+
+const change_dtype = @import("change_dtype.zig");
+pub const changeDtype = change_dtype.changeDtype;
+pub const Affine = change_dtype.Affine;
 
 test {
     _ = toComplex;
     _ = toReal;
+    _ = toStorage;
+    _ = fromStorage;
+    _ = change_dtype;
 }
@@ -0,0 +1,186 @@
+const std = @import("std");
+const cl = @import("opencl");
+
+const core = @import("core");
+const Pipeline = core.Pipeline;
+const CommandQueue = core.CommandQueue;
+const KernelsSet = core.KernelsSet;
+
+const tensor_module = @import("../main.zig");
+const Tensor = tensor_module.Tensor;
+const TensorErrors = tensor_module.Errors;
+
+const helpers = @import("../helpers.zig");
+
+const storage_cl_kernel: []const u8 = @embedFile("kernels/storage.cl");
+
+const Direction = enum {
+    to_storage,
+    from_storage,
+};
+
+fn getKernel(
+    comptime S: type,
+    command_queue: *const CommandQueue,
+    comptime direction: Direction,
+) TensorErrors!cl.kernel.Kernel {
+    const kernel_id: KernelsSet.KernelsID = switch (direction) {
+        .to_storage => .ToStorage,
+        .from_storage => .FromStorage,
+    };
+
+    const kernels_set = try KernelsSet.getKernelSet(command_queue, kernel_id, core.types.STORAGE_TYPES.len);
+    const index: usize = core.types.getStorageTypeIndex(S);
+    if (kernels_set.kernels.?[index]) |v| return v;
+
+    var kernel: cl.kernel.Kernel = undefined;
+    var program: cl.program.Program = undefined;
+    const allocator = command_queue.context.allocator;
+    const extra_args: []u8 = try std.fmt.allocPrint(allocator, "-DWK_STORAGE_TYPE={d}", .{index});
+    defer allocator.free(extra_args);
+
+    try KernelsSet.compileKernel(
+        f32,
+        command_queue,
+        .{
+            .vectors_enabled = false,
+            .kernel_name = @tagName(direction),
+            .extra_args = extra_args,
+        },
+        &kernel,
+        &program,
+        storage_cl_kernel,
+    );
+
+    kernels_set.kernels.?[index] = kernel;
+    kernels_set.programs.?[index] = program;
+
+    return kernel;
+}
+
+fn convert(
+    comptime S: type,
+    comptime direction: Direction,
+    pipeline: *Pipeline,
+    src: anytype,
+    dst: anytype,
+) TensorErrors!void {
+    if (!std.mem.eql(u64, src.dimensions.shape, dst.dimensions.shape)) {
+        return TensorErrors.UnqualTensorsShape;
+    }
+
+    const command_queue = pipeline.command_queue;
+    const kernel = try getKernel(S, command_queue, direction);
+
+    dst.markModified();
+
+    const prev_events = pipeline.prevEvents();
+
+    const setArg = cl.kernel.setArg;
+    const cl_mem_size = @sizeOf(cl.buffer.Mem);
+
+    try setArg(kernel, 0, cl_mem_size, @ptrCast(&src.buffer));
+    try setArg(kernel, 1, cl_mem_size, @ptrCast(&dst.buffer));
+    try setArg(kernel, 2, @sizeOf(u64), @ptrCast(&src.memory_layout.row_pitch));
+    try setArg(kernel, 3, @sizeOf(u64), @ptrCast(&src.memory_layout.slice_pitch));
+    try setArg(kernel, 4, @sizeOf(u64), @ptrCast(&dst.memory_layout.row_pitch));
+    try setArg(kernel, 5, @sizeOf(u64), @ptrCast(&dst.memory_layout.slice_pitch));
+
+    var new_event: cl.event.Event = undefined;
+    try cl.kernel.enqueueNdRange(
+        command_queue.cl_command_queue,
+        kernel,
+        null,
+        &src.work_configuration.global_work_items_without_vectors,
+        &src.work_configuration.local_work_items_without_vectors[command_queue.wekua_id],
+        prev_events,
+        &new_event,
+    );
+    errdefer helpers.releaseEvent(new_event);
+
+    try pipeline.append(&.{new_event});
+}
+
+/// Rounds `src` to the storage type `S` (f16 or bf16), to the nearest value with ties to even.
+pub fn toStorage(
+    comptime S: type,
+    pipeline: *Pipeline,
+    src: *Tensor(f32),
+    dst: *Tensor(S),
+) TensorErrors!void {
+    try convert(S, .to_storage, pipeline, src, dst);
+}
+
+/// Widens the storage type tensor `src` to f32, exact.
+pub fn fromStorage(
+    comptime S: type,
+    pipeline: *Pipeline,
+    src: *Tensor(S),
+    dst: *Tensor(f32),
+) TensorErrors!void {
+    try convert(S, .from_storage, pipeline, src, dst);
+}
+
+// -----------------------------------------------------------------------------
+// Unit Tests
+const testing = std.testing;
+
+const memory = tensor_module.memory;
+const fill = tensor_module.fill;
+
+test "toStorage and fromStorage - round trip for all storage types" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const shape = [_]u64{ 3, 5 };
+
+    const src = try Tensor(f32).alloc(context, pipeline, &shape, .{});
+    defer src.release(pipeline);
+
+    const dst = try Tensor(f32).alloc(context, pipeline, &shape, .{});
+    defer dst.release(pipeline);
+
+    var values: [15]f32 = undefined;
+    for (&values, 0..) |*v, i| v.* = @as(f32, @floatFromInt(i)) * 0.3 - 2;
+    try memory.readFromBuffer(f32, pipeline, src, &values);
+
+    inline for (core.types.STORAGE_TYPES) |S| {
+        const storage = try Tensor(S).alloc(context, pipeline, &shape, .{});
+        defer storage.release(pipeline);
+
+        try toStorage(S, pipeline, src, storage);
+
+        var stored: [15]S = undefined;
+        try memory.writeToBuffer(S, pipeline, storage, &stored);
+
+        try fromStorage(S, pipeline, storage, dst);
+
+        var result: [15]f32 = undefined;
+        try memory.writeToBuffer(f32, pipeline, dst, &result);
+        pipeline.waitAndCleanup();
+
+        for (values, stored, result) |v, s, r| {
+            const expected: f32 = if (S == core.types.BF16) core.types.BF16.fromF32(v).toF32() else @floatCast(@as(f16, @floatCast(v)));
+            const stored_value: f32 = if (S == core.types.BF16) s.toF32() else @floatCast(s);
+
+            try testing.expectEqual(expected, stored_value);
+            try testing.expectEqual(expected, r);
+        }
+
+        // Storage types are filled as raw bits
+        try fill.one(S, pipeline, storage);
+        try fromStorage(S, pipeline, storage, dst);
+        try memory.writeToBuffer(f32, pipeline, dst, &result);
+        pipeline.waitAndCleanup();
+
+        for (result) |r| try testing.expectEqual(@as(f32, 1), r);
+    }
+}
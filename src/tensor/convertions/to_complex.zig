@@ -63,6 +63,8 @@ pub fn toComplex(
     const command_queue = pipeline.command_queue;
     const kernel = try getKernel(T, command_queue, space);
 
+    dst.markModified();
+
     const prev_events = pipeline.prevEvents();
 
     const setArg = cl.kernel.setArg;
@@ -13,15 +13,54 @@ const TensorErrors = tensor_module.Errors;
 
 const fill_cl_kernel: []const u8 = @embedFile("kernels/fill.cl");
 
+fn fillBuffer(
+    comptime T: type,
+    pipeline: *Pipeline,
+    tensor: *Tensor(T),
+    scalar: T,
+    offset: usize,
+    size: usize,
+) TensorErrors!void {
+    tensor.markModified();
+
+    const prev_events = pipeline.prevEvents();
+
+    var new_event: cl.event.Event = undefined;
+    try cl.buffer.fill(
+        pipeline.command_queue.cl_command_queue,
+        tensor.buffer,
+        &scalar,
+        @sizeOf(T),
+        offset,
+        size,
+        prev_events,
+        &new_event,
+    );
+    errdefer helpers.releaseEvent(new_event);
+
+    try pipeline.append(&.{new_event});
+}
+
 pub fn constant(
     comptime T: type,
     pipeline: *Pipeline,
     tensor: *Tensor(T),
     scalar: T,
 ) TensorErrors!void {
+    // The padding must stay zero, a buffer fill can only be used when there is no padding or
+    // the scalar is zero
+    const has_padding = (tensor.dimensions.number_of_elements != tensor.dimensions.number_of_elements_without_padding);
+    if (!has_padding or std.mem.allEqual(u8, std.mem.asBytes(&scalar), 0)) {
+        return fillBuffer(T, pipeline, tensor, scalar, 0, tensor.memory_layout.size);
+    }
+
+    // Storage types are written as their raw bits
+    const KernelT = if (comptime core.types.isStorageType(T)) u16 else T;
+    const kernel_scalar: KernelT = @bitCast(scalar);
+
     const command_queue = pipeline.command_queue;
     const kernel = try KernelsSet.getClNoVectorKernel(
-        T,
+        KernelT,
         command_queue,
         .Fill,
         "fill",
@@ -29,6 +68,8 @@ pub fn constant(
         null,
     );
 
+    tensor.markModified();
+
     const prev_events = pipeline.prevEvents();
 
     const setArg = cl.kernel.setArg;
@@ -37,7 +78,7 @@ pub fn constant(
     try setArg(kernel, 0, cl_mem_size, @ptrCast(&tensor.buffer));
     try setArg(kernel, 1, @sizeOf(u64), @ptrCast(&tensor.memory_layout.row_pitch));
     try setArg(kernel, 2, @sizeOf(u64), @ptrCast(&tensor.memory_layout.slice_pitch));
-    try setArg(kernel, 3, @sizeOf(T), @ptrCast(&scalar));
+    try setArg(kernel, 3, @sizeOf(KernelT), @ptrCast(&kernel_scalar));
 
 
     // TODO: Adapt code to use views
@@ -61,10 +102,14 @@ pub inline fn one(
     pipeline: *Pipeline,
     tensor: *Tensor(T),
 ) !void {
-    try constant(T, pipeline, tensor, switch (comptime core.types.isComplex(T)) {
-        true => .{ .real = 1, .imag = 0 },
-        false => 1,
-    });
+    const value: T = comptime if (core.types.isComplex(T))
+        .{ .real = 1, .imag = 0 }
+    else if (T == core.types.BF16)
+        core.types.BF16.fromF32(1)
+    else
+        1;
+
+    try constant(T, pipeline, tensor, value);
 }
 
 pub fn zeroes(
@@ -72,18 +117,69 @@ pub fn zeroes(
     pipeline: *Pipeline,
     tensor: *Tensor(T),
 ) TensorErrors!void {
-    const prev_events = pipeline.prevEvents();
+    // The reserved capacity is cleared too, so the tensor stays zeroed when it grows
+    try fillBuffer(T, pipeline, tensor, std.mem.zeroes(T), 0, tensor.memory_layout.buffer_size);
+}
+
+// Sets the rows x cols block at (row, col) of every matrix of `tensor` to zero
+fn zeroBlock(
+    comptime T: type,
+    pipeline: *Pipeline,
+    tensor: *Tensor(T),
+    row: u64,
+    col: u64,
+    depth: u64,
+    rows: u64,
+    cols: u64,
+) TensorErrors!void {
+    const KernelT = if (comptime core.types.isStorageType(T)) u16 else T;
+    const zero = std.mem.zeroes(KernelT);
+
+    const command_queue = pipeline.command_queue;
+    const kernel = try KernelsSet.getClNoVectorKernel(
+        KernelT,
+        command_queue,
+        .FillBlock,
+        "fill_block",
+        fill_cl_kernel,
+        null,
+    );
+
+    const setArg = cl.kernel.setArg;
+    const cl_mem_size = @sizeOf(cl.buffer.Mem);
 
-    const zero: T = std.mem.zeroes(T);
+    try setArg(kernel, 0, cl_mem_size, @ptrCast(&tensor.buffer));
+    try setArg(kernel, 1, @sizeOf(u64), @ptrCast(&tensor.memory_layout.row_pitch));
+    try setArg(kernel, 2, @sizeOf(u64), @ptrCast(&tensor.memory_layout.slice_pitch));
+    try setArg(kernel, 3, @sizeOf(u64), @ptrCast(&row));
+    try setArg(kernel, 4, @sizeOf(u64), @ptrCast(&col));
+
+    const global_work_items = [3]u64{ depth, rows, cols };
+    for (global_work_items, 5..) |g, arg_index| {
+        try setArg(kernel, @intCast(arg_index), @sizeOf(u64), @ptrCast(&g));
+    }
+    try setArg(kernel, 8, @sizeOf(KernelT), @ptrCast(&zero));
+
+    var padded_global_work_items: [3]u64 = undefined;
+    var local_work_items: [3]u64 = undefined;
+    core.WorkGroupTuner.getLocalWorkItems(
+        command_queue,
+        "fill_block",
+        core.types.getTypeIndex(KernelT),
+        &global_work_items,
+        &padded_global_work_items,
+        &local_work_items,
+    );
+
+    const prev_events = pipeline.prevEvents();
 
     var new_event: cl.event.Event = undefined;
-    try cl.buffer.fill(
-        pipeline.command_queue.cl_command_queue,
-        tensor.buffer,
-        &zero,
-        @sizeOf(T),
-        0,
-        tensor.memory_layout.size,
+    try cl.kernel.enqueueNdRange(
+        command_queue.cl_command_queue,
+        kernel,
+        null,
+        &padded_global_work_items,
+        &local_work_items,
         prev_events,
         &new_event,
     );
@@ -92,6 +188,45 @@ pub fn zeroes(
     try pipeline.append(&.{new_event});
 }
 
+/// Zeroes the padding of `tensor` (the columns after the last one of every row and the rows after
+/// the last one of every matrix) and the capacity reserved after it. Its elements are left as
+/// they are.
+pub fn padding(
+    comptime T: type,
+    pipeline: *Pipeline,
+    tensor: *Tensor(T),
+) TensorErrors!void {
+    const shape = tensor.dimensions.shape;
+    const ndim = shape.len;
+
+    var depth: u64 = 1;
+    if (ndim >= 3) {
+        for (shape[0 .. ndim - 2]) |e| depth *= e;
+    }
+
+    const rows: u64 = if (ndim >= 2) shape[ndim - 2] else 1;
+    const cols = shape[ndim - 1];
+
+    const row_pitch = tensor.memory_layout.row_pitch;
+    const padded_rows = tensor.memory_layout.slice_pitch / row_pitch;
+
+    if (row_pitch > cols) {
+        try zeroBlock(T, pipeline, tensor, 0, cols, depth, rows, row_pitch - cols);
+    }
+
+    if (padded_rows > rows) {
+        try zeroBlock(T, pipeline, tensor, rows, 0, depth, padded_rows - rows, row_pitch);
+    }
+
+    const size = tensor.memory_layout.size;
+    const buffer_size = tensor.memory_layout.buffer_size;
+    if (buffer_size > size) {
+        try fillBuffer(T, pipeline, tensor, std.mem.zeroes(T), size, buffer_size - size);
+    }
+
+    tensor.markModified();
+}
+
 // -----------------------------------------------------------------------------
 // Unit Tests
 const testing = std.testing;
@@ -610,3 +745,159 @@ test "one - 3D tensor for all types" {
         }
     }
 }
+
+test "constant - padding stays zero" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    inline for (.{ tensor_module.Initialization.zeroes, tensor_module.Initialization.padding }) |initialization| {
+        const tensor = try Tensor(f32).alloc(context, pipeline, &.{ 3, 5 }, .{ .initialization = initialization });
+        defer tensor.release(pipeline);
+
+        try constant(f32, pipeline, tensor, 7);
+
+        const raw = try allocator.alloc(f32, tensor.memory_layout.size / @sizeOf(f32));
+        defer allocator.free(raw);
+
+        const prev_events = pipeline.prevEvents();
+        var new_event: cl.event.Event = undefined;
+        try cl.buffer.read(
+            command_queue.cl_command_queue,
+            tensor.buffer,
+            false,
+            0,
+            tensor.memory_layout.size,
+            raw.ptr,
+            prev_events,
+            &new_event,
+        );
+        try pipeline.append(&.{new_event});
+        pipeline.waitAndCleanup();
+
+        const row_pitch = tensor.memory_layout.row_pitch;
+        for (raw, 0..) |val, i| {
+            const expected: f32 = if ((i % row_pitch) < 5 and (i / row_pitch) < 3) 7 else 0;
+            try testing.expectEqual(expected, val);
+        }
+    }
+}
+
+test "constant - compact tensor" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    inline for (core.types.SUPPORTED_TYPES) |T| {
+        if (command_queue.isTypeSupported(T)) {
+            const tensor = try Tensor(T).alloc(context, pipeline, &.{ 3, 5, 3 }, .{ .compact = true });
+            defer tensor.release(pipeline);
+
+            try one(T, pipeline, tensor);
+
+            // The whole buffer is the tensor, read it as it is
+            const raw = try allocator.alloc(T, tensor.memory_layout.size / @sizeOf(T));
+            defer allocator.free(raw);
+            try testing.expectEqual(@as(usize, 45), raw.len);
+
+            const prev_events = pipeline.prevEvents();
+            var new_event: cl.event.Event = undefined;
+            try cl.buffer.read(
+                command_queue.cl_command_queue,
+                tensor.buffer,
+                false,
+                0,
+                tensor.memory_layout.size,
+                raw.ptr,
+                prev_events,
+                &new_event,
+            );
+            try pipeline.append(&.{new_event});
+            pipeline.waitAndCleanup();
+
+            for (raw) |val| {
+                if (comptime core.types.isComplex(T)) {
+                    try testing.expectEqual(@as(@TypeOf(val.real), 1), val.real);
+                    try testing.expectEqual(@as(@TypeOf(val.imag), 0), val.imag);
+                } else {
+                    try testing.expectEqual(@as(T, 1), val);
+                }
+            }
+        }
+    }
+}
+
+test "padding - the elements are left as they are" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const Case = struct { shape: []const u64, capacity: ?u64 = null };
+    const cases = [_]Case{
+        .{ .shape = &.{7} },
+        .{ .shape = &.{ 3, 5 } },
+        .{ .shape = &.{ 3, 5 }, .capacity = 8 },
+        .{ .shape = &.{ 2, 5, 3 } },
+    };
+
+    for (cases) |case| {
+        const tensor = try Tensor(f32).empty(context, pipeline, case.shape, .{ .capacity = case.capacity });
+        defer tensor.release(pipeline);
+
+        // Every element of the buffer, padding included, starts as 7
+        const buffer_size = tensor.memory_layout.buffer_size;
+        try fillBuffer(f32, pipeline, tensor, 7, 0, buffer_size);
+        try padding(f32, pipeline, tensor);
+
+        const raw = try allocator.alloc(f32, buffer_size / @sizeOf(f32));
+        defer allocator.free(raw);
+
+        const prev_events = pipeline.prevEvents();
+        var new_event: cl.event.Event = undefined;
+        try cl.buffer.read(
+            command_queue.cl_command_queue,
+            tensor.buffer,
+            false,
+            0,
+            buffer_size,
+            raw.ptr,
+            prev_events,
+            &new_event,
+        );
+        try pipeline.append(&.{new_event});
+        pipeline.waitAndCleanup();
+
+        const shape = case.shape;
+        const ndim = shape.len;
+        const rows: u64 = if (ndim >= 2) shape[ndim - 2] else 1;
+        const cols = shape[ndim - 1];
+        const row_pitch = tensor.memory_layout.row_pitch;
+        const slice_pitch = tensor.memory_layout.slice_pitch;
+        const number_of_elements = tensor.dimensions.number_of_elements;
+
+        for (raw, 0..) |val, i| {
+            const is_element = i < number_of_elements and
+                (i % row_pitch) < cols and ((i % slice_pitch) / row_pitch) < rows;
+            try testing.expectEqual(@as(f32, if (is_element) 7 else 0), val);
+        }
+    }
+}
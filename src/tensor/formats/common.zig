@@ -0,0 +1,111 @@
+const std = @import("std");
+const cl = @import("opencl");
+
+const core = @import("core");
+const Pipeline = core.Pipeline;
+
+const helpers = @import("../helpers.zig");
+
+const tensor_module = @import("../main.zig");
+const Tensor = tensor_module.Tensor;
+
+pub const Errors = tensor_module.Errors || std.fs.File.OpenError || std.fs.File.StatError ||
+    std.fs.File.WriteError || std.posix.MMapError || error{
+    InvalidFormat,
+    UnsupportedFormat,
+    FormatMismatch,
+};
+
+/// Bytes moved through the staging buffers when a tensor is exported
+pub const EXPORT_STAGING_SIZE: usize = 16 * 1024 * 1024;
+
+pub const MappedFile = struct {
+    file: std.fs.File,
+    content: []align(std.heap.page_size_min) const u8,
+
+    pub fn open(path: []const u8) Errors!MappedFile {
+        const file = try std.fs.cwd().openFile(path, .{});
+        errdefer file.close();
+
+        const size = (try file.stat()).size;
+        if (size == 0) return error.InvalidFormat;
+
+        const content = try std.posix.mmap(
+            null,
+            size,
+            std.posix.PROT.READ,
+            .{ .TYPE = .PRIVATE },
+            file.handle,
+            0,
+        );
+
+        return .{ .file = file, .content = content };
+    }
+
+    pub fn close(self: *const MappedFile) void {
+        std.posix.munmap(self.content);
+        self.file.close();
+    }
+};
+
+/// Uploads row major data without padding (e.g. straight from a mapped file) with a single rect
+/// copy that skips the padding of the tensor. Blocks until the upload is done, so `data` can be
+/// unmapped afterwards.
+pub fn uploadDense(
+    comptime T: type,
+    pipeline: *Pipeline,
+    tensor: *Tensor(T),
+    data: []const u8,
+) Errors!void {
+    if (data.len != tensor.dimensions.number_of_elements_without_padding * @sizeOf(T)) {
+        return error.InvalidFormat;
+    }
+
+    const shape = tensor.dimensions.shape;
+    const ndim = shape.len;
+    const width: usize = shape[ndim - 1] * @sizeOf(T);
+    const height: usize = if (ndim >= 2) shape[ndim - 2] else 1;
+
+    var depth: usize = 1;
+    if (ndim >= 3) {
+        for (shape[0..(ndim - 2)]) |e| depth *= e;
+    }
+
+    const origin: [3]usize = .{ 0, 0, 0 };
+    const region: [3]usize = .{ width, height, depth };
+
+    tensor.markModified();
+    const prev_events = pipeline.prevEvents();
+
+    var new_event: cl.event.Event = undefined;
+    try cl.buffer.writeRect(
+        pipeline.command_queue.cl_command_queue,
+        tensor.buffer,
+        false,
+        &origin,
+        &origin,
+        &region,
+        tensor.memory_layout.row_pitch * @sizeOf(T),
+        tensor.memory_layout.slice_pitch * @sizeOf(T),
+        width,
+        width * height,
+        data.ptr,
+        prev_events,
+        &new_event,
+    );
+    errdefer helpers.releaseEvent(new_event);
+
+    try pipeline.append(&.{new_event});
+    pipeline.waitAndCleanup();
+}
+
+/// Sink for `memory.writeToStream` that appends the elements to a file
+pub fn FileSink(comptime T: type) type {
+    return struct {
+        file: std.fs.File,
+
+        pub fn consume(self: *@This(), values: []const T) std.fs.File.WriteError!void {
+            try self.file.writeAll(std.mem.sliceAsBytes(values));
+        }
+    };
+}
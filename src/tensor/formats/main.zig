@@ -0,0 +1,9 @@
+pub const npy = @import("npy.zig");
+pub const safetensors = @import("safetensors.zig");
+
+pub const Errors = @import("common.zig").Errors;
+
+test {
+    _ = npy;
+    _ = safetensors;
+}
@@ -0,0 +1,288 @@
+const std = @import("std");
+const builtin = @import("builtin");
+const cl = @import("opencl");
+
+const core = @import("core");
+const Context = core.Context;
+const Pipeline = core.Pipeline;
+
+const tensor_module = @import("../main.zig");
+const Tensor = tensor_module.Tensor;
+const CreateConfig = tensor_module.CreateConfig;
+
+const common = @import("common.zig");
+pub const Errors = common.Errors;
+
+const MAGIC = "\x93NUMPY";
+const MAX_DIMENSIONS = 32;
+
+const native_endian_char: u8 = if (builtin.cpu.arch.endian() == .little) '<' else '>';
+
+/// NumPy type string of `T` without the byte order, null if NumPy has no equivalent (complex
+/// integers).
+fn getDescr(comptime T: type) ?[]const u8 {
+    return switch (T) {
+        i8 => "i1",
+        u8 => "u1",
+        i16 => "i2",
+        u16 => "u2",
+        i32 => "i4",
+        u32 => "u4",
+        i64 => "i8",
+        u64 => "u8",
+        f32 => "f4",
+        f64 => "f8",
+        core.types.ComplexF32 => "c8",
+        core.types.ComplexF64 => "c16",
+        else => null,
+    };
+}
+
+const Header = struct {
+    descr: []const u8,
+    fortran_order: bool,
+    shape: [MAX_DIMENSIONS]u64,
+    ndim: usize,
+    data_offset: usize,
+};
+
+fn getValue(dict: []const u8, key: []const u8) Errors![]const u8 {
+    var buf: [32]u8 = undefined;
+    const quoted = std.fmt.bufPrint(&buf, "'{s}'", .{key}) catch unreachable;
+
+    const key_start = std.mem.indexOf(u8, dict, quoted) orelse return error.InvalidFormat;
+    var rest = dict[(key_start + quoted.len)..];
+
+    const colon = std.mem.indexOfScalar(u8, rest, ':') orelse return error.InvalidFormat;
+    rest = std.mem.trimLeft(u8, rest[(colon + 1)..], " ");
+    if (rest.len == 0) return error.InvalidFormat;
+
+    const end = switch (rest[0]) {
+        '\'' => (std.mem.indexOfScalarPos(u8, rest, 1, '\'') orelse return error.InvalidFormat) + 1,
+        '(' => (std.mem.indexOfScalar(u8, rest, ')') orelse return error.InvalidFormat) + 1,
+        else => std.mem.indexOfAny(u8, rest, ",}") orelse return error.InvalidFormat,
+    };
+
+    return std.mem.trim(u8, rest[0..end], " ");
+}
+
+fn parseHeader(content: []const u8) Errors!Header {
+    if (content.len < 10 or !std.mem.eql(u8, content[0..6], MAGIC)) return error.InvalidFormat;
+
+    const major = content[6];
+    var header_len: usize = undefined;
+    var dict_start: usize = undefined;
+    switch (major) {
+        1 => {
+            header_len = std.mem.readInt(u16, content[8..10], .little);
+            dict_start = 10;
+        },
+        2, 3 => {
+            if (content.len < 12) return error.InvalidFormat;
+            header_len = std.mem.readInt(u32, content[8..12], .little);
+            dict_start = 12;
+        },
+        else => return error.UnsupportedFormat,
+    }
+
+    const data_offset = dict_start + header_len;
+    if (data_offset > content.len) return error.InvalidFormat;
+
+    const dict = content[dict_start..data_offset];
+
+    var header: Header = undefined;
+    header.data_offset = data_offset;
+
+    const descr = try getValue(dict, "descr");
+    if (descr.len < 3) return error.InvalidFormat;
+    header.descr = descr[1..(descr.len - 1)];
+
+    const fortran_order = try getValue(dict, "fortran_order");
+    header.fortran_order = std.mem.eql(u8, fortran_order, "True");
+
+    const shape = try getValue(dict, "shape");
+    if (shape.len < 2 or shape[0] != '(' or shape[shape.len - 1] != ')') return error.InvalidFormat;
+
+    header.ndim = 0;
+    var dims = std.mem.tokenizeAny(u8, shape[1..(shape.len - 1)], ", ");
+    while (dims.next()) |d| {
+        if (header.ndim == MAX_DIMENSIONS) return error.UnsupportedFormat;
+        header.shape[header.ndim] = std.fmt.parseInt(u64, d, 10) catch return error.InvalidFormat;
+        header.ndim += 1;
+    }
+
+    return header;
+}
+
+fn checkDescr(comptime T: type, descr: []const u8) Errors!void {
+    const expected = getDescr(T) orelse return error.UnsupportedFormat;
+    if (descr.len != expected.len + 1) return error.FormatMismatch;
+
+    // Single byte types don't have a byte order
+    const order = descr[0];
+    if (order != '|' and order != '=' and order != native_endian_char) return error.UnsupportedFormat;
+
+    if (!std.mem.eql(u8, descr[1..], expected)) return error.FormatMismatch;
+}
+
+/// Creates a tensor with the shape and content of the `.npy` file in `path`. The file must hold
+/// elements of type `T` in C order. The data is uploaded straight from the mapped file.
+pub fn load(
+    comptime T: type,
+    context: *const Context,
+    pipeline: *Pipeline,
+    path: []const u8,
+    config: CreateConfig,
+) Errors!*Tensor(T) {
+    const mapped = try common.MappedFile.open(path);
+    defer mapped.close();
+
+    const header = try parseHeader(mapped.content);
+    try checkDescr(T, header.descr);
+    if (header.fortran_order) return error.UnsupportedFormat;
+
+    // 0-d arrays are loaded as a single element tensor
+    const shape: []const u64 = if (header.ndim == 0) &.{1} else header.shape[0..header.ndim];
+
+    const tensor = try Tensor(T).alloc(context, pipeline, shape, config);
+    errdefer tensor.release(pipeline);
+
+    try common.uploadDense(T, pipeline, tensor, mapped.content[header.data_offset..]);
+
+    return tensor;
+}
+
+/// Writes `tensor` as a version 1.0 `.npy` file. Elements are streamed to the file a few rows at
+/// a time, the tensor is never copied as a whole to host memory.
+pub fn save(
+    comptime T: type,
+    pipeline: *Pipeline,
+    tensor: *Tensor(T),
+    path: []const u8,
+) Errors!void {
+    const descr = comptime getDescr(T) orelse @compileError("NumPy has no equivalent of this type");
+    const byte_order = if (@sizeOf(T) == 1) '|' else native_endian_char;
+
+    var dict_buf: [1024]u8 = undefined;
+    var dict_stream = std.io.fixedBufferStream(&dict_buf);
+    const dict_writer = dict_stream.writer();
+
+    dict_writer.print("{{'descr': '{c}{s}', 'fortran_order': False, 'shape': (", .{ byte_order, descr }) catch
+        return error.UnsupportedFormat;
+    for (tensor.dimensions.shape) |s| {
+        dict_writer.print("{d}, ", .{s}) catch return error.UnsupportedFormat;
+    }
+    dict_writer.writeAll("), }") catch return error.UnsupportedFormat;
+
+    // Magic, version and length take 10 bytes, the header ends with a newline and everything is
+    // padded with spaces to a multiple of 64 bytes
+    const dict_len = dict_stream.getWritten().len;
+    const header_len = std.mem.alignForward(usize, 10 + dict_len + 1, 64) - 10;
+    if (header_len > std.math.maxInt(u16)) return error.UnsupportedFormat;
+
+    var prefix: [10]u8 = undefined;
+    @memcpy(prefix[0..6], MAGIC);
+    prefix[6] = 1;
+    prefix[7] = 0;
+    std.mem.writeInt(u16, prefix[8..10], @intCast(header_len), .little);
+
+    const file = try std.fs.cwd().createFile(path, .{});
+    defer file.close();
+
+    // Less than 64 spaces and the newline
+    var padding: [64]u8 = undefined;
+    const padding_len = header_len - dict_len;
+    @memset(padding[0..(padding_len - 1)], ' ');
+    padding[padding_len - 1] = '\n';
+
+    try file.writeAll(&prefix);
+    try file.writeAll(dict_stream.getWritten());
+    try file.writeAll(padding[0..padding_len]);
+
+    var sink = common.FileSink(T){ .file = file };
+    try tensor_module.memory.writeToStream(T, pipeline, tensor, common.EXPORT_STAGING_SIZE, &sink);
+}
+
+// -----------------------------------------------------------------------------
+// Unit Tests
+const testing = std.testing;
+
+test "npy - header parsing" {
+    const content = "\x93NUMPY\x01\x00\x46\x00{'descr': '<f4', 'fortran_order': False, 'shape': (3, 5), }" ++
+        " " ** 10 ++ "\n";
+
+    const header = try parseHeader(content);
+    try testing.expectEqualStrings("<f4", header.descr);
+    try testing.expect(!header.fortran_order);
+    try testing.expectEqual(@as(usize, 2), header.ndim);
+    try testing.expectEqualSlices(u64, &.{ 3, 5 }, header.shape[0..2]);
+    try testing.expectEqual(content.len, header.data_offset);
+
+    try checkDescr(f32, header.descr);
+    try testing.expectError(error.FormatMismatch, checkDescr(f64, header.descr));
+    try testing.expectError(error.UnsupportedFormat, checkDescr(core.types.ComplexI32, header.descr));
+
+    try testing.expectError(error.InvalidFormat, parseHeader("not a npy file"));
+}
+
+test "npy - malformed headers" {
+    const shapes = [_][]const u8{ "5", "'(3, 5)'", "3, 5" };
+    inline for (shapes) |shape| {
+        const dict = "{'descr': '<f4', 'fortran_order': False, 'shape': " ++ shape ++ ", }\n";
+        const content = "\x93NUMPY\x01\x00" ++ [_]u8{ dict.len, 0 } ++ dict;
+        try testing.expectError(error.InvalidFormat, parseHeader(content));
+    }
+}
+
+test "npy - save and load" {
+    const allocator = testing.allocator;
+
+    const context = try Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    var tmp = testing.tmpDir(.{});
+    defer tmp.cleanup();
+
+    const path = try std.fmt.allocPrint(allocator, ".zig-cache/tmp/{s}/tensor.npy", .{tmp.sub_path});
+    defer allocator.free(path);
+
+    inline for (.{ u8, i32, f32, f64 }) |T| {
+        if (command_queue.isTypeSupported(T)) {
+            const shape = [_]u64{ 2, 3, 5 };
+
+            const tensor = try Tensor(T).alloc(context, pipeline, &shape, .{});
+            defer tensor.release(pipeline);
+
+            var values: [30]T = undefined;
+            for (&values, 0..) |*v, i| {
+                v.* = switch (@typeInfo(T)) {
+                    .float => @floatFromInt(i),
+                    .int => @intCast(i),
+                    else => unreachable,
+                };
+            }
+            try tensor_module.memory.readFromBuffer(T, pipeline, tensor, &values);
+
+            try save(T, pipeline, tensor, path);
+
+            const loaded = try load(T, context, pipeline, path, .{});
+            defer loaded.release(pipeline);
+
+            try testing.expectEqualSlices(u64, &shape, loaded.dimensions.shape);
+
+            var result: [30]T = undefined;
+            try tensor_module.memory.writeToBuffer(T, pipeline, loaded, &result);
+            pipeline.waitAndCleanup();
+
+            try testing.expectEqualSlices(T, &values, &result);
+
+            if (T != u8) {
+                try testing.expectError(error.FormatMismatch, load(u8, context, pipeline, path, .{}));
+            }
+        }
+    }
+}
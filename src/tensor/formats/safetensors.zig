@@ -0,0 +1,282 @@
+const std = @import("std");
+const builtin = @import("builtin");
+const cl = @import("opencl");
+
+const core = @import("core");
+const Context = core.Context;
+const Pipeline = core.Pipeline;
+
+const tensor_module = @import("../main.zig");
+const Tensor = tensor_module.Tensor;
+const CreateConfig = tensor_module.CreateConfig;
+
+const common = @import("common.zig");
+pub const Errors = common.Errors;
+
+comptime {
+    // Safetensors data is always little endian
+    if (builtin.cpu.arch.endian() != .little) @compileError("safetensors needs a little endian host");
+}
+
+/// Safetensors dtype of `T`, null if the format has no equivalent (complex types).
+fn getDtype(comptime T: type) ?[]const u8 {
+    return switch (T) {
+        i8 => "I8",
+        u8 => "U8",
+        i16 => "I16",
+        u16 => "U16",
+        i32 => "I32",
+        u32 => "U32",
+        i64 => "I64",
+        u64 => "U64",
+        f32 => "F32",
+        f64 => "F64",
+        else => null,
+    };
+}
+
+const Header = struct {
+    parsed: std.json.Parsed(std.json.Value),
+    data: []const u8,
+
+    fn parse(allocator: std.mem.Allocator, content: []const u8) Errors!Header {
+        if (content.len < 8) return error.InvalidFormat;
+
+        const header_size = std.mem.readInt(u64, content[0..8], .little);
+        if (header_size > content.len - 8) return error.InvalidFormat;
+
+        const json = content[8..(8 + header_size)];
+        const parsed = std.json.parseFromSlice(std.json.Value, allocator, json, .{}) catch |err| switch (err) {
+            error.OutOfMemory => return error.OutOfMemory,
+            else => return error.InvalidFormat,
+        };
+        errdefer parsed.deinit();
+
+        if (parsed.value != .object) return error.InvalidFormat;
+
+        return .{ .parsed = parsed, .data = content[(8 + header_size)..] };
+    }
+
+    fn deinit(self: *const Header) void {
+        self.parsed.deinit();
+    }
+
+    const Info = struct {
+        shape: []const std.json.Value,
+        data: []const u8,
+    };
+
+    fn get(self: *const Header, comptime T: type, name: []const u8) Errors!Info {
+        const dtype = comptime getDtype(T) orelse @compileError("safetensors has no equivalent of this type");
+
+        const entry = self.parsed.value.object.get(name) orelse return error.FormatMismatch;
+        if (entry != .object) return error.InvalidFormat;
+
+        const entry_dtype = entry.object.get("dtype") orelse return error.InvalidFormat;
+        if (entry_dtype != .string) return error.InvalidFormat;
+        if (!std.mem.eql(u8, entry_dtype.string, dtype)) return error.FormatMismatch;
+
+        const shape = entry.object.get("shape") orelse return error.InvalidFormat;
+        if (shape != .array) return error.InvalidFormat;
+        for (shape.array.items) |d| {
+            if (d != .integer or d.integer < 0) return error.InvalidFormat;
+        }
+
+        const offsets = entry.object.get("data_offsets") orelse return error.InvalidFormat;
+        if (offsets != .array or offsets.array.items.len != 2) return error.InvalidFormat;
+
+        const begin = offsets.array.items[0];
+        const end = offsets.array.items[1];
+        if (begin != .integer or end != .integer) return error.InvalidFormat;
+        if (begin.integer < 0 or end.integer < begin.integer or end.integer > self.data.len) {
+            return error.InvalidFormat;
+        }
+
+        return .{
+            .shape = shape.array.items,
+            .data = self.data[@intCast(begin.integer)..@intCast(end.integer)],
+        };
+    }
+};
+
+/// Loads the tensor called `name` of the safetensors file in `path` into `tensor`, that must have
+/// the same type and shape. The data is uploaded straight from the mapped file.
+pub fn loadInto(
+    comptime T: type,
+    pipeline: *Pipeline,
+    tensor: *Tensor(T),
+    path: []const u8,
+    name: []const u8,
+) Errors!void {
+    const mapped = try common.MappedFile.open(path);
+    defer mapped.close();
+
+    const header = try Header.parse(pipeline.command_queue.context.allocator, mapped.content);
+    defer header.deinit();
+
+    const info = try header.get(T, name);
+
+    // Scalars (empty shape) are loaded as a single element tensor
+    const shape = tensor.dimensions.shape;
+    if (info.shape.len == 0) {
+        if (shape.len != 1 or shape[0] != 1) return error.FormatMismatch;
+    } else {
+        if (info.shape.len != shape.len) return error.FormatMismatch;
+        for (info.shape, shape) |d, s| {
+            if (d.integer != s) return error.FormatMismatch;
+        }
+    }
+
+    try common.uploadDense(T, pipeline, tensor, info.data);
+}
+
+/// Creates a tensor with the shape and content of the tensor called `name` of the safetensors
+/// file in `path`.
+pub fn load(
+    comptime T: type,
+    context: *const Context,
+    pipeline: *Pipeline,
+    path: []const u8,
+    name: []const u8,
+    config: CreateConfig,
+) Errors!*Tensor(T) {
+    const allocator = context.allocator;
+
+    const mapped = try common.MappedFile.open(path);
+    defer mapped.close();
+
+    const header = try Header.parse(allocator, mapped.content);
+    defer header.deinit();
+
+    const info = try header.get(T, name);
+
+    const shape = try allocator.alloc(u64, @max(info.shape.len, 1));
+    defer allocator.free(shape);
+
+    shape[0] = 1;
+    for (info.shape, shape[0..info.shape.len]) |d, *s| s.* = @intCast(d.integer);
+
+    const tensor = try Tensor(T).alloc(context, pipeline, shape, config);
+    errdefer tensor.release(pipeline);
+
+    try common.uploadDense(T, pipeline, tensor, info.data);
+
+    return tensor;
+}
+
+/// Writes `tensors` in a safetensors file, `names[i]` being the name of `tensors[i]`. The data of
+/// every tensor is streamed to the file a few rows at a time.
+pub fn save(
+    comptime T: type,
+    pipeline: *Pipeline,
+    names: []const []const u8,
+    tensors: []const *Tensor(T),
+    path: []const u8,
+) Errors!void {
+    const dtype = comptime getDtype(T) orelse @compileError("safetensors has no equivalent of this type");
+    if (names.len != tensors.len) return error.InvalidValue;
+
+    const allocator = pipeline.command_queue.context.allocator;
+
+    var header: std.ArrayList(u8) = .empty;
+    defer header.deinit(allocator);
+
+    const writer = header.writer(allocator);
+    try writer.writeByte('{');
+
+    var offset: u64 = 0;
+    for (names, tensors, 0..) |name, t, i| {
+        // Names are written as they are, so characters that need escaping are not allowed
+        for (name) |c| {
+            if (c == '"' or c == '\\' or c < 0x20) return error.UnsupportedFormat;
+        }
+
+        if (i > 0) try writer.writeByte(',');
+        try writer.print("\"{s}\":{{\"dtype\":\"{s}\",\"shape\":[", .{ name, dtype });
+        for (t.dimensions.shape, 0..) |s, j| {
+            if (j > 0) try writer.writeByte(',');
+            try writer.print("{d}", .{s});
+        }
+
+        const size = t.dimensions.number_of_elements_without_padding * @sizeOf(T);
+        try writer.print("],\"data_offsets\":[{d},{d}]}}", .{ offset, offset + size });
+        offset += size;
+    }
+    try writer.writeByte('}');
+
+    // The data section starts aligned to 8 bytes
+    while (header.items.len % 8 != 0) try header.append(allocator, ' ');
+
+    var header_size: [8]u8 = undefined;
+    std.mem.writeInt(u64, &header_size, header.items.len, .little);
+
+    const file = try std.fs.cwd().createFile(path, .{});
+    defer file.close();
+
+    try file.writeAll(&header_size);
+    try file.writeAll(header.items);
+
+    var sink = common.FileSink(T){ .file = file };
+    for (tensors) |t| {
+        try tensor_module.memory.writeToStream(T, pipeline, t, common.EXPORT_STAGING_SIZE, &sink);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Unit Tests
+const testing = std.testing;
+
+test "safetensors - save and load" {
+    const allocator = testing.allocator;
+
+    const context = try Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    var tmp = testing.tmpDir(.{});
+    defer tmp.cleanup();
+
+    const path = try std.fmt.allocPrint(allocator, ".zig-cache/tmp/{s}/model.safetensors", .{tmp.sub_path});
+    defer allocator.free(path);
+
+    const weight = try Tensor(f32).alloc(context, pipeline, &.{ 3, 5 }, .{});
+    defer weight.release(pipeline);
+
+    const bias = try Tensor(f32).alloc(context, pipeline, &.{3}, .{});
+    defer bias.release(pipeline);
+
+    var weight_values: [15]f32 = undefined;
+    for (&weight_values, 0..) |*v, i| v.* = @floatFromInt(i);
+    const bias_values = [_]f32{ -1, -2, -3 };
+
+    try tensor_module.memory.readFromBuffer(f32, pipeline, weight, &weight_values);
+    try tensor_module.memory.readFromBuffer(f32, pipeline, bias, &bias_values);
+
+    try save(f32, pipeline, &.{ "layer.weight", "layer.bias" }, &.{ weight, bias }, path);
+
+    const loaded_bias = try load(f32, context, pipeline, path, "layer.bias", .{});
+    defer loaded_bias.release(pipeline);
+    try testing.expectEqualSlices(u64, &.{3}, loaded_bias.dimensions.shape);
+
+    const loaded_weight = try Tensor(f32).alloc(context, pipeline, &.{ 3, 5 }, .{});
+    defer loaded_weight.release(pipeline);
+    try loadInto(f32, pipeline, loaded_weight, path, "layer.weight");
+
+    var weight_result: [15]f32 = undefined;
+    var bias_result: [3]f32 = undefined;
+    try tensor_module.memory.writeToBuffer(f32, pipeline, loaded_weight, &weight_result);
+    try tensor_module.memory.writeToBuffer(f32, pipeline, loaded_bias, &bias_result);
+    pipeline.waitAndCleanup();
+
+    try testing.expectEqualSlices(f32, &weight_values, &weight_result);
+    try testing.expectEqualSlices(f32, &bias_values, &bias_result);
+
+    try testing.expectError(error.FormatMismatch, load(f32, context, pipeline, path, "missing", .{}));
+    try testing.expectError(error.FormatMismatch, load(i32, context, pipeline, path, "layer.bias", .{}));
+    try testing.expectError(error.FormatMismatch, loadInto(f32, pipeline, loaded_weight, path, "layer.bias"));
+}
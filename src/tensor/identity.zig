@@ -36,6 +36,8 @@ pub fn identity(
         identity_cl_kernel,
         null,
     );
+
+    tensor.markModified();
     const prev_events = pipeline.prevEvents();
 
     const setArg = cl.kernel.setArg;
@@ -15,3 +15,30 @@ __kernel void fill(
     const ulong index = i*slice_pitch + j*row_pitch + k;
     buffer[index] = scalar;
 }
+
+// Sets the rows x cols block at (row, col) of every matrix. The NDRange (depth, rows, cols) is
+// padded to a multiple of the local size, work items outside of it return early.
+__kernel void fill_block(
+    __global wks *restrict buffer,
+
+    const ulong row_pitch,
+    const ulong slice_pitch,
+
+    const ulong row,
+    const ulong col,
+
+    const ulong depth,
+    const ulong rows,
+    const ulong cols,
+
+    const wks scalar
+) {
+    const ulong i = get_global_id(0);
+    const ulong j = get_global_id(1);
+    const ulong k = get_global_id(2);
+
+    if (i >= depth || j >= rows || k >= cols) return;
+
+    const ulong index = i*slice_pitch + (row + j)*row_pitch + col + k;
+    buffer[index] = scalar;
+}
@@ -1,42 +1,120 @@
 #include "wekua.h"
 
-__kernel void transpose(
-	__global const wks *restrict A,
-    __global const ulong *restrict pitches_A,
+// Tiles are padded with one column so reading a column of the tile doesn't hit the same bank
+// of local memory
+#define TILE_STRIDE (TILE_SIZE + 1)
 
-	__global wks *restrict B,
-    __global const ulong *restrict pitches_B,
+// Size, pitch in A and pitch in B of every axis that isn't part of the tiles. Up to
+// MAX_ARG_BATCH_AXES of them are passed by value, more are read from a buffer.
+#if BATCH_AXES_IN_BUFFER
+#define BATCH_AXES_SPACE __global
+#define BATCH_AXES batch_axes
+#else
+typedef struct {
+    ulong axes[MAX_ARG_BATCH_AXES * 3];
+} permute_batch_axes;
+
+#define BATCH_AXES_SPACE __private
+#define BATCH_AXES batch_axes.axes
+#endif
+
+__kernel void permute(
+	__global const wks *restrict const A,
+	__global wks *restrict const B,
+
+#if BATCH_AXES_IN_BUFFER
+    __global const ulong *restrict const batch_axes,
+#else
+    const permute_batch_axes batch_axes,
+#endif
+    const ulong number_of_batch_axes,
+
+    const ulong rows,
+    const ulong cols,
 
     const ulong A_row_pitch,
-    const ulong A_slice_pitch,
-    const ulong A_height,
-    const ulong A_cols,
+    const ulong B_row_pitch,
+    const ulong B_col_pitch
+) {
+#if TRANSPOSED
+    __local wks tile[TILE_SIZE * TILE_STRIDE];
+#endif
+
+    // The batch offsets are computed once per work item
+    ulong batch = get_global_id(0);
+    ulong A_offset = 0;
+    ulong B_offset = 0;
+    for (ulong x = number_of_batch_axes; x > 0; x--) {
+        BATCH_AXES_SPACE const ulong *const axis = BATCH_AXES + (x - 1) * 3;
+        const ulong coordinate = batch % axis[0];
+        batch /= axis[0];
+
+        A_offset += coordinate * axis[1];
+        B_offset += coordinate * axis[2];
+    }
+
+    const ulong tile_row = get_group_id(1) * TILE_SIZE;
+    const ulong tile_col = get_group_id(2) * TILE_SIZE;
+    const ulong local_row = get_local_id(1);
+    const ulong local_col = get_local_id(2);
+
+    // Columns are the last axis of A, so reads are always coalesced
+    ulong row = tile_row + local_row;
+    ulong col = tile_col + local_col;
+
+#if TRANSPOSED
+    if (row < rows && col < cols) {
+        tile[local_row * TILE_STRIDE + local_col] = A[A_offset + row * A_row_pitch + col];
+    }
+
+    barrier(CLK_LOCAL_MEM_FENCE);
 
-	const ulong dim0,
-    const ulong dim1,
-    const ulong ndim
+    // Rows are the last axis of B, neighbour work items write neighbour rows
+    row = tile_row + local_col;
+    col = tile_col + local_row;
+    if (row < rows && col < cols) {
+        B[B_offset + row * B_row_pitch + col * B_col_pitch] = tile[local_col * TILE_STRIDE + local_row];
+    }
+#else
+    if (row < rows && col < cols) {
+        B[B_offset + row * B_row_pitch + col * B_col_pitch] = A[A_offset + row * A_row_pitch + col];
+    }
+#endif
+}
+
+__kernel void transpose_in_place(
+	__global wks *restrict const A,
+
+    const ulong slice_pitch,
+    const ulong row_pitch,
+    const ulong n
 ) {
-	ulong index = get_global_id(0);
-    if ((index % A_row_pitch) >= A_cols) return;
-    else if ((index % A_slice_pitch) >= A_height) return;
-
-	const wks value = A[index];
-
-	ulong b_index = 0;
-	for (ulong x=0; x<ndim; x++) {
-		const ulong dim_pitch = pitches_A[x];
-		const ulong remaining = index % dim_pitch;
-		const ulong dim_index = (index - remaining) / dim_pitch;
-
-		if (x == dim0) {
-			b_index += dim_index * pitches_B[dim1];
-		}else if (x == dim1) {
-			b_index += dim_index * pitches_B[dim0];
-		}else{
-			b_index += dim_index * pitches_B[x];
-		}
-
-		index = remaining;
-	}
-	B[b_index + index] = value;
+    // Each work group swaps a tile of the upper triangle with its mirror tile, the lower
+    // triangle groups have nothing to do
+    const ulong group_row = get_group_id(1);
+    const ulong group_col = get_group_id(2);
+    if (group_row > group_col) return;
+
+    __local wks tile_a[TILE_SIZE * TILE_STRIDE];
+    __local wks tile_b[TILE_SIZE * TILE_STRIDE];
+
+    const ulong offset = get_global_id(0) * slice_pitch;
+    const ulong local_row = get_local_id(1);
+    const ulong local_col = get_local_id(2);
+
+    const ulong row_a = group_row * TILE_SIZE + local_row;
+    const ulong col_a = group_col * TILE_SIZE + local_col;
+    const ulong row_b = group_col * TILE_SIZE + local_row;
+    const ulong col_b = group_row * TILE_SIZE + local_col;
+
+    const bool inside_a = (row_a < n && col_a < n);
+    const bool inside_b = (row_b < n && col_b < n);
+
+    if (inside_a) tile_a[local_row * TILE_STRIDE + local_col] = A[offset + row_a * row_pitch + col_a];
+    if (inside_b) tile_b[local_row * TILE_STRIDE + local_col] = A[offset + row_b * row_pitch + col_b];
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (inside_a) A[offset + row_a * row_pitch + col_a] = tile_b[local_col * TILE_STRIDE + local_row];
+    if (inside_b) A[offset + row_b * row_pitch + col_b] = tile_a[local_col * TILE_STRIDE + local_row];
 }
@@ -14,12 +14,18 @@ pub const fill = @import("fill.zig");
 pub const memory = @import("memory/main.zig");
 pub const random = @import("random/main.zig");
 pub const transpose = @import("transpose.zig").transpose;
+pub const permute = @import("transpose.zig").permute;
+pub const transposeInPlace = @import("transpose.zig").transposeInPlace;
 pub const convertions = @import("convertions/main.zig");
 pub const identity = @import("identity.zig").identity;
 pub const print = @import("print.zig").print;
+pub const checkpoint = @import("checkpoint.zig");
+pub const formats = @import("formats/main.zig");
+pub const PlanarComplex = @import("planar.zig").PlanarComplex;
 
 const WorkConfiguration = @import("work_configuration.zig");
 pub const GemmAlgorithm = WorkConfiguration.GemmAlgorithm;
+pub const GemmRectangularBlock = WorkConfiguration.GemmRectangularBlock;
 
 
 pub const Errors = error{
@@ -32,10 +38,29 @@ pub const Errors = error{
     UnqualTensorsContext,
 } || std.mem.Allocator.Error || cl.errors.OpenCLError || core.KernelsSet.Errors;
 
+/// How `Tensor.alloc` initializes the buffer
+pub const Initialization = enum {
+    /// Every element is zero
+    zeroes,
+    /// Only the padding (and the capacity reserved after the tensor) is zeroed, the elements are
+    /// left uninitialized, for tensors whose content is going to be fully overwritten. Nothing is
+    /// done when the tensor has no padding.
+    padding,
+};
+
 pub const CreateConfig = struct {
     cl_mem_flags: cl.buffer.MemFlags = cl.buffer.MemFlag.read_write,
     host_ptr: ?*anyopaque = null,
     vectors_enabled: bool = true,
+    initialization: Initialization = .zeroes,
+    /// Maximum size of the leading dimension (e.g. the batch), the buffer is allocated for it and
+    /// the tensor can later be resized up to it with `Tensor.resize`. Defaults to `shape[0]`.
+    /// Tensors with a single dimension can't reserve capacity.
+    capacity: ?u64 = null,
+    /// Rows are not padded to the vector width nor to an even length, and matrices don't get an
+    /// even number of rows, so the memory used is the logical size. Vectors are disabled and these
+    /// tensors can't be used with GEMM, whose kernels work on 2x2 blocks at least.
+    compact: bool = false,
 };
 
 const Dimensions = struct {
@@ -44,6 +69,7 @@ const Dimensions = struct {
     pitches: []u64,
     number_of_elements: u64,
     number_of_elements_without_padding: u64,
+    capacity: u64,
 };
 
 const MemoryLayout = struct {
@@ -53,12 +79,22 @@ const MemoryLayout = struct {
     slice_pitch_for_vectors: u64,
     number_of_vectors: u64,
     size: usize,
+    buffer_size: usize,
 };
 
 const Flags = struct {
     vectors_enabled: bool,
+    compact: bool,
 };
 
+// Source of `Tensor.version`, shared by every tensor of every type so that no two contents ever get
+// the same version, not even those of a tensor allocated where a released one was
+var last_version = std.atomic.Value(u64).init(0);
+
+fn nextVersion() u64 {
+    return last_version.fetchAdd(1, .monotonic) + 1;
+}
+
 pub fn Tensor(comptime T: type) type {
     const type_id = core.types.getTypeId(T);
     const is_complex = core.types.isComplex(T);
@@ -72,9 +108,14 @@ pub fn Tensor(comptime T: type) type {
 
         dimensions: Dimensions,
         work_configuration: WorkConfiguration,
+        work_configuration_arena: std.heap.ArenaAllocator,
         memory_layout: MemoryLayout,
         flags: Flags,
 
+        // Tags the content for what is derived from it, such as pre-packed GEMM operands. Unique
+        // across every tensor, see `markModified`
+        version: u64,
+
         const Self = @This();
 
         fn createPitchBuffer(
@@ -110,6 +151,60 @@ pub fn Tensor(comptime T: type) type {
             try pipeline.append(&.{new_event});
         }
 
+        // Everything that depends on the leading dimension: number of elements, slice pitch (of
+        // matrices), size and work configuration. The row pitch must be already computed.
+        fn computeLayout(self: *Self) Errors!void {
+            const shape = self.dimensions.shape;
+            const ndim = shape.len;
+
+            const last_element_index = ndim - 1;
+            const penultimate_element_index = last_element_index -| 1;
+
+            var depth: u64 = 1;
+            for (shape[0..penultimate_element_index]) |e| depth *= e;
+
+            const penultimate_size = if (ndim >= 2) shape[penultimate_element_index] else 1;
+            const last_size = shape[last_element_index];
+
+            var padded_penultimate_size = penultimate_size;
+            if (!self.flags.compact) {
+                padded_penultimate_size += penultimate_size % 2;
+            }
+
+            self.dimensions.number_of_elements_without_padding = depth * penultimate_size * last_size;
+            if (ndim >= 2) {
+                self.dimensions.vl_shape[0] = shape[0];
+            }
+
+            const row_pitch = self.memory_layout.row_pitch;
+            const vector_width = row_pitch / self.memory_layout.row_pitch_for_vectors;
+
+            const slice_pitch = row_pitch * padded_penultimate_size;
+            const number_of_elements = slice_pitch * depth;
+            self.dimensions.number_of_elements = number_of_elements;
+            self.memory_layout.slice_pitch = slice_pitch;
+            self.memory_layout.slice_pitch_for_vectors = slice_pitch / vector_width;
+
+            const number_of_vectors = number_of_elements / vector_width;
+            self.memory_layout.number_of_vectors = number_of_vectors;
+            self.memory_layout.size = number_of_elements * @sizeOf(T);
+
+            _ = self.work_configuration_arena.reset(.retain_capacity);
+            try self.work_configuration.init(
+                T,
+                self.work_configuration_arena.allocator(),
+                self.context.command_queues,
+                depth,
+                penultimate_size,
+                padded_penultimate_size,
+                row_pitch,
+                number_of_elements,
+                number_of_vectors,
+                last_size,
+                self.dimensions.vl_shape,
+            );
+        }
+
         pub fn empty(
             context: *const Context,
             pipeline: *Pipeline,
@@ -139,7 +234,7 @@ pub fn Tensor(comptime T: type) type {
                 d.* = s;
             }
 
-            var vectors_enabled = (!is_complex and config.vectors_enabled);
+            var vectors_enabled = (!is_complex and !config.compact and config.vectors_enabled);
             var vector_width: u64 = 1;
             if (vectors_enabled) {
                 for (command_queues) |cmd| {
@@ -150,27 +245,25 @@ pub fn Tensor(comptime T: type) type {
             }
 
             tensor.flags.vectors_enabled = vectors_enabled;
+            tensor.flags.compact = config.compact;
+            tensor.version = nextVersion();
 
             const vl_shape = try arena_allocator.dupe(u64, shape);
             tensor.dimensions.vl_shape = vl_shape;
 
             const ndim = shape.len;
 
+            const capacity = config.capacity orelse shape[0];
+            if (capacity < shape[0] or (ndim == 1 and capacity != shape[0])) {
+                return Errors.InvalidValue;
+            }
+            tensor.dimensions.capacity = capacity;
+
             const last_element_index = ndim - 1;
             const penultimate_element_index = last_element_index -| 1;
 
-            var number_of_elements_without_padding: u64 = 1;
-            for (shape[0..penultimate_element_index]) |e| number_of_elements_without_padding *= e;
-
-            const penultimate_size = if (ndim >= 2) shape[penultimate_element_index] else 1;
             const last_size = shape[last_element_index];
 
-            const padded_penultimate_size = penultimate_size + (penultimate_size % 2);
-            const depth: usize = number_of_elements_without_padding;
-
-            number_of_elements_without_padding *= last_size * penultimate_size;
-            tensor.dimensions.number_of_elements_without_padding = number_of_elements_without_padding;
-
             var row_pitch: u64 = last_size;
             if (!is_complex and vectors_enabled and vector_width > 1) {
                 const remainder = @mod(row_pitch, vector_width);
@@ -182,21 +275,25 @@ pub fn Tensor(comptime T: type) type {
             var row_pitch_for_vectors = row_pitch / vector_width;
             vl_shape[last_element_index] = row_pitch_for_vectors;
 
-            const row_pitch_for_vectors_remainder = row_pitch_for_vectors % 2;
-            row_pitch_for_vectors += row_pitch_for_vectors_remainder;
-            row_pitch += vector_width * row_pitch_for_vectors_remainder;
+            if (!config.compact) {
+                const row_pitch_for_vectors_remainder = row_pitch_for_vectors % 2;
+                row_pitch_for_vectors += row_pitch_for_vectors_remainder;
+                row_pitch += vector_width * row_pitch_for_vectors_remainder;
+            }
 
             tensor.memory_layout.row_pitch = row_pitch;
             tensor.memory_layout.row_pitch_for_vectors = row_pitch_for_vectors;
 
-            const slice_pitch = row_pitch * padded_penultimate_size;
-            const number_of_elements = slice_pitch * depth;
-            tensor.dimensions.number_of_elements = number_of_elements;
-            tensor.memory_layout.slice_pitch = slice_pitch;
-            tensor.memory_layout.slice_pitch_for_vectors = slice_pitch / vector_width;
+            tensor.work_configuration_arena = std.heap.ArenaAllocator.init(allocator);
+            errdefer tensor.work_configuration_arena.deinit();
 
-            const number_of_vectors = number_of_elements / vector_width;
-            tensor.memory_layout.number_of_vectors = number_of_vectors;
+            // The buffer and the pitches are computed for the whole capacity, the pitches don't
+            // depend on the leading dimension
+            tensor.dimensions.shape[0] = capacity;
+            try tensor.computeLayout();
+
+            const number_of_elements = tensor.dimensions.number_of_elements;
+            const slice_pitch = tensor.memory_layout.slice_pitch;
 
             const pitches = try arena_allocator.alloc(u64, shape.len);
             tensor.dimensions.pitches = pitches;
@@ -204,7 +301,7 @@ pub fn Tensor(comptime T: type) type {
             const antepenultimate_element_index = penultimate_element_index -| 1;
             var pitch: u64 = number_of_elements;
             for (
-                shape[0..antepenultimate_element_index],
+                tensor.dimensions.shape[0..antepenultimate_element_index],
                 pitches[0..antepenultimate_element_index],
             ) |e, *p| {
                 pitch /= e;
@@ -221,27 +318,18 @@ pub fn Tensor(comptime T: type) type {
 
             pitches[last_element_index] = 1;
 
-            try tensor.work_configuration.init(
-                T,
-                arena_allocator,
-                command_queues,
-                depth,
-                penultimate_size,
-                padded_penultimate_size,
-                row_pitch,
-                number_of_elements,
-                number_of_vectors,
-                last_size,
-                vl_shape,
-            );
+            const buffer_size = tensor.memory_layout.size;
+            tensor.memory_layout.buffer_size = buffer_size;
 
-            const size = number_of_elements * @sizeOf(T);
-            tensor.memory_layout.size = size;
+            if (capacity != shape[0]) {
+                tensor.dimensions.shape[0] = shape[0];
+                try tensor.computeLayout();
+            }
 
             tensor.buffer = try cl.buffer.create(
                 context.cl_context,
                 config.cl_mem_flags,
-                size,
+                buffer_size,
                 config.host_ptr,
             );
             errdefer cl.buffer.release(tensor.buffer);
@@ -258,6 +346,7 @@ pub fn Tensor(comptime T: type) type {
             cl.buffer.release(self.buffer);
             cl.buffer.release(self.pitches_buffer);
 
+            self.work_configuration_arena.deinit();
             self.arena.deinit();
             allocator.destroy(self);
         }
@@ -271,10 +360,60 @@ pub fn Tensor(comptime T: type) type {
             const tensor = try empty(context, pipeline, shape, config);
             errdefer tensor.release(pipeline);
 
-            try fill.zeroes(T, pipeline, tensor);
+            const has_padding = (tensor.dimensions.number_of_elements != tensor.dimensions.number_of_elements_without_padding);
+            switch (config.initialization) {
+                .zeroes => try fill.zeroes(T, pipeline, tensor),
+                .padding => if (has_padding) try fill.padding(T, pipeline, tensor),
+            }
 
             return tensor;
         }
+
+        /// Sets the leading dimension (e.g. the batch) to `size`, which can't exceed the capacity
+        /// reserved when the tensor was created. Nothing is allocated, only the layout and the work
+        /// configuration are recomputed. Elements that become part of the tensor when it grows
+        /// are not initialized.
+        pub fn resize(self: *Self, pipeline: *Pipeline, size: u64) Errors!void {
+            const shape = self.dimensions.shape;
+            if (size == 0 or size > self.dimensions.capacity) return Errors.InvalidValue;
+            if (size == shape[0]) return;
+
+            shape[0] = size;
+            try self.computeLayout();
+            self.markModified();
+
+            // The rows of matrices are padded to an even number, the row after the last one is
+            // padding again and must be zero
+            if (shape.len == 2 and (size % 2) == 1 and !self.flags.compact) {
+                const row_size = self.memory_layout.row_pitch * @sizeOf(T);
+                const zero: T = std.mem.zeroes(T);
+
+                const prev_events = pipeline.prevEvents();
+
+                var new_event: cl.event.Event = undefined;
+                try cl.buffer.fill(
+                    pipeline.command_queue.cl_command_queue,
+                    self.buffer,
+                    &zero,
+                    @sizeOf(T),
+                    size * row_size,
+                    row_size,
+                    prev_events,
+                    &new_event,
+                );
+                errdefer helpers.releaseEvent(new_event);
+
+                try pipeline.append(&.{new_event});
+            }
+        }
+
+        /// Gives the tensor a new `version`, so what was derived from the previous content is built
+        /// again. Every operation that writes to a tensor calls it when it enqueues the write, host
+        /// writes and optimizer steps included; code that writes to `buffer` directly must call it
+        /// too.
+        pub fn markModified(self: *Self) void {
+            self.version = nextVersion();
+        }
     };
 }
 
@@ -707,3 +846,102 @@ test "Tensor - vl_shape calculated" {
         }
     }
 }
+
+test "Tensor.resize - leading dimension within capacity" {
+    const allocator = testing.allocator;
+
+    const context = try Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const tensor = try Tensor(f32).alloc(context, pipeline, &.{ 4, 5 }, .{ .capacity = 8 });
+    defer tensor.release(pipeline);
+
+    try testing.expectEqual(@as(u64, 8), tensor.dimensions.capacity);
+    try testing.expect(tensor.memory_layout.buffer_size > tensor.memory_layout.size);
+
+    const buffer_size = tensor.memory_layout.buffer_size;
+    const row_pitch = tensor.memory_layout.row_pitch;
+    const pitches = try allocator.dupe(u64, tensor.dimensions.pitches);
+    defer allocator.free(pitches);
+
+    try tensor.resize(pipeline, 7);
+    try testing.expectEqual(@as(u64, 7), tensor.dimensions.shape[0]);
+    try testing.expectEqual(@as(u64, 35), tensor.dimensions.number_of_elements_without_padding);
+    try testing.expectEqual(row_pitch * 8, tensor.dimensions.number_of_elements);
+    try testing.expectEqual(@as(u64, 7), tensor.work_configuration.global_work_items[1]);
+
+    // Nothing that depends on the allocation changes
+    try testing.expectEqual(buffer_size, tensor.memory_layout.buffer_size);
+    try testing.expectEqual(row_pitch, tensor.memory_layout.row_pitch);
+    try testing.expectEqualSlices(u64, pitches, tensor.dimensions.pitches);
+
+    const values = [_]f32{1} ** 35;
+    try memory.readFromBuffer(f32, pipeline, tensor, &values);
+
+    // The row after the last one is padding again
+    try tensor.resize(pipeline, 3);
+    try tensor.resize(pipeline, 4);
+
+    var result: [20]f32 = undefined;
+    try memory.writeToBuffer(f32, pipeline, tensor, &result);
+    pipeline.waitAndCleanup();
+
+    try testing.expectEqualSlices(f32, &([_]f32{1} ** 15 ++ [_]f32{0} ** 5), &result);
+
+    try testing.expectError(Errors.InvalidValue, tensor.resize(pipeline, 9));
+    try testing.expectError(Errors.InvalidValue, tensor.resize(pipeline, 0));
+
+    // Capacity smaller than the shape and capacity of vectors are not allowed
+    try testing.expectError(Errors.InvalidValue, Tensor(f32).empty(context, pipeline, &.{ 4, 5 }, .{ .capacity = 3 }));
+    try testing.expectError(Errors.InvalidValue, Tensor(f32).empty(context, pipeline, &.{5}, .{ .capacity = 8 }));
+}
+
+test "Tensor.empty - compact layout" {
+    const allocator = testing.allocator;
+
+    const context = try Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    inline for (core.types.SUPPORTED_TYPES) |T| {
+        if (command_queue.isTypeSupported(T)) {
+            const tensor = try Tensor(T).alloc(context, pipeline, &.{ 2, 5, 3 }, .{ .compact = true });
+            defer tensor.release(pipeline);
+
+            try testing.expect(tensor.flags.compact);
+            try testing.expect(!tensor.flags.vectors_enabled);
+            try testing.expectEqual(@as(u64, 3), tensor.memory_layout.row_pitch);
+            try testing.expectEqual(@as(u64, 15), tensor.memory_layout.slice_pitch);
+            try testing.expectEqual(@as(u64, 30), tensor.dimensions.number_of_elements);
+            try testing.expectEqual(tensor.dimensions.number_of_elements, tensor.dimensions.number_of_elements_without_padding);
+            try testing.expectEqual(30 * @sizeOf(T), tensor.memory_layout.size);
+
+            const SubType = core.types.getType(T);
+
+            var values: [30]T = undefined;
+            for (&values, 0..) |*v, i| {
+                const x: SubType = switch (@typeInfo(SubType)) {
+                    .float => @floatFromInt(i),
+                    else => @intCast(i),
+                };
+                v.* = if (comptime core.types.isComplex(T)) .{ .real = x, .imag = x } else x;
+            }
+            try memory.readFromBuffer(T, pipeline, tensor, &values);
+
+            var result: [30]T = undefined;
+            try memory.writeToBuffer(T, pipeline, tensor, &result);
+            pipeline.waitAndCleanup();
+
+            for (values, result) |expected, val| {
+                try testing.expectEqual(expected, val);
+            }
+        }
+    }
+}
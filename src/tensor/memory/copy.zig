@@ -89,8 +89,16 @@ pub fn copy(
     dst: *Tensor(T),
 ) TensorErrors!void {
     try helpers.eqlTensorsShape(T, src, dst);
-
-    if (src.memory_layout.row_pitch == dst.memory_layout.row_pitch) {
+    dst.markModified();
+
+    // A compact and a padded tensor can share the row pitch and still differ in the number of rows
+    // of their matrices, so the buffers are copied as a block only when the whole layout matches
+    const src_layout = &src.memory_layout;
+    const dst_layout = &dst.memory_layout;
+    if (src_layout.row_pitch == dst_layout.row_pitch and
+        src_layout.slice_pitch == dst_layout.slice_pitch and
+        src_layout.size == dst_layout.size)
+    {
         try copy_tensor_with_same_row_pitch(T, pipeline, src, dst);
     } else {
         try copy_tensor_with_different_row_pitch(T, pipeline, src, dst);
@@ -0,0 +1,145 @@
+const std = @import("std");
+const cl = @import("opencl");
+
+const core = @import("core");
+const Pipeline = core.Pipeline;
+const KernelsSet = core.KernelsSet;
+
+const helpers = @import("../helpers.zig");
+
+const tensor_module = @import("../main.zig");
+const Tensor = tensor_module.Tensor;
+const TensorErrors = tensor_module.Errors;
+
+const gather_cl_kernel: []const u8 = @embedFile("kernels/gather.cl");
+
+/// Translates `coordinates` (one group of `shape.len` coordinates per element) into offsets in
+/// `wks` units.
+pub fn computeOffsets(
+    comptime T: type,
+    allocator: std.mem.Allocator,
+    tensor: *Tensor(T),
+    coordinates: []const u64,
+    number_of_elements: usize,
+) TensorErrors![]u64 {
+    const ndim = tensor.dimensions.shape.len;
+    if (coordinates.len != number_of_elements * ndim) {
+        return tensor_module.Errors.InvalidCoordinates;
+    }
+
+    const offsets = try allocator.alloc(u64, number_of_elements);
+    errdefer allocator.free(offsets);
+
+    for (offsets, 0..) |*offset, i| {
+        const coor = coordinates[(i * ndim)..((i + 1) * ndim)];
+
+        offset.* = 0;
+        for (tensor.dimensions.pitches, tensor.dimensions.shape, coor) |p, ds, c| {
+            if (c >= ds) return tensor_module.Errors.InvalidCoordinates;
+
+            offset.* += c * p;
+        }
+    }
+
+    return offsets;
+}
+
+/// Batched `getValue`: reads `values.len` elements, where `coordinates` holds `shape.len`
+/// coordinates per element, one after the other. The elements are gathered on the device into a
+/// compact buffer that is read with a single transfer. As with `getValue`, `values` is filled
+/// when the pipeline is waited.
+pub fn getValues(
+    comptime T: type,
+    pipeline: *Pipeline,
+    tensor: *Tensor(T),
+    coordinates: []const u64,
+    values: []T,
+) TensorErrors!void {
+    const command_queue = pipeline.command_queue;
+    const allocator = command_queue.context.allocator;
+
+    const offsets = try computeOffsets(T, allocator, tensor, coordinates, values.len);
+    defer allocator.free(offsets);
+
+    if (values.len == 0) return;
+
+    const cl_context = command_queue.context.cl_context;
+
+    // Both buffers are released right after enqueueing, OpenCL keeps them alive until the
+    // commands that use them finish
+    const offsets_buffer = try cl.buffer.create(
+        cl_context,
+        cl.buffer.MemFlag.read_only | cl.buffer.MemFlag.copy_host_ptr,
+        offsets.len * @sizeOf(u64),
+        offsets.ptr,
+    );
+    defer cl.buffer.release(offsets_buffer);
+
+    const values_buffer = try cl.buffer.create(
+        cl_context,
+        cl.buffer.MemFlag.write_only,
+        values.len * @sizeOf(T),
+        null,
+    );
+    defer cl.buffer.release(values_buffer);
+
+    const kernel = try KernelsSet.getClNoVectorKernel(
+        T,
+        command_queue,
+        .Gather,
+        "gather",
+        gather_cl_kernel,
+        null,
+    );
+
+    const number_of_elements: u64 = values.len;
+
+    const setArg = cl.kernel.setArg;
+    const cl_mem_size = @sizeOf(cl.buffer.Mem);
+
+    try setArg(kernel, 0, cl_mem_size, @ptrCast(&tensor.buffer));
+    try setArg(kernel, 1, cl_mem_size, @ptrCast(&offsets_buffer));
+    try setArg(kernel, 2, cl_mem_size, @ptrCast(&values_buffer));
+    try setArg(kernel, 3, @sizeOf(u64), @ptrCast(&number_of_elements));
+
+    const global_work_items = [1]u64{number_of_elements};
+    var padded_global_work_items: [1]u64 = undefined;
+    var local_work_items: [1]u64 = undefined;
+    core.WorkGroupTuner.getLocalWorkItems(
+        command_queue,
+        "gather",
+        core.types.getTypeIndex(T),
+        &global_work_items,
+        &padded_global_work_items,
+        &local_work_items,
+    );
+
+    const prev_events = pipeline.prevEvents();
+
+    var gather_event: cl.event.Event = undefined;
+    try cl.kernel.enqueueNdRange(
+        command_queue.cl_command_queue,
+        kernel,
+        null,
+        &padded_global_work_items,
+        &local_work_items,
+        prev_events,
+        &gather_event,
+    );
+    errdefer helpers.releaseEvent(gather_event);
+
+    var read_event: cl.event.Event = undefined;
+    try cl.buffer.read(
+        command_queue.cl_command_queue,
+        values_buffer,
+        false,
+        0,
+        values.len * @sizeOf(T),
+        values.ptr,
+        &.{gather_event},
+        &read_event,
+    );
+    errdefer helpers.releaseEvent(read_event);
+
+    try pipeline.append(&.{ gather_event, read_event });
+}
@@ -0,0 +1,46 @@
+#include "wekua.h"
+
+/**
+ * =============================================================================
+ * Gather / scatter of scattered elements through a compact buffer
+ * =============================================================================
+ *
+ * KERNEL PARAMETERS
+ * -----------------
+ * tensor   - Tensor buffer
+ * offsets  - Offset of every element in the tensor, in `wks` units
+ * values   - Compact buffer with one element per offset
+ * n        - Number of offsets
+ *
+ * NDRANGE
+ * -------
+ * (n), padded up to a multiple of the local size.
+ *
+ * If the same offset appears several times in a scatter, which value is
+ * written is undefined.
+ * =============================================================================
+ */
+
+__kernel void gather(
+    __global const wks *restrict tensor,
+    __global const ulong *restrict offsets,
+    __global wks *restrict values,
+    const ulong n
+) {
+    const ulong i = get_global_id(0);
+    if (i >= n) return;
+
+    values[i] = tensor[offsets[i]];
+}
+
+__kernel void scatter(
+    __global wks *restrict tensor,
+    __global const ulong *restrict offsets,
+    __global const wks *restrict values,
+    const ulong n
+) {
+    const ulong i = get_global_id(0);
+    if (i >= n) return;
+
+    tensor[offsets[i]] = values[i];
+}
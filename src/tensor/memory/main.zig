@@ -1,8 +1,12 @@
 pub const getValue = @import("get_value.zig").getValue;
 pub const putValue = @import("put_value.zig").putValue;
+pub const getValues = @import("get_values.zig").getValues;
+pub const putValues = @import("put_values.zig").putValues;
 pub const readFromBuffer = @import("read_from_buffer.zig").readFromBuffer;
 pub const writeToBuffer = @import("write_to_buffer.zig").writeToBuffer;
 pub const copy = @import("copy.zig").copy;
+pub const readFromStream = @import("stream.zig").readFromStream;
+pub const writeToStream = @import("stream.zig").writeToStream;
 
 // -----------------------------------------------------------------------------
 // Unit Tests
@@ -420,6 +424,129 @@ test "getValue - invalid coordinates out of bounds" {
     try testing.expectError(tensor_module.Errors.InvalidCoordinates, err);
 }
 
+test "putValues and getValues - 3D tensor for all types" {
+    const allocator = testing.allocator;
+
+    const context = try Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const shape = [_]u64{ 3, 5, 7 };
+    const config = tensor_module.CreateConfig{};
+
+    const coordinates = [_]u64{
+        0, 0, 0,
+        2, 4, 6,
+        1, 3, 2,
+        0, 4, 1,
+        2, 0, 5,
+    };
+    const number_of_values = coordinates.len / shape.len;
+
+    inline for (core.types.SUPPORTED_TYPES) |T| {
+        if (command_queue.isTypeSupported(T)) {
+            const tensor = try Tensor(T).alloc(context, pipeline, &shape, config);
+            defer tensor.release(pipeline);
+
+            var values: [number_of_values]T = undefined;
+            for (&values, 0..) |*value, i| {
+                if (comptime core.types.isComplex(T)) {
+                    value.* = switch (@typeInfo(core.types.getType(T))) {
+                        .float => .{ .real = @floatFromInt(i + 1), .imag = @floatFromInt(i * 3) },
+                        .int => .{ .real = @intCast(i + 1), .imag = @intCast(i * 3) },
+                        else => unreachable
+                    };
+                } else {
+                    value.* = switch (@typeInfo(T)) {
+                        .float => @floatFromInt(i + 1),
+                        .int => @intCast(i + 1),
+                        else => unreachable
+                    };
+                }
+            }
+
+            try putValues(T, pipeline, tensor, &coordinates, &values);
+
+            var results: [number_of_values]T = undefined;
+            try getValues(T, pipeline, tensor, &coordinates, &results);
+            pipeline.waitAndCleanup();
+
+            for (values, results, 0..) |expected, result, i| {
+                // Must agree with the single element path
+                var single: T = undefined;
+                try getValue(T, pipeline, tensor, coordinates[(i * shape.len)..((i + 1) * shape.len)], &single);
+                pipeline.waitAndCleanup();
+
+                if (comptime core.types.isComplex(T)) {
+                    try testing.expectEqual(expected.real, result.real);
+                    try testing.expectEqual(expected.imag, result.imag);
+                    try testing.expectEqual(expected.real, single.real);
+                    try testing.expectEqual(expected.imag, single.imag);
+                } else {
+                    try testing.expectEqual(expected, result);
+                    try testing.expectEqual(expected, single);
+                }
+            }
+
+            // Nothing else was written
+            var untouched: T = undefined;
+            try getValue(T, pipeline, tensor, &.{ 1, 1, 1 }, &untouched);
+            pipeline.waitAndCleanup();
+
+            if (comptime core.types.isComplex(T)) {
+                try testing.expectEqual(@as(@TypeOf(untouched.real), 0), untouched.real);
+            } else {
+                try testing.expectEqual(@as(T, 0), untouched);
+            }
+        }
+    }
+}
+
+test "putValues and getValues - invalid coordinates" {
+    const allocator = testing.allocator;
+
+    const context = try Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const shape = [_]u64{ 2, 3 };
+    const config = tensor_module.CreateConfig{};
+
+    const tensor = try Tensor(f32).alloc(context, pipeline, &shape, config);
+    defer tensor.release(pipeline);
+
+    const values = [_]f32{ 1, 2 };
+    var results: [2]f32 = undefined;
+
+    // Not enough coordinates for two values
+    const short_coordinates = [_]u64{ 0, 1, 1 };
+    try testing.expectError(
+        tensor_module.Errors.InvalidCoordinates,
+        putValues(f32, pipeline, tensor, &short_coordinates, &values),
+    );
+    try testing.expectError(
+        tensor_module.Errors.InvalidCoordinates,
+        getValues(f32, pipeline, tensor, &short_coordinates, &results),
+    );
+
+    // Out of bounds
+    const out_of_bounds = [_]u64{ 0, 1, 2, 0 };
+    try testing.expectError(
+        tensor_module.Errors.InvalidCoordinates,
+        putValues(f32, pipeline, tensor, &out_of_bounds, &values),
+    );
+    try testing.expectError(
+        tensor_module.Errors.InvalidCoordinates,
+        getValues(f32, pipeline, tensor, &out_of_bounds, &results),
+    );
+}
+
 test "readFromBuffer and writeToBuffer - 1D tensor for all types" {
     const allocator = testing.allocator;
 
@@ -729,6 +856,74 @@ test "readFromBuffer and writeToBuffer - round trip preserves data" {
     }
 }
 
+test "readFromStream and writeToStream - chunked round trip" {
+    const allocator = testing.allocator;
+
+    const context = try Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const shape = [_]u64{ 3, 5, 7 };
+    const number_of_elements = shape[0] * shape[1] * shape[2];
+    const row_size = shape[2] * @sizeOf(f32);
+
+    const Source = struct {
+        next_value: f32 = 0,
+
+        pub fn fill(self: *@This(), values: []f32) !void {
+            for (values) |*v| {
+                v.* = self.next_value;
+                self.next_value += 1;
+            }
+        }
+    };
+
+    const Sink = struct {
+        values: []f32,
+        position: usize = 0,
+
+        pub fn consume(self: *@This(), values: []const f32) !void {
+            @memcpy(self.values[self.position..(self.position + values.len)], values);
+            self.position += values.len;
+        }
+    };
+
+    const tensor = try Tensor(f32).alloc(context, pipeline, &shape, .{});
+    defer tensor.release(pipeline);
+
+    const expected = try allocator.alloc(f32, number_of_elements);
+    defer allocator.free(expected);
+    for (expected, 0..) |*v, i| v.* = @floatFromInt(i);
+
+    const result = try allocator.alloc(f32, number_of_elements);
+    defer allocator.free(result);
+
+    // One row, part of a slice, several slices and everything at once
+    const staging_sizes = [_]usize{ 1, 2 * 3 * row_size, 2 * 10 * row_size, 1 << 20 };
+    for (staging_sizes) |staging_size| {
+        var source = Source{};
+        try readFromStream(f32, pipeline, tensor, staging_size, &source);
+
+        try writeToBuffer(f32, pipeline, tensor, result);
+        pipeline.waitAndCleanup();
+        try testing.expectEqualSlices(f32, expected, result);
+
+        @memset(result, -1);
+        var sink = Sink{ .values = result };
+        try writeToStream(f32, pipeline, tensor, staging_size, &sink);
+
+        try testing.expectEqual(number_of_elements, sink.position);
+        try testing.expectEqualSlices(f32, expected, result);
+
+        try tensor_module.fill.zeroes(f32, pipeline, tensor);
+    }
+}
+
 test "copy - same row_pitch for all types" {
     const allocator = testing.allocator;
 
@@ -996,3 +1191,86 @@ test "copy - 3D tensor for all types" {
         }
     }
 }
+
+test "copy - between compact and padded tensors" {
+    const allocator = testing.allocator;
+
+    const context = try Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    // Without vectors both layouts have the same row pitch, but the padded matrices get an extra
+    // row, so the slice pitches and the sizes differ
+    const shapes = [_][]const u64{ &.{ 2, 5, 4 }, &.{ 5, 4 }, &.{ 3, 3, 5, 2 } };
+    const compact_config = tensor_module.CreateConfig{ .compact = true };
+    const padded_config = tensor_module.CreateConfig{ .vectors_enabled = false };
+
+    for (shapes) |shape| {
+        const compact = try Tensor(f32).alloc(context, pipeline, shape, compact_config);
+        defer compact.release(pipeline);
+
+        const padded = try Tensor(f32).alloc(context, pipeline, shape, padded_config);
+        defer padded.release(pipeline);
+
+        try testing.expectEqual(compact.memory_layout.row_pitch, padded.memory_layout.row_pitch);
+        try testing.expect(compact.memory_layout.size < padded.memory_layout.size);
+
+        const number_of_elements = compact.dimensions.number_of_elements_without_padding;
+        const values = try allocator.alloc(f32, number_of_elements);
+        defer allocator.free(values);
+
+        const result = try allocator.alloc(f32, number_of_elements);
+        defer allocator.free(result);
+
+        for (values, 0..) |*v, i| v.* = @floatFromInt(i + 1);
+
+        // Compact to padded
+        try readFromBuffer(f32, pipeline, compact, values);
+        try copy(f32, pipeline, compact, padded);
+
+        try writeToBuffer(f32, pipeline, padded, result);
+        pipeline.waitAndCleanup();
+        try testing.expectEqualSlices(f32, values, result);
+
+        // The padding of the destination is left zeroed
+        const raw = try allocator.alloc(f32, padded.memory_layout.size / @sizeOf(f32));
+        defer allocator.free(raw);
+
+        const prev_events = pipeline.prevEvents();
+        var new_event: cl.event.Event = undefined;
+        try cl.buffer.read(
+            command_queue.cl_command_queue,
+            padded.buffer,
+            false,
+            0,
+            padded.memory_layout.size,
+            raw.ptr,
+            prev_events,
+            &new_event,
+        );
+        try pipeline.append(&.{new_event});
+        pipeline.waitAndCleanup();
+
+        const rows = shape[shape.len - 2];
+        const cols = shape[shape.len - 1];
+        const row_pitch = padded.memory_layout.row_pitch;
+        const slice_pitch = padded.memory_layout.slice_pitch;
+        for (raw, 0..) |val, i| {
+            if ((i % row_pitch) >= cols or ((i % slice_pitch) / row_pitch) >= rows) {
+                try testing.expectEqual(@as(f32, 0), val);
+            }
+        }
+
+        // Padded to compact
+        for (values) |*v| v.* = -v.*;
+        try readFromBuffer(f32, pipeline, padded, values);
+        try copy(f32, pipeline, padded, compact);
+
+        try writeToBuffer(f32, pipeline, compact, result);
+        pipeline.waitAndCleanup();
+        try testing.expectEqualSlices(f32, values, result);
+    }
+}
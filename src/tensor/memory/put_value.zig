@@ -28,6 +28,7 @@ pub fn putValue(
     }
     offset *= @sizeOf(T);
 
+    tensor.markModified();
     const prev_events = pipeline.prevEvents();
     var new_event: cl.event.Event = undefined;
 
@@ -0,0 +1,103 @@
+const cl = @import("opencl");
+
+const core = @import("core");
+const Pipeline = core.Pipeline;
+const KernelsSet = core.KernelsSet;
+
+const helpers = @import("../helpers.zig");
+
+const tensor_module = @import("../main.zig");
+const Tensor = tensor_module.Tensor;
+const TensorErrors = tensor_module.Errors;
+
+const computeOffsets = @import("get_values.zig").computeOffsets;
+
+const gather_cl_kernel: []const u8 = @embedFile("kernels/gather.cl");
+
+/// Batched `putValue`: writes `values.len` elements, where `coordinates` holds `shape.len`
+/// coordinates per element, one after the other. The values are uploaded with the buffer
+/// creation and scattered by a single kernel, so `values` can be freed as soon as this returns.
+/// If the same coordinates appear more than once, which value ends in the tensor is undefined.
+pub fn putValues(
+    comptime T: type,
+    pipeline: *Pipeline,
+    tensor: *Tensor(T),
+    coordinates: []const u64,
+    values: []const T,
+) TensorErrors!void {
+    const command_queue = pipeline.command_queue;
+    const allocator = command_queue.context.allocator;
+
+    const offsets = try computeOffsets(T, allocator, tensor, coordinates, values.len);
+    defer allocator.free(offsets);
+
+    if (values.len == 0) return;
+    tensor.markModified();
+
+    const cl_context = command_queue.context.cl_context;
+
+    // Both buffers are released right after enqueueing, OpenCL keeps them alive until the
+    // kernel finishes
+    const offsets_buffer = try cl.buffer.create(
+        cl_context,
+        cl.buffer.MemFlag.read_only | cl.buffer.MemFlag.copy_host_ptr,
+        offsets.len * @sizeOf(u64),
+        offsets.ptr,
+    );
+    defer cl.buffer.release(offsets_buffer);
+
+    const values_buffer = try cl.buffer.create(
+        cl_context,
+        cl.buffer.MemFlag.read_only | cl.buffer.MemFlag.copy_host_ptr,
+        values.len * @sizeOf(T),
+        @constCast(values.ptr),
+    );
+    defer cl.buffer.release(values_buffer);
+
+    const kernel = try KernelsSet.getClNoVectorKernel(
+        T,
+        command_queue,
+        .Scatter,
+        "scatter",
+        gather_cl_kernel,
+        null,
+    );
+
+    const number_of_elements: u64 = values.len;
+
+    const setArg = cl.kernel.setArg;
+    const cl_mem_size = @sizeOf(cl.buffer.Mem);
+
+    try setArg(kernel, 0, cl_mem_size, @ptrCast(&tensor.buffer));
+    try setArg(kernel, 1, cl_mem_size, @ptrCast(&offsets_buffer));
+    try setArg(kernel, 2, cl_mem_size, @ptrCast(&values_buffer));
+    try setArg(kernel, 3, @sizeOf(u64), @ptrCast(&number_of_elements));
+
+    const global_work_items = [1]u64{number_of_elements};
+    var padded_global_work_items: [1]u64 = undefined;
+    var local_work_items: [1]u64 = undefined;
+    core.WorkGroupTuner.getLocalWorkItems(
+        command_queue,
+        "scatter",
+        core.types.getTypeIndex(T),
+        &global_work_items,
+        &padded_global_work_items,
+        &local_work_items,
+    );
+
+    const prev_events = pipeline.prevEvents();
+
+    var new_event: cl.event.Event = undefined;
+    try cl.kernel.enqueueNdRange(
+        command_queue.cl_command_queue,
+        kernel,
+        null,
+        &padded_global_work_items,
+        &local_work_items,
+        prev_events,
+        &new_event,
+    );
+    errdefer helpers.releaseEvent(new_event);
+
+    try pipeline.append(&.{new_event});
+}
@@ -39,6 +39,8 @@ pub fn readFromBuffer(
     const host_row_pitch = width;
     const host_slice_pitch = height * host_row_pitch;
 
+    tensor.markModified();
+
     const prev_events = pipeline.prevEvents();
 
     var new_event: cl.event.Event = undefined;
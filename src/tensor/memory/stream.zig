@@ -0,0 +1,227 @@
+const std = @import("std");
+const cl = @import("opencl");
+
+const core = @import("core");
+const Pipeline = core.Pipeline;
+
+const tensor_module = @import("../main.zig");
+const Tensor = tensor_module.Tensor;
+
+/// Part of the tensor moved by one transfer, `origin` and `region` are given as expected by
+/// `cl.buffer.writeRect`/`readRect` (bytes, rows, slices).
+const Chunk = struct {
+    origin: [3]usize,
+    region: [3]usize,
+    number_of_elements: usize,
+};
+
+/// Splits the tensor in row aligned chunks of at most `rows_per_chunk` rows. When a whole slice
+/// (penultimate and last dimension) fits in a chunk, several slices are moved together.
+const Chunks = struct {
+    width: usize,
+    height: usize,
+    depth: usize,
+    rows_per_chunk: usize,
+
+    slice: usize = 0,
+    row: usize = 0,
+
+    fn init(comptime T: type, tensor: *Tensor(T), staging_size: usize) Chunks {
+        const shape = tensor.dimensions.shape;
+        const ndim = shape.len;
+
+        var depth: usize = 1;
+        if (ndim >= 3) {
+            for (shape[0..(ndim - 2)]) |e| depth *= e;
+        }
+
+        const width: usize = shape[ndim - 1];
+        return .{
+            .width = width,
+            .height = if (ndim >= 2) shape[ndim - 2] else 1,
+            .depth = depth,
+            // Half of the budget for each staging buffer, at least one row
+            .rows_per_chunk = @max(1, staging_size / (2 * width * @sizeOf(T))),
+        };
+    }
+
+    fn next(self: *Chunks, comptime T: type) ?Chunk {
+        if (self.slice >= self.depth) return null;
+
+        const width_in_bytes = self.width * @sizeOf(T);
+
+        var chunk: Chunk = undefined;
+        if (self.row == 0 and self.rows_per_chunk >= self.height) {
+            const slices = @min(self.rows_per_chunk / self.height, self.depth - self.slice);
+            chunk.origin = .{ 0, 0, self.slice };
+            chunk.region = .{ width_in_bytes, self.height, slices };
+
+            self.slice += slices;
+        } else {
+            const rows = @min(self.rows_per_chunk, self.height - self.row);
+            chunk.origin = .{ 0, self.row, self.slice };
+            chunk.region = .{ width_in_bytes, rows, 1 };
+
+            self.row += rows;
+            if (self.row == self.height) {
+                self.row = 0;
+                self.slice += 1;
+            }
+        }
+
+        chunk.number_of_elements = self.width * chunk.region[1] * chunk.region[2];
+        return chunk;
+    }
+};
+
+fn waitEvent(event: cl.event.Event) void {
+    cl.event.waitForMany(&.{event}) catch |err| {
+        std.debug.panic("Unexpected error ({s}) while waiting for events", .{@errorName(err)});
+    };
+    cl.event.release(event);
+}
+
+fn waitPending(pending: *[2]?cl.event.Event) void {
+    for (pending) |*event| {
+        if (event.*) |e| waitEvent(e);
+        event.* = null;
+    }
+}
+
+/// Fills the tensor from `source`, that must provide `fn fill(self, values: []T) !void` and gives
+/// the elements in row major order (as `readFromBuffer` expects them), a chunk at a time.
+///
+/// The data goes through two staging buffers of `staging_size / 2` bytes (rounded to whole rows,
+/// at least one row), so the host fill of a chunk overlaps with the transfer of the previous one
+/// and the whole tensor never needs to be in host memory. Returns when every chunk has been
+/// transferred.
+pub fn readFromStream(
+    comptime T: type,
+    pipeline: *Pipeline,
+    tensor: *Tensor(T),
+    staging_size: usize,
+    source: anytype,
+) !void {
+    const command_queue = pipeline.command_queue;
+    const allocator = command_queue.context.allocator;
+
+    var chunks = Chunks.init(T, tensor, staging_size);
+    const staging_elements = chunks.rows_per_chunk * chunks.width;
+
+    const staging = try allocator.alloc(T, 2 * staging_elements);
+    defer allocator.free(staging);
+
+    const buf_row_pitch = tensor.memory_layout.row_pitch * @sizeOf(T);
+    const buf_slice_pitch = tensor.memory_layout.slice_pitch * @sizeOf(T);
+    const host_origin: [3]usize = .{ 0, 0, 0 };
+
+    tensor.markModified();
+    const prev_events = pipeline.prevEvents();
+
+    // Staging buffers can't be freed while a transfer still uses them
+    var pending: [2]?cl.event.Event = .{ null, null };
+    defer waitPending(&pending);
+
+    var slot: usize = 0;
+    while (chunks.next(T)) |chunk| : (slot ^= 1) {
+        if (pending[slot]) |event| {
+            waitEvent(event);
+            pending[slot] = null;
+        }
+
+        const host_chunk = staging[(slot * staging_elements)..][0..chunk.number_of_elements];
+        try source.fill(host_chunk);
+
+        var new_event: cl.event.Event = undefined;
+        try cl.buffer.writeRect(
+            command_queue.cl_command_queue,
+            tensor.buffer,
+            false,
+            &chunk.origin,
+            &host_origin,
+            &chunk.region,
+            buf_row_pitch,
+            buf_slice_pitch,
+            chunk.region[0],
+            chunk.region[0] * chunk.region[1],
+            host_chunk.ptr,
+            prev_events,
+            &new_event,
+        );
+        pending[slot] = new_event;
+    }
+}
+
+/// Mirror of `readFromStream`: passes the elements of the tensor in row major order to `sink`,
+/// that must provide `fn consume(self, values: []const T) !void`, a chunk at a time. The transfer
+/// of the next chunk overlaps with the host consumption of the current one. Returns when every
+/// chunk has been consumed.
+pub fn writeToStream(
+    comptime T: type,
+    pipeline: *Pipeline,
+    tensor: *Tensor(T),
+    staging_size: usize,
+    sink: anytype,
+) !void {
+    const command_queue = pipeline.command_queue;
+    const allocator = command_queue.context.allocator;
+
+    var chunks = Chunks.init(T, tensor, staging_size);
+    const staging_elements = chunks.rows_per_chunk * chunks.width;
+
+    const staging = try allocator.alloc(T, 2 * staging_elements);
+    defer allocator.free(staging);
+
+    const buf_row_pitch = tensor.memory_layout.row_pitch * @sizeOf(T);
+    const buf_slice_pitch = tensor.memory_layout.slice_pitch * @sizeOf(T);
+    const host_origin: [3]usize = .{ 0, 0, 0 };
+
+    const prev_events = pipeline.prevEvents();
+
+    var pending: [2]?cl.event.Event = .{ null, null };
+    defer waitPending(&pending);
+
+    var in_flight: [2]?Chunk = .{ null, null };
+
+    var slot: usize = 0;
+    var next_chunk = chunks.next(T);
+    while (next_chunk != null or in_flight[slot ^ 1] != null) {
+        // Start the transfer of the next chunk before consuming the previous one
+        if (next_chunk) |chunk| {
+            const host_chunk = staging[(slot * staging_elements)..][0..chunk.number_of_elements];
+
+            var new_event: cl.event.Event = undefined;
+            try cl.buffer.readRect(
+                command_queue.cl_command_queue,
+                tensor.buffer,
+                false,
+                &chunk.origin,
+                &host_origin,
+                &chunk.region,
+                buf_row_pitch,
+                buf_slice_pitch,
+                chunk.region[0],
+                chunk.region[0] * chunk.region[1],
+                host_chunk.ptr,
+                prev_events,
+                &new_event,
+            );
+            pending[slot] = new_event;
+            in_flight[slot] = chunk;
+
+            next_chunk = chunks.next(T);
+        }
+
+        const previous_slot = slot ^ 1;
+        if (in_flight[previous_slot]) |chunk| {
+            waitEvent(pending[previous_slot].?);
+            pending[previous_slot] = null;
+            in_flight[previous_slot] = null;
+
+            const host_chunk = staging[(previous_slot * staging_elements)..][0..chunk.number_of_elements];
+            try sink.consume(host_chunk);
+        }
+
+        slot = previous_slot;
+    }
+}
@@ -0,0 +1,128 @@
+const std = @import("std");
+const cl = @import("opencl");
+
+const core = @import("core");
+const Context = core.Context;
+const Pipeline = core.Pipeline;
+
+const tensor_module = @import("main.zig");
+const Tensor = tensor_module.Tensor;
+const TensorErrors = tensor_module.Errors;
+const CreateConfig = tensor_module.CreateConfig;
+
+const convertions = tensor_module.convertions;
+
+/// Complex tensor stored in planar form: one real tensor with the real parts and another one with
+/// the imaginary parts. `Tensor(Complex(T))` interleaves both parts and can't use vectors, the
+/// planar form runs every kernel with the vector width of `T`.
+///
+/// Both parts always have the same shape and layout.
+pub fn PlanarComplex(comptime T: type) type {
+    if (@typeInfo(T) != .float) {
+        @compileError("Planar complex tensors are only supported for floats");
+    }
+
+    const TensorT = Tensor(T);
+    const ComplexTensor = Tensor(core.types.Complex(T));
+
+    return struct {
+        real: *TensorT,
+        imag: *TensorT,
+
+        const Self = @This();
+
+        pub fn alloc(
+            context: *const Context,
+            pipeline: *Pipeline,
+            shape: []const u64,
+            config: CreateConfig,
+        ) TensorErrors!Self {
+            const real = try TensorT.alloc(context, pipeline, shape, config);
+            errdefer real.release(pipeline);
+
+            const imag = try TensorT.alloc(context, pipeline, shape, config);
+            errdefer imag.release(pipeline);
+
+            return .{ .real = real, .imag = imag };
+        }
+
+        pub fn release(self: Self, pipeline: *Pipeline) void {
+            self.real.release(pipeline);
+            self.imag.release(pipeline);
+        }
+
+        /// Copies the interleaved tensor `src`, which must have the same shape.
+        pub fn fromInterleaved(self: Self, pipeline: *Pipeline, src: *ComplexTensor) TensorErrors!void {
+            try convertions.toReal(core.types.Complex(T), pipeline, src, self.real, .real);
+            try convertions.toReal(core.types.Complex(T), pipeline, src, self.imag, .imag);
+        }
+
+        /// Copies the content to the interleaved tensor `dst`, which must have the same shape.
+        pub fn toInterleaved(self: Self, pipeline: *Pipeline, dst: *ComplexTensor) TensorErrors!void {
+            try convertions.toComplex(T, pipeline, self.real, dst, .real);
+            try convertions.toComplex(T, pipeline, self.imag, dst, .imag);
+        }
+
+        /// Whether `other` has the same shape and layout, so both can be processed element by
+        /// element over their whole buffers.
+        pub fn sameLayout(self: Self, other: Self) bool {
+            return std.mem.eql(u64, self.real.dimensions.shape, other.real.dimensions.shape) and
+                self.real.flags.vectors_enabled == other.real.flags.vectors_enabled and
+                self.real.memory_layout.row_pitch == other.real.memory_layout.row_pitch and
+                self.real.dimensions.number_of_elements == other.real.dimensions.number_of_elements;
+        }
+    };
+}
+
+// -----------------------------------------------------------------------------
+// Unit Tests
+const testing = std.testing;
+
+const memory = tensor_module.memory;
+
+test "PlanarComplex - interleaved round trip" {
+    const allocator = testing.allocator;
+
+    const context = try Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(core.types.ComplexF32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    const interleaved = try Tensor(core.types.ComplexF32).alloc(context, pipeline, &.{ 3, 5 }, .{});
+    defer interleaved.release(pipeline);
+
+    const other = try Tensor(core.types.ComplexF32).alloc(context, pipeline, &.{ 3, 5 }, .{});
+    defer other.release(pipeline);
+
+    const planar = try PlanarComplex(f32).alloc(context, pipeline, &.{ 3, 5 }, .{});
+    defer planar.release(pipeline);
+
+    var values: [15]core.types.ComplexF32 = undefined;
+    for (&values, 0..) |*v, i| {
+        v.* = .{ .real = @floatFromInt(i), .imag = -@as(f32, @floatFromInt(i)) };
+    }
+    try memory.readFromBuffer(core.types.ComplexF32, pipeline, interleaved, &values);
+
+    try planar.fromInterleaved(pipeline, interleaved);
+
+    var real: [15]f32 = undefined;
+    var imag: [15]f32 = undefined;
+    try memory.writeToBuffer(f32, pipeline, planar.real, &real);
+    try memory.writeToBuffer(f32, pipeline, planar.imag, &imag);
+
+    try planar.toInterleaved(pipeline, other);
+
+    var result: [15]core.types.ComplexF32 = undefined;
+    try memory.writeToBuffer(core.types.ComplexF32, pipeline, other, &result);
+    pipeline.waitAndCleanup();
+
+    for (values, real, imag, result) |v, r, i, c| {
+        try testing.expectEqual(v.real, r);
+        try testing.expectEqual(v.imag, i);
+        try testing.expectEqual(v, c);
+    }
+}
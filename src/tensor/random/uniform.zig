@@ -74,6 +74,8 @@ pub fn uniform(
         range_defined,
     );
 
+    tensor.markModified();
+
     const prev_events = pipeline.prevEvents();
 
     const setArg = cl.kernel.setArg;
@@ -1,6 +1,8 @@
+const std = @import("std");
 const cl = @import("opencl");
 
 const core = @import("core");
+const CommandQueue = core.CommandQueue;
 const KernelsSet = core.KernelsSet;
 const Pipeline = core.Pipeline;
 
@@ -12,89 +14,288 @@ const helpers = @import("helpers.zig");
 
 const transpose_cl_kernel: []const u8 = @embedFile("kernels/transpose.cl");
 
-pub fn transpose(
+const MAX_TILE_SIZE = 16;
+
+// Batch axes passed to `permute` by value, tensors with more of them upload a table
+const MAX_ARG_BATCH_AXES = 4;
+
+// Size, pitch in the tensor and pitch in the result of every batch axis, same layout as the
+// `permute_batch_axes` struct of the kernel
+const BatchAxes = extern struct {
+    axes: [MAX_ARG_BATCH_AXES * 3]u64,
+};
+
+/// Largest square tile, up to `MAX_TILE_SIZE`, whose work group fits in the device
+fn getTileSize(command_queue: *const CommandQueue) u64 {
+    var tile_size: u64 = MAX_TILE_SIZE;
+    while (tile_size > 1 and tile_size * tile_size > command_queue.max_work_group_size) {
+        tile_size /= 2;
+    }
+    return tile_size;
+}
+
+fn getKernel(
+    comptime T: type,
+    command_queue: *const CommandQueue,
+    kernel_id: KernelsSet.KernelsID,
+    kernel_name: []const u8,
+    transposed: bool,
+    batch_axes_in_buffer: bool,
+) TensorErrors!cl.kernel.Kernel {
+    const SUPPORTED_TYPES = core.types.SUPPORTED_TYPES;
+    const kernels_set = try KernelsSet.getKernelSet(command_queue, kernel_id, 2 * 2 * SUPPORTED_TYPES.len);
+
+    var kernel_index: usize = @intFromBool(batch_axes_in_buffer) * (2 * SUPPORTED_TYPES.len);
+    kernel_index += @intFromBool(transposed) * SUPPORTED_TYPES.len;
+    kernel_index += @as(usize, core.types.getTypeIndex(T));
+    if (kernels_set.kernels.?[kernel_index]) |v| return v;
+
+    var kernel: cl.kernel.Kernel = undefined;
+    var program: cl.program.Program = undefined;
+    const allocator = command_queue.context.allocator;
+    const extra_args: []u8 = try std.fmt.allocPrint(
+        allocator,
+        "-DTILE_SIZE={d} -DTRANSPOSED={d} -DBATCH_AXES_IN_BUFFER={d} -DMAX_ARG_BATCH_AXES={d}",
+        .{
+            getTileSize(command_queue),
+            @intFromBool(transposed),
+            @intFromBool(batch_axes_in_buffer),
+            MAX_ARG_BATCH_AXES,
+        },
+    );
+    defer allocator.free(extra_args);
+
+    try KernelsSet.compileKernel(
+        T,
+        command_queue,
+        .{
+            .vectors_enabled = false,
+            .kernel_name = kernel_name,
+            .extra_args = extra_args,
+        },
+        &kernel,
+        &program,
+        transpose_cl_kernel,
+    );
+
+    kernels_set.kernels.?[kernel_index] = kernel;
+    kernels_set.programs.?[kernel_index] = program;
+
+    return kernel;
+}
+
+/// `result_tensor[i_0, ..., i_n] = tensor[j_0, ..., j_n]` with `j_axes[d] = i_d`, so the shape of
+/// the result is `shape[axes[0]], ..., shape[axes[n]]`.
+///
+/// Runs as a batch of 2D copies over tiles of the last axis of `tensor` and the axis that ends
+/// last in the result. When they differ, the tiles are transposed in local memory, so both the
+/// reads and the writes are coalesced. The other axes form the batch.
+pub fn permute(
     comptime T: type,
     pipeline: *Pipeline,
     result_tensor: *Tensor(T),
     tensor: *Tensor(T),
-    dim0: u64,
-    dim1: u64,
+    axes: []const u64,
 ) TensorErrors!void {
-    const shape_a = result_tensor.dimensions.shape;
-    const shape_b = tensor.dimensions.shape;
-    if (shape_a.len != shape_b.len) {
-        return tensor_module.Errors.UnqualTensorsDimension;
-    } else if (dim0 >= shape_a.len or dim1 >= shape_a.len) {
-        return tensor_module.Errors.InvalidValue;
+    const shape = tensor.dimensions.shape;
+    const result_shape = result_tensor.dimensions.shape;
+    const ndim = shape.len;
+
+    if (result_shape.len != ndim or axes.len != ndim) {
+        return TensorErrors.UnqualTensorsDimension;
     } else if (tensor.dimensions.number_of_elements_without_padding != result_tensor.dimensions.number_of_elements_without_padding) {
-        return tensor_module.Errors.UnqualTensorsDimension;
-    } else if (shape_a[dim0] != shape_b[dim1] or shape_a[dim1] != shape_b[dim0]) {
-        return tensor_module.Errors.InvalidValue;
+        return TensorErrors.UnqualTensorsDimension;
+    }
+
+    var identity = true;
+    for (axes, result_shape, 0..) |axis, s, d| {
+        if (axis >= ndim or shape[axis] != s) return TensorErrors.InvalidValue;
+        for (axes[0..d]) |previous_axis| {
+            if (previous_axis == axis) return TensorErrors.InvalidValue;
+        }
+        identity = identity and (axis == d);
     }
 
-    if (dim0 == dim1) {
+    if (identity) {
         try tensor_module.memory.copy(T, pipeline, tensor, result_tensor);
         return;
     }
 
+    // Tiles are made of the last axis of the tensor (columns) and another one (rows), which is
+    // the axis that ends last in the result when it isn't already the last one
+    const col_axis = ndim - 1;
+    const transposed = (axes[ndim - 1] != col_axis);
+    const row_axis = if (transposed) axes[ndim - 1] else axes[ndim - 2];
+
+    const pitches = tensor.dimensions.pitches;
+    const result_pitches = result_tensor.dimensions.pitches;
+
+    // Pitch in the result of every axis of the tensor
     const command_queue = pipeline.command_queue;
-    const kernel = try KernelsSet.getClNoVectorKernel(
-        T,
-        command_queue,
-        .Transpose,
-        "transpose",
-        transpose_cl_kernel,
-        null,
-    );
+    const allocator = command_queue.context.allocator;
+
+    const axes_pitches = try allocator.alloc(u64, ndim);
+    defer allocator.free(axes_pitches);
+
+    for (axes, result_pitches) |axis, p| axes_pitches[axis] = p;
+
+    // Up to MAX_ARG_BATCH_AXES the table is a kernel argument, so most permutations (and every
+    // plain transpose) need no allocation nor upload
+    const number_of_batch_axes: u64 = ndim - 2;
+    const batch_axes_in_buffer = (number_of_batch_axes > MAX_ARG_BATCH_AXES);
+
+    var batch_axes_arg: BatchAxes = .{ .axes = @splat(0) };
+    const batch_axes: []u64 = if (batch_axes_in_buffer)
+        try allocator.alloc(u64, number_of_batch_axes * 3)
+    else
+        batch_axes_arg.axes[0..(number_of_batch_axes * 3)];
+    defer if (batch_axes_in_buffer) allocator.free(batch_axes);
+
+    var number_of_batches: u64 = 1;
+    var batch_index: usize = 0;
+    for (0..ndim) |axis| {
+        if (axis == col_axis or axis == row_axis) continue;
+
+        batch_axes[batch_index * 3] = shape[axis];
+        batch_axes[batch_index * 3 + 1] = pitches[axis];
+        batch_axes[batch_index * 3 + 2] = axes_pitches[axis];
+        number_of_batches *= shape[axis];
+        batch_index += 1;
+    }
 
-    const prev_events = pipeline.prevEvents();
+    // Released right after enqueueing, OpenCL keeps it alive until the kernel finishes
+    const batch_axes_buffer: ?cl.buffer.Mem = if (batch_axes_in_buffer) try cl.buffer.create(
+        command_queue.context.cl_context,
+        cl.buffer.MemFlag.read_only | cl.buffer.MemFlag.copy_host_ptr,
+        batch_axes.len * @sizeOf(u64),
+        batch_axes.ptr,
+    ) else null;
+    defer if (batch_axes_buffer) |v| cl.buffer.release(v);
+
+    const kernel = try getKernel(T, command_queue, .Transpose, "permute", transposed, batch_axes_in_buffer);
 
     const setArg = cl.kernel.setArg;
     const u64_size = @sizeOf(u64);
     const cl_mem_size = @sizeOf(cl.buffer.Mem);
-    const shape = tensor.dimensions.shape;
-    const ndim: u64 = @intCast(shape.len);
-    var dim0_: u64 = undefined;
-    var dim1_: u64 = undefined;
 
-    if (dim0 > dim1) {
-        dim0_ = dim1;
-        dim1_ = dim0;
+    const rows = shape[row_axis];
+    const cols = shape[col_axis];
+
+    try setArg(kernel, 0, cl_mem_size, @ptrCast(&tensor.buffer));
+    try setArg(kernel, 1, cl_mem_size, @ptrCast(&result_tensor.buffer));
+    if (batch_axes_buffer) |v| {
+        try setArg(kernel, 2, cl_mem_size, @ptrCast(&v));
     } else {
-        dim0_ = dim0;
-        dim1_ = dim1;
+        try setArg(kernel, 2, @sizeOf(BatchAxes), @ptrCast(&batch_axes_arg));
     }
+    try setArg(kernel, 3, u64_size, @ptrCast(&number_of_batch_axes));
+    try setArg(kernel, 4, u64_size, @ptrCast(&rows));
+    try setArg(kernel, 5, u64_size, @ptrCast(&cols));
+    try setArg(kernel, 6, u64_size, @ptrCast(&pitches[row_axis]));
+    try setArg(kernel, 7, u64_size, @ptrCast(&axes_pitches[row_axis]));
+    try setArg(kernel, 8, u64_size, @ptrCast(&axes_pitches[col_axis]));
+
+    const tile_size = getTileSize(command_queue);
+    const global_work_items = [3]u64{
+        number_of_batches,
+        std.mem.alignForward(u64, rows, tile_size),
+        std.mem.alignForward(u64, cols, tile_size),
+    };
+    const local_work_items = [3]u64{ 1, tile_size, tile_size };
+
+    result_tensor.markModified();
 
-    const row_pitch = tensor.memory_layout.row_pitch;
+    const prev_events = pipeline.prevEvents();
 
-    const tensor_width = tensor.work_configuration.global_work_items_without_vectors[2];
-    const tensor_height = tensor.work_configuration.global_work_items_without_vectors[1] * row_pitch;
+    var new_event: cl.event.Event = undefined;
+    try cl.kernel.enqueueNdRange(
+        command_queue.cl_command_queue,
+        kernel,
+        null,
+        &global_work_items,
+        &local_work_items,
+        prev_events,
+        &new_event,
+    );
+    errdefer helpers.releaseEvent(new_event);
 
-    try setArg(kernel, 0, cl_mem_size, @ptrCast(&tensor.buffer));
-    try setArg(kernel, 1, cl_mem_size, @ptrCast(&tensor.pitches_buffer));
+    try pipeline.append(&.{new_event});
+}
+
+/// Swaps the dimensions `dim0` and `dim1` of `tensor` into `result_tensor`, see `permute`.
+pub fn transpose(
+    comptime T: type,
+    pipeline: *Pipeline,
+    result_tensor: *Tensor(T),
+    tensor: *Tensor(T),
+    dim0: u64,
+    dim1: u64,
+) TensorErrors!void {
+    const ndim = tensor.dimensions.shape.len;
+    if (result_tensor.dimensions.shape.len != ndim) {
+        return TensorErrors.UnqualTensorsDimension;
+    } else if (dim0 >= ndim or dim1 >= ndim) {
+        return TensorErrors.InvalidValue;
+    }
+
+    const allocator = pipeline.command_queue.context.allocator;
+    const axes = try allocator.alloc(u64, ndim);
+    defer allocator.free(axes);
+
+    for (axes, 0..) |*axis, d| axis.* = d;
+    axes[dim0] = dim1;
+    axes[dim1] = dim0;
 
-    try setArg(kernel, 2, cl_mem_size, @ptrCast(&result_tensor.buffer));
-    try setArg(kernel, 3, cl_mem_size, @ptrCast(&result_tensor.pitches_buffer));
+    try permute(T, pipeline, result_tensor, tensor, axes);
+}
 
-    try setArg(kernel, 4, u64_size, @ptrCast(&row_pitch));
-    try setArg(kernel, 5, u64_size, @ptrCast(&tensor.memory_layout.slice_pitch));
-    try setArg(kernel, 6, u64_size, @ptrCast(&tensor_height));
-    try setArg(kernel, 7, u64_size, @ptrCast(&tensor_width));
+/// Transposes in place the last two dimensions of `tensor`, which must be equal. Every square
+/// matrix of the batch is swapped tile by tile with its mirror tile.
+pub fn transposeInPlace(
+    comptime T: type,
+    pipeline: *Pipeline,
+    tensor: *Tensor(T),
+) TensorErrors!void {
+    const shape = tensor.dimensions.shape;
+    const ndim = shape.len;
+    if (ndim < 2 or shape[ndim - 1] != shape[ndim - 2]) {
+        return TensorErrors.InvalidValue;
+    }
 
-    try setArg(kernel, 8, u64_size, @ptrCast(&dim0_));
-    try setArg(kernel, 9, u64_size, @ptrCast(&dim1_));
-    try setArg(kernel, 10, u64_size, @ptrCast(&ndim));
+    const command_queue = pipeline.command_queue;
+    const kernel = try getKernel(T, command_queue, .TransposeInPlace, "transpose_in_place", true, false);
 
-    const wekua_id = command_queue.wekua_id;
+    const setArg = cl.kernel.setArg;
+    const u64_size = @sizeOf(u64);
+    const cl_mem_size = @sizeOf(cl.buffer.Mem);
+
+    const n = shape[ndim - 1];
+
+    try setArg(kernel, 0, cl_mem_size, @ptrCast(&tensor.buffer));
+    try setArg(kernel, 1, u64_size, @ptrCast(&tensor.memory_layout.slice_pitch));
+    try setArg(kernel, 2, u64_size, @ptrCast(&tensor.memory_layout.row_pitch));
+    try setArg(kernel, 3, u64_size, @ptrCast(&n));
+
+    const tile_size = getTileSize(command_queue);
+    const aligned_n = std.mem.alignForward(u64, n, tile_size);
+    const global_work_items = [3]u64{
+        tensor.work_configuration.global_work_items_without_vectors[0],
+        aligned_n,
+        aligned_n,
+    };
+    const local_work_items = [3]u64{ 1, tile_size, tile_size };
+
+    tensor.markModified();
+
+    const prev_events = pipeline.prevEvents();
 
-    // TODO: Adapt code to use views
     var new_event: cl.event.Event = undefined;
     try cl.kernel.enqueueNdRange(
         command_queue.cl_command_queue,
         kernel,
         null,
-        &[1]u64{tensor.dimensions.number_of_elements},
-        tensor.work_configuration.local_work_items_1d[wekua_id .. wekua_id + 1],
+        &global_work_items,
+        &local_work_items,
         prev_events,
         &new_event,
     );
@@ -105,7 +306,6 @@ pub fn transpose(
 
 // -----------------------------------------------------------------------------
 // Unit Tests
-const std = @import("std");
 const testing = std.testing;
 
 const memory = @import("memory/main.zig");
@@ -669,3 +869,193 @@ test "transpose - double transpose returns original" {
         }
     }
 }
+
+test "permute - every permutation of a 3D tensor" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    // Sizes that are not multiples of the tile size
+    const shape = [_]u64{ 3, 19, 21 };
+    const number_of_elements = shape[0] * shape[1] * shape[2];
+
+    const tensor = try Tensor(f32).alloc(context, pipeline, &shape, .{});
+    defer tensor.release(pipeline);
+
+    const values = try allocator.alloc(f32, number_of_elements);
+    defer allocator.free(values);
+
+    for (values, 0..) |*v, i| v.* = @floatFromInt(i);
+    try memory.readFromBuffer(f32, pipeline, tensor, values);
+
+    const result_values = try allocator.alloc(f32, number_of_elements);
+    defer allocator.free(result_values);
+
+    const permutations = [_][3]u64{
+        .{ 0, 1, 2 }, .{ 0, 2, 1 }, .{ 1, 0, 2 },
+        .{ 1, 2, 0 }, .{ 2, 0, 1 }, .{ 2, 1, 0 },
+    };
+
+    for (permutations) |axes| {
+        const result_shape = [_]u64{ shape[axes[0]], shape[axes[1]], shape[axes[2]] };
+
+        const result = try Tensor(f32).alloc(context, pipeline, &result_shape, .{});
+        defer result.release(pipeline);
+
+        try permute(f32, pipeline, result, tensor, &axes);
+
+        try memory.writeToBuffer(f32, pipeline, result, result_values);
+        pipeline.waitAndCleanup();
+
+        var index: usize = 0;
+        for (0..result_shape[0]) |i| {
+            for (0..result_shape[1]) |j| {
+                for (0..result_shape[2]) |k| {
+                    var coords: [3]u64 = undefined;
+                    coords[axes[0]] = i;
+                    coords[axes[1]] = j;
+                    coords[axes[2]] = k;
+
+                    const expected = values[(coords[0] * shape[1] + coords[1]) * shape[2] + coords[2]];
+                    try testing.expectEqual(expected, result_values[index]);
+                    index += 1;
+                }
+            }
+        }
+    }
+
+    const result = try Tensor(f32).alloc(context, pipeline, &shape, .{});
+    defer result.release(pipeline);
+
+    try testing.expectError(TensorErrors.InvalidValue, permute(f32, pipeline, result, tensor, &.{ 0, 0, 2 }));
+    try testing.expectError(TensorErrors.InvalidValue, permute(f32, pipeline, result, tensor, &.{ 2, 1, 0 }));
+}
+
+test "permute - batch axes passed by value and in a buffer" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    if (!command_queue.isTypeSupported(f32)) return;
+
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    // 4 batch axes fit in the kernel argument, 5 don't
+    const shapes = [_][]const u64{
+        &.{ 2, 3, 1, 2, 5, 7 },
+        &.{ 2, 3, 1, 2, 2, 5, 7 },
+    };
+
+    for (shapes) |shape| {
+        const ndim = shape.len;
+
+        var number_of_elements: usize = 1;
+        for (shape) |s| number_of_elements *= s;
+
+        const tensor = try Tensor(f32).alloc(context, pipeline, shape, .{});
+        defer tensor.release(pipeline);
+
+        const values = try allocator.alloc(f32, number_of_elements);
+        defer allocator.free(values);
+
+        for (values, 0..) |*v, i| v.* = @floatFromInt(i);
+        try memory.readFromBuffer(f32, pipeline, tensor, values);
+
+        // Reversed axes, every axis moves
+        var axes: [7]u64 = undefined;
+        var result_shape: [7]u64 = undefined;
+        for (0..ndim) |d| {
+            axes[d] = ndim - 1 - d;
+            result_shape[d] = shape[axes[d]];
+        }
+
+        const result = try Tensor(f32).alloc(context, pipeline, result_shape[0..ndim], .{});
+        defer result.release(pipeline);
+
+        try permute(f32, pipeline, result, tensor, axes[0..ndim]);
+
+        const result_values = try allocator.alloc(f32, number_of_elements);
+        defer allocator.free(result_values);
+
+        try memory.writeToBuffer(f32, pipeline, result, result_values);
+        pipeline.waitAndCleanup();
+
+        for (result_values, 0..) |v, index| {
+            // Coordinates in the result are the reversed coordinates in the tensor
+            var rest = index;
+            var source_index: usize = 0;
+            var d = ndim;
+            while (d > 0) {
+                d -= 1;
+                const coordinate = rest % result_shape[d];
+                rest /= result_shape[d];
+
+                // Axis `ndim - 1 - d` of the tensor
+                var pitch: usize = 1;
+                for (shape[(ndim - d)..]) |s| pitch *= s;
+                source_index += coordinate * pitch;
+            }
+
+            try testing.expectEqual(values[source_index], v);
+        }
+    }
+}
+
+test "transposeInPlace - batch of square matrices" {
+    const allocator = testing.allocator;
+
+    const context = try core.Context.initFromDeviceType(allocator, null, cl.device.Type.all);
+    defer context.deinit();
+
+    const command_queue = &context.command_queues[0];
+    const pipeline = try Pipeline.init(command_queue);
+    defer pipeline.deinit();
+
+    inline for (.{ i32, core.types.ComplexF32 }) |T| {
+        if (command_queue.isTypeSupported(T)) {
+            const shape = [_]u64{ 2, 19, 19 };
+            const n = shape[1];
+
+            const tensor = try Tensor(T).alloc(context, pipeline, &shape, .{});
+            defer tensor.release(pipeline);
+
+            var values: [2 * n * n]T = undefined;
+            for (&values, 0..) |*v, i| {
+                const x: i32 = @intCast(i);
+                v.* = if (comptime core.types.isComplex(T))
+                    .{ .real = @floatFromInt(x), .imag = @floatFromInt(-x) }
+                else
+                    x;
+            }
+            try memory.readFromBuffer(T, pipeline, tensor, &values);
+
+            try transposeInPlace(T, pipeline, tensor);
+
+            var result: [2 * n * n]T = undefined;
+            try memory.writeToBuffer(T, pipeline, tensor, &result);
+            pipeline.waitAndCleanup();
+
+            for (0..shape[0]) |b| {
+                for (0..n) |i| {
+                    for (0..n) |j| {
+                        try testing.expectEqual(values[(b * n + j) * n + i], result[(b * n + i) * n + j]);
+                    }
+                }
+            }
+
+            const rectangular = try Tensor(T).alloc(context, pipeline, &.{ 3, 4 }, .{});
+            defer rectangular.release(pipeline);
+            try testing.expectError(TensorErrors.InvalidValue, transposeInPlace(T, pipeline, rectangular));
+        }
+    }
+}
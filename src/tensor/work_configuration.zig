@@ -16,6 +16,41 @@ pub const GemmAlgorithm = enum(u8) {
 };
 const MAX_BLOCK_SIZE = 64;
 
+/// Rectangular blocks of C computed by every work-item of the GEMM kernel for devices without
+/// local memory, rows x columns. They fit results whose rows and columns don't share a large
+/// power of two, where the square blocks would have to be small. K is stepped by the shorter side.
+pub const GemmRectangularBlock = enum(u8) {
+    @"4x8" = 0,
+    @"8x4" = 1,
+    @"8x16" = 2,
+    @"16x8" = 3,
+    @"16x32" = 4,
+    @"32x16" = 5,
+
+    pub fn getRows(self: GemmRectangularBlock) u16 {
+        return switch (self) {
+            .@"4x8" => 4,
+            .@"8x4", .@"8x16" => 8,
+            .@"16x8", .@"16x32" => 16,
+            .@"32x16" => 32,
+        };
+    }
+
+    pub fn getCols(self: GemmRectangularBlock) u16 {
+        return switch (self) {
+            .@"8x4" => 4,
+            .@"4x8", .@"16x8" => 8,
+            .@"8x16", .@"32x16" => 16,
+            .@"16x32" => 32,
+        };
+    }
+
+    /// Elements of K multiplied per step, K must be a multiple of it.
+    pub fn getDepth(self: GemmRectangularBlock) u16 {
+        return @min(self.getRows(), self.getCols());
+    }
+};
+
 global_work_items: [3]u64,
 global_work_items_without_vectors: [3]u64,
 
@@ -44,6 +79,26 @@ local_work_items_gemm_32x32: [][2]u64,
 global_work_items_gemm_64x64: [][2]u64,
 local_work_items_gemm_64x64: [][2]u64,
 
+// Null when no rectangular block beats the square one of `gemm_algorithm_per_device`
+gemm_rectangular_block_per_device: []?GemmRectangularBlock,
+global_work_items_gemm_4x8: [][2]u64,
+local_work_items_gemm_4x8: [][2]u64,
+
+global_work_items_gemm_8x4: [][2]u64,
+local_work_items_gemm_8x4: [][2]u64,
+
+global_work_items_gemm_8x16: [][2]u64,
+local_work_items_gemm_8x16: [][2]u64,
+
+global_work_items_gemm_16x8: [][2]u64,
+local_work_items_gemm_16x8: [][2]u64,
+
+global_work_items_gemm_16x32: [][2]u64,
+local_work_items_gemm_16x32: [][2]u64,
+
+global_work_items_gemm_32x16: [][2]u64,
+local_work_items_gemm_32x16: [][2]u64,
+
 
 pub fn init(
     self: *WorkConfiguration,
@@ -190,6 +245,79 @@ fn initGemm(
         }
         gemm_algorithm_per_device[i] = algorithm;
     }
+
+    try self.initGemmRectangularBlocks(T, arena_allocator, command_queues, gwi_h, gwi_w);
+}
+
+fn initGemmRectangularBlocks(
+    self: *WorkConfiguration,
+    comptime T: type,
+    arena_allocator: std.mem.Allocator,
+    command_queues: []CommandQueue,
+    gwi_h: u64,
+    gwi_w: u64,
+) error{OutOfMemory}!void {
+    const gemm_rectangular_block_per_device = try arena_allocator.alloc(?GemmRectangularBlock, command_queues.len);
+    self.gemm_rectangular_block_per_device = gemm_rectangular_block_per_device;
+
+    inline for (comptime std.meta.fieldNames(GemmRectangularBlock)) |algorithm_name| {
+        const block = @field(GemmRectangularBlock, algorithm_name);
+        const global_field_name = "global_work_items_gemm_" ++ algorithm_name;
+        const local_field_name = "local_work_items_gemm_" ++ algorithm_name;
+        if ((gwi_h % block.getRows() == 0) and (gwi_w % block.getCols() == 0)) {
+            @field(self, global_field_name) = try arena_allocator.alloc([2]u64, command_queues.len);
+            @field(self, local_field_name) = try arena_allocator.alloc([2]u64, command_queues.len);
+        } else {
+            @field(self, global_field_name) = &.{};
+            @field(self, local_field_name) = &.{};
+        }
+    }
+
+    for (command_queues, gemm_rectangular_block_per_device, 0..) |cmd, *best_block, i| {
+        best_block.* = null;
+
+        // Devices with local memory share the tiles of a work-group instead, their kernels only
+        // have square blocks
+        if (cmd.local_mem_type == .local) continue;
+
+        const vector_width: u64 = blk: {
+            if (comptime core.types.isComplex(T)) {
+                break :blk 1;
+            }else{
+                break :blk cmd.vector_widths[core.types.getTypeId(T)];
+            }
+        };
+
+        const square_block_length: u64 = @as(u64, 2) << @intCast(@intFromEnum(self.gemm_algorithm_per_device[i]));
+        var best_area = square_block_length * square_block_length;
+
+        inline for (comptime std.meta.fieldNames(GemmRectangularBlock)) |algorithm_name| {
+            const block = @field(GemmRectangularBlock, algorithm_name);
+            const rows: u64 = block.getRows();
+            const cols: u64 = block.getCols();
+            const area = rows * cols;
+
+            const g_values = @field(self, "global_work_items_gemm_" ++ algorithm_name);
+            const fits_in_cache = (vector_width * area * @sizeOf(T)) <= 16 * 1024;
+            if (g_values.len > 0 and fits_in_cache) {
+                g_values[i] = .{ gwi_h / rows, gwi_w / cols };
+                utils.calculateWorkItems(
+                    &g_values[i],
+                    &@field(self, "local_work_items_gemm_" ++ algorithm_name)[i],
+                    @min(area, cmd.max_work_group_size),
+                );
+
+                // Bigger blocks reuse more of what they load, between blocks of the same size the
+                // one with the orientation of C is kept
+                const better = (area > best_area) or
+                    (area == best_area and best_block.* != null and (rows > cols) == (gwi_h > gwi_w));
+                if (better) {
+                    best_block.* = block;
+                    best_area = area;
+                }
+            }
+        }
+    }
 }
 
 const WorkConfiguration = @This();
@@ -31,6 +31,66 @@ pub fn calculateWorkItems(
     }
 }
 
+fn powerOfTwoShare(budget: u64, dims: usize) u64 {
+    const budget_float: f64 = @floatFromInt(budget);
+    const dims_float: f64 = @floatFromInt(dims);
+    const share = std.math.pow(f64, budget_float, 1.0 / dims_float);
+
+    return std.math.floorPowerOfTwo(u64, @max(@as(u64, @intFromFloat(share + 1e-6)), 1));
+}
+
+/// Unlike `calculateWorkItems`, the local size doesn't have to divide the global one: the
+/// global size is rounded up to a multiple of the local one, so kernels launched with
+/// `padded_global_work_items` must discard the work items outside of `global_work_items`.
+///
+/// Dimensions smaller than their share of `max_work_group_size` take their whole size and
+/// give what they don't use to the others. The rest get powers of two, assigned from the last
+/// dimension (the contiguous one in wekua's kernels) to the first one, so prime sizes no
+/// longer end up with a local size of 1.
+pub fn calculatePaddedWorkItems(
+    global_work_items: []const u64,
+    padded_global_work_items: []u64,
+    local_work_items: []u64,
+    max_work_group_size: u64,
+) void {
+    var budget: u64 = @max(max_work_group_size, 1);
+    var unassigned: usize = global_work_items.len;
+
+    @memset(local_work_items, 0);
+    while (unassigned > 0) {
+        const share = powerOfTwoShare(budget, unassigned);
+
+        var assigned_in_pass = false;
+        for (global_work_items, local_work_items) |g, *l| {
+            if (l.* == 0 and g <= share) {
+                l.* = g;
+                budget /= g;
+                unassigned -= 1;
+                assigned_in_pass = true;
+            }
+        }
+
+        if (!assigned_in_pass) break;
+    }
+
+    var index: usize = global_work_items.len;
+    while (index > 0) {
+        index -= 1;
+
+        const l = &local_work_items[index];
+        if (l.* == 0) {
+            l.* = @min(powerOfTwoShare(budget, unassigned), global_work_items[index]);
+            budget /= l.*;
+            unassigned -= 1;
+        }
+    }
+
+    for (global_work_items, local_work_items, padded_global_work_items) |g, l, *p| {
+        p.* = std.math.divCeil(u64, g, l) catch unreachable;
+        p.* *= l;
+    }
+}
+
 pub fn ravelMultiIndex(
     multi_index: []const u64,
     shape: []const u64,
@@ -89,3 +149,22 @@ pub fn unravelIndex(
 test {
     _ = linked_list_module;
 }
+
+test "calculatePaddedWorkItems - prime and small dimensions" {
+    const testing = std.testing;
+
+    var padded: [3]u64 = undefined;
+    var local: [3]u64 = undefined;
+
+    calculatePaddedWorkItems(&.{ 1, 3, 1021 }, &padded, &local, 256);
+    try testing.expectEqualSlices(u64, &.{ 1, 3, 1024 }, &padded);
+    try testing.expectEqualSlices(u64, &.{ 1, 3, 64 }, &local);
+    try testing.expect(local[0] * local[1] * local[2] <= 256);
+
+    calculatePaddedWorkItems(&.{ 7, 13, 17 }, &padded, &local, 1024);
+    for (padded, local, [_]u64{ 7, 13, 17 }) |p, l, g| {
+        try testing.expect(p >= g);
+        try testing.expectEqual(@as(u64, 0), p % l);
+    }
+    try testing.expect(local[0] * local[1] * local[2] <= 1024);
+}